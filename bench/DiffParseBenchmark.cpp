@@ -0,0 +1,201 @@
+// Micro-benchmark: GitOutputParser::parseDiffs (string_view lines, hand-written
+// hunk header parser) against the previous GitManager::parseDiffs (substr per
+// line, std::regex for every "@@" header), plus the GitPatch index alone,
+// which is what callers that only read views pay.
+//
+// Usage: DiffParseBenchmark [lines] [iterations]
+
+#include "GitOutputParser.h"
+#include "GitPatch.h"
+#include "GitUtils.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <regex>
+#include <string>
+
+using namespace VersionTools;
+
+namespace {
+
+// The parser as it was in GitManager::parseDiffs
+std::vector<GitDiff> parseLegacyDiffs(const std::string& diffOutput) {
+    static const std::regex hunkRegex(R"(^@@ -(\d+)(?:,(\d+))? \+(\d+)(?:,(\d+))? @@)");
+
+    std::vector<GitDiff> diffs;
+    GitDiff* diff = nullptr;
+    GitDiffHunk* hunk = nullptr;
+    int oldLineNum = 0, newLineNum = 0;
+    int oldRemaining = 0, newRemaining = 0;
+
+    size_t pos = 0;
+    while (pos < diffOutput.size()) {
+        size_t end = diffOutput.find('\n', pos);
+        if (end == std::string::npos) {
+            end = diffOutput.size();
+        }
+        std::string line = diffOutput.substr(pos, end - pos);
+        pos = end + 1;
+
+        // "\ No newline at end of file" annotates the previous line
+        if (!line.empty() && line[0] == '\\') {
+            continue;
+        }
+
+        // Body lines are consumed by the hunk's counts, so a "--- x" deletion is never mistaken for a header
+        if (hunk && (oldRemaining > 0 || newRemaining > 0)) {
+            GitDiffLine diffLine;
+            char marker = line.empty() ? ' ' : line[0];
+            diffLine.content = line.empty() ? "" : line.substr(1);
+            if (marker == '+') {
+                diffLine.type = GitDiffLine::Type::Addition;
+                diffLine.newLineNumber = newLineNum++;
+                --newRemaining;
+            } else if (marker == '-') {
+                diffLine.type = GitDiffLine::Type::Deletion;
+                diffLine.oldLineNumber = oldLineNum++;
+                --oldRemaining;
+            } else {
+                diffLine.type = GitDiffLine::Type::Context;
+                diffLine.oldLineNumber = oldLineNum++;
+                diffLine.newLineNumber = newLineNum++;
+                --oldRemaining;
+                --newRemaining;
+            }
+            hunk->lines.push_back(std::move(diffLine));
+            continue;
+        }
+
+        if (GitUtils::startsWith(line, "diff --git ")) {
+            diffs.emplace_back();
+            diff = &diffs.back();
+            hunk = nullptr;
+
+            // "a/<path> b/<path>" - only unambiguous when both sides match, renames are fixed up below
+            std::string names = line.substr(11);
+            size_t half = names.size() >= 5 ? (names.size() - 5) / 2 : 0;
+            if (half > 0 && GitUtils::startsWith(names, "a/") && names.compare(2 + half, 3, " b/") == 0) {
+                diff->filePath = names.substr(2, half);
+            } else {
+                diff->filePath = GitUtils::unquotePath(names);
+            }
+            continue;
+        }
+
+        if (!diff) {
+            continue;
+        }
+
+        if (GitUtils::startsWith(line, "@@")) {
+            std::smatch matches;
+            if (std::regex_search(line, matches, hunkRegex)) {
+                GitDiffHunk newHunk;
+                newHunk.header = line;
+                newHunk.oldStart = std::stoi(matches[1]);
+                newHunk.oldCount = matches[2].matched ? std::stoi(matches[2]) : 1;
+                newHunk.newStart = std::stoi(matches[3]);
+                newHunk.newCount = matches[4].matched ? std::stoi(matches[4]) : 1;
+                diff->hunks.push_back(std::move(newHunk));
+                hunk = &diff->hunks.back();
+                oldLineNum = hunk->oldStart;
+                newLineNum = hunk->newStart;
+                oldRemaining = hunk->oldCount;
+                newRemaining = hunk->newCount;
+            }
+        } else if (GitUtils::startsWith(line, "new file mode")) {
+            diff->isNewFile = true;
+        } else if (GitUtils::startsWith(line, "deleted file mode")) {
+            diff->isDeletedFile = true;
+        } else if (GitUtils::startsWith(line, "rename from ")) {
+            diff->oldPath = GitUtils::unquotePath(line.substr(12));
+        } else if (GitUtils::startsWith(line, "rename to ")) {
+            diff->filePath = GitUtils::unquotePath(line.substr(10));
+        } else if ((GitUtils::startsWith(line, "+++ ") || (GitUtils::startsWith(line, "--- ") && diff->isDeletedFile)) &&
+                   line.compare(4, 9, "/dev/null") != 0) {
+            // git terminates names containing spaces with a tab on these lines
+            std::string path = line.substr(4);
+            if (!path.empty() && path.back() == '\t') {
+                path.pop_back();
+            }
+            path = GitUtils::unquotePath(path);
+            diff->filePath = GitUtils::startsWith(path, "a/") || GitUtils::startsWith(path, "b/") ? path.substr(2) : path;
+        } else if (GitUtils::startsWith(line, "Binary files ")) {
+            diff->isBinary = true;
+        }
+    }
+
+    return diffs;
+}
+
+// Many files with small hunks, so headers are a realistic share of the lines
+std::string generateDiff(size_t lines) {
+    std::string diff;
+    size_t written = 0;
+    for (int file = 0; written < lines; ++file) {
+        std::string path = "src/module" + std::to_string(file % 97) + "/component" + std::to_string(file) + ".cpp";
+        diff += "diff --git a/" + path + " b/" + path + "\n";
+        diff += "index 0123456..89abcde 100644\n--- a/" + path + "\n+++ b/" + path + "\n";
+        written += 4;
+        for (int hunk = 0; hunk < 8 && written < lines; ++hunk) {
+            int start = 1 + hunk * 40;
+            diff += "@@ -" + std::to_string(start) + ",6 +" + std::to_string(start) + ",7 @@ void function" +
+                    std::to_string(hunk) + "()\n";
+            diff += "     int value = compute();\n     if (value > limit) {\n-        return value;\n";
+            diff += "+        log(value);\n+        return limit;\n     }\n     return 0;\n }\n";
+            written += 9;
+        }
+    }
+    return diff;
+}
+
+size_t countLines(const std::vector<GitDiff>& diffs) {
+    size_t count = 0;
+    for (const auto& diff : diffs) {
+        for (const auto& hunk : diff.hunks) {
+            count += hunk.lines.size();
+        }
+    }
+    return count;
+}
+
+template <typename Parse>
+double measure(int iterations, size_t& parsed, Parse parse) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        parsed = countLines(parse());
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    std::string diff = generateDiff(lines);
+
+    size_t legacyCount = 0, parserCount = 0;
+    double legacyMs = measure(iterations, legacyCount, [&] { return parseLegacyDiffs(diff); });
+    double parserMs = measure(iterations, parserCount, [&] { return GitOutputParser::parseDiffs(diff); });
+
+    auto start = std::chrono::steady_clock::now();
+    size_t patchCount = 0;
+    for (int i = 0; i < iterations; ++i) {
+        patchCount = GitPatch::parse(diff).lineCount();
+    }
+    double patchMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    if (legacyCount != parserCount || patchCount != parserCount) {
+        std::cerr << "body line mismatch: legacy " << legacyCount << ", parser " << parserCount << "\n";
+        return 1;
+    }
+
+    std::cout << "diff lines:     " << lines << " (" << parserCount << " in hunks)\n";
+    std::cout << "legacy regex:   " << legacyMs << " ms\n";
+    std::cout << "hand-written:   " << parserMs << " ms\n";
+    std::cout << "speedup:        " << legacyMs / parserMs << "x\n";
+    std::cout << "GitPatch only:  " << patchMs << " ms (" << legacyMs / patchMs << "x)\n";
+    return 0;
+}
@@ -0,0 +1,349 @@
+// End-to-end benchmarks of the core read paths against a generated repository
+// (see SyntheticRepository.h), written as Google Benchmark compatible JSON so
+// runs can be compared between releases with the usual tooling.
+//
+// Usage: vt_bench [--repo DIR] [--regenerate] [--force-regenerate]
+//                 [--files N] [--commits N]
+//                 [--merge-every N] [--merge-width N] [--huge-diff-lines N]
+//                 [--refs N] [--dirty N] [--untracked N] [--seed N]
+//                 [--min-time SECONDS] [--filter TEXT] [--json FILE]
+//                 [--spawn-heap-mb N]
+//
+// DIR is deleted and regenerated when its spec differs, which vt_bench only
+// does for a directory it generated itself; --force-regenerate replaces any
+// DIR, after printing it.
+
+#include "CommitSearchIndex.h"
+#include "GitHistoryCache.h"
+#include "GitManager.h"
+#include "GitOutputParser.h"
+#include "GitPatch.h"
+#include "GitUtils.h"
+#include "SyntheticRepository.h"
+#include "SystemCommand.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace VersionTools;
+
+namespace {
+
+struct Result {
+    std::string name;
+    size_t iterations = 0;
+    double realMs = 0;  // Per iteration
+    double cpuMs = 0;   // This process only; git's own time is in realMs
+    std::map<std::string, double> counters;
+};
+
+struct Options {
+    std::string repository;
+    bool regenerate = false;
+    bool forceRegenerate = false;  // Also delete a DIR that vt_bench did not generate
+    double minTime = 0.5;
+    std::string filter;
+    std::string jsonPath;
+    size_t spawnHeapMb = 512;  // Resident heap for the spawn benchmark that models a large GUI process
+    SyntheticRepositorySpec spec;
+};
+
+// Runs body until minTime has passed (at least twice, after one warm-up run) and reports the mean
+Result measure(const std::string& name, double minTime, const std::function<void(Result&)>& body) {
+    Result result;
+    result.name = name;
+    body(result);
+    result.counters.clear();
+
+    auto wallStart = std::chrono::steady_clock::now();
+    std::clock_t cpuStart = std::clock();
+    double elapsed = 0;
+    while (result.iterations < 2 || elapsed < minTime) {
+        body(result);
+        ++result.iterations;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    }
+    double cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    result.realMs = elapsed * 1000.0 / result.iterations;
+    result.cpuMs = cpu * 1000.0 / result.iterations;
+    for (auto& [key, value] : result.counters) {
+        value /= static_cast<double>(result.iterations);
+    }
+    return result;
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+std::string toJson(const Options& options, const std::vector<Result>& results) {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::string out = "{\n  \"context\": {\n";
+    out += "    \"date\": " + jsonString(date) + ",\n";
+    out += "    \"executable\": \"vt_bench\",\n";
+    out += "    \"num_cpus\": " + std::to_string(std::thread::hardware_concurrency()) + ",\n";
+#ifdef NDEBUG
+    out += "    \"library_build_type\": \"release\",\n";
+#else
+    out += "    \"library_build_type\": \"debug\",\n";
+#endif
+    out += "    \"repository\": " + jsonString(options.repository) + ",\n";
+    out += "    \"repository_spec\": " + jsonString(options.spec.describe()) + "\n";
+    out += "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out += i == 0 ? "\n" : ",\n";
+        out += "    {\"name\": " + jsonString(result.name) + ", \"run_name\": " + jsonString(result.name);
+        out += ", \"run_type\": \"iteration\", \"iterations\": " + std::to_string(result.iterations);
+        out += ", \"real_time\": " + std::to_string(result.realMs);
+        out += ", \"cpu_time\": " + std::to_string(result.cpuMs) + ", \"time_unit\": \"ms\"";
+        for (const auto& [key, value] : result.counters) {
+            out += ", " + jsonString(key) + ": " + std::to_string(value);
+        }
+        out += "}";
+    }
+    out += "\n  ]\n}\n";
+    return out;
+}
+
+bool parseArguments(int argc, char* argv[], Options& options) {
+    SyntheticRepositorySpec& spec = options.spec;
+    std::map<std::string, size_t*> sizes = {
+        {"--files", &spec.files},         {"--commits", &spec.commits},
+        {"--merge-every", &spec.mergeEvery}, {"--merge-width", &spec.mergeWidth},
+        {"--huge-diff-lines", &spec.hugeDiffLines}, {"--refs", &spec.refs},
+        {"--dirty", &spec.dirtyFiles},    {"--untracked", &spec.untrackedFiles},
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--regenerate") {
+            options.regenerate = true;
+            continue;
+        }
+        if (arg == "--force-regenerate") {
+            options.regenerate = true;
+            options.forceRegenerate = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << "\n";
+            return false;
+        }
+        const char* value = argv[++i];
+        if (auto it = sizes.find(arg); it != sizes.end()) {
+            *it->second = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--seed") {
+            spec.seed = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--repo") {
+            options.repository = value;
+        } else if (arg == "--min-time") {
+            options.minTime = std::atof(value);
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--json") {
+            options.jsonPath = value;
+        } else if (arg == "--spawn-heap-mb") {
+            options.spawnHeapMb = std::strtoull(value, nullptr, 10);
+        } else {
+            std::cerr << "unknown option " << arg << "\n";
+            return false;
+        }
+    }
+
+    if (options.repository.empty()) {
+        // Keyed by the spec so differently shaped runs don't keep regenerating each other
+        size_t key = std::hash<std::string>()(spec.describe());
+        options.repository = (std::filesystem::temp_directory_path() / ("vt-bench-" + std::to_string(key))).string();
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        return 2;
+    }
+
+    std::string error;
+    if (options.forceRegenerate && !SyntheticRepository::isGenerated(options.repository)) {
+        std::cerr << "deleting " << options.repository << " to generate the benchmark repository there\n";
+    }
+    auto generateStart = std::chrono::steady_clock::now();
+    bool ready = options.regenerate
+                     ? SyntheticRepository::generate(options.repository, options.spec, error, options.forceRegenerate)
+                     : SyntheticRepository::ensure(options.repository, options.spec, error);
+    if (!ready) {
+        std::cerr << "could not build the benchmark repository: " << error << "\n";
+        return 1;
+    }
+    std::cerr << "repository: " << options.repository << " (" << options.spec.describe() << ", ready in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - generateStart).count() << " s)\n";
+
+    const std::string& path = options.repository;
+
+    // Raw inputs for the parser benchmarks, captured once
+    SystemCommand cmd;
+    cmd.setTimeout(0);
+    std::string logFormat = "--format=%H%x00%P%x00%an%x00%ae%x00%ct%x00%s";
+    std::string logOutput = cmd.execute("git", {"log", "-z", logFormat}, path).output;
+    std::string patchOutput = cmd.execute("git", {"diff", "-M", "HEAD~1", "HEAD"}, path).output;
+    std::string head = GitUtils::trim(cmd.execute("git", {"rev-parse", "HEAD"}, path).output);
+    // A file of the last ordinary commit, so it has some history to blame
+    auto changedPaths = GitUtils::split(
+        cmd.execute("git", {"diff-tree", "--no-commit-id", "--name-only", "-r", "HEAD~1"}, path).output, "\n");
+    std::string blamePath = changedPaths.empty() ? "" : changedPaths.front();
+
+    GitManager scanning(path);
+    scanning.setStatusCacheEnabled(false);
+    GitManager counting(path);
+    counting.setStatusCacheEnabled(false);
+    counting.setStatusLineStatsEnabled(true);
+    GitManager cached(path);
+    GitManager warmRefs(path);
+    auto searchHistory = GitHistoryCache::open(path, "", GitLogOptions::ShowMerges);
+    SystemCommand spawner;
+    std::vector<char> ballast;
+
+    std::vector<std::pair<std::string, std::function<void(Result&)>>> benchmarks = {
+        {"GitUtils::split/log", [&](Result& result) {
+             auto fields = GitUtils::split(logOutput, std::string(1, '\0'));
+             result.counters["bytes"] += static_cast<double>(logOutput.size());
+             result.counters["items"] += static_cast<double>(fields.size());
+         }},
+        {"GitPatch::parse/toDiffs", [&](Result& result) {
+             auto diffs = GitPatch::parse(patchOutput).toDiffs();
+             result.counters["bytes"] += static_cast<double>(patchOutput.size());
+             result.counters["items"] += static_cast<double>(diffs.size());
+         }},
+        {"GitPatch::Builder/64k-chunks", [&](Result& result) {
+             // The default budget, fed the way a pipe delivers it
+             GitPatch::Builder builder;
+             for (size_t pos = 0; pos < patchOutput.size(); pos += 65536) {
+                 builder.feed(std::string_view(patchOutput).substr(pos, 65536));
+             }
+             auto diffs = builder.finish().toDiffs();
+             result.counters["bytes"] += static_cast<double>(patchOutput.size());
+             result.counters["items"] += static_cast<double>(diffs.size());
+         }},
+        {"getStatus/scan", [&](Result& result) {
+             result.counters["items"] += static_cast<double>(scanning.getStatus().changes.size());
+         }},
+        {"getStatus/scan+numstat", [&](Result& result) {
+             result.counters["items"] += static_cast<double>(counting.getStatus().changes.size());
+         }},
+        {"getStatus/cached", [&](Result& result) {
+             result.counters["items"] += static_cast<double>(cached.getStatus().changes.size());
+         }},
+        {"getCommitHistory/1000", [&](Result& result) {
+             result.counters["items"] += static_cast<double>(scanning.getCommitHistory(1000).size());
+         }},
+        {"getCommitHistory/all", [&](Result& result) {
+             auto commits = scanning.getCommitHistory(0, GitLogOptions::ShowMerges);
+             result.counters["items"] += static_cast<double>(commits.size());
+         }},
+        {"getBranches/cold", [&](Result& result) {
+             // A fresh manager has no ref snapshot yet
+             GitManager manager(path);
+             result.counters["items"] += static_cast<double>(manager.getBranches(true).size());
+         }},
+        {"getBranches/warm", [&](Result& result) {
+             result.counters["items"] += static_cast<double>(warmRefs.getBranches(true).size());
+         }},
+        {"getCommitDiffAll/HEAD", [&](Result& result) {
+             // A fresh manager: a long-lived one answers from its object cache after the first run
+             GitManager manager(path);
+             result.counters["items"] += static_cast<double>(manager.getCommitDiffAll(head).size());
+         }},
+        {"getCommitDiffAll/HEAD/unlimited", [&](Result& result) {
+             GitManager manager(path);
+             auto diffs = manager.getCommitDiffAll(head, GitDiffBudget::unlimited());
+             result.counters["items"] += static_cast<double>(diffs.size());
+         }},
+        {"getCommitDiffAll/HEAD/cached", [&](Result& result) {
+             result.counters["items"] += static_cast<double>(warmRefs.getCommitDiffAll(head).size());
+         }},
+        {"blame/cold", [&](Result& result) {
+             // A fresh manager has an empty blame cache
+             GitManager manager(path);
+             auto blame = manager.blame(blamePath, head);
+             result.counters["items"] += blame ? static_cast<double>(blame->hunks.size()) : 0;
+         }},
+        {"blame/cached", [&](Result& result) {
+             auto blame = warmRefs.blame(blamePath, head);
+             result.counters["items"] += blame ? static_cast<double>(blame->hunks.size()) : 0;
+         }},
+        {"CommitSearchIndex/build", [&](Result& result) {
+             // Subjects and authors only; details are read by the background tasks
+             CommitSearchIndex index(searchHistory);
+             result.counters["items"] += static_cast<double>(searchHistory ? searchHistory->size() : 0);
+         }},
+        {"searchCommits/warm", [&](Result& result) {
+             auto hits = warmRefs.searchCommits("change", 0, 50);
+             result.counters["items"] += static_cast<double>(hits.commits.size());
+         }},
+        {"SystemCommand/spawn", [&](Result& result) {
+             result.counters["items"] += spawner.execute("git", {"--version"}).success() ? 1 : 0;
+         }},
+        // Last: the ballast stays resident, as a GUI's heap would, and copying its page tables is what fork pays
+        {"SystemCommand/spawn+heap", [&](Result& result) {
+             if (ballast.empty()) {
+                 ballast.assign(std::max<size_t>(options.spawnHeapMb, 1) << 20, 1);
+             }
+             result.counters["items"] += spawner.execute("git", {"--version"}).success() ? 1 : 0;
+         }},
+    };
+
+    std::vector<Result> results;
+    std::printf("%-32s %10s %12s %12s %12s\n", "benchmark", "iterations", "real ms", "cpu ms", "items");
+    for (const auto& [name, body] : benchmarks) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        Result result = measure(name, options.minTime, body);
+        std::printf("%-32s %10zu %12.3f %12.3f %12.0f\n", name.c_str(), result.iterations, result.realMs,
+                    result.cpuMs, result.counters["items"]);
+        std::fflush(stdout);
+        results.push_back(std::move(result));
+    }
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream json(options.jsonPath, std::ios::trunc);
+        json << toJson(options, results);
+        if (!json) {
+            std::cerr << "could not write " << options.jsonPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
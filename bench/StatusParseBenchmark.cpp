@@ -0,0 +1,137 @@
+// Micro-benchmark: GitStatusParser (porcelain v2 -z, string_view) against the
+// previous porcelain v1 parser (line split + std::regex + substr copies).
+//
+// Usage: StatusParseBenchmark [entries] [iterations]
+
+#include "GitStatusParser.h"
+#include "GitUtils.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <regex>
+#include <string>
+
+using namespace VersionTools;
+
+namespace {
+
+// The v1 parser as it was in GitManager::getStatus / parseFileChange
+GitStatus parseLegacyV1(const std::string& output) {
+    GitStatus status;
+    auto lines = GitUtils::split(output, "\n");
+
+    if (!lines.empty() && lines[0].substr(0, 2) == "##") {
+        std::string branchLine = lines[0].substr(3);
+        std::regex branchRegex(R"(([^.]+)(?:\.\.\.([^[\s]+))?\s*(?:\[([^\]]+)\])?)");
+        std::smatch matches;
+        if (std::regex_search(branchLine, matches, branchRegex)) {
+            status.currentBranch = matches[1].str();
+            if (matches[2].matched) {
+                status.upstreamBranch = matches[2].str();
+            }
+            if (matches[3].matched) {
+                std::string trackInfo = matches[3].str();
+                std::regex trackRegex(R"(ahead (\d+)|behind (\d+))");
+                std::sregex_iterator iter(trackInfo.begin(), trackInfo.end(), trackRegex);
+                for (std::sregex_iterator end; iter != end; ++iter) {
+                    if ((*iter)[1].matched) {
+                        status.aheadCount = std::stoi((*iter)[1].str());
+                    } else if ((*iter)[2].matched) {
+                        status.behindCount = std::stoi((*iter)[2].str());
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t i = 1; i < lines.size(); ++i) {
+        const std::string& line = lines[i];
+        if (line.length() < 3) {
+            continue;
+        }
+        GitFileChange change;
+        change.filePath = line.substr(3);
+        if (change.filePath.find(" -> ") != std::string::npos) {
+            auto parts = GitUtils::split(change.filePath, " -> ");
+            if (parts.size() == 2) {
+                change.oldPath = parts[0];
+                change.filePath = parts[1];
+            }
+        }
+        change.filePath = GitUtils::unquotePath(change.filePath);
+        if (!change.oldPath.empty()) {
+            change.oldPath = GitUtils::unquotePath(change.oldPath);
+        }
+        GitUtils::applyStatusCodes(line[0], line[1], change);
+        status.changes.push_back(change);
+    }
+
+    GitUtils::summarizeStatus(status);
+    return status;
+}
+
+// Equivalent v1 and v2 outputs: mostly worktree edits, some staged, renames and untracked files
+void generateOutputs(size_t entries, std::string& v1, std::string& v2) {
+    v1 = "## main...origin/main [ahead 3, behind 12]\n";
+    v2 = std::string("# branch.oid 0123456789abcdef0123456789abcdef01234567") + '\0' + "# branch.head main" + '\0' +
+         "# branch.upstream origin/main" + '\0' + "# branch.ab +3 -12" + '\0';
+
+    const std::string hash = "0123456789abcdef0123456789abcdef01234567";
+    for (size_t i = 0; i < entries; ++i) {
+        std::string path = "src/module" + std::to_string(i % 97) + "/component" + std::to_string(i) + ".cpp";
+        switch (i % 10) {
+            case 0:
+                v1 += "M  " + path + "\n";
+                v2 += "1 M. N... 100644 100644 100644 " + hash + " " + hash + " " + path + '\0';
+                break;
+            case 1:
+                v1 += "R  old/" + path + " -> " + path + "\n";
+                v2 += "2 R. N... 100644 100644 100644 " + hash + " " + hash + " R100 " + path + '\0' + "old/" + path +
+                      '\0';
+                break;
+            case 2:
+            case 3:
+                v1 += "?? " + path + "\n";
+                v2 += "? " + path + '\0';
+                break;
+            default:
+                v1 += " M " + path + "\n";
+                v2 += "1 .M N... 100644 100644 100644 " + hash + " " + hash + " " + path + '\0';
+                break;
+        }
+    }
+}
+
+template <typename Parse>
+double measure(int iterations, size_t& parsed, Parse parse) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        parsed = parse().changes.size();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t entries = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    std::string v1, v2;
+    generateOutputs(entries, v1, v2);
+
+    size_t legacyCount = 0, parserCount = 0;
+    double legacyMs = measure(iterations, legacyCount, [&] { return parseLegacyV1(v1); });
+    double parserMs = measure(iterations, parserCount, [&] { return GitStatusParser::parse(v2); });
+
+    if (legacyCount != entries || parserCount != entries) {
+        std::cerr << "entry count mismatch: legacy " << legacyCount << ", v2 " << parserCount << "\n";
+        return 1;
+    }
+
+    std::cout << "entries:        " << entries << "\n";
+    std::cout << "legacy v1:      " << legacyMs << " ms (" << legacyMs * 1e6 / entries << " ns/entry)\n";
+    std::cout << "porcelain v2:   " << parserMs << " ms (" << parserMs * 1e6 / entries << " ns/entry)\n";
+    std::cout << "speedup:        " << legacyMs / parserMs << "x\n";
+    return 0;
+}
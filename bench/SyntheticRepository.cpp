@@ -0,0 +1,276 @@
+#include "SyntheticRepository.h"
+#include "SystemCommand.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace VersionTools {
+
+namespace {
+
+constexpr size_t DIRECTORIES = 64;
+constexpr int64_t START_TIME = 1577836800;  // 2020-01-01 UTC, then one commit a minute
+constexpr const char* STAMP_FILE = "vt-bench-spec";
+
+// splitmix64: the same sequence everywhere, unlike the standard distributions
+uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+std::string filePath(size_t index) {
+    char path[48];
+    std::snprintf(path, sizeof(path), "dir%02zu/file%05zu.txt", index % DIRECTORIES, index);
+    return path;
+}
+
+bool run(const std::string& directory, const std::vector<std::string>& args, std::string& error) {
+    SystemCommand cmd;
+    cmd.setTimeout(0);
+    auto result = cmd.execute("git", args, directory);
+    if (!result.success()) {
+        error = "git " + args.front() + " failed: " + result.error;
+        return false;
+    }
+    return true;
+}
+
+// Writes the fast-import stream for the spec straight into git's stdin
+class StreamWriter {
+public:
+    StreamWriter(FILE* out, const SyntheticRepositorySpec& spec)
+        : out(out), spec(spec), versions(spec.files, 0), random(spec.seed) {}
+
+    void write() {
+        std::vector<size_t> mainline;
+        size_t mainTip = 0;
+        for (size_t c = 0; c < spec.commits; ++c) {
+            if (c == 0) {
+                std::vector<size_t> all(spec.files);
+                for (size_t i = 0; i < spec.files; ++i) {
+                    all[i] = i;
+                }
+                mainTip = commit("refs/heads/main", 0, {}, all, "Initial import");
+            } else if (c + 1 == spec.commits && spec.hugeDiffLines > 0 && spec.files > 0) {
+                mainTip = hugeCommit(mainTip);
+            } else if (spec.mergeEvery > 0 && spec.mergeWidth > 0 && c % spec.mergeEvery == 0) {
+                mainTip = merge(mainTip, c);
+            } else {
+                mainTip = commit("refs/heads/main", mainTip, {}, pickFiles(), "Change " + std::to_string(c));
+            }
+            mainline.push_back(mainTip);
+        }
+
+        for (size_t i = 0; i < spec.refs && !mainline.empty(); ++i) {
+            size_t target = mainline[(i * 7919) % mainline.size()];
+            const char* kind = i % 2 == 0 ? "refs/heads/bench/branch-" : "refs/tags/bench-";
+            std::fprintf(out, "reset %s%zu\nfrom :%zu\n\n", kind, i / 2, target);
+        }
+    }
+
+private:
+    FILE* out;
+    const SyntheticRepositorySpec& spec;
+    std::vector<uint32_t> versions;
+    uint64_t random;
+    size_t nextMark = 1;
+    int64_t time = START_TIME;
+
+    uint64_t next() {
+        random = mix(random);
+        return random;
+    }
+
+    // Line j keeps the newest version that touched it: each bump rewrites the lines j with j % 10 == version % 10
+    std::string content(size_t file, uint32_t version) const {
+        std::string text;
+        text.reserve(spec.linesPerFile * 64);
+        char line[96];
+        for (size_t j = 0; j < spec.linesPerFile; ++j) {
+            uint32_t slot = static_cast<uint32_t>(j % 10);
+            uint32_t touched = version >= slot ? version - (version - slot) % 10 : 0;
+            uint64_t value = mix(spec.seed ^ (uint64_t(file) << 32) ^ (uint64_t(j) << 12) ^ touched);
+            std::snprintf(line, sizeof(line), "%06zu %016llx lorem ipsum dolor sit amet %u\n", j,
+                          static_cast<unsigned long long>(value), touched);
+            text += line;
+        }
+        return text;
+    }
+
+    std::vector<size_t> pickFiles() {
+        std::vector<size_t> files;
+        for (size_t i = 0; i < spec.filesPerCommit && spec.files > 0; ++i) {
+            size_t file = next() % spec.files;
+            ++versions[file];
+            files.push_back(file);
+        }
+        return files;
+    }
+
+    void data(const std::string& text) {
+        std::fprintf(out, "data %zu\n", text.size());
+        std::fwrite(text.data(), 1, text.size(), out);
+        std::fputc('\n', out);
+    }
+
+    void header(const std::string& ref, size_t from, const std::vector<size_t>& merges, const std::string& message) {
+        size_t mark = nextMark++;
+        std::fprintf(out, "commit %s\nmark :%zu\n", ref.c_str(), mark);
+        std::fprintf(out, "author Bench Author <author@example.com> %lld +0000\n", static_cast<long long>(time));
+        std::fprintf(out, "committer Bench Committer <committer@example.com> %lld +0000\n",
+                     static_cast<long long>(time));
+        time += 60;
+        data(message);
+        if (from != 0) {
+            std::fprintf(out, "from :%zu\n", from);
+        }
+        for (size_t parent : merges) {
+            std::fprintf(out, "merge :%zu\n", parent);
+        }
+    }
+
+    void modify(const std::string& path, const std::string& text) {
+        std::fprintf(out, "M 100644 inline %s\n", path.c_str());
+        data(text);
+    }
+
+    size_t commit(const std::string& ref, size_t from, const std::vector<size_t>& merges,
+                  const std::vector<size_t>& files, const std::string& message) {
+        header(ref, from, merges, message);
+        for (size_t file : files) {
+            modify(filePath(file), content(file, versions[file]));
+        }
+        std::fputc('\n', out);
+        return nextMark - 1;
+    }
+
+    // Side branches off the tip, merged back in one commit carrying all their changes
+    size_t merge(size_t mainTip, size_t c) {
+        std::vector<size_t> sides;
+        std::vector<size_t> changed;
+        for (size_t k = 0; k < spec.mergeWidth; ++k) {
+            auto files = pickFiles();
+            changed.insert(changed.end(), files.begin(), files.end());
+            sides.push_back(commit("refs/heads/bench/side-" + std::to_string(k), mainTip, {}, files,
+                                   "Side change " + std::to_string(c) + "." + std::to_string(k)));
+        }
+        return commit("refs/heads/main", mainTip, sides, changed,
+                      "Merge " + std::to_string(sides.size()) + " branches at " + std::to_string(c));
+    }
+
+    size_t hugeCommit(size_t mainTip) {
+        header("refs/heads/main", mainTip, {}, "Rewrite " + filePath(0));
+        std::string text;
+        text.reserve(spec.hugeDiffLines * 48);
+        char line[64];
+        for (size_t j = 0; j < spec.hugeDiffLines; ++j) {
+            std::snprintf(line, sizeof(line), "huge %08zu %016llx\n", j,
+                          static_cast<unsigned long long>(mix(spec.seed * 31 + j)));
+            text += line;
+        }
+        modify(filePath(0), text);
+        std::fputc('\n', out);
+        return nextMark - 1;
+    }
+};
+
+bool dirtyWorktree(const std::filesystem::path& root, const SyntheticRepositorySpec& spec, std::string& error) {
+    for (size_t i = 0; i < spec.dirtyFiles && spec.files > 0; ++i) {
+        size_t file = (i * spec.files) / spec.dirtyFiles;
+        std::ofstream edit(root / filePath(file), std::ios::app | std::ios::binary);
+        edit << "worktree edit " << i << "\n";
+        if (!edit) {
+            error = "Could not edit " + filePath(file);
+            return false;
+        }
+    }
+
+    std::filesystem::create_directories(root / "untracked");
+    for (size_t i = 0; i < spec.untrackedFiles; ++i) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "new%05zu.txt", i);
+        std::ofstream added(root / "untracked" / name, std::ios::binary);
+        added << "untracked " << i << "\n";
+        if (!added) {
+            error = std::string("Could not create ") + name;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+std::string SyntheticRepositorySpec::describe() const {
+    std::ostringstream text;
+    text << "files=" << files << " lines=" << linesPerFile << " commits=" << commits
+         << " filesPerCommit=" << filesPerCommit << " mergeEvery=" << mergeEvery << " mergeWidth=" << mergeWidth
+         << " hugeDiffLines=" << hugeDiffLines << " refs=" << refs << " dirty=" << dirtyFiles
+         << " untracked=" << untrackedFiles << " seed=" << seed;
+    return text.str();
+}
+
+bool SyntheticRepository::ensure(const std::string& path, const SyntheticRepositorySpec& spec, std::string& error) {
+    std::ifstream stamp(std::filesystem::path(path) / ".git" / STAMP_FILE);
+    std::string described;
+    if (stamp && std::getline(stamp, described) && described == spec.describe()) {
+        return true;
+    }
+    return generate(path, spec, error);
+}
+
+bool SyntheticRepository::isGenerated(const std::string& path) {
+    std::error_code statError;
+    return std::filesystem::is_regular_file(std::filesystem::path(path) / ".git" / STAMP_FILE, statError);
+}
+
+bool SyntheticRepository::generate(const std::string& path, const SyntheticRepositorySpec& spec, std::string& error,
+                                   bool force) {
+    std::filesystem::path root(path);
+    std::error_code statError;
+    bool occupied = std::filesystem::exists(root, statError) &&
+                    !(std::filesystem::is_directory(root, statError) && std::filesystem::is_empty(root, statError));
+    if (occupied && !force && !isGenerated(path)) {
+        error = path + " exists and was not generated by vt_bench (no .git/" + STAMP_FILE +
+                "); refusing to delete it. Pass --force-regenerate to replace it anyway";
+        return false;
+    }
+    std::error_code removeError;
+    std::filesystem::remove_all(root, removeError);
+    std::filesystem::create_directories(root);
+
+    if (!run(path, {"init", "-q"}, error) || !run(path, {"symbolic-ref", "HEAD", "refs/heads/main"}, error)) {
+        return false;
+    }
+
+    std::string importCommand = "git -C \"" + path + "\" fast-import --quiet";
+    FILE* importer = popen(importCommand.c_str(), "w");
+    if (!importer) {
+        error = "Could not start git fast-import";
+        return false;
+    }
+    StreamWriter(importer, spec).write();
+    if (pclose(importer) != 0) {
+        error = "git fast-import failed";
+        return false;
+    }
+
+    if (!run(path, {"checkout", "-q", "-f", "main"}, error) || !dirtyWorktree(root, spec, error)) {
+        return false;
+    }
+
+    std::ofstream stamp(root / ".git" / STAMP_FILE, std::ios::trunc);
+    stamp << spec.describe() << "\n";
+    return static_cast<bool>(stamp);
+}
+
+}
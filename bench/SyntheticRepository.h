@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace VersionTools {
+
+// Shape of a generated benchmark repository. The same spec always produces
+// the same commits (fixed authors, dates and contents from a seeded
+// generator), so object ids and timings are comparable between runs and
+// machines.
+struct SyntheticRepositorySpec {
+    size_t files = 2000;           // Tracked files, spread over 64 directories
+    size_t linesPerFile = 40;
+    size_t commits = 5000;         // First-parent commits on main
+    size_t filesPerCommit = 3;     // Files each commit rewrites about a tenth of
+    size_t mergeEvery = 50;        // A merge every that many commits; 0 for linear history
+    size_t mergeWidth = 3;         // Side branches per merge; above 1 the merges are octopus merges
+    size_t hugeDiffLines = 200000; // Lines the last commit rewrites in one file; 0 for none
+    size_t refs = 500;             // Extra branches and tags, half each, spread over the history
+    size_t dirtyFiles = 200;       // Worktree edits left after checkout
+    size_t untrackedFiles = 100;
+    uint64_t seed = 1;
+
+    // One line naming every field, stored in the repository to tell whether it can be reused
+    std::string describe() const;
+};
+
+class SyntheticRepository {
+public:
+    // Builds the repository at path with git fast-import, or reuses the one
+    // already there when it was built from the same spec. Returns false and
+    // sets error when git fails or path is not safe to replace (see generate).
+    static bool ensure(const std::string& path, const SyntheticRepositorySpec& spec, std::string& error);
+    // Always rebuilds; path is deleted first. Only a missing or empty directory,
+    // or one a previous run generated (it carries the vt-bench stamp), is
+    // deleted unless force is set: anything else may be a real checkout.
+    static bool generate(const std::string& path, const SyntheticRepositorySpec& spec, std::string& error,
+                         bool force = false);
+    // Whether path holds a repository this class generated
+    static bool isGenerated(const std::string& path);
+};
+
+}
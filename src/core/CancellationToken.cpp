@@ -0,0 +1,112 @@
+#include "CancellationToken.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace VersionTools {
+
+struct CancellationToken::State {
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    std::condition_variable callbacksDone;
+    std::vector<std::pair<uint64_t, std::function<void()>>> callbacks;
+    uint64_t nextId = 1;
+    bool running = false;  // cancel() is invoking the callbacks outside the lock
+    std::thread::id runningThread;
+};
+
+namespace {
+
+thread_local std::shared_ptr<void> currentState;
+
+}
+
+CancellationToken::CancellationToken() : state(std::make_shared<State>()) {}
+
+CancellationToken::CancellationToken(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+void CancellationToken::cancel() {
+    if (!state) {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, std::function<void()>>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->cancelled.exchange(true)) {
+            return;
+        }
+        callbacks.swap(state->callbacks);
+        state->running = true;
+        state->runningThread = std::this_thread::get_id();
+    }
+
+    for (auto& entry : callbacks) {
+        entry.second();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->running = false;
+    }
+    state->callbacksDone.notify_all();
+}
+
+bool CancellationToken::isCancelled() const {
+    return state && state->cancelled.load(std::memory_order_acquire);
+}
+
+uint64_t CancellationToken::subscribe(std::function<void()> callback) {
+    if (!state || !callback) {
+        return 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->cancelled) {
+            uint64_t id = state->nextId++;
+            state->callbacks.emplace_back(id, std::move(callback));
+            return id;
+        }
+    }
+    callback();
+    return 0;
+}
+
+void CancellationToken::unsubscribe(uint64_t id) {
+    if (!state || id == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    auto& callbacks = state->callbacks;
+    for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+        if (it->first == id) {
+            callbacks.erase(it);
+            return;
+        }
+    }
+
+    // Already handed to cancel(); it may still be running on another thread
+    if (state->runningThread != std::this_thread::get_id()) {
+        state->callbacksDone.wait(lock, [this] { return !state->running; });
+    }
+}
+
+CancellationToken CancellationToken::current() {
+    return CancellationToken(std::static_pointer_cast<State>(currentState));
+}
+
+CancellationToken::Scope::Scope(CancellationToken token)
+    : previous(std::static_pointer_cast<State>(currentState)) {
+    currentState = std::move(token.state);
+}
+
+CancellationToken::Scope::~Scope() {
+    currentState = std::move(previous);
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace VersionTools {
+
+// Shared cancellation flag. Copies refer to the same flag, so the caller keeps
+// one copy and hands another to the work; cancel() is sticky and may be
+// called from any thread.
+//
+// While a Scope is alive the token is the thread's current() token, and every
+// SystemCommand started on that thread subscribes to it: cancelling kills the
+// running git process instead of waiting for it to finish. CommandScheduler
+// installs a Scope around each task it runs.
+class CancellationToken {
+    struct State;
+
+public:
+    CancellationToken();
+
+    void cancel();
+    bool isCancelled() const;
+
+    // Runs callback on the cancelling thread, or right away when the token is
+    // already cancelled (in which case 0 is returned). Pass the id to
+    // unsubscribe() before anything the callback touches goes away; a callback
+    // running concurrently is waited for.
+    uint64_t subscribe(std::function<void()> callback);
+    void unsubscribe(uint64_t id);
+
+    // The token of the innermost Scope on this thread; a token that is never
+    // cancelled when there is none
+    static CancellationToken current();
+
+    class Scope {
+    public:
+        explicit Scope(CancellationToken token);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        std::shared_ptr<State> previous;
+    };
+
+private:
+    explicit CancellationToken(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> state;
+};
+
+}
@@ -0,0 +1,292 @@
+#include "CommandScheduler.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace VersionTools {
+
+namespace {
+
+constexpr size_t LANE_COUNT = 3;
+
+struct QueuedTask {
+    TaskOptions options;
+    std::function<void()> work;
+    std::function<void()> dropped;  // Instead of work when cancelAll() drops the task; empty when it must run
+};
+
+}
+
+class CommandScheduler::Impl {
+public:
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;  // Signalled after every task while someone is in waitIdle()
+    size_t idleWaiters = 0;
+    std::deque<QueuedTask> lanes[LANE_COUNT];
+    std::set<std::string> writing;              // Repositories with a Write task running
+    std::map<std::string, size_t> reading;      // Read tasks running per repository
+    std::list<TaskOptions*> running;
+    std::vector<std::thread> workers;
+    size_t interactiveRunning = 0;
+    bool stopping = false;
+
+    // writesQueued: repositories with a Write task waiting, which holds back newer reads of them
+    bool runnable(const QueuedTask& task, const std::set<std::string>& writesQueued) const {
+        if (task.options.preemptible && (interactiveRunning > 0 || !interactiveLane().empty())) {
+            return false;
+        }
+        const std::string& repository = task.options.repository;
+        if (repository.empty()) {
+            return true;
+        }
+        if (writing.count(repository) != 0) {
+            return false;
+        }
+        if (task.options.access == TaskAccess::Read) {
+            return writesQueued.count(repository) == 0;
+        }
+        auto readers = reading.find(repository);
+        return readers == reading.end() || readers->second == 0;
+    }
+
+    const std::deque<QueuedTask>& interactiveLane() const {
+        return lanes[static_cast<size_t>(TaskPriority::Interactive)];
+    }
+
+    // Tokens of the preemptible tasks, queued or running, for an Interactive task that just arrived
+    void collectPreemptible(std::vector<CancellationToken>& tokens) const {
+        for (const auto& lane : lanes) {
+            for (const auto& task : lane) {
+                if (task.options.preemptible) {
+                    tokens.push_back(task.options.token);
+                }
+            }
+        }
+        for (const auto* options : running) {
+            if (options->preemptible) {
+                tokens.push_back(options->token);
+            }
+        }
+    }
+
+    // Oldest runnable task of the highest lane that has one
+    bool take(QueuedTask& task) {
+        std::set<std::string> writesQueued;
+        for (const auto& lane : lanes) {
+            for (const auto& queued : lane) {
+                if (queued.options.access == TaskAccess::Write && !queued.options.repository.empty()) {
+                    writesQueued.insert(queued.options.repository);
+                }
+            }
+        }
+        for (auto& lane : lanes) {
+            for (auto it = lane.begin(); it != lane.end(); ++it) {
+                if (runnable(*it, writesQueued)) {
+                    task = std::move(*it);
+                    lane.erase(it);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool empty() const {
+        return std::all_of(std::begin(lanes), std::end(lanes), [](const auto& lane) { return lane.empty(); });
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            QueuedTask task;
+            wake.wait(lock, [&] { return take(task) || (stopping && empty()); });
+            if (!task.work) {
+                return;
+            }
+
+            bool keyed = !task.options.repository.empty();
+            bool exclusive = keyed && task.options.access == TaskAccess::Write;
+            if (exclusive) {
+                writing.insert(task.options.repository);
+            } else if (keyed) {
+                ++reading[task.options.repository];
+            }
+            bool interactive = task.options.priority == TaskPriority::Interactive;
+            if (interactive) {
+                ++interactiveRunning;
+            }
+            auto entry = running.insert(running.end(), &task.options);
+            lock.unlock();
+
+            {
+                CancellationToken::Scope scope(task.options.token);
+                try {
+                    task.work();
+                } catch (...) {
+                }
+            }
+
+            lock.lock();
+            running.erase(entry);
+            bool released = exclusive;
+            if (exclusive) {
+                writing.erase(task.options.repository);
+            } else if (keyed) {
+                auto readers = reading.find(task.options.repository);
+                if (--readers->second == 0) {
+                    reading.erase(readers);
+                    released = true;
+                }
+            }
+            if (interactive) {
+                --interactiveRunning;
+            }
+            // Tasks waiting on this repository, or speculative work held back, may have become runnable
+            if (released || (interactive && interactiveRunning == 0)) {
+                wake.notify_all();
+            }
+            if (idleWaiters > 0) {
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+CommandScheduler::CommandScheduler(size_t workerCount) : pImpl(std::make_unique<Impl>()) {
+    if (workerCount == 0) {
+        workerCount = std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 8);
+    }
+    for (size_t i = 0; i < workerCount; ++i) {
+        pImpl->workers.emplace_back([this]() { pImpl->work(); });
+    }
+}
+
+CommandScheduler::~CommandScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        pImpl->stopping = true;
+        for (auto& lane : pImpl->lanes) {
+            for (auto& task : lane) {
+                task.options.token.cancel();
+            }
+        }
+        for (auto* options : pImpl->running) {
+            options->token.cancel();
+        }
+    }
+    pImpl->wake.notify_all();
+    for (auto& worker : pImpl->workers) {
+        worker.join();
+    }
+}
+
+CommandScheduler& CommandScheduler::shared() {
+    static CommandScheduler scheduler;
+    return scheduler;
+}
+
+void CommandScheduler::post(TaskOptions options, std::function<void()> work, std::function<void()> dropped) {
+    if (!work) {
+        return;
+    }
+    std::vector<CancellationToken> preempted;
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        if (pImpl->stopping) {
+            options.token.cancel();
+        }
+        if (options.priority == TaskPriority::Interactive) {
+            pImpl->collectPreemptible(preempted);
+        }
+        pImpl->lanes[static_cast<size_t>(options.priority)].push_back(
+            {std::move(options), std::move(work), std::move(dropped)});
+    }
+    pImpl->wake.notify_one();
+    // Outside the lock, as in cancelAll()
+    for (auto& token : preempted) {
+        token.cancel();
+    }
+}
+
+void CommandScheduler::cancelAll(const std::string& repository) {
+    std::vector<CancellationToken> tokens;
+    std::vector<std::function<void()>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        for (auto& lane : pImpl->lanes) {
+            for (auto it = lane.begin(); it != lane.end();) {
+                if (it->options.repository != repository) {
+                    ++it;
+                    continue;
+                }
+                tokens.push_back(it->options.token);
+                if (it->dropped) {
+                    dropped.push_back(std::move(it->dropped));
+                    it = lane.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (auto* options : pImpl->running) {
+            if (options->repository == repository) {
+                tokens.push_back(options->token);
+            }
+        }
+    }
+    if (!dropped.empty()) {
+        // Reads held back by a dropped Write may run now, and waitIdle() may have nothing left to wait for
+        pImpl->wake.notify_all();
+        pImpl->finished.notify_all();
+    }
+    // Outside the lock: the callbacks kill processes and may take a moment, and the dropped
+    // callbacks run continuations
+    for (auto& token : tokens) {
+        token.cancel();
+    }
+    for (auto& drop : dropped) {
+        try {
+            drop();
+        } catch (...) {
+        }
+    }
+}
+
+void CommandScheduler::waitIdle(const std::string& repository) {
+    std::unique_lock<std::mutex> lock(pImpl->mutex);
+    ++pImpl->idleWaiters;
+    pImpl->finished.wait(lock, [&] {
+        for (const auto& lane : pImpl->lanes) {
+            for (const auto& task : lane) {
+                if (task.options.repository == repository) {
+                    return false;
+                }
+            }
+        }
+        return std::none_of(pImpl->running.begin(), pImpl->running.end(),
+                            [&](const TaskOptions* options) { return options->repository == repository; });
+    });
+    --pImpl->idleWaiters;
+}
+
+size_t CommandScheduler::workerCount() const {
+    return pImpl->workers.size();
+}
+
+size_t CommandScheduler::pendingCount() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    size_t count = 0;
+    for (const auto& lane : pImpl->lanes) {
+        count += lane.size();
+    }
+    return count;
+}
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "CancellationToken.h"
+#include "Task.h"
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace VersionTools {
+
+// Lanes, highest first. A worker always takes the oldest runnable task of the
+// highest non-empty lane, so background work only runs when nothing the user
+// is waiting for is queued.
+enum class TaskPriority {
+    Interactive,  // UI reads: status, diffs, the visible history page
+    Normal,       // User-initiated operations: commit, checkout, pull, push
+    Background    // Fetch, prefetch, cache warming
+};
+
+// Per repository, like a reader-writer lock: a Write runs alone, so a scan
+// never holds index.lock while a commit wants it. A queued Write holds back
+// the Reads still queued, so a stream of status polls cannot starve it. Tasks
+// without a repository run alongside anything.
+enum class TaskAccess {
+    Read,  // Runs concurrently with other Reads of the repository
+    Write  // Touches the index, refs or worktree; runs with nothing else of the repository
+};
+
+struct TaskOptions {
+    TaskPriority priority = TaskPriority::Normal;
+    TaskAccess access = TaskAccess::Read;
+    std::string repository;     // Key for TaskAccess; empty for none
+    CancellationToken token;    // Installed as CancellationToken::current() while the task runs
+    // Speculative work: not started while an Interactive task is queued or
+    // running, and cancelled (running or queued) as soon as one is posted
+    bool preemptible = false;
+};
+
+// Bounded worker pool shared by every GitManager async operation, so the
+// number of git processes running at once stays fixed however many
+// operations the UI starts. Tasks cancelled while still queued are run as
+// usual with their token already cancelled, which lets the future report the
+// cancellation; git commands started under a cancelled token fail at once.
+// cancelAll() drops the queued tasks that can report being dropped instead:
+// a Task from start() then fails with TaskCancelled without its work running.
+//
+// A task must not block on the future of another task in the same
+// scheduler: with every worker waiting, nothing would be left to run it.
+class CommandScheduler {
+public:
+    // workerCount == 0 picks one worker per core, between 2 and 8
+    explicit CommandScheduler(size_t workerCount = 0);
+    // Cancels what is still queued or running, then drains the queue
+    ~CommandScheduler();
+
+    CommandScheduler(const CommandScheduler&) = delete;
+    CommandScheduler& operator=(const CommandScheduler&) = delete;
+
+    static CommandScheduler& shared();
+
+    template <typename Work>
+    auto submit(TaskOptions options, Work&& work) -> std::future<std::invoke_result_t<std::decay_t<Work>&>> {
+        using Result = std::invoke_result_t<std::decay_t<Work>&>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Work>(work));
+        auto future = task->get_future();
+        post(std::move(options), [task]() { (*task)(); });
+        return future;
+    }
+
+    // Completion-based form of submit: the task's continuation runs once the
+    // work returned, and cancelling the task cancels options.token. What work
+    // throws goes to the task's error callback, as does TaskCancelled when
+    // cancelAll() drops the task before it started.
+    template <typename Work>
+    auto start(TaskOptions options, Work&& work) -> Task<std::invoke_result_t<std::decay_t<Work>&>> {
+        using Result = std::invoke_result_t<std::decay_t<Work>&>;
+        TaskSource<Result> source(options.token);
+        auto shared = std::make_shared<std::decay_t<Work>>(std::forward<Work>(work));
+        post(
+            std::move(options),
+            [source, shared]() {
+                try {
+                    if constexpr (std::is_void_v<Result>) {
+                        (*shared)();
+                        source.setValue();
+                    } else {
+                        source.setValue((*shared)());
+                    }
+                } catch (...) {
+                    source.setException(std::current_exception());
+                }
+            },
+            [source]() { source.setException(std::make_exception_ptr(TaskCancelled())); });
+        return source.task();
+    }
+
+    // Fire and forget; exceptions thrown by work are swallowed. Without
+    // dropped the task always runs, cancelled or not, so work that keeps its
+    // own bookkeeping sees every task it posted. With it, cancelAll() may call
+    // dropped instead of work while the task is still queued.
+    void post(TaskOptions options, std::function<void()> work, std::function<void()> dropped = nullptr);
+
+    // Cancels every queued and running task of the repository, and drops the
+    // queued ones posted with a dropped callback
+    void cancelAll(const std::string& repository);
+    // Blocks until no task of the repository is queued or running, e.g. after
+    // cancelAll() before the helpers those tasks use are replaced. Never from
+    // a task of that repository; from a task of another one only while a
+    // worker is left over for what the repository still has queued.
+    void waitIdle(const std::string& repository);
+
+    size_t workerCount() const;
+    size_t pendingCount() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}
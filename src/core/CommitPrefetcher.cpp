@@ -0,0 +1,88 @@
+#include "CommitPrefetcher.h"
+#include "CommandScheduler.h"
+#include <algorithm>
+
+namespace VersionTools {
+
+CommitPrefetcher::CommitPrefetcher(std::string repositoryPath, Warm warm, IsCached isCached)
+    : repositoryPath(std::move(repositoryPath)), warm(std::move(warm)), isCached(std::move(isCached)) {
+}
+
+void CommitPrefetcher::prefetch(std::vector<std::string> hashes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.assign(std::make_move_iterator(hashes.begin()), std::make_move_iterator(hashes.end()));
+    if (!scheduled && !pending.empty()) {
+        schedule();
+    }
+}
+
+void CommitPrefetcher::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.clear();
+    token.cancel();
+}
+
+size_t CommitPrefetcher::pendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.size();
+}
+
+// Called with the mutex held
+void CommitPrefetcher::schedule() {
+    scheduled = true;
+    token = CancellationToken();
+    TaskOptions options{TaskPriority::Background, TaskAccess::Read, repositoryPath, token, true};
+    CommandScheduler::shared().post(std::move(options), [weak = weak_from_this()]() {
+        if (auto self = weak.lock()) {
+            self->runNext();
+        }
+    });
+}
+
+void CommitPrefetcher::runNext() {
+    std::string hash;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!pending.empty() && isCached(pending.front())) {
+            pending.pop_front();
+        }
+        if (pending.empty()) {
+            scheduled = false;
+            return;
+        }
+        hash = pending.front();
+    }
+
+    warm(hash);
+    bool preempted = CancellationToken::current().isCancelled();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // A preempted commit stays first in line; one that failed otherwise is not tried again
+    if (!preempted && !pending.empty() && pending.front() == hash) {
+        pending.pop_front();
+    }
+    if (pending.empty()) {
+        scheduled = false;
+        return;
+    }
+    schedule();
+}
+
+std::vector<size_t> CommitPrefetcher::neighbourRows(size_t selectedRow, int direction, size_t count,
+                                                    size_t rowCount) {
+    std::vector<size_t> rows;
+    auto walk = [&](bool down, size_t steps) {
+        for (size_t step = 1; step <= steps; ++step) {
+            if (down ? selectedRow + step >= rowCount : step > selectedRow) {
+                break;
+            }
+            rows.push_back(down ? selectedRow + step : selectedRow - step);
+        }
+    };
+    bool down = direction >= 0;
+    walk(down, count);
+    walk(!down, (count + 3) / 4);
+    return rows;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CancellationToken.h"
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace VersionTools {
+
+// Warms the details of the commits next to the selection, one commit per
+// preemptible background task: interactive work queued or posted meanwhile
+// goes first and cancels the commit being read, which is put back and read
+// again once the interactive work is done. A new prefetch() replaces what is
+// still pending of the previous one.
+class CommitPrefetcher : public std::enable_shared_from_this<CommitPrefetcher> {
+public:
+    // Reads one commit into the cache; runs on a scheduler worker
+    using Warm = std::function<void(const std::string& hash)>;
+    // Whether what warm reads is cached already
+    using IsCached = std::function<bool(const std::string& hash)>;
+
+    CommitPrefetcher(std::string repositoryPath, Warm warm, IsCached isCached);
+
+    // hashes nearest first; the ones already cached are skipped
+    void prefetch(std::vector<std::string> hashes);
+    // Drops what is pending and cancels the commit being read
+    void cancel();
+
+    size_t pendingCount() const;
+
+    // Rows to prefetch around the selected one: count rows in the direction
+    // of travel (> 0 down the history, < 0 up), nearest first, then a quarter
+    // as many the other way, all clamped to [0, rowCount)
+    static std::vector<size_t> neighbourRows(size_t selectedRow, int direction, size_t count, size_t rowCount);
+
+private:
+    void schedule();
+    void runNext();
+
+    std::string repositoryPath;
+    Warm warm;
+    IsCached isCached;
+
+    mutable std::mutex mutex;
+    std::deque<std::string> pending;
+    CancellationToken token;  // Of the task queued or running, if any
+    bool scheduled = false;
+};
+
+}
@@ -0,0 +1,452 @@
+#include "CommitSearchIndex.h"
+#include "SystemCommand.h"
+#include "Trace.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace VersionTools {
+
+namespace {
+
+enum Field { Message, Author, Path, FIELD_COUNT };
+
+constexpr size_t MAX_WORD_LENGTH = 64;  // Longer words (hashes, base64) are indexed by their start
+constexpr size_t MIN_HASH_PREFIX = 4;
+#ifdef _WIN32
+constexpr size_t HASHES_PER_COMMAND = 512;  // CreateProcess command lines stop at 32K characters
+#else
+constexpr size_t HASHES_PER_COMMAND = CommitSearchIndex::SEGMENT_SIZE;
+#endif
+
+using Bits = std::vector<uint64_t>;
+
+bool isWordByte(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+char lower(unsigned char c) {
+    return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+}
+
+bool isHex(std::string_view text) {
+    return std::all_of(text.begin(), text.end(),
+                       [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+}
+
+template <typename Sink>
+void forEachWord(std::string_view text, Sink&& sink) {
+    std::string word;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+        if (isWordByte(c)) {
+            if (word.size() < MAX_WORD_LENGTH) {
+                word.push_back(lower(c));
+            }
+        } else if (!word.empty()) {
+            sink(word);
+            word.clear();
+        }
+    }
+}
+
+// Sorted words of one field of a segment, each with the ascending local ids that contain it
+struct FieldIndex {
+    std::string words;
+    std::vector<uint32_t> wordStart{0};
+    std::vector<uint32_t> postingStart{0};
+    std::vector<uint16_t> postings;
+
+    size_t wordCount() const { return wordStart.size() - 1; }
+
+    std::string_view word(size_t index) const {
+        return std::string_view(words).substr(wordStart[index], wordStart[index + 1] - wordStart[index]);
+    }
+
+    // Sets the bits of every id with a word starting with prefix
+    void match(std::string_view prefix, Bits& hits) const {
+        size_t low = 0, high = wordCount();
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (word(middle) < prefix) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        for (size_t i = low; i < wordCount() && word(i).compare(0, prefix.size(), prefix) == 0; ++i) {
+            for (uint32_t p = postingStart[i]; p < postingStart[i + 1]; ++p) {
+                hits[postings[p] / 64] |= uint64_t(1) << (postings[p] % 64);
+            }
+        }
+    }
+};
+
+class FieldBuilder {
+public:
+    void add(uint16_t id, std::string_view text) {
+        forEachWord(text, [&](const std::string& word) {
+            auto& ids = postings[word];
+            if (ids.empty() || ids.back() != id) {
+                ids.push_back(id);
+            }
+        });
+    }
+
+    FieldIndex build() {
+        std::vector<std::pair<std::string_view, const std::vector<uint16_t>*>> sorted;
+        sorted.reserve(postings.size());
+        for (const auto& [word, ids] : postings) {
+            sorted.emplace_back(word, &ids);
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        FieldIndex index;
+        index.wordStart.reserve(sorted.size() + 1);
+        index.postingStart.reserve(sorted.size() + 1);
+        for (const auto& [word, ids] : sorted) {
+            index.words += word;
+            index.wordStart.push_back(static_cast<uint32_t>(index.words.size()));
+            index.postings.insert(index.postings.end(), ids->begin(), ids->end());
+            index.postingStart.push_back(static_cast<uint32_t>(index.postings.size()));
+        }
+        index.words.shrink_to_fit();
+        return index;
+    }
+
+private:
+    std::unordered_map<std::string, std::vector<uint16_t>> postings;
+};
+
+// Full message and touched paths of one commit, from `git log --name-only`
+struct CommitDetails {
+    bool found = false;
+    std::string message;
+    std::vector<std::string> paths;
+};
+
+struct Term {
+    int field = -1;  // Any field
+    std::vector<std::string> words;
+    std::string hashPrefix;
+};
+
+std::vector<Term> parseQuery(std::string_view query) {
+    static const std::pair<std::string_view, Field> qualifiers[] = {
+        {"message:", Message}, {"author:", Author}, {"path:", Path}};
+
+    std::vector<Term> terms;
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t end = query.find_first_of(" \t\r\n", pos);
+        end = end == std::string_view::npos ? query.size() : end;
+        std::string text;
+        for (char c : query.substr(pos, end - pos)) {
+            text.push_back(lower(static_cast<unsigned char>(c)));
+        }
+        pos = end + 1;
+
+        Term term;
+        std::string_view body = text;
+        for (const auto& [qualifier, field] : qualifiers) {
+            if (body.compare(0, qualifier.size(), qualifier) == 0) {
+                body.remove_prefix(qualifier.size());
+                term.field = field;
+                break;
+            }
+        }
+        forEachWord(body, [&](const std::string& word) { term.words.push_back(word); });
+        if (term.field < 0 && body.size() >= MIN_HASH_PREFIX && isHex(body)) {
+            term.hashPrefix = std::string(body);
+        }
+        if (!term.words.empty()) {
+            terms.push_back(std::move(term));
+        }
+    }
+    return terms;
+}
+
+} // namespace
+
+struct CommitSearchIndex::Segment {
+    size_t firstId = 0;
+    size_t count = 0;
+    bool detailed = false;
+    FieldIndex fields[FIELD_COUNT];
+};
+
+struct CommitSearchIndex::State {
+    std::shared_ptr<const GitHistoryCache> history;
+    // Segment i holds ids [i * SEGMENT_SIZE, (i + 1) * SEGMENT_SIZE); only the last one can be short
+    std::vector<std::shared_ptr<const Segment>> segments;
+    size_t indexedCommits = 0;
+};
+
+namespace {
+
+size_t rowOf(const GitHistoryCache& history, size_t id) {
+    return history.size() - 1 - id;
+}
+
+// details is empty for a segment of what the cache holds, else one entry per local id
+template <typename Segment>
+std::shared_ptr<const Segment> buildSegment(const GitHistoryCache& history, size_t firstId, size_t count,
+                                            const std::vector<CommitDetails>& details) {
+    FieldBuilder fields[FIELD_COUNT];
+    for (size_t local = 0; local < count; ++local) {
+        size_t row = rowOf(history, firstId + local);
+        auto id = static_cast<uint16_t>(local);
+        fields[Author].add(id, history.author(row));
+        fields[Author].add(id, history.email(row));
+        if (!details.empty() && details[local].found) {
+            fields[Message].add(id, details[local].message);
+            for (const auto& path : details[local].paths) {
+                fields[Path].add(id, path);
+            }
+        } else {
+            fields[Message].add(id, history.subject(row));
+        }
+    }
+
+    auto segment = std::make_shared<Segment>();
+    segment->firstId = firstId;
+    segment->count = count;
+    segment->detailed = !details.empty();
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        segment->fields[field] = fields[field].build();
+    }
+    return segment;
+}
+
+// Messages and paths of the given commits, in the order of hashes
+bool readDetails(const std::string& repositoryPath, const std::vector<std::string>& hashes,
+                 std::vector<CommitDetails>& details) {
+    TraceScope trace("parse", "search details");
+    details.assign(hashes.size(), {});
+
+    for (size_t start = 0; start < hashes.size(); start += HASHES_PER_COMMAND) {
+        size_t end = std::min(hashes.size(), start + HASHES_PER_COMMAND);
+        std::unordered_map<std::string_view, size_t> position;
+        std::vector<std::string> args = {"log",          "--no-walk=unsorted", "--no-renames",
+                                         "--name-only",  "-z",                 "--format=%H%x00%B%x00"};
+        for (size_t i = start; i < end; ++i) {
+            position.emplace(hashes[i], i);
+            args.push_back(hashes[i]);
+        }
+
+        // NUL-separated: hash, message, then the paths (the first after a newline, the
+        // list closed by an empty field) until the next hash
+        enum class Expect { Hash, Message, Path } expect = Expect::Hash;
+        CommitDetails* current = nullptr;
+        auto takeField = [&](std::string_view field) {
+            if (expect == Expect::Message) {
+                current->message = std::string(field);
+                expect = Expect::Path;
+                return;
+            }
+            if (!field.empty() && field.front() == '\n') {
+                field.remove_prefix(1);
+            }
+            if (field.empty()) {
+                return;
+            }
+            auto it = position.find(field);
+            if (it != position.end()) {
+                current = &details[it->second];
+                current->found = true;
+                expect = Expect::Message;
+            } else if (expect == Expect::Path) {
+                current->paths.emplace_back(field);
+            }
+        };
+
+        std::string pending;
+        SystemCommand cmd;
+        auto result = cmd.executeWithCallback(
+            "git", args,
+            [&](const std::string& chunk) {
+                trace.count("bytes", static_cast<int64_t>(chunk.size()));
+                pending.append(chunk);
+                size_t fieldStart = 0;
+                size_t fieldEnd;
+                while ((fieldEnd = pending.find('\0', fieldStart)) != std::string::npos) {
+                    takeField(std::string_view(pending).substr(fieldStart, fieldEnd - fieldStart));
+                    fieldStart = fieldEnd + 1;
+                }
+                pending.erase(0, fieldStart);
+            },
+            repositoryPath);
+        if (result.exitCode != 0) {
+            return false;
+        }
+        takeField(pending);
+    }
+    trace.count("commits", static_cast<int64_t>(hashes.size()));
+    return true;
+}
+
+} // namespace
+
+CommitSearchIndex::CommitSearchIndex(std::shared_ptr<const GitHistoryCache> history)
+    : state(std::make_shared<State>()) {
+    update(std::move(history));
+}
+
+CommitSearchIndex::~CommitSearchIndex() = default;
+
+std::shared_ptr<const CommitSearchIndex::State> CommitSearchIndex::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state;
+}
+
+void CommitSearchIndex::update(std::shared_ptr<const GitHistoryCache> history) {
+    // Rows are built outside the lock, so searches go on meanwhile; updates take turns
+    std::lock_guard<std::mutex> updating(updateMutex);
+    auto base = snapshot();
+    if (!history || history == base->history) {
+        return;
+    }
+
+    size_t oldSize = base->history ? base->history->size() : 0;
+    size_t newSize = history->size();
+    bool extends = base->history && oldSize <= newSize &&
+                   (oldSize == 0 || history->hash(newSize - oldSize) == base->history->tip());
+    // A cache reopened at the same tip keeps every segment; new commits are added (and a
+    // short newest segment rebuilt with them) without details
+    size_t kept = !extends ? 0 : newSize == oldSize ? base->segments.size() : oldSize / SEGMENT_SIZE;
+
+    TraceScope trace("parse", "search index");
+    std::vector<std::shared_ptr<const Segment>> added;
+    for (size_t firstId = kept * SEGMENT_SIZE; firstId < newSize; firstId += SEGMENT_SIZE) {
+        added.push_back(buildSegment<Segment>(*history, firstId, std::min(SEGMENT_SIZE, newSize - firstId), {}));
+    }
+    trace.count("commits", static_cast<int64_t>(newSize - kept * SEGMENT_SIZE));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // indexDetails() may have published detailed versions of the kept segments since
+    auto next = std::make_shared<State>();
+    next->history = std::move(history);
+    next->segments.assign(state->segments.begin(), state->segments.begin() + kept);
+    next->segments.insert(next->segments.end(), added.begin(), added.end());
+    for (const auto& segment : next->segments) {
+        next->indexedCommits += segment->detailed ? segment->count : 0;
+    }
+    state = std::move(next);
+}
+
+std::shared_ptr<const GitHistoryCache> CommitSearchIndex::history() const {
+    return snapshot()->history;
+}
+
+bool CommitSearchIndex::isComplete() const {
+    auto current = snapshot();
+    return !current->history || current->indexedCommits == current->history->size();
+}
+
+GitCommitSearchResult CommitSearchIndex::search(std::string_view query, size_t offset, size_t limit) const {
+    auto current = snapshot();
+    GitCommitSearchResult result;
+    if (!current->history) {
+        return result;
+    }
+    const GitHistoryCache& history = *current->history;
+    result.totalCommits = history.size();
+    result.indexedCommits = current->indexedCommits;
+
+    std::vector<Term> terms = parseQuery(query);
+    if (terms.empty()) {
+        return result;
+    }
+
+    TraceScope trace("parse", "search");
+    size_t skipped = 0;
+    for (auto it = current->segments.rbegin(); it != current->segments.rend(); ++it) {
+        const Segment& segment = **it;
+        size_t words = (segment.count + 63) / 64;
+        Bits hits(words, ~uint64_t(0));
+        for (const Term& term : terms) {
+            Bits termHits(words, ~uint64_t(0));
+            for (const std::string& word : term.words) {
+                Bits wordHits(words, 0);
+                for (int field = 0; field < FIELD_COUNT; ++field) {
+                    if (term.field < 0 || term.field == field) {
+                        segment.fields[field].match(word, wordHits);
+                    }
+                }
+                for (size_t w = 0; w < words; ++w) {
+                    termHits[w] &= wordHits[w];
+                }
+            }
+            if (!term.hashPrefix.empty()) {
+                for (size_t local = 0; local < segment.count; ++local) {
+                    if (history.hashHasPrefix(rowOf(history, segment.firstId + local), term.hashPrefix)) {
+                        termHits[local / 64] |= uint64_t(1) << (local % 64);
+                    }
+                }
+            }
+            for (size_t w = 0; w < words; ++w) {
+                hits[w] &= termHits[w];
+            }
+        }
+
+        // Newest first: highest local id down
+        for (size_t local = segment.count; local-- > 0;) {
+            if (!(hits[local / 64] >> (local % 64) & 1)) {
+                continue;
+            }
+            if (skipped < offset) {
+                ++skipped;
+            } else if (result.commits.size() < limit) {
+                result.commits.push_back(history.commit(rowOf(history, segment.firstId + local)));
+            } else {
+                result.hasMore = true;
+                trace.count("hits", static_cast<int64_t>(result.commits.size()));
+                return result;
+            }
+        }
+    }
+    trace.count("hits", static_cast<int64_t>(result.commits.size()));
+    return result;
+}
+
+bool CommitSearchIndex::beginIndexing() {
+    return !indexing.exchange(true);
+}
+
+void CommitSearchIndex::endIndexing() {
+    indexing = false;
+}
+
+bool CommitSearchIndex::indexDetails(const std::string& repositoryPath) {
+    auto current = snapshot();
+    auto pending = std::find_if(current->segments.rbegin(), current->segments.rend(),
+                                [](const auto& segment) { return !segment->detailed; });
+    if (pending == current->segments.rend()) {
+        return false;
+    }
+    std::shared_ptr<const Segment> source = *pending;
+    size_t slot = current->segments.size() - 1 - (pending - current->segments.rbegin());
+    const GitHistoryCache& history = *current->history;
+
+    std::vector<std::string> hashes;
+    hashes.reserve(source->count);
+    for (size_t local = 0; local < source->count; ++local) {
+        hashes.push_back(history.hash(rowOf(history, source->firstId + local)));
+    }
+    std::vector<CommitDetails> details;
+    if (!readDetails(repositoryPath, hashes, details)) {
+        return false;
+    }
+    auto detailed = buildSegment<Segment>(history, source->firstId, source->count, details);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Dropped when an update replaced the segment meanwhile; the next call indexes the new one
+    if (slot < state->segments.size() && state->segments[slot] == source) {
+        auto next = std::make_shared<State>(*state);
+        next->segments[slot] = std::move(detailed);
+        next->indexedCommits += source->count;
+        state = std::move(next);
+    }
+    return true;
+}
+
+}
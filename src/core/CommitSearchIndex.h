@@ -0,0 +1,73 @@
+#pragma once
+
+#include "GitHistoryCache.h"
+#include "GitTypes.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VersionTools {
+
+// Inverted index over a GitHistoryCache: commit messages, authors (name and
+// email) and the paths each commit touched. Commits are numbered oldest
+// first (id = size - 1 - row), so ids stay put when the cache grows new rows
+// in front, and are kept in immutable segments of SEGMENT_SIZE ids with a
+// sorted token table and postings per field.
+//
+// A segment starts out with what the cache already holds (subject, author,
+// email) and is replaced by a detailed one, with the full message and the
+// touched paths, once indexDetails() has read them from git; searches run
+// against whatever is published at the time. Thread-safe: searches work on
+// a snapshot and never wait for indexing.
+//
+// Queries are whitespace-separated terms, all of which must match. A term
+// matches words starting with it in any field, or in one field with an
+// "author:", "path:" or "message:" qualifier; words are runs of letters and
+// digits (any non-ASCII byte counts as a letter), compared
+// case-insensitively. Unqualified hex terms of 4 or more digits also match
+// commit hash prefixes.
+class CommitSearchIndex {
+public:
+    static constexpr size_t SEGMENT_SIZE = 4096;
+
+    explicit CommitSearchIndex(std::shared_ptr<const GitHistoryCache> history);
+    ~CommitSearchIndex();
+
+    CommitSearchIndex(const CommitSearchIndex&) = delete;
+    CommitSearchIndex& operator=(const CommitSearchIndex&) = delete;
+
+    // Moves to a newer snapshot of the same history. When it only added
+    // commits in front, just those are indexed (together with the newest
+    // segment if it had room); anything else starts over.
+    void update(std::shared_ptr<const GitHistoryCache> history);
+    std::shared_ptr<const GitHistoryCache> history() const;
+
+    GitCommitSearchResult search(std::string_view query, size_t offset, size_t limit) const;
+
+    // Reads messages and paths of the newest segment that lacks them, one git
+    // process per segment. False when nothing is left or git failed.
+    bool indexDetails(const std::string& repositoryPath);
+    // Only one caller drives indexDetails() at a time; the next one is told to stay away
+    bool beginIndexing();
+    void endIndexing();
+
+    bool isComplete() const;
+
+private:
+    struct Segment;
+    struct State;
+
+    std::shared_ptr<const State> snapshot() const;
+
+    mutable std::mutex mutex;  // Guards state
+    std::mutex updateMutex;
+    std::shared_ptr<const State> state;
+    std::atomic<bool> indexing{false};
+};
+
+}
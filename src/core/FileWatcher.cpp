@@ -0,0 +1,453 @@
+#include "FileWatcher.h"
+#include <filesystem>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <map>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace VersionTools {
+
+namespace {
+
+// Repository metadata that affects status; everything else under .git is noise
+bool isRelevantPath(const std::string& path) {
+    if (path.compare(0, 5, ".git/") != 0) {
+        return path != ".git";
+    }
+    std::string inner = path.substr(5);
+    return inner == "index" || inner == "HEAD" || inner == "packed-refs" || inner == "info/exclude" ||
+           inner.compare(0, 5, "refs/") == 0;
+}
+
+#if !defined(__linux__)
+std::string relativeTo(const std::string& root, std::string path) {
+    for (auto& c : path) {
+        if (c == '\\') {
+            c = '/';
+        }
+    }
+    if (path.compare(0, root.size(), root) == 0) {
+        path.erase(0, root.size());
+    }
+    while (!path.empty() && path[0] == '/') {
+        path.erase(0, 1);
+    }
+    return path;
+}
+#endif
+
+} // namespace
+
+#if defined(__linux__)
+
+class FileWatcher::Impl {
+public:
+    std::string root;
+    int fd = -1;
+    std::map<int, std::string> directories;  // watch descriptor -> relative directory
+    bool degraded = false;                     // a watch could not be added; changes may be missed
+
+    void addWatch(const std::string& relative) {
+        std::string absolute = relative.empty() ? root : root + "/" + relative;
+        uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                        IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+        int wd = inotify_add_watch(fd, absolute.c_str(), mask);
+        if (wd == -1) {
+            // ENOSPC: fs.inotify.max_user_watches is exhausted
+            if (errno != ENOENT) {
+                degraded = true;
+            }
+            return;
+        }
+        directories[wd] = relative;
+    }
+
+    // Watches a directory and everything below it, except the uninteresting parts of .git
+    void addTree(const std::string& relative) {
+        addWatch(relative);
+
+        std::error_code error;
+        std::string absolute = relative.empty() ? root : root + "/" + relative;
+        for (std::filesystem::directory_iterator it(absolute, error), end; !error && it != end; it.increment(error)) {
+            if (!it->is_directory(error) || it->is_symlink(error)) {
+                continue;
+            }
+            std::string name = it->path().filename().string();
+            std::string child = relative.empty() ? name : relative + "/" + name;
+            if (child == ".git") {
+                addWatch(child);
+                addTree(".git/refs");
+                addWatch(".git/info");
+            } else if (name != ".git") {
+                // Nested repositories are not part of this worktree's status
+                addTree(child);
+            }
+        }
+    }
+};
+
+FileWatcher::FileWatcher() : pImpl(std::make_unique<Impl>()) {}
+
+FileWatcher::~FileWatcher() {
+    stop();
+}
+
+bool FileWatcher::isSupported() {
+    return true;
+}
+
+bool FileWatcher::start(const std::string& rootPath) {
+    stop();
+
+    pImpl->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (pImpl->fd == -1) {
+        return false;
+    }
+    pImpl->root = rootPath;
+    while (pImpl->root.size() > 1 && pImpl->root.back() == '/') {
+        pImpl->root.pop_back();
+    }
+    pImpl->degraded = false;
+    pImpl->addTree("");
+    return true;
+}
+
+void FileWatcher::stop() {
+    if (pImpl->fd != -1) {
+        close(pImpl->fd);
+        pImpl->fd = -1;
+    }
+    pImpl->directories.clear();
+}
+
+bool FileWatcher::isActive() const {
+    return pImpl->fd != -1;
+}
+
+bool FileWatcher::poll(const FileChangeCallback& callback) {
+    if (pImpl->fd == -1) {
+        return false;
+    }
+
+    std::vector<std::string> paths;
+    bool overflow = pImpl->degraded;
+    alignas(struct inotify_event) char buffer[64 * 1024];
+
+    while (true) {
+        ssize_t length = read(pImpl->fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length == -1 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            auto dir = pImpl->directories.find(event->wd);
+            if (dir == pImpl->directories.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                pImpl->directories.erase(dir);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            std::string path = dir->second.empty() ? event->name : dir->second + "/" + event->name;
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) &&
+                std::string(event->name) != ".git" &&
+                (path.compare(0, 5, ".git/") != 0 || path.compare(0, 10, ".git/refs/") == 0)) {
+                pImpl->addTree(path);
+            }
+            if (isRelevantPath(path)) {
+                paths.push_back(std::move(path));
+            }
+        }
+    }
+
+    if (!paths.empty() || overflow) {
+        callback(paths, overflow);
+    }
+    return true;
+}
+
+#elif defined(__APPLE__)
+
+class FileWatcher::Impl {
+public:
+    std::string root;
+    FSEventStreamRef stream = nullptr;
+    dispatch_queue_t queue = nullptr;
+
+    // Filled on the dispatch queue, drained by poll()
+    std::mutex mutex;
+    std::vector<std::string> pending;
+    bool overflow = false;
+
+    static void onEvents(ConstFSEventStreamRef, void* info, size_t count, void* eventPaths,
+                         const FSEventStreamEventFlags flags[], const FSEventStreamEventId[]) {
+        auto* self = static_cast<Impl*>(info);
+        auto** paths = static_cast<char**>(eventPaths);
+
+        std::lock_guard<std::mutex> lock(self->mutex);
+        for (size_t i = 0; i < count; ++i) {
+            if (flags[i] & (kFSEventStreamEventFlagMustScanSubDirs | kFSEventStreamEventFlagUserDropped |
+                            kFSEventStreamEventFlagKernelDropped)) {
+                self->overflow = true;
+                continue;
+            }
+            std::string path = relativeTo(self->root, paths[i]);
+            if (!path.empty() && isRelevantPath(path)) {
+                self->pending.push_back(std::move(path));
+            }
+        }
+    }
+};
+
+FileWatcher::FileWatcher() : pImpl(std::make_unique<Impl>()) {}
+
+FileWatcher::~FileWatcher() {
+    stop();
+}
+
+bool FileWatcher::isSupported() {
+    return true;
+}
+
+bool FileWatcher::start(const std::string& rootPath) {
+    stop();
+
+    // FSEvents reports resolved paths (/private/tmp rather than /tmp)
+    std::error_code error;
+    auto canonical = std::filesystem::canonical(rootPath, error);
+    pImpl->root = error ? rootPath : canonical.string();
+
+    CFStringRef path = CFStringCreateWithCString(nullptr, pImpl->root.c_str(), kCFStringEncodingUTF8);
+    CFArrayRef paths = CFArrayCreate(nullptr, reinterpret_cast<const void**>(&path), 1, &kCFTypeArrayCallBacks);
+
+    FSEventStreamContext context = {0, pImpl.get(), nullptr, nullptr, nullptr};
+    pImpl->stream = FSEventStreamCreate(nullptr, &Impl::onEvents, &context, paths, kFSEventStreamEventIdSinceNow, 0.05,
+                                        kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagNoDefer);
+    CFRelease(paths);
+    CFRelease(path);
+    if (!pImpl->stream) {
+        return false;
+    }
+
+    pImpl->queue = dispatch_queue_create("VersionTools.FileWatcher", DISPATCH_QUEUE_SERIAL);
+    FSEventStreamSetDispatchQueue(pImpl->stream, pImpl->queue);
+    if (!FSEventStreamStart(pImpl->stream)) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void FileWatcher::stop() {
+    if (pImpl->stream) {
+        FSEventStreamStop(pImpl->stream);
+        FSEventStreamInvalidate(pImpl->stream);
+        FSEventStreamRelease(pImpl->stream);
+        pImpl->stream = nullptr;
+    }
+    if (pImpl->queue) {
+        dispatch_release(pImpl->queue);
+        pImpl->queue = nullptr;
+    }
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->pending.clear();
+    pImpl->overflow = false;
+}
+
+bool FileWatcher::isActive() const {
+    return pImpl->stream != nullptr;
+}
+
+bool FileWatcher::poll(const FileChangeCallback& callback) {
+    if (!pImpl->stream) {
+        return false;
+    }
+
+    // Pushes everything the kernel has queued through onEvents before returning
+    FSEventStreamFlushSync(pImpl->stream);
+
+    std::vector<std::string> paths;
+    bool overflow;
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        paths.swap(pImpl->pending);
+        overflow = pImpl->overflow;
+        pImpl->overflow = false;
+    }
+
+    if (!paths.empty() || overflow) {
+        callback(paths, overflow);
+    }
+    return true;
+}
+
+#elif defined(_WIN32)
+
+class FileWatcher::Impl {
+public:
+    HANDLE directory = INVALID_HANDLE_VALUE;
+    OVERLAPPED overlapped = {};
+    alignas(DWORD) char buffer[64 * 1024];
+    bool pending = false;
+
+    // Once issued, the system buffers changes between calls; a zero-byte completion means that buffer overflowed
+    bool issueRead() {
+        ResetEvent(overlapped.hEvent);
+        DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE |
+                       FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_ATTRIBUTES;
+        pending = ReadDirectoryChangesW(directory, buffer, sizeof(buffer), TRUE, filter, NULL, &overlapped, NULL) != 0;
+        return pending;
+    }
+};
+
+FileWatcher::FileWatcher() : pImpl(std::make_unique<Impl>()) {}
+
+FileWatcher::~FileWatcher() {
+    stop();
+}
+
+bool FileWatcher::isSupported() {
+    return true;
+}
+
+bool FileWatcher::start(const std::string& rootPath) {
+    stop();
+
+    pImpl->directory = CreateFileA(rootPath.c_str(), FILE_LIST_DIRECTORY,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                                   FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (pImpl->directory == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    pImpl->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!pImpl->overlapped.hEvent || !pImpl->issueRead()) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void FileWatcher::stop() {
+    if (pImpl->directory != INVALID_HANDLE_VALUE) {
+        if (pImpl->pending) {
+            CancelIo(pImpl->directory);
+            DWORD ignored = 0;
+            GetOverlappedResult(pImpl->directory, &pImpl->overlapped, &ignored, TRUE);
+        }
+        CloseHandle(pImpl->directory);
+        pImpl->directory = INVALID_HANDLE_VALUE;
+    }
+    if (pImpl->overlapped.hEvent) {
+        CloseHandle(pImpl->overlapped.hEvent);
+        pImpl->overlapped.hEvent = NULL;
+    }
+    pImpl->pending = false;
+}
+
+bool FileWatcher::isActive() const {
+    return pImpl->directory != INVALID_HANDLE_VALUE;
+}
+
+bool FileWatcher::poll(const FileChangeCallback& callback) {
+    if (pImpl->directory == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    std::vector<std::string> paths;
+    bool overflow = false;
+
+    while (pImpl->pending) {
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(pImpl->directory, &pImpl->overlapped, &bytes, FALSE)) {
+            if (GetLastError() != ERROR_IO_INCOMPLETE) {
+                overflow = true;
+                pImpl->pending = false;
+            }
+            break;
+        }
+
+        if (bytes == 0) {
+            overflow = true;
+        }
+        for (DWORD offset = 0; bytes > 0;) {
+            auto* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(pImpl->buffer + offset);
+            int wideLength = static_cast<int>(info->FileNameLength / sizeof(WCHAR));
+            int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, NULL, 0, NULL, NULL);
+            std::string name(length, '\0');
+            WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, &name[0], length, NULL, NULL);
+
+            std::string path = relativeTo("", name);
+            if (isRelevantPath(path)) {
+                paths.push_back(std::move(path));
+            }
+
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            offset += info->NextEntryOffset;
+        }
+
+        if (!pImpl->issueRead()) {
+            overflow = true;
+        }
+    }
+
+    if (!paths.empty() || overflow) {
+        callback(paths, overflow);
+    }
+    return true;
+}
+
+#else
+
+class FileWatcher::Impl {};
+
+FileWatcher::FileWatcher() : pImpl(std::make_unique<Impl>()) {}
+
+FileWatcher::~FileWatcher() = default;
+
+bool FileWatcher::isSupported() {
+    return false;
+}
+
+bool FileWatcher::start(const std::string&) {
+    return false;
+}
+
+void FileWatcher::stop() {}
+
+bool FileWatcher::isActive() const {
+    return false;
+}
+
+bool FileWatcher::poll(const FileChangeCallback&) {
+    return false;
+}
+
+#endif
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace VersionTools {
+
+// Paths are relative to the watched root and use '/' separators.
+// overflow == true means the OS dropped events and the paths are incomplete.
+using FileChangeCallback = std::function<void(const std::vector<std::string>& paths, bool overflow)>;
+
+// Recursive filesystem watcher over inotify (Linux), FSEvents (macOS) or
+// ReadDirectoryChangesW (Windows). Events queue up in the OS and are only
+// collected by poll(), so no thread is involved on Linux and Windows and no
+// callback ever runs concurrently with the caller.
+//
+// Inside .git only the index, HEAD and the refs are watched; object and log
+// churn is never reported.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    static bool isSupported();
+
+    bool start(const std::string& rootPath);
+    void stop();
+    bool isActive() const;
+
+    // Delivers every change queued so far; changes made by a process that has
+    // already exited are guaranteed to be included. Returns false if inactive.
+    bool poll(const FileChangeCallback& callback);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}
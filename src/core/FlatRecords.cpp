@@ -0,0 +1,187 @@
+#include "FlatRecords.h"
+#include "GraphLayout.h"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace VersionTools {
+
+// The Swift reader hard-codes these offsets
+static_assert(sizeof(FlatRecords::Header) == 40, "FlatRecords::Header layout changed");
+static_assert(sizeof(FlatRecords::String) == 8, "FlatRecords::String layout changed");
+static_assert(sizeof(FlatRecords::FileChange) == 32, "FlatRecords::FileChange layout changed");
+static_assert(offsetof(FlatRecords::FileChange, nameStart) == 8 && offsetof(FlatRecords::FileChange, status) == 20 &&
+                  offsetof(FlatRecords::FileChange, id) == 24,
+              "FlatRecords::FileChange layout changed");
+static_assert(sizeof(FlatRecords::Commit) == 88, "FlatRecords::Commit layout changed");
+static_assert(offsetof(FlatRecords::Commit, timestamp) == 48 && offsetof(FlatRecords::Commit, graphLane) == 64 &&
+                  offsetof(FlatRecords::Commit, firstEdge) == 76,
+              "FlatRecords::Commit layout changed");
+static_assert(std::is_trivially_copyable_v<FlatRecords::FileChange> &&
+                  std::is_trivially_copyable_v<FlatRecords::Commit>,
+              "Flat records must be plain data");
+
+namespace {
+
+constexpr size_t ALIGNMENT = 8;
+
+size_t aligned(size_t size) {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// Records, extras and strings are collected separately and laid out once their sizes are known
+template <typename Record>
+class Writer {
+public:
+    explicit Writer(size_t recordCount, size_t stringBytes) {
+        records.reserve(recordCount);
+        strings.reserve(stringBytes);
+    }
+
+    FlatRecords::String add(const std::string& text) {
+        FlatRecords::String slice{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size())};
+        strings += text;
+        return slice;
+    }
+
+    std::vector<Record> records;
+    std::vector<uint32_t> extras;
+    std::string strings;
+
+    std::string finish(FlatRecords::Kind kind, uint32_t split) const {
+        FlatRecords::Header header{};
+        header.magic = FlatRecords::MAGIC;
+        header.version = FlatRecords::VERSION;
+        header.kind = static_cast<uint16_t>(kind);
+        header.recordCount = static_cast<uint32_t>(records.size());
+        header.recordSize = sizeof(Record);
+        header.extraCount = static_cast<uint32_t>(extras.size());
+        header.split = split;
+        header.recordsOffset = static_cast<uint32_t>(aligned(sizeof(FlatRecords::Header)));
+        header.extrasOffset = static_cast<uint32_t>(aligned(header.recordsOffset + records.size() * sizeof(Record)));
+        header.stringsOffset = static_cast<uint32_t>(aligned(header.extrasOffset + extras.size() * sizeof(uint32_t)));
+        header.stringsSize = static_cast<uint32_t>(strings.size());
+
+        std::string buffer(header.stringsOffset + strings.size(), '\0');
+        std::memcpy(&buffer[0], &header, sizeof(header));
+        if (!records.empty()) {
+            std::memcpy(&buffer[header.recordsOffset], records.data(), records.size() * sizeof(Record));
+        }
+        if (!extras.empty()) {
+            std::memcpy(&buffer[header.extrasOffset], extras.data(), extras.size() * sizeof(uint32_t));
+        }
+        if (!strings.empty()) {
+            std::memcpy(&buffer[header.stringsOffset], strings.data(), strings.size());
+        }
+        return buffer;
+    }
+};
+
+}
+
+std::string FlatRecords::encodeFileChanges(const std::vector<GitFileChange>& changes) {
+    size_t stringBytes = 0;
+    for (const auto& change : changes) {
+        stringBytes += change.filePath.size();
+    }
+
+    Writer<FileChange> writer(changes.size(), stringBytes);
+    uint32_t staged = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto& change : changes) {
+            if (change.isStaged != (pass == 0)) {
+                continue;
+            }
+            FileChange record{};
+            record.path = writer.add(change.filePath);
+            size_t slash = change.filePath.find_last_of('/');
+            record.nameStart = slash == std::string::npos ? 0 : static_cast<uint32_t>(slash + 1);
+            record.linesAdded = static_cast<uint32_t>(change.linesAdded);
+            record.linesDeleted = static_cast<uint32_t>(change.linesDeleted);
+            record.status = static_cast<uint8_t>(change.status);
+            record.staged = change.isStaged ? 1 : 0;
+            record.id = fileChangeId(change.filePath, change.isStaged);
+            writer.records.push_back(record);
+            staged += change.isStaged ? 1 : 0;
+        }
+    }
+    return writer.finish(Kind::FileChanges, staged);
+}
+
+std::string FlatRecords::encodeCommits(const std::vector<GitCommit>& commits, const GraphLayout* graph,
+                                       size_t graphRow) {
+    size_t stringBytes = 0;
+    for (const auto& commit : commits) {
+        stringBytes += commit.hash.size() + commit.shortHash.size() + commit.author.size() + commit.email.size() +
+                       commit.message.size() + commit.shortMessage.size() + commit.parentHashes.size() * 40;
+    }
+
+    Writer<Commit> writer(commits.size(), stringBytes);
+    for (size_t index = 0; index < commits.size(); ++index) {
+        const auto& commit = commits[index];
+        Commit record{};
+        record.hash = writer.add(commit.hash);
+        record.shortHash = writer.add(commit.shortHash);
+        record.author = writer.add(commit.author);
+        record.email = writer.add(commit.email);
+        record.message = writer.add(commit.message);
+        record.shortMessage = writer.add(commit.shortMessage);
+        auto sinceEpoch = commit.timestamp.time_since_epoch();
+        record.timestamp = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch).count();
+
+        record.firstParent = static_cast<uint32_t>(writer.extras.size());
+        record.parentCount = static_cast<uint32_t>(commit.parentHashes.size());
+        for (const auto& parent : commit.parentHashes) {
+            String slice = writer.add(parent);
+            writer.extras.push_back(slice.offset);
+            writer.extras.push_back(slice.length);
+        }
+
+        record.graphLane = -1;
+        if (graph && graphRow + index < graph->size()) {
+            const auto& row = graph->row(graphRow + index);
+            record.graphLane = row.lane;
+            record.graphColor = row.color;
+            record.graphWidth = row.width;
+            record.firstEdge = static_cast<uint32_t>(writer.extras.size());
+            record.edgeCount = row.edgeCount;
+            for (uint32_t i = 0; i < row.edgeCount; ++i) {
+                const auto& edge = graph->edge(row.firstEdge + i);
+                writer.extras.push_back(static_cast<uint32_t>(edge.type));
+                writer.extras.push_back(edge.from);
+                writer.extras.push_back(edge.to);
+                writer.extras.push_back(edge.color);
+            }
+        }
+        writer.records.push_back(record);
+    }
+    return writer.finish(Kind::Commits, 0);
+}
+
+const FlatRecords::Header* FlatRecords::header(const std::string& buffer) {
+    if (buffer.size() < sizeof(Header)) {
+        return nullptr;
+    }
+    const auto* header = reinterpret_cast<const Header*>(buffer.data());
+    if (header->magic != MAGIC || header->version != VERSION ||
+        static_cast<size_t>(header->stringsOffset) + header->stringsSize != buffer.size()) {
+        return nullptr;
+    }
+    return header;
+}
+
+uint64_t FlatRecords::fileChangeId(const std::string& path, bool staged) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto add = [&hash](unsigned char byte) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    };
+    for (char c : path) {
+        add(static_cast<unsigned char>(c));
+    }
+    add(staged ? 1 : 0);
+    return hash;
+}
+
+}
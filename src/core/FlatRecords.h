@@ -0,0 +1,94 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VersionTools {
+
+class GraphLayout;
+
+// Flat, pointer-free encodings of status and history for UI bridges that
+// would otherwise build one object per field. A buffer is a single
+// allocation:
+//
+//   Header | records[recordCount] | extras[extraCount] (uint32) | strings
+//
+// Records are fixed-size, every section starts 8-byte aligned, integers are
+// in native byte order, and strings are (offset, length) slices of the
+// string table: UTF-8 as git wrote it, not NUL-terminated. Readers outside
+// C++ (the Swift bridge) read fields at the offsets pinned by the
+// static_asserts in FlatRecords.cpp; bump VERSION whenever a layout changes.
+class FlatRecords {
+public:
+    static constexpr uint32_t MAGIC = 0x42465456;  // "VTFB"
+    static constexpr uint16_t VERSION = 1;
+
+    enum class Kind : uint16_t {
+        FileChanges = 1,
+        Commits = 2
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t kind;
+        uint32_t recordCount;
+        uint32_t recordSize;
+        uint32_t extraCount;
+        uint32_t split;          // FileChanges: how many leading records are staged
+        uint32_t recordsOffset;
+        uint32_t extrasOffset;
+        uint32_t stringsOffset;
+        uint32_t stringsSize;
+    };
+
+    struct String {
+        uint32_t offset;  // From the start of the string table
+        uint32_t length;
+    };
+
+    struct FileChange {
+        String path;
+        uint32_t nameStart;  // Byte offset of the file name within path; the directory is what precedes it
+        uint32_t linesAdded;
+        uint32_t linesDeleted;
+        uint8_t status;      // FileStatus
+        uint8_t staged;
+        uint16_t reserved;
+        uint64_t id;         // FNV-1a of the path followed by the staged byte; stable across refreshes
+    };
+
+    struct Commit {
+        String hash;
+        String shortHash;
+        String author;
+        String email;
+        String message;
+        String shortMessage;
+        int64_t timestamp;     // Seconds since the epoch
+        uint32_t firstParent;  // Parents are String pairs in extras, starting at this index
+        uint32_t parentCount;
+        int32_t graphLane;     // -1 when the row has not been laid out
+        uint32_t graphColor;
+        uint32_t graphWidth;
+        uint32_t firstEdge;    // Edges are (type, from, to, color) quadruples in extras
+        uint32_t edgeCount;
+        uint32_t reserved;
+    };
+
+    // Staged changes first, each group in the order given; Header::split counts the staged ones
+    static std::string encodeFileChanges(const std::vector<GitFileChange>& changes);
+    // graphRow is the history row of commits[0] in graph; rows the graph has laid out carry their lane and edges
+    static std::string encodeCommits(const std::vector<GitCommit>& commits, const GraphLayout* graph = nullptr,
+                                     size_t graphRow = 0);
+
+    // The header of a buffer built by this class, or nullptr if it isn't one
+    static const Header* header(const std::string& buffer);
+
+    static uint64_t fileChangeId(const std::string& path, bool staged);
+};
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <string>
+#include <vector>
+#include <optional>
+
+namespace VersionTools {
+
+// In-process implementation of GitManager's read paths.
+// Every query returns std::nullopt when the backend cannot answer it
+// (unsupported option, library error), in which case GitManager falls
+// back to the system git command line.
+class GitBackend {
+public:
+    virtual ~GitBackend() = default;
+
+    virtual const char* name() const = 0;
+
+    virtual bool open(const std::string& repositoryPath) = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+
+    virtual std::optional<GitStatus> getStatus() = 0;
+    virtual std::optional<std::string> getCurrentBranch() = 0;
+    // Visits commits in log order. Returns false, without visiting anything,
+    // when the walk cannot be answered here. The visitor runs while the
+    // backend is busy and must not call back into it.
+    virtual bool walkCommitHistory(int maxCount,
+                                   GitLogOptions options,
+                                   const std::string& branch,
+                                   const std::string& filePath,
+                                   const CommitVisitor& visitor) = 0;
+    virtual std::optional<std::vector<GitBranch>> getBranches(bool includeRemote) = 0;
+    virtual std::optional<std::vector<GitTag>> getTags() = 0;
+    virtual std::optional<std::vector<GitStash>> getStashes() = 0;
+};
+
+}
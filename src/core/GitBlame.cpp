@@ -0,0 +1,187 @@
+#include "GitBlame.h"
+#include "GitUtils.h"
+#include <algorithm>
+#include <charconv>
+
+namespace VersionTools {
+
+namespace {
+
+bool hasPrefix(std::string_view text, std::string_view prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool parseNumber(std::string_view text, long long& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+// "<hash> <original line> <final line> <line count>"
+bool parseEntryHeader(std::string_view line, std::string_view& hash, GitBlameHunk& hunk) {
+    size_t first = line.find(' ');
+    size_t second = first == std::string_view::npos ? first : line.find(' ', first + 1);
+    size_t third = second == std::string_view::npos ? second : line.find(' ', second + 1);
+    if (third == std::string_view::npos || (first != 40 && first != 64)) {
+        return false;
+    }
+
+    long long original = 0, finalLine = 0, count = 0;
+    if (!parseNumber(line.substr(first + 1, second - first - 1), original) ||
+        !parseNumber(line.substr(second + 1, third - second - 1), finalLine) ||
+        !parseNumber(line.substr(third + 1), count)) {
+        return false;
+    }
+    hash = line.substr(0, first);
+    hunk.originalLine = static_cast<int>(original);
+    hunk.finalLine = static_cast<int>(finalLine);
+    hunk.lineCount = static_cast<int>(count);
+    return true;
+}
+
+} // namespace
+
+GitBlameParser::GitBlameParser(GitBlame& blame, BlameVisitor visitor) : blame(blame), visitor(std::move(visitor)) {
+    for (size_t i = 0; i < blame.commits.size(); ++i) {
+        commitIndex.emplace(blame.commits[i].hash, i);
+    }
+}
+
+bool GitBlameParser::feed(std::string_view chunk) {
+    size_t pos = 0;
+    while (!stopped && pos < chunk.size()) {
+        size_t newline = chunk.find('\n', pos);
+        if (newline == std::string_view::npos) {
+            pending.append(chunk.substr(pos));
+            break;
+        }
+        if (pending.empty()) {
+            addLine(chunk.substr(pos, newline - pos));
+        } else {
+            pending.append(chunk.substr(pos, newline - pos));
+            addLine(pending);
+            pending.clear();
+        }
+        pos = newline + 1;
+    }
+    return !stopped;
+}
+
+void GitBlameParser::addLine(std::string_view line) {
+    if (!inEntry) {
+        std::string_view hash;
+        GitBlameHunk header;
+        if (!parseEntryHeader(line, hash, header)) {
+            return;
+        }
+        auto [it, added] = commitIndex.emplace(std::string(hash), blame.commits.size());
+        if (added) {
+            blame.commits.emplace_back();
+            blame.commits.back().hash = it->first;
+        }
+        hunk = header;
+        hunk.commit = it->second;
+        inEntry = true;
+        return;
+    }
+
+    GitBlameCommit& commit = blame.commits[hunk.commit];
+    size_t space = line.find(' ');
+    std::string_view key = line.substr(0, space);
+    std::string_view value = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+
+    if (key == "filename") {
+        // Closes the entry
+        hunk.originalPath = GitUtils::unquotePath(std::string(value));
+        blame.hunks.push_back(hunk);
+        inEntry = false;
+        if (visitor && !visitor(blame.hunks.back(), commit)) {
+            stopped = true;
+        }
+    } else if (key == "author") {
+        commit.author = std::string(value);
+    } else if (key == "author-mail") {
+        if (hasPrefix(value, "<") && value.size() >= 2 && value.back() == '>') {
+            value = value.substr(1, value.size() - 2);
+        }
+        commit.authorEmail = std::string(value);
+    } else if (key == "author-time") {
+        long long seconds = 0;
+        if (parseNumber(value, seconds)) {
+            commit.authorTime = std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+        }
+    } else if (key == "summary") {
+        commit.summary = std::string(value);
+    } else if (key == "boundary") {
+        commit.isBoundary = true;
+    } else if (key == "previous") {
+        commit.previousHash = std::string(value.substr(0, value.find(' ')));
+    }
+}
+
+void GitBlameParser::finish(GitBlame& blame) {
+    auto& hunks = blame.hunks;
+    std::sort(hunks.begin(), hunks.end(),
+              [](const GitBlameHunk& a, const GitBlameHunk& b) { return a.finalLine < b.finalLine; });
+
+    size_t out = 0;
+    for (size_t i = 0; i < hunks.size(); ++i) {
+        if (out > 0) {
+            GitBlameHunk& last = hunks[out - 1];
+            if (last.commit == hunks[i].commit && last.originalPath == hunks[i].originalPath &&
+                last.finalLine + last.lineCount == hunks[i].finalLine &&
+                last.originalLine + last.lineCount == hunks[i].originalLine) {
+                last.lineCount += hunks[i].lineCount;
+                continue;
+            }
+        }
+        if (out != i) {
+            hunks[out] = std::move(hunks[i]);
+        }
+        ++out;
+    }
+    hunks.resize(out);
+}
+
+GitBlameCache::GitBlameCache(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {
+}
+
+std::string GitBlameCache::key(const std::string& commitHash, const std::string& filePath,
+                               const std::string& blobId) {
+    // The ids are fixed-length hex, so the path last can't run into them
+    return commitHash + ' ' + blobId + ' ' + filePath;
+}
+
+std::shared_ptr<const GitBlame> GitBlameCache::find(const std::string& commitHash, const std::string& filePath,
+                                                    const std::string& blobId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key(commitHash, filePath, blobId));
+    if (it == index.end()) {
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+void GitBlameCache::insert(std::shared_ptr<const GitBlame> blame) {
+    std::string entryKey = key(blame->commitHash, blame->filePath, blame->blobId);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(entryKey);
+    if (it != index.end()) {
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    entries.emplace_front(entryKey, std::move(blame));
+    index[entryKey] = entries.begin();
+    while (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+void GitBlameCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace VersionTools {
+
+// Streaming parser for `git blame --incremental` output. Chunks are fed as
+// git writes them; every entry is added to the blame and handed to the
+// visitor as soon as its closing "filename" line arrives. A commit's
+// headers are only written with its first entry, so they are remembered by
+// hash for the entries that follow.
+class GitBlameParser {
+public:
+    GitBlameParser(GitBlame& blame, BlameVisitor visitor = nullptr);
+
+    // False once the visitor asked to stop; the rest of the output is ignored
+    bool feed(std::string_view chunk);
+
+    // Sorts the hunks into line order and joins the runs that separate -L ranges cut apart
+    static void finish(GitBlame& blame);
+
+private:
+    void addLine(std::string_view line);
+
+    GitBlame& blame;
+    BlameVisitor visitor;
+    std::unordered_map<std::string, size_t> commitIndex;
+    std::string pending;  // Start of a line the last chunk ended in
+    GitBlameHunk hunk;
+    bool inEntry = false;
+    bool stopped = false;
+};
+
+// Finished blames of committed files, keyed by (commit, path, blob id). The
+// path is part of the key because blame follows that path's history: two
+// paths with the same content at a commit still blame differently. A commit
+// and its history are immutable, so an entry never goes stale; the least
+// recently used ones are dropped past the capacity. Thread-safe.
+class GitBlameCache {
+public:
+    explicit GitBlameCache(size_t capacity = 32);
+
+    std::shared_ptr<const GitBlame> find(const std::string& commitHash, const std::string& filePath,
+                                         const std::string& blobId);
+    void insert(std::shared_ptr<const GitBlame> blame);
+    void clear();
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const GitBlame>>;
+
+    static std::string key(const std::string& commitHash, const std::string& filePath, const std::string& blobId);
+
+    size_t capacity;
+    std::mutex mutex;
+    std::list<Entry> entries;  // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+};
+
+}
@@ -0,0 +1,586 @@
+#include "GitHistoryCache.h"
+#include "GitUtils.h"
+#include "SystemCommand.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VersionTools {
+
+namespace {
+
+constexpr char FILE_MAGIC[8] = {'V', 'T', 'H', 'I', 'S', 'T', '\0', '\0'};
+constexpr uint32_t FILE_VERSION = 1;
+constexpr size_t MAX_HASH_BYTES = 32;  // SHA-256; SHA-1 repositories use 20
+
+// Fixed 64-byte header, followed by the columns in this order:
+//   int64_t  timestamps[commitCount]
+//   uint32_t parentStart[commitCount + 1]      index into parents
+//   uint32_t stringOffsets[3 * commitCount + 1] author, email, subject per row
+//   uint8_t  hashes[commitCount * hashBytes]
+//   uint8_t  parents[parentCount * hashBytes]
+//   char     strings[stringBytes]
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t options;
+    uint32_t hashBytes;
+    uint32_t commitCount;
+    uint32_t parentCount;
+    uint32_t stringBytes;
+    uint8_t tip[MAX_HASH_BYTES];
+};
+static_assert(sizeof(FileHeader) == 64, "history cache header must stay 64 bytes");
+
+struct Layout {
+    size_t timestamps;
+    size_t parentStart;
+    size_t stringOffsets;
+    size_t hashes;
+    size_t parents;
+    size_t strings;
+    size_t total;
+};
+
+Layout computeLayout(const FileHeader& header) {
+    Layout layout;
+    size_t count = header.commitCount;
+    layout.timestamps = sizeof(FileHeader);
+    layout.parentStart = layout.timestamps + count * sizeof(int64_t);
+    layout.stringOffsets = layout.parentStart + (count + 1) * sizeof(uint32_t);
+    layout.hashes = layout.stringOffsets + (3 * count + 1) * sizeof(uint32_t);
+    layout.parents = layout.hashes + count * header.hashBytes;
+    layout.strings = layout.parents + size_t(header.parentCount) * header.hashBytes;
+    layout.total = layout.strings + header.stringBytes;
+    return layout;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool appendHashBytes(std::string_view hex, size_t hashBytes, std::string& out) {
+    if (hex.size() != hashBytes * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < hashBytes; ++i) {
+        int high = hexValue(hex[2 * i]);
+        int low = hexValue(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out.push_back(static_cast<char>(high << 4 | low));
+    }
+    return true;
+}
+
+std::string toHex(const uint8_t* bytes, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(length * 2, '0');
+    for (size_t i = 0; i < length; ++i) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+    }
+    return hex;
+}
+
+// FNV-1a, only used to turn the ref name into a file name
+uint64_t hashKey(const std::string& key) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : key) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Commits walked from git, already in the file's column layout
+struct Rows {
+    std::vector<int64_t> timestamps;
+    std::vector<uint32_t> parentStart{0};
+    std::vector<uint32_t> stringOffsets{0};
+    std::string hashes;
+    std::string parents;
+    std::string strings;
+
+    size_t size() const { return timestamps.size(); }
+    uint32_t parentCount() const { return parentStart.back(); }
+};
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!view) {
+            return false;
+        }
+        mapping = view;
+        data = static_cast<const char*>(MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0));
+        if (!data) {
+            close();
+            return false;
+        }
+        length = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const char*>(address);
+        length = static_cast<size_t>(info.st_size);
+        return true;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+            mapping = nullptr;
+        }
+#else
+        if (data) {
+            munmap(const_cast<char*>(data), length);
+        }
+#endif
+        data = nullptr;
+        length = 0;
+    }
+
+    const char* data = nullptr;
+    size_t length = 0;
+
+private:
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+};
+
+} // namespace
+
+class GitHistoryCache::Impl {
+public:
+    MappedFile mapping;
+    std::string owned;  // Used instead of the mapping when the file could not be written
+
+    FileHeader header{};
+    const int64_t* timestamps = nullptr;
+    const uint32_t* parentStart = nullptr;
+    const uint32_t* stringOffsets = nullptr;
+    const uint8_t* hashes = nullptr;
+    const uint8_t* parents = nullptr;
+    const char* strings = nullptr;
+    std::string tip;
+
+    size_t size() const { return header.commitCount; }
+
+    // Points the columns into a file image after checking that it is complete
+    bool attach(const char* data, size_t length) {
+        if (length < sizeof(FileHeader)) {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(FileHeader));
+        if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION ||
+            header.hashBytes == 0 || header.hashBytes > MAX_HASH_BYTES) {
+            return false;
+        }
+        Layout layout = computeLayout(header);
+        if (layout.total != length) {
+            return false;
+        }
+        timestamps = reinterpret_cast<const int64_t*>(data + layout.timestamps);
+        parentStart = reinterpret_cast<const uint32_t*>(data + layout.parentStart);
+        stringOffsets = reinterpret_cast<const uint32_t*>(data + layout.stringOffsets);
+        hashes = reinterpret_cast<const uint8_t*>(data + layout.hashes);
+        parents = reinterpret_cast<const uint8_t*>(data + layout.parents);
+        strings = data + layout.strings;
+        if (parentStart[header.commitCount] != header.parentCount ||
+            stringOffsets[3 * size_t(header.commitCount)] != header.stringBytes) {
+            return false;
+        }
+        tip = toHex(header.tip, header.hashBytes);
+        return true;
+    }
+
+    bool load(const std::string& path) {
+        if (!mapping.open(path)) {
+            return false;
+        }
+        if (!attach(mapping.data, mapping.length)) {
+            mapping.close();
+            return false;
+        }
+        return true;
+    }
+
+    static std::string serialize(const Rows& fresh, const Impl* previous, const std::string& tipBytes,
+                                 GitLogOptions options, uint32_t hashBytes);
+
+    std::string_view field(size_t index, int column) const {
+        size_t slot = 3 * index + column;
+        return std::string_view(strings + stringOffsets[slot], stringOffsets[slot + 1] - stringOffsets[slot]);
+    }
+};
+
+// New rows first, then the previous snapshot (if any) shifted behind them
+std::string GitHistoryCache::Impl::serialize(const Rows& fresh, const Impl* previous, const std::string& tipBytes,
+                                             GitLogOptions options, uint32_t hashBytes) {
+    size_t oldCount = previous ? previous->size() : 0;
+    uint32_t oldParents = previous ? previous->header.parentCount : 0;
+    uint32_t oldStrings = previous ? previous->header.stringBytes : 0;
+
+    FileHeader header{};
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.options = static_cast<uint32_t>(options);
+    header.hashBytes = hashBytes;
+    header.commitCount = static_cast<uint32_t>(fresh.size() + oldCount);
+    header.parentCount = fresh.parentCount() + oldParents;
+    header.stringBytes = static_cast<uint32_t>(fresh.strings.size()) + oldStrings;
+    std::memcpy(header.tip, tipBytes.data(), std::min<size_t>(tipBytes.size(), MAX_HASH_BYTES));
+
+    std::string image;
+    image.reserve(computeLayout(header).total);
+    auto append = [&image](const void* data, size_t length) {
+        image.append(static_cast<const char*>(data), length);
+    };
+
+    append(&header, sizeof(header));
+    append(fresh.timestamps.data(), fresh.timestamps.size() * sizeof(int64_t));
+    if (previous) {
+        append(previous->timestamps, oldCount * sizeof(int64_t));
+    }
+
+    append(fresh.parentStart.data(), fresh.parentStart.size() * sizeof(uint32_t));
+    for (size_t i = 1; i <= oldCount; ++i) {
+        uint32_t value = previous->parentStart[i] + fresh.parentCount();
+        append(&value, sizeof(value));
+    }
+
+    append(fresh.stringOffsets.data(), fresh.stringOffsets.size() * sizeof(uint32_t));
+    for (size_t i = 1; i <= 3 * oldCount; ++i) {
+        uint32_t value = previous->stringOffsets[i] + static_cast<uint32_t>(fresh.strings.size());
+        append(&value, sizeof(value));
+    }
+
+    image += fresh.hashes;
+    if (previous) {
+        append(previous->hashes, oldCount * hashBytes);
+    }
+    image += fresh.parents;
+    if (previous) {
+        append(previous->parents, size_t(oldParents) * hashBytes);
+    }
+    image += fresh.strings;
+    if (previous) {
+        append(previous->strings, oldStrings);
+    }
+    return image;
+}
+
+namespace {
+
+// Writes next to the target and renames over it, so readers never see a partial file
+bool writeAtomically(const std::string& path, const std::string& image) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    std::string temporary = path + ".tmp" + std::to_string(reinterpret_cast<uintptr_t>(&image));
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.write(image.data(), static_cast<std::streamsize>(image.size()))) {
+            out.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+// Walks `git log --topo-order <tip> [^<base>]` into rows. firstParentOfLast
+// receives the first parent of the oldest commit walked, merges included, so
+// callers can check that the walk ended right on top of base.
+bool walkHistory(const std::string& repositoryPath, const std::string& tip, const std::string& base,
+                 GitLogOptions options, uint32_t hashBytes, Rows& rows, std::string& firstParentOfLast) {
+    // Encloses the git process span: the walk's time beyond git's own is the parsing
+    TraceScope trace("parse", "log cache");
+    size_t rowsBefore = rows.timestamps.size();
+    // Every field is NUL terminated as well as every record, so one field never bleeds into the next.
+    // Children before parents even when committer dates are skewed, as GraphLayout needs
+    std::vector<std::string> args = {"log", "--topo-order", "--format=%H%x00%P%x00%an%x00%ae%x00%ct%x00%s", "-z"};
+    if ((options & GitLogOptions::FirstParentOnly) != GitLogOptions::None) {
+        args.push_back("--first-parent");
+    }
+    args.push_back(tip);
+    if (!base.empty()) {
+        args.push_back("^" + base);
+    }
+
+    const bool showMerges = (options & GitLogOptions::ShowMerges) != GitLogOptions::None;
+    std::vector<std::string> fields;
+    std::string pending;
+    bool malformed = false;
+
+    auto addRow = [&]() {
+        std::vector<std::string> parentHashes = fields[1].empty() ? std::vector<std::string>{}
+                                                                  : GitUtils::split(fields[1], " ");
+        firstParentOfLast = parentHashes.empty() ? "" : parentHashes.front();
+        // Merges are filtered here rather than with --no-merges so firstParentOfLast still sees them
+        if (!showMerges && parentHashes.size() > 1) {
+            return;
+        }
+
+        size_t hashesBefore = rows.hashes.size();
+        size_t parentsBefore = rows.parents.size();
+        bool valid = appendHashBytes(fields[0], hashBytes, rows.hashes);
+        for (const auto& parent : parentHashes) {
+            valid = valid && appendHashBytes(parent, hashBytes, rows.parents);
+        }
+        if (!valid) {
+            rows.hashes.resize(hashesBefore);
+            rows.parents.resize(parentsBefore);
+            malformed = true;
+            return;
+        }
+
+        int64_t timestamp = 0;
+        try {
+            timestamp = std::stoll(fields[4]);
+        } catch (...) {
+        }
+        rows.timestamps.push_back(timestamp);
+        rows.parentStart.push_back(static_cast<uint32_t>(rows.parents.size() / hashBytes));
+        for (size_t column : {size_t(2), size_t(3), size_t(5)}) {
+            rows.strings += fields[column];
+            rows.stringOffsets.push_back(static_cast<uint32_t>(rows.strings.size()));
+        }
+    };
+
+    auto takeField = [&](std::string field) {
+        fields.push_back(std::move(field));
+        if (fields.size() == 6) {
+            addRow();
+            fields.clear();
+        }
+    };
+
+    SystemCommand cmd;
+    auto result = cmd.executeWithCallback(
+        "git", args,
+        [&](const std::string& chunk) {
+            trace.count("bytes", static_cast<int64_t>(chunk.size()));
+            pending.append(chunk);
+            size_t start = 0;
+            size_t end;
+            while ((end = pending.find('\0', start)) != std::string::npos) {
+                takeField(pending.substr(start, end - start));
+                start = end + 1;
+            }
+            pending.erase(0, start);
+        },
+        repositoryPath);
+    if (result.exitCode != 0) {
+        return false;
+    }
+    // The last record has no terminator
+    if (!fields.empty() || !pending.empty()) {
+        takeField(std::move(pending));
+    }
+    trace.count("commits", static_cast<int64_t>(rows.timestamps.size() - rowsBefore));
+    return !malformed && fields.empty();
+}
+
+} // namespace
+
+GitHistoryCache::GitHistoryCache() : pImpl(std::make_unique<Impl>()) {}
+
+GitHistoryCache::~GitHistoryCache() = default;
+
+std::shared_ptr<GitHistoryCache> GitHistoryCache::open(const std::string& repositoryPath,
+                                                       const std::string& branch,
+                                                       GitLogOptions options) {
+    // One round trip for the cache location, the tip and the ref name the file is keyed by
+    std::string spec = branch.empty() ? "HEAD" : branch;
+    SystemCommand cmd;
+    auto resolved = cmd.execute("git", {"rev-parse", "--git-common-dir", spec + "^{commit}", "--symbolic-full-name", spec},
+                                repositoryPath);
+    if (resolved.exitCode != 0) {
+        return nullptr;
+    }
+    auto lines = GitUtils::split(resolved.output, "\n");
+    if (lines.size() < 2 || (lines[1].size() != 40 && lines[1].size() != 64)) {
+        return nullptr;
+    }
+    const std::string& tip = lines[1];
+    std::string refName = lines.size() > 2 && !lines[2].empty() ? lines[2] : spec;
+    auto hashBytes = static_cast<uint32_t>(tip.size() / 2);
+
+    std::filesystem::path commonDir(lines[0]);
+    if (commonDir.is_relative()) {
+        commonDir = std::filesystem::path(repositoryPath) / commonDir;
+    }
+    char name[40];
+    std::snprintf(name, sizeof(name), "history-%016llx.bin",
+                  static_cast<unsigned long long>(hashKey(refName + '\0' + std::to_string(int(options)))));
+    std::string path = (commonDir / "versiontools" / name).string();
+
+    std::shared_ptr<GitHistoryCache> cache(new GitHistoryCache());
+    Impl* impl = cache->pImpl.get();
+    bool loaded = impl->load(path) && impl->header.hashBytes == hashBytes &&
+                  impl->header.options == static_cast<uint32_t>(options);
+    if (loaded && impl->tip == tip) {
+        return cache;
+    }
+
+    // Only build on top of the old file when every commit in it is still part of the new history
+    std::string base;
+    if (loaded) {
+        auto ancestor = cmd.execute("git", {"merge-base", "--is-ancestor", impl->tip, tip}, repositoryPath);
+        if (ancestor.exitCode == 0) {
+            base = impl->tip;
+        }
+    }
+
+    Rows rows;
+    std::string firstParentOfLast;
+    bool extended = !base.empty() && walkHistory(repositoryPath, tip, base, options, hashBytes, rows, firstParentOfLast);
+    // A first-parent chain only continues into the old file if it ends right on the old tip
+    if (extended && (options & GitLogOptions::FirstParentOnly) != GitLogOptions::None && firstParentOfLast != base) {
+        extended = false;
+    }
+    if (!extended) {
+        rows = Rows();
+        if (!walkHistory(repositoryPath, tip, "", options, hashBytes, rows, firstParentOfLast)) {
+            return nullptr;
+        }
+    }
+
+    std::string tipBytes;
+    appendHashBytes(tip, hashBytes, tipBytes);
+    std::string image = Impl::serialize(rows, extended ? impl : nullptr, tipBytes, options, hashBytes);
+
+    std::shared_ptr<GitHistoryCache> updated(new GitHistoryCache());
+    Impl* fresh = updated->pImpl.get();
+    cache.reset();  // Release the old mapping before replacing the file (required on Windows)
+    if (writeAtomically(path, image) && fresh->load(path)) {
+        return updated;
+    }
+    fresh->owned = std::move(image);
+    if (!fresh->attach(fresh->owned.data(), fresh->owned.size())) {
+        return nullptr;
+    }
+    return updated;
+}
+
+size_t GitHistoryCache::size() const {
+    return pImpl->size();
+}
+
+const std::string& GitHistoryCache::tip() const {
+    return pImpl->tip;
+}
+
+std::string GitHistoryCache::hash(size_t index) const {
+    return toHex(pImpl->hashes + index * pImpl->header.hashBytes, pImpl->header.hashBytes);
+}
+
+bool GitHistoryCache::hashHasPrefix(size_t index, std::string_view prefix) const {
+    const uint8_t* bytes = pImpl->hashes + index * pImpl->header.hashBytes;
+    if (prefix.size() > size_t(pImpl->header.hashBytes) * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        uint8_t byte = bytes[i / 2];
+        if (hexValue(prefix[i]) != (i % 2 == 0 ? byte >> 4 : byte & 0x0f)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view GitHistoryCache::author(size_t index) const {
+    return pImpl->field(index, 0);
+}
+
+std::string_view GitHistoryCache::email(size_t index) const {
+    return pImpl->field(index, 1);
+}
+
+std::string_view GitHistoryCache::subject(size_t index) const {
+    return pImpl->field(index, 2);
+}
+
+GitCommit GitHistoryCache::commit(size_t index) const {
+    const Impl& impl = *pImpl;
+    if (index >= impl.size()) {
+        return {};
+    }
+
+    GitCommit commit;
+    commit.hash = hash(index);
+    commit.shortHash = GitUtils::shortenHash(commit.hash);
+    commit.author = std::string(impl.field(index, 0));
+    commit.email = std::string(impl.field(index, 1));
+    commit.shortMessage = std::string(impl.field(index, 2));
+    commit.message = commit.shortMessage;  // Subject only, same as the log walk
+    commit.timestamp = std::chrono::system_clock::time_point(std::chrono::seconds(impl.timestamps[index]));
+    for (uint32_t p = impl.parentStart[index]; p < impl.parentStart[index + 1]; ++p) {
+        commit.parentHashes.push_back(toHex(impl.parents + size_t(p) * impl.header.hashBytes, impl.header.hashBytes));
+    }
+    return commit;
+}
+
+}
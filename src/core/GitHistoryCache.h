@@ -0,0 +1,57 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace VersionTools {
+
+// Commit metadata (hash, parents, author, email, timestamp, subject) for one
+// ref and set of GitLogOptions, kept in a columnar file under
+// <git-common-dir>/versiontools/ and memory-mapped on open. Rows are
+// newest first, children always before their parents, and are only decoded
+// into GitCommit when asked for, so opening an up-to-date cache of any size
+// costs a rev-parse and a map.
+//
+// open() brings the file up to date with the ref tip first: it is used
+// as-is when the tip is unchanged, extended with just the new commits when
+// the old tip is an ancestor of the new one (those rows go in front of the
+// cached ones), and rebuilt after anything else (rebase, reset). The file
+// is keyed by the full ref name, so HEAD follows the checked-out branch
+// without rebuilding on every switch. An opened cache is an immutable
+// snapshot and safe to read from any thread.
+class GitHistoryCache {
+public:
+    // branch may be empty for HEAD; path-limited histories are not cached.
+    // nullptr when the ref does not resolve to a commit.
+    static std::shared_ptr<GitHistoryCache> open(const std::string& repositoryPath,
+                                                 const std::string& branch,
+                                                 GitLogOptions options);
+
+    ~GitHistoryCache();
+
+    GitHistoryCache(const GitHistoryCache&) = delete;
+    GitHistoryCache& operator=(const GitHistoryCache&) = delete;
+
+    size_t size() const;
+    const std::string& tip() const;
+
+    GitCommit commit(size_t index) const;
+    std::string hash(size_t index) const;
+    // Case-insensitive; prefix is hex digits
+    bool hashHasPrefix(size_t index, std::string_view prefix) const;
+
+    // Columns of one row without decoding it; valid while the cache is alive
+    std::string_view author(size_t index) const;
+    std::string_view email(size_t index) const;
+    std::string_view subject(size_t index) const;
+
+private:
+    GitHistoryCache();
+
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}
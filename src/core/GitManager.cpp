@@ -1,59 +1,608 @@
 #include "GitManager.h"
 #include "SystemCommand.h"
 #include "GitUtils.h"
-#include <sstream>
-#include <regex>
+#include "GitBackend.h"
+#include "CommitPrefetcher.h"
+#include "CommitSearchIndex.h"
+#include "GitBlame.h"
+#include "GitHistoryCache.h"
+#include "GitObjectReader.h"
+#include "GitOutputParser.h"
+#include "GitStatusCache.h"
+#include "GitStatusParser.h"
+#include "RefSnapshot.h"
+#include "RequestCoalescer.h"
+#include "Trace.h"
 #include <filesystem>
 #include <future>
 #include <thread>
 #include <fstream>
-#include <iomanip>
+#include <mutex>
 #include <ctime>
-#include <set>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 #ifdef USE_LIBGIT2
 #include <git2.h>
+#include "LibGit2Backend.h"
 #endif
 
 namespace VersionTools {
 
+namespace {
+
+constexpr int COMMAND_TIMEOUT_MS = 30000;      // Local commands: 30 s without output
+constexpr int REMOTE_TIMEOUT_MS = 120000;      // clone/fetch/pull/push: 2 min without progress
+constexpr auto PROGRESS_INTERVAL = std::chrono::milliseconds(50);  // At most 20 reports a second
+// git matches every pathspec against every path it walks, so add, rm and reset take minutes past a few
+// thousand paths; longer lists of plain file paths go to update-index, which takes each path as it is
+constexpr size_t PATHSPEC_BULK_LIMIT = 1000;
+
+const char* filterSpec(GitObjectFilter filter) {
+    switch (filter) {
+        case GitObjectFilter::BlobNone: return "--filter=blob:none";
+        case GitObjectFilter::TreeNone: return "--filter=tree:0";
+        case GitObjectFilter::None: break;
+    }
+    return nullptr;
+}
+
+// Splits git's stderr into progress meters, which are reported (throttled) to
+// the callback, and everything else, which is kept as the error text. Every
+// meter change and every ", done." line is reported right away.
+class ProgressReporter {
+public:
+    explicit ProgressReporter(ProgressCallback callback) : callback(std::move(callback)) {}
+
+    void feed(const std::string& chunk) {
+        partial.append(chunk);
+        size_t start = 0;
+        size_t end;
+        while ((end = partial.find_first_of("\r\n", start)) != std::string::npos) {
+            handleLine(std::string_view(partial).substr(start, end - start));
+            start = end + 1;
+        }
+        partial.erase(0, start);
+    }
+
+    // Reports the last throttled update and returns the non-progress stderr
+    std::string finish() {
+        if (!partial.empty()) {
+            handleLine(partial);
+            partial.clear();
+        }
+        if (pending) {
+            report(std::chrono::steady_clock::now());
+        }
+        return std::move(errors);
+    }
+
+private:
+    void handleLine(std::string_view line) {
+        // git pads meter lines with spaces to overwrite the previous one
+        while (!line.empty() && line.back() == ' ') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            return;
+        }
+
+        GitProgressLine progress;
+        if (!GitOutputParser::parseProgressLine(line, progress)) {
+            errors.append(line);
+            errors.push_back('\n');
+            return;
+        }
+
+        bool changed = progress.operation != operation;
+        if (changed) {
+            if (pending) {
+                report(std::chrono::steady_clock::now());
+            }
+            operation.assign(progress.operation);
+        }
+        current = progress.current;
+        total = progress.total == 0 && progress.done ? progress.current : progress.total;
+        pending = true;
+
+        auto now = std::chrono::steady_clock::now();
+        if (changed || progress.done || now - lastReport >= PROGRESS_INTERVAL) {
+            report(now);
+        }
+    }
+
+    void report(std::chrono::steady_clock::time_point now) {
+        pending = false;
+        lastReport = now;
+        if (callback) {
+            callback(operation, current, total);
+        }
+    }
+
+    ProgressCallback callback;
+    std::string partial;
+    std::string errors;
+    std::string operation;
+    int current = 0;
+    int total = 0;
+    bool pending = false;
+    std::chrono::steady_clock::time_point lastReport;
+};
+
+// Runs git; with a reporter, stderr is parsed for progress meters as it arrives. input, when given, is
+// written to git's stdin.
+GitOperationResult runGit(const std::vector<std::string>& args, const std::string& dir, int timeoutMs,
+                          ProgressReporter* reporter, std::optional<std::string> input = std::nullopt) {
+    SystemCommand cmd;
+    cmd.setTimeout(timeoutMs);
+    if (input) {
+        cmd.setInput(std::move(*input));
+    }
+    if (reporter) {
+        cmd.setErrorCallback([reporter](const std::string& chunk) { reporter->feed(chunk); });
+    }
+    auto result = cmd.execute("git", args, dir);
+    if (reporter) {
+        // stderr went to the reporter; SystemCommand only adds its own timeout or launch errors
+        result.error = reporter->finish() + result.error;
+    }
+
+    GitCommandResult gitResult = GitCommandResult::Success;
+    if (result.exitCode != 0) {
+        if (CancellationToken::current().isCancelled()) {
+            gitResult = GitCommandResult::Cancelled;
+        } else if (result.output.find("not a git repository") != std::string::npos) {
+            gitResult = GitCommandResult::InvalidRepository;
+        } else {
+            gitResult = GitCommandResult::Failed;
+        }
+    }
+
+    return {gitResult, result.output, result.error, result.exitCode};
+}
+
+// Paths NUL-separated for --pathspec-from-file=- --pathspec-file-nul
+std::string pathspecInput(const std::vector<std::string>& files) {
+    std::string input;
+    size_t size = 0;
+    for (const auto& file : files) {
+        size += file.size() + 1;
+    }
+    input.reserve(size);
+    for (const auto& file : files) {
+        input += file;
+        input.push_back('\0');
+    }
+    return input;
+}
+
+// Whether the paths can skip pathspec matching: many of them, and none names a directory
+bool isBulkFileList(const std::string& repositoryPath, const std::vector<std::string>& files) {
+    if (files.size() <= PATHSPEC_BULK_LIMIT) {
+        return false;
+    }
+    std::error_code error;
+    return std::none_of(files.begin(), files.end(), [&](const std::string& file) {
+        return file.empty() || file.back() == '/' ||
+               std::filesystem::is_directory(std::filesystem::path(repositoryPath) / file, error);
+    });
+}
+
+// The paths of `git ... -z` name listings
+std::vector<std::string_view> nulSeparated(std::string_view paths) {
+    std::vector<std::string_view> result;
+    while (!paths.empty()) {
+        size_t end = paths.find('\0');
+        result.push_back(paths.substr(0, end));
+        paths.remove_prefix(end == std::string_view::npos ? paths.size() : end + 1);
+    }
+    return result;
+}
+
+// The paths in the index, or std::nullopt when git failed; index keeps the listing they point into
+std::optional<std::unordered_set<std::string_view>> indexPaths(const std::string& repositoryPath,
+                                                               GitOperationResult& index) {
+    index = runGit({"ls-files", "-z"}, repositoryPath, COMMAND_TIMEOUT_MS, nullptr);
+    if (!index.isSuccess()) {
+        return std::nullopt;
+    }
+    auto paths = nulSeparated(index.output);
+    return std::unordered_set<std::string_view>(paths.begin(), paths.end());
+}
+
+// Whether `update-index --add --remove` stages the paths exactly as `git add` would. It differs in
+// two cases: it takes untracked ignored files, which add refuses, and it skips paths that exist neither
+// on disk nor in the index, where add fails. Lists with either go to add itself, so its errors are kept
+bool updateIndexMatchesAdd(const std::string& repositoryPath, const std::vector<std::string>& files,
+                           const std::string& input) {
+    // Without the index check-ignore does not match every path against it, and reports tracked files too;
+    // exit code 1 means no path matches an ignore rule
+    auto ignored = runGit({"check-ignore", "--no-index", "--stdin", "-z"}, repositoryPath, COMMAND_TIMEOUT_MS,
+                          nullptr, input);
+    if (ignored.exitCode != 0 && ignored.exitCode != 1) {
+        return false;
+    }
+
+    // Paths that must be in the index for add to take them
+    std::vector<std::string_view> required = nulSeparated(ignored.output);
+    std::error_code error;
+    for (const auto& file : files) {
+        if (!std::filesystem::exists(std::filesystem::symlink_status(std::filesystem::path(repositoryPath) / file,
+                                                                     error))) {
+            required.push_back(file);
+        }
+    }
+    if (required.empty()) {
+        return true;
+    }
+
+    GitOperationResult index;
+    auto tracked = indexPaths(repositoryPath, index);
+    return tracked && std::all_of(required.begin(), required.end(),
+                                  [&](std::string_view file) { return tracked->count(file) > 0; });
+}
+
+// Whether `update-index --force-remove` unstages the paths exactly as `git rm --cached` would: rm fails
+// when a path is not in the index, and refuses one whose staged content differs from both HEAD and the
+// file. Lists with either go to rm itself
+bool forceRemoveMatchesRm(const std::string& repositoryPath, const std::vector<std::string>& files) {
+    GitOperationResult index;
+    auto tracked = indexPaths(repositoryPath, index);
+    if (!tracked || !std::all_of(files.begin(), files.end(),
+                                 [&](const std::string& file) { return tracked->count(file) > 0; })) {
+        return false;
+    }
+
+    // Against the empty tree on an unborn branch
+    auto staged = runGit({"diff", "--cached", "--name-only", "--no-renames", "-z"}, repositoryPath,
+                         COMMAND_TIMEOUT_MS, nullptr);
+    auto unstaged = runGit({"diff-files", "--name-only", "-z"}, repositoryPath, COMMAND_TIMEOUT_MS, nullptr);
+    if (!staged.isSuccess() || !unstaged.isSuccess()) {
+        return false;
+    }
+    auto stagedPaths = nulSeparated(staged.output);
+    std::unordered_set<std::string_view> differsFromHead(stagedPaths.begin(), stagedPaths.end());
+    std::unordered_set<std::string_view> requested(files.begin(), files.end());
+    auto unstagedPaths = nulSeparated(unstaged.output);
+    return std::none_of(unstagedPaths.begin(), unstagedPaths.end(), [&](std::string_view path) {
+        return differsFromHead.count(path) && requested.count(path);
+    });
+}
+
+// `update-index --index-info` records putting the HEAD version of each path back into the index, or
+// taking the path out where HEAD does not have it: what `git reset HEAD -- <paths>` does
+std::string headIndexInfo(const std::string& tree, const std::vector<std::string>& files) {
+    // ls-tree -r -z: "<mode> <type> <hash>\t<path>\0"
+    std::unordered_map<std::string_view, std::string_view> entries;
+    size_t hashLength = 40;
+    std::string_view records(tree);
+    while (!records.empty()) {
+        size_t end = records.find('\0');
+        std::string_view record = records.substr(0, end);
+        records.remove_prefix(end == std::string_view::npos ? records.size() : end + 1);
+        size_t tab = record.find('\t');
+        size_t firstSpace = record.find(' ');
+        size_t secondSpace = firstSpace == std::string_view::npos ? firstSpace : record.find(' ', firstSpace + 1);
+        if (tab == std::string_view::npos || secondSpace == std::string_view::npos || secondSpace > tab) {
+            continue;
+        }
+        hashLength = tab - secondSpace - 1;
+        entries[record.substr(tab + 1)] = record.substr(0, tab);
+    }
+
+    std::string info;
+    for (const auto& file : files) {
+        auto it = entries.find(file);
+        if (it != entries.end()) {
+            // "<mode> <hash>" without the type
+            std::string_view entry = it->second;
+            size_t firstSpace = entry.find(' ');
+            info.append(entry.substr(0, firstSpace));
+            info.push_back(' ');
+            info.append(entry.substr(entry.find(' ', firstSpace + 1) + 1));
+        } else {
+            info += "0 " + std::string(hashLength, '0');
+        }
+        info.push_back('\t');
+        info += file;
+        info.push_back('\0');
+    }
+    return info;
+}
+
+std::vector<std::string> commitPatchArguments(const std::string& commitHash, const std::string& filePath) {
+    // One process for the whole commit, or a path-limited one when a file is given
+    std::vector<std::string> args = {"diff-tree", "-p", "-r", "-M", "--root", "--no-commit-id", commitHash};
+    if (!filePath.empty()) {
+        args.push_back("--");
+        args.push_back(filePath);
+    }
+    return args;
+}
+
+// Only what fits the budget is kept while git writes, so a huge diff never sits in memory whole
+std::optional<GitPatch> runPatch(const std::string& directory, const std::vector<std::string>& args,
+                                 GitPatch::Builder builder, bool differencesExit) {
+    TraceScope trace("parse", "diff");
+    SystemCommand cmd;
+    cmd.setTimeout(COMMAND_TIMEOUT_MS);
+    auto onOutput = [&](const std::string& chunk) {
+        trace.count("bytes", static_cast<int64_t>(chunk.size()));
+        builder.feed(chunk);
+    };
+
+    auto result = cmd.executeWithCallback("git", args, onOutput, directory);
+    if (result.exitCode != 0 && !(differencesExit && result.exitCode == 1)) {
+        return std::nullopt;
+    }
+    return builder.finish();
+}
+
+// Cache key of a patch: against the parents when from is empty, else between the two commits
+std::string patchKey(const std::string& from, const std::string& to, const std::string& filePath,
+                     const GitDiffBudget& budget) {
+    std::string limits = std::to_string(budget.maxBytes) + "/" + std::to_string(budget.maxLines) + "/" +
+                         std::to_string(budget.maxLineLength);
+    return ObjectCache::key(CachedObject::Patch, {from, to, filePath, limits});
+}
+
+// What CommitPrefetcher warms: the commit from the object reader and its whole patch
+void warmCommit(const std::string& repositoryPath, GitObjectReader* objects, ObjectCache& cache,
+                const std::string& hash) {
+    auto commit = objects ? objects->readCommit(hash) : std::nullopt;
+    if (!commit || CancellationToken::current().isCancelled()) {
+        return;
+    }
+    size_t commitBytes = commit->memoryUsage();
+    cache.insert(ObjectCache::key(CachedObject::Commit, {hash}), std::make_shared<const GitCommit>(std::move(*commit)),
+                 commitBytes);
+    if (auto patch = runPatch(repositoryPath, commitPatchArguments(hash, ""), GitPatch::Builder(), false)) {
+        size_t patchBytes = patch->memoryUsage();
+        cache.insert(patchKey("", hash, "", {}), std::make_shared<const GitPatch>(std::move(*patch)), patchBytes);
+    }
+}
+
+// Reads commit messages and paths for the search index one segment per
+// background task, so interactive work queued meanwhile goes first. Stops
+// once the index is complete, git fails or the index is gone.
+void scheduleSearchIndexing(std::weak_ptr<CommitSearchIndex> index, std::string repositoryPath) {
+    TaskOptions options{TaskPriority::Background, TaskAccess::Read, repositoryPath, {}};
+    CommandScheduler::shared().post(std::move(options), [index, repositoryPath]() {
+        auto search = index.lock();
+        if (!search) {
+            return;
+        }
+        if (search->indexDetails(repositoryPath)) {
+            scheduleSearchIndexing(index, repositoryPath);
+        } else {
+            search->endIndexing();
+        }
+    });
+}
+
+}
+
 class GitManager::Impl {
 public:
     std::string repositoryPath;
     std::string lastError;
     LogCallback logCallback;
     ProgressCallback progressCallback;
+#ifdef USE_LIBGIT2
+    GitBackendType backendType = GitBackendType::LibGit2;
+#else
+    GitBackendType backendType = GitBackendType::SystemGit;
+#endif
+    std::unique_ptr<GitBackend> backend;
+    std::shared_ptr<GitObjectReader> objectReader;
+    std::unique_ptr<GitStatusCache> statusCache;
+    std::unique_ptr<RefSnapshotCache> refCache;
+    GitBlameCache blameCache;
+    std::shared_ptr<CommitSearchIndex> searchIndex;
+    std::shared_ptr<ObjectCache> objectCache = std::make_shared<ObjectCache>();
+    std::shared_ptr<CommitPrefetcher> prefetcher;
+    RequestCoalescer requests;
+    // Guards creating and dropping the helpers below that are made on first use; concurrent
+    // Read tasks on one manager may ask for the same one at once
+    std::mutex lazyMutex;
+    bool statusCacheEnabled = true;
+    bool statusCacheUnavailable = false;  // Bare repository or no worktree root
+    bool statusLineStats = false;
+    uint64_t traceListener = 0;
 
     Impl(const std::string& repoPath) : repositoryPath(repoPath) {
 #ifdef USE_LIBGIT2
         git_libgit2_init();
 #endif
+        attachRepository();
     }
 
     ~Impl() {
+        Tracer::shared().unsubscribe(traceListener);
+        if (prefetcher) {
+            prefetcher->cancel();
+        }
+        // The native backend owns library handles and must go before the library is shut down
+        backend.reset();
 #ifdef USE_LIBGIT2
         git_libgit2_shutdown();
 #endif
     }
 
-    GitOperationResult executeGitCommand(const std::string& command) {
-        GitOperationResult result;
-        std::string fullCommand = "git " + command;
+    // (Re)attach the per-repository helpers. The native backend stays empty to use the CLI;
+    // the object reader, status cache and ref cache are created on first use.
+    void attachRepository() {
+        std::lock_guard<std::mutex> lock(lazyMutex);
+        backend.reset();
+        objectReader.reset();
+        statusCache.reset();
+        refCache.reset();
+        searchIndex.reset();
+        if (prefetcher) {
+            prefetcher->cancel();
+            prefetcher.reset();
+        }
+        objectCache->clear();
+        statusCacheUnavailable = false;
+        attachTraceLog();
+        if (repositoryPath.empty()) {
+            return;
+        }
+#ifdef USE_LIBGIT2
+        if (backendType == GitBackendType::LibGit2) {
+            auto native = std::make_unique<LibGit2Backend>();
+            if (native->open(repositoryPath)) {
+                backend = std::move(native);
+            }
+        }
+#endif
+    }
 
-        SystemCommand cmd;
-        auto cmdResult = cmd.execute(fullCommand, {}, repositoryPath);
+    // Forwards finished process spans run in the repository (or its worktree root) to the log callback.
+    // The listener gets copies, so it never races with later changes to either.
+    void attachTraceLog() {
+        Tracer& tracer = Tracer::shared();
+        tracer.unsubscribe(traceListener);
+        traceListener = 0;
+        if (!logCallback || repositoryPath.empty()) {
+            return;
+        }
+        traceListener = tracer.subscribe([callback = logCallback, path = repositoryPath](const TraceSpan& span) {
+            auto within = [](const std::string& inner, const std::string& outer) {
+                return GitUtils::startsWith(inner, outer) &&
+                       (inner.size() == outer.size() || inner[outer.size()] == '/' || outer.back() == '/');
+            };
+            const std::string& directory = span.directory;
+            if (std::string_view(span.category) == "process" && !directory.empty() &&
+                (within(directory, path) || within(path, directory))) {
+                callback(span.summary());
+            }
+        });
+    }
 
-        result.exitCode = cmdResult.exitCode;
-        result.output = cmdResult.output;
-        result.error = cmdResult.error;
-        result.result = cmdResult.exitCode == 0 ? GitCommandResult::Success : GitCommandResult::Failed;
+    // cat-file co-processes for object lookups, started on first use
+    GitObjectReader* objects() {
+        std::lock_guard<std::mutex> lock(lazyMutex);
+        return objectsLocked();
+    }
 
-        if (!result.isSuccess()) {
-            lastError = result.error.empty() ? result.output : result.error;
+    GitObjectReader* objectsLocked() {
+        if (!objectReader && !repositoryPath.empty()) {
+            objectReader = GitObjectReader::forRepository(repositoryPath);
+        }
+        return objectReader.get();
+    }
+
+    // Watched status snapshot for the worktree, created on first use
+    GitStatusCache* status(const GitManager* manager) {
+        std::lock_guard<std::mutex> lock(lazyMutex);
+        if (statusCache || !statusCacheEnabled || statusCacheUnavailable || repositoryPath.empty()) {
+            return statusCache.get();
+        }
+
+        auto result = manager->executeGitCommand({"rev-parse", "--show-toplevel"});
+        std::string workingDirectory = GitUtils::trim(result.output);
+        if (!result.isSuccess() || workingDirectory.empty()) {
+            statusCacheUnavailable = true;
+            return nullptr;
+        }
+
+        // Pathspecs are relative to the worktree root, which may differ from repositoryPath
+        statusCache = std::make_unique<GitStatusCache>([manager, workingDirectory](const std::vector<std::string>& paths) {
+            return manager->scanStatus(paths, workingDirectory);
+        });
+        statusCache->startWatching(workingDirectory);
+        return statusCache.get();
+    }
+
+    // Search index over the HEAD history, brought up to date with it and
+    // filled in with commit details in the background
+    std::shared_ptr<CommitSearchIndex> search() {
+        if (repositoryPath.empty()) {
+            return nullptr;
+        }
+        auto history = GitHistoryCache::open(repositoryPath, "", GitLogOptions::ShowMerges);
+        if (!history) {
+            return nullptr;
+        }
+        std::shared_ptr<CommitSearchIndex> index;
+        {
+            std::lock_guard<std::mutex> lock(lazyMutex);
+            if (!searchIndex) {
+                searchIndex = std::make_shared<CommitSearchIndex>(history);
+            }
+            index = searchIndex;
+        }
+        // Also brings a just created index up to date, which does nothing
+        index->update(std::move(history));
+        if (!index->isComplete() && index->beginIndexing()) {
+            scheduleSearchIndexing(index, repositoryPath);
         }
+        return index;
+    }
+
+    // Prefetch tasks only hold what they read with, so they may outlive the manager
+    CommitPrefetcher* prefetch() {
+        std::lock_guard<std::mutex> lock(lazyMutex);
+        if (!prefetcher && !repositoryPath.empty()) {
+            auto warm = [path = repositoryPath, reader = objectsLocked() ? objectReader : nullptr,
+                         cache = objectCache](const std::string& hash) {
+                warmCommit(path, reader.get(), *cache, hash);
+            };
+            auto isCached = [cache = objectCache](const std::string& hash) {
+                return cache->contains(patchKey("", hash, "", {}));
+            };
+            prefetcher = std::make_shared<CommitPrefetcher>(repositoryPath, std::move(warm), std::move(isCached));
+        }
+        return prefetcher.get();
+    }
 
+    // Patch of a commit (from empty) or between two commits, through the object cache when both are object ids
+    std::shared_ptr<const GitPatch> patch(const std::string& from, const std::string& to, const std::string& filePath,
+                                          const GitDiffBudget& budget) {
+        std::vector<std::string> args;
+        if (from.empty()) {
+            args = commitPatchArguments(to, filePath);
+        } else {
+            args = {"diff", "-M", from, to};
+            if (!filePath.empty()) {
+                args.push_back("--");
+                args.push_back(filePath);
+            }
+        }
+        bool cacheable = ObjectCache::isObjectId(to) && (from.empty() || ObjectCache::isObjectId(from));
+        std::string key = cacheable ? patchKey(from, to, filePath, budget) : std::string();
+        if (cacheable) {
+            if (auto cached = objectCache->find<GitPatch>(key)) {
+                return cached;
+            }
+        }
+        auto read = runPatch(repositoryPath, args, GitPatch::Builder(budget), false);
+        if (!read) {
+            return std::make_shared<const GitPatch>();
+        }
+        size_t bytes = read->memoryUsage();
+        auto result = std::make_shared<const GitPatch>(std::move(*read));
+        if (cacheable) {
+            objectCache->insert(std::move(key), result, bytes);
+        }
         return result;
     }
+
+    // Ref snapshot, rebuilt only when HEAD, refs or the config change on disk
+    std::shared_ptr<const RefSnapshot> refs() {
+        RefSnapshotCache* cache;
+        {
+            std::lock_guard<std::mutex> lock(lazyMutex);
+            if (!refCache && !repositoryPath.empty()) {
+                refCache = std::make_unique<RefSnapshotCache>(repositoryPath);
+            }
+            cache = refCache.get();
+        }
+        return cache ? cache->get() : nullptr;
+    }
 };
 
 GitManager::GitManager(const std::string& repositoryPath) 
@@ -72,27 +621,78 @@ GitOperationResult GitManager::initRepository(const std::string& path, bool bare
     auto result = executeGitCommand(args);
     if (result.isSuccess()) {
         pImpl->repositoryPath = path;
+        pImpl->attachRepository();
     }
     return result;
 }
 
 GitOperationResult GitManager::cloneRepository(const std::string& url, const std::string& path,
                                              ProgressCallback progressCallback) {
-    std::vector<std::string> args = {"clone", "--progress", url, path};
-    
-    auto result = executeGitCommand(args, "", progressCallback);
-    if (result.isSuccess()) {
-        pImpl->repositoryPath = path;
+    return cloneRepository(url, path, GitCloneOptions{}, std::move(progressCallback));
+}
+
+GitOperationResult GitManager::cloneRepository(const std::string& url, const std::string& path,
+                                             const GitCloneOptions& options,
+                                             ProgressCallback progressCallback) {
+    std::vector<std::string> args = {"clone"};
+    if (const char* filter = filterSpec(options.filter)) {
+        args.push_back(filter);
+    }
+    if (options.depth > 0) {
+        args.push_back("--depth=" + std::to_string(options.depth));
+    }
+    // --depth implies --single-branch; keep all branches unless asked otherwise
+    if (options.singleBranch) {
+        args.push_back("--single-branch");
+    } else if (options.depth > 0) {
+        args.push_back("--no-single-branch");
+    }
+    if (!options.branch.empty()) {
+        args.push_back("--branch=" + options.branch);
+    }
+    if (!options.sparsePaths.empty()) {
+        // Checks out only the top-level files until the cone is set below
+        args.push_back("--sparse");
+    }
+    args.push_back("--");
+    args.push_back(url);
+    args.push_back(path);
+
+    auto result = executeRemoteCommand(args, "", progressCallback);
+    if (!result.isSuccess()) {
+        return result;
+    }
+
+    pImpl->repositoryPath = path;
+    pImpl->attachRepository();
+    if (!options.sparsePaths.empty()) {
+        // With a blob filter this fetches the contents of the cone, so it reports progress too
+        std::vector<std::string> sparseArgs = {"sparse-checkout", "set", "--cone"};
+        sparseArgs.insert(sparseArgs.end(), options.sparsePaths.begin(), options.sparsePaths.end());
+        auto sparse = executeGitCommand(sparseArgs, path, progressCallback);
+        if (!sparse.isSuccess()) {
+            return sparse;
+        }
     }
     return result;
 }
 
+GitOperationResult GitManager::setSparseCheckout(const std::vector<std::string>& directories) {
+    if (directories.empty()) {
+        return executeGitCommand({"sparse-checkout", "disable"});
+    }
+    std::vector<std::string> args = {"sparse-checkout", "set", "--cone"};
+    args.insert(args.end(), directories.begin(), directories.end());
+    return executeGitCommand(args);
+}
+
 GitOperationResult GitManager::openRepository(const std::string& path) {
     if (!isValidRepository(path)) {
         return {GitCommandResult::InvalidRepository, "", "Not a valid git repository", 1};
     }
     
     pImpl->repositoryPath = path;
+    pImpl->attachRepository();
     return {GitCommandResult::Success, "", "", 0};
 }
 
@@ -118,97 +718,165 @@ bool GitManager::isValidRepository(const std::string& path) const {
     return std::filesystem::exists(headPath) && std::filesystem::exists(objectsPath) && std::filesystem::exists(refsPath);
 }
 
-GitRepository GitManager::getRepositoryInfo() const {
+GitRepository GitManager::getRepositoryHead() const {
+    if (auto repo = RefSnapshot::readHead(pImpl->repositoryPath)) {
+        return std::move(*repo);
+    }
+
+    // Not laid out the way readHead() expects; ask git
     GitRepository repo;
     repo.path = pImpl->repositoryPath;
     repo.workingDirectory = pImpl->repositoryPath;
+    repo.head = getCurrentBranch();
+    return repo;
+}
 
-    std::filesystem::path gitDir = std::filesystem::path(pImpl->repositoryPath) / ".git";
+GitRepository GitManager::getRepositoryInfo() const {
+    GitRepository repo = getRepositoryHead();
+    repo.status = getStatus();
+    return repo;
+}
 
-    if (std::filesystem::exists(gitDir)) {
-        if (std::filesystem::is_directory(gitDir)) {
-            repo.gitDirectory = gitDir.string();
-        } else {
-            // Handle git worktrees and submodules
-            std::ifstream gitFile(gitDir);
-            std::string line;
-            if (std::getline(gitFile, line) && line.substr(0, 8) == "gitdir: ") {
-                repo.gitDirectory = line.substr(8);
-            }
+GitStatus GitManager::getStatus() const {
+    if (auto* cache = pImpl->status(this)) {
+        // Already serialized: callers queue on the cache and the later ones find nothing left to refresh
+        return cache->getStatus();
+    }
+    return pImpl->requests.share<GitStatus>("status", [this]() { return scanStatus({}, "").value_or(GitStatus{}); });
+}
+
+GitStatus GitManager::getStatus(const std::vector<std::string>& paths) const {
+    return scanStatus(paths, "").value_or(GitStatus{});
+}
+
+std::optional<GitStatus> GitManager::queryStatus(bool refreshIndex) const {
+    if (pImpl->backend) {
+        return scanStatus({}, "");
+    }
+    std::string key = refreshIndex ? "query-status:refresh" : "query-status";
+    return pImpl->requests.share<std::optional<GitStatus>>(key, [this, refreshIndex]() -> std::optional<GitStatus> {
+        std::vector<std::string> args = {"status", "--porcelain=v2", "-z", "--branch"};
+        if (!refreshIndex) {
+            args.insert(args.begin(), "--no-optional-locks");
         }
-    } else {
-        // Bare repository
-        repo.gitDirectory = pImpl->repositoryPath;
-        repo.isBare = true;
+        auto result = executeGitCommand(args);
+        if (!result.isSuccess()) {
+            return std::nullopt;
+        }
+        return GitStatusParser::parse(result.output);
+    });
+}
+
+GitStatusDelta GitManager::refreshStatus() const {
+    if (auto* cache = pImpl->status(this)) {
+        return cache->refresh();
     }
+    return {};
+}
 
-    repo.head = getCurrentBranch();
-    repo.status = getStatus();
+void GitManager::setStatusCacheEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(pImpl->lazyMutex);
+    pImpl->statusCacheEnabled = enabled;
+    if (!enabled) {
+        pImpl->statusCache.reset();
+    }
+}
 
-    return repo;
+bool GitManager::isStatusCacheEnabled() const {
+    return pImpl->statusCacheEnabled;
 }
 
-GitStatus GitManager::getStatus() const {
-    auto result = executeGitCommand({"status", "--porcelain=v1", "-b"});
-    if (!result.isSuccess()) {
-        return {};
+void GitManager::setStatusLineStatsEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(pImpl->lazyMutex);
+    if (pImpl->statusLineStats != enabled) {
+        pImpl->statusLineStats = enabled;
+        // The snapshot is rebuilt with (or without) counts on the next getStatus()
+        pImpl->statusCache.reset();
     }
-    
-    GitStatus status;
-    auto lines = parseGitOutput(result.output);
-    
-    if (!lines.empty() && lines[0].substr(0, 2) == "##") {
-        std::string branchLine = lines[0].substr(3);
-        
-        // Parse branch information
-        std::regex branchRegex(R"(([^.]+)(?:\.\.\.([^[\s]+))?\s*(?:\[([^\]]+)\])?)");
-        std::smatch matches;
-        
-        if (std::regex_search(branchLine, matches, branchRegex)) {
-            status.currentBranch = matches[1].str();
-            if (matches[2].matched) {
-                status.upstreamBranch = matches[2].str();
+}
+
+bool GitManager::isStatusLineStatsEnabled() const {
+    return pImpl->statusLineStats;
+}
+
+bool GitManager::isWatchingStatus() const {
+    auto* cache = pImpl->status(this);
+    return cache && cache->isWatching();
+}
+
+RequestCoalescer& GitManager::requests() const {
+    return pImpl->requests;
+}
+
+std::optional<GitStatus> GitManager::scanStatus(const std::vector<std::string>& paths,
+                                                const std::string& workingDir) const {
+    // Both numstat sides run alongside the status scan: three processes at once, whatever the file count
+    std::future<GitOperationResult> indexStats;
+    std::future<GitOperationResult> worktreeStats;
+    if (pImpl->statusLineStats) {
+        auto numstat = [this, &paths, workingDir](bool cached) {
+            std::vector<std::string> args = {"--no-optional-locks", "--literal-pathspecs", "diff", "--numstat", "-z"};
+            if (cached) {
+                args.push_back("--cached");
             }
-            
-            if (matches[3].matched) {
-                std::string trackInfo = matches[3].str();
-                std::regex trackRegex(R"(ahead (\d+)|behind (\d+))");
-                std::sregex_iterator iter(trackInfo.begin(), trackInfo.end(), trackRegex);
-                std::sregex_iterator end;
-                
-                for (; iter != end; ++iter) {
-                    if ((*iter)[1].matched) {
-                        status.aheadCount = std::stoi((*iter)[1].str());
-                    } else if ((*iter)[2].matched) {
-                        status.behindCount = std::stoi((*iter)[2].str());
-                    }
-                }
+            if (!paths.empty()) {
+                args.push_back("--");
+                args.insert(args.end(), paths.begin(), paths.end());
             }
+            return executeGitCommand(args, workingDir);
+        };
+        indexStats = std::async(std::launch::async, numstat, true);
+        worktreeStats = std::async(std::launch::async, numstat, false);
+    }
+    auto withLineStats = [&](GitStatus status) {
+        if (indexStats.valid()) {
+            auto index = indexStats.get();
+            auto worktree = worktreeStats.get();
+            GitStatusParser::mergeLineStats(status, index.isSuccess() ? index.output : std::string(),
+                                            worktree.isSuccess() ? worktree.output : std::string());
         }
-    }
-    
-    // Parse file changes
-    for (size_t i = 1; i < lines.size(); ++i) {
-        if (lines[i].length() >= 3) {
-            GitFileChange change = parseFileChange(lines[i]);
-            status.changes.push_back(change);
-
-            // Any change (including untracked files) means we have uncommitted changes
-            if (change.status != FileStatus::Ignored) {
-                status.hasUncommittedChanges = true;
-            }
-            if (change.isStaged) {
-                status.hasStagedChanges = true;
-            } else if (change.status != FileStatus::Untracked) {
-                status.hasUnstagedChanges = true;
-            }
+        return status;
+    };
+
+    if (paths.empty() && pImpl->backend) {
+        if (auto status = pImpl->backend->getStatus()) {
+            GitUtils::summarizeStatus(*status);
+            return withLineStats(std::move(*status));
         }
     }
-    
-    return status;
+
+    // Scans run in the background next to commits and adds: never take index.lock for the optional
+    // stat refresh (queryStatus(true) does that on request). Paths come from the filesystem, never
+    // from a user pattern.
+    std::vector<std::string> args = {"--no-optional-locks"};
+    if (!paths.empty()) {
+        args.push_back("--literal-pathspecs");
+    }
+    args.insert(args.end(), {"status", "--porcelain=v2", "-z", "--branch"});
+    if (!paths.empty()) {
+        args.push_back("--");
+        args.insert(args.end(), paths.begin(), paths.end());
+    }
+
+    auto result = executeGitCommand(args, workingDir);
+    if (!result.isSuccess()) {
+        return std::nullopt;
+    }
+
+    return withLineStats(GitStatusParser::parse(result.output));
 }
 
 std::string GitManager::getCurrentBranch() const {
+    if (auto refs = pImpl->refs()) {
+        return refs->currentBranchName();
+    }
+
+    if (pImpl->backend) {
+        if (auto branch = pImpl->backend->getCurrentBranch()) {
+            return *branch;
+        }
+    }
+
     auto result = executeGitCommand({"branch", "--show-current"});
     if (result.isSuccess() && !result.output.empty()) {
         return GitUtils::trim(result.output);
@@ -237,11 +905,14 @@ GitOperationResult GitManager::addFiles(const std::vector<std::string>& files) {
     if (files.empty()) {
         return {GitCommandResult::Success, "", "", 0};
     }
-    
-    std::vector<std::string> args = {"add"};
-    args.insert(args.end(), files.begin(), files.end());
-    
-    return executeGitCommand(args);
+    std::string input = pathspecInput(files);
+    if (isBulkFileList(pImpl->repositoryPath, files) && updateIndexMatchesAdd(pImpl->repositoryPath, files, input)) {
+        // New, modified and deleted files alike
+        return runGit({"update-index", "--add", "--remove", "-z", "--stdin"}, pImpl->repositoryPath,
+                      COMMAND_TIMEOUT_MS, nullptr, std::move(input));
+    }
+    return runGit({"--literal-pathspecs", "add", "--pathspec-from-file=-", "--pathspec-file-nul"},
+                  pImpl->repositoryPath, COMMAND_TIMEOUT_MS, nullptr, std::move(input));
 }
 
 GitOperationResult GitManager::addAllFiles() {
@@ -252,25 +923,74 @@ GitOperationResult GitManager::removeFiles(const std::vector<std::string>& files
     if (files.empty()) {
         return {GitCommandResult::Success, "", "", 0};
     }
-    
-    std::vector<std::string> args = {"rm"};
+
+    if (cached && isBulkFileList(pImpl->repositoryPath, files) && forceRemoveMatchesRm(pImpl->repositoryPath, files)) {
+        return runGit({"update-index", "--force-remove", "-z", "--stdin"}, pImpl->repositoryPath,
+                      COMMAND_TIMEOUT_MS, nullptr, pathspecInput(files));
+    }
+
+    std::vector<std::string> args = {"--literal-pathspecs", "rm"};
     if (cached) {
         args.push_back("--cached");
     }
-    args.insert(args.end(), files.begin(), files.end());
-    
-    return executeGitCommand(args);
+    args.insert(args.end(), {"--pathspec-from-file=-", "--pathspec-file-nul"});
+    return runGit(args, pImpl->repositoryPath, COMMAND_TIMEOUT_MS, nullptr, pathspecInput(files));
 }
 
 GitOperationResult GitManager::resetFiles(const std::vector<std::string>& files) {
+    // No revision: reset then defaults to HEAD, and on an unborn branch takes the paths out of the index
     if (files.empty()) {
-        return executeGitCommand({"reset", "HEAD"});
+        return executeGitCommand({"reset"});
+    }
+    if (isBulkFileList(pImpl->repositoryPath, files)) {
+        if (!executeGitCommand({"rev-parse", "--verify", "-q", "HEAD"}).isSuccess()) {
+            return runGit({"update-index", "--force-remove", "-z", "--stdin"}, pImpl->repositoryPath,
+                          COMMAND_TIMEOUT_MS, nullptr, pathspecInput(files));
+        }
+        auto tree = executeGitCommand({"ls-tree", "-r", "-z", "--full-tree", "HEAD"});
+        if (!tree.isSuccess()) {
+            return tree;
+        }
+        return runGit({"update-index", "-z", "--index-info"}, pImpl->repositoryPath, COMMAND_TIMEOUT_MS, nullptr,
+                      headIndexInfo(tree.output, files));
+    }
+    return runGit({"--literal-pathspecs", "reset", "--pathspec-from-file=-", "--pathspec-file-nul"},
+                  pImpl->repositoryPath, COMMAND_TIMEOUT_MS, nullptr, pathspecInput(files));
+}
+
+GitOperationResult GitManager::stageLines(const std::string& filePath,
+                                          const std::vector<GitLineSelection>& selection) {
+    // Unlimited, so every selected hunk is loaded; the hunks are still those getDiff numbers
+    auto patch = readWorktreePatch(filePath, false, GitPatch::Builder(GitDiffBudget::unlimited()));
+    size_t index = patch.findFile(filePath);
+    std::string selected = index == std::string::npos ? std::string() : patch.selectionPatch(index, selection);
+    if (selected.empty()) {
+        return {GitCommandResult::Success, "", "", 0};
+    }
+    return applyPatch(selected, true, false);
+}
+
+GitOperationResult GitManager::unstageLines(const std::string& filePath,
+                                            const std::vector<GitLineSelection>& selection) {
+    auto patch = readWorktreePatch(filePath, true, GitPatch::Builder(GitDiffBudget::unlimited()));
+    size_t index = patch.findFile(filePath);
+    std::string selected = index == std::string::npos ? std::string() : patch.selectionPatch(index, selection, true);
+    if (selected.empty()) {
+        return {GitCommandResult::Success, "", "", 0};
+    }
+    return applyPatch(selected, true, true);
+}
+
+GitOperationResult GitManager::applyPatch(const std::string& patch, bool cached, bool reverse) {
+    std::vector<std::string> args = {"apply", "--whitespace=nowarn"};
+    if (cached) {
+        args.push_back("--cached");
+    }
+    if (reverse) {
+        args.push_back("-R");
     }
-    
-    std::vector<std::string> args = {"reset", "HEAD"};
-    args.insert(args.end(), files.begin(), files.end());
-    
-    return executeGitCommand(args);
+    args.push_back("-");
+    return runGit(args, pImpl->repositoryPath, COMMAND_TIMEOUT_MS, nullptr, patch);
 }
 
 GitOperationResult GitManager::resetHard(const std::string& commitHash) {
@@ -302,6 +1022,126 @@ std::vector<GitCommit> GitManager::getCommitHistory(int maxCount,
                                                    GitLogOptions options,
                                                    const std::string& branch,
                                                    const std::string& filePath) const {
+    // NUL never appears in a ref or a path, so the key is unambiguous
+    std::string key = "log";
+    for (const std::string& part :
+         {std::to_string(maxCount), std::to_string(static_cast<int>(options)), branch, filePath}) {
+        key += '\0';
+        key += part;
+    }
+
+    return pImpl->requests.share<std::vector<GitCommit>>(key, [&]() {
+        std::vector<GitCommit> commits;
+        if (maxCount > 0) {
+            commits.reserve(static_cast<size_t>(maxCount));
+        }
+
+        auto result = streamCommitHistory(
+            [&commits](const GitCommit& commit) {
+                commits.push_back(commit);
+                return true;
+            },
+            maxCount, options, branch, filePath);
+        if (!result.isSuccess()) {
+            commits.clear();
+        }
+        return commits;
+    });
+}
+
+GitOperationResult GitManager::streamCommitHistory(const CommitVisitor& visitor,
+                                                  int maxCount,
+                                                  GitLogOptions options,
+                                                  const std::string& branch,
+                                                  const std::string& filePath) const {
+    if (pImpl->backend && pImpl->backend->walkCommitHistory(maxCount, options, branch, filePath, visitor)) {
+        return {GitCommandResult::Success, "", "", 0};
+    }
+
+    // Encloses the git process span: the walk's time beyond git's own is parsing and the visitor
+    TraceScope trace("parse", "log");
+    SystemCommand cmd;
+    std::string pending;
+    bool stopped = false;
+
+    // Records are NUL terminated (-z); parse every complete one as soon as its chunk arrives
+    auto onOutput = [&](const std::string& chunk) {
+        if (stopped) {
+            return;
+        }
+        trace.count("bytes", static_cast<int64_t>(chunk.size()));
+        pending.append(chunk);
+
+        size_t start = 0;
+        size_t end;
+        while ((end = pending.find('\0', start)) != std::string::npos) {
+            if (end > start && !visitor(parseCommit(pending.substr(start, end - start)))) {
+                stopped = true;
+                cmd.cancel();
+                return;
+            }
+            trace.count("commits", 1);
+            start = end + 1;
+        }
+        pending.erase(0, start);
+    };
+
+    auto result = cmd.executeWithCallback("git", buildLogArguments(maxCount, options, branch, filePath), onOutput,
+                                          pImpl->repositoryPath);
+    if (stopped) {
+        return {GitCommandResult::Cancelled, "", "", 0};
+    }
+    if (result.exitCode != 0) {
+        pImpl->lastError = result.error;
+        return {GitCommandResult::Failed, "", result.error, result.exitCode};
+    }
+
+    // The last record has no terminator
+    if (!pending.empty()) {
+        visitor(parseCommit(pending));
+    }
+
+    return {GitCommandResult::Success, "", result.error, 0};
+}
+
+HistoryCursor GitManager::openHistory(GitLogOptions options,
+                                     const std::string& branch,
+                                     const std::string& filePath) const {
+    if (filePath.empty() && !pImpl->repositoryPath.empty()) {
+        if (auto cache = GitHistoryCache::open(pImpl->repositoryPath, branch, options)) {
+            return HistoryCursor(std::move(cache));
+        }
+    }
+
+    // Path-limited walks (and revision ranges the cache cannot key) are read once into memory
+    return HistoryCursor(getCommitHistory(0, options, branch, filePath));
+}
+
+void GitManager::prefetchCommits(const std::vector<std::string>& hashes) const {
+    if (auto* prefetcher = pImpl->prefetch()) {
+        prefetcher->prefetch(hashes);
+    }
+}
+
+void GitManager::cancelPrefetch() const {
+    std::lock_guard<std::mutex> lock(pImpl->lazyMutex);
+    if (pImpl->prefetcher) {
+        pImpl->prefetcher->cancel();
+    }
+}
+
+std::shared_ptr<const GitPatch> GitManager::findCommitPatch(const std::string& hash) const {
+    return pImpl->objectCache->find<GitPatch>(patchKey("", hash, "", {}));
+}
+
+GitCommitSearchResult GitManager::searchCommits(const std::string& query, size_t offset, size_t limit) const {
+    auto index = pImpl->search();
+    return index ? index->search(query, offset, limit) : GitCommitSearchResult{};
+}
+
+std::vector<std::string> GitManager::buildLogArguments(int maxCount, GitLogOptions options,
+                                                       const std::string& branch,
+                                                       const std::string& filePath) const {
     std::vector<std::string> args = {"log", "--pretty=format:%H|%h|%an|%ae|%s|%ct|%P", "-z"};
     
     if (maxCount > 0) {
@@ -319,6 +1159,10 @@ std::vector<GitCommit> GitManager::getCommitHistory(int maxCount,
     if ((options & GitLogOptions::FollowRenames) != GitLogOptions::None && !filePath.empty()) {
         args.push_back("--follow");
     }
+
+    if ((options & GitLogOptions::SimplifyMerges) != GitLogOptions::None) {
+        args.push_back("--simplify-merges");
+    }
     
     if (!branch.empty()) {
         args.push_back(branch);
@@ -328,26 +1172,27 @@ std::vector<GitCommit> GitManager::getCommitHistory(int maxCount,
         args.push_back("--");
         args.push_back(filePath);
     }
-    
-    auto result = executeGitCommand(args);
-    if (!result.isSuccess()) {
-        return {};
-    }
 
-    std::vector<GitCommit> commits;
-    // Split by null character since we used -z flag
-    auto commitBlocks = GitUtils::split(result.output, std::string(1, '\0'));
+    return args;
+}
 
-    for (const auto& block : commitBlocks) {
-        if (!block.empty()) {
-            commits.push_back(parseCommit(block));
+std::optional<GitCommit> GitManager::getCommit(const std::string& hash) const {
+    bool cacheable = ObjectCache::isObjectId(hash);
+    if (cacheable) {
+        if (auto cached = pImpl->objectCache->find<GitCommit>(ObjectCache::key(CachedObject::Commit, {hash}))) {
+            return *cached;
+        }
+    }
+    if (auto* objects = pImpl->objects()) {
+        if (auto commit = objects->readCommit(hash)) {
+            if (cacheable) {
+                pImpl->objectCache->insert(ObjectCache::key(CachedObject::Commit, {hash}),
+                                           std::make_shared<const GitCommit>(*commit), commit->memoryUsage());
+            }
+            return commit;
         }
     }
 
-    return commits;
-}
-
-std::optional<GitCommit> GitManager::getCommit(const std::string& hash) const {
     auto result = executeGitCommand({"show", "--pretty=format:%H|%h|%an|%ae|%s|%B|%ct|%P", 
                                    "--no-patch", hash});
     if (!result.isSuccess() || result.output.empty()) {
@@ -357,27 +1202,162 @@ std::optional<GitCommit> GitManager::getCommit(const std::string& hash) const {
     return parseCommit(result.output);
 }
 
+std::vector<GitCommit> GitManager::getCommits(const std::vector<std::string>& hashes) const {
+    if (auto* objects = pImpl->objects()) {
+        return objects->readCommits(hashes);
+    }
+    return {};
+}
+
+std::shared_ptr<const GitBlame> GitManager::blame(const std::string& filePath, const std::string& revision,
+                                                  const BlameVisitor& visitor, int firstVisibleLine,
+                                                  int visibleLineCount) const {
+    auto result = std::make_shared<GitBlame>();
+    result->filePath = filePath;
+
+    // Committed content: resolve both ids in one round trip to the object reader
+    std::optional<std::string> content;
+    if (!revision.empty()) {
+        auto* objects = pImpl->objects();
+        if (!objects) {
+            return nullptr;
+        }
+        auto ids = objects->readObjectInfo({revision + "^{commit}", revision + ":" + filePath});
+        if (ids.size() != 2 || !ids[0].found() || ids[1].type != "blob") {
+            return nullptr;
+        }
+        result->commitHash = ids[0].hash;
+        result->blobId = ids[1].hash;
+
+        if (auto cached = pImpl->blameCache.find(result->commitHash, filePath, result->blobId)) {
+            if (visitor) {
+                for (const auto& hunk : cached->hunks) {
+                    if (!visitor(hunk, cached->commits[hunk.commit])) {
+                        return nullptr;
+                    }
+                }
+            }
+            return cached;
+        }
+        if (visibleLineCount > 0) {
+            std::string key = ObjectCache::key(CachedObject::Blob, {result->blobId});
+            if (auto cached = pImpl->objectCache->find<std::string>(key)) {
+                content = *cached;
+            } else if ((content = objects->readBlob(result->blobId))) {
+                pImpl->objectCache->insert(std::move(key), std::make_shared<const std::string>(*content),
+                                           content->capacity());
+            }
+        }
+    } else if (visibleLineCount > 0) {
+        std::ifstream file(std::filesystem::path(pImpl->repositoryPath) / filePath, std::ios::binary);
+        if (file) {
+            content = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+    }
+
+    // -L ranges for each pass: the visible lines, then whatever lies around them
+    std::vector<std::vector<std::string>> passes = {{}};
+    if (content) {
+        int total = static_cast<int>(std::count(content->begin(), content->end(), '\n'));
+        if (!content->empty() && content->back() != '\n') {
+            ++total;
+        }
+        int first = std::max(firstVisibleLine, 1);
+        int last = std::min(first + visibleLineCount - 1, total);
+        if (first <= last && (first > 1 || last < total)) {
+            passes = {{"-L", std::to_string(first) + "," + std::to_string(last)}, {}};
+            if (first > 1) {
+                passes[1].insert(passes[1].end(), {"-L", "1," + std::to_string(first - 1)});
+            }
+            if (last < total) {
+                passes[1].insert(passes[1].end(), {"-L", std::to_string(last + 1) + "," + std::to_string(total)});
+            }
+        }
+    }
+
+    TraceScope trace("parse", "blame");
+    GitBlameParser parser(*result, visitor);
+    for (const auto& ranges : passes) {
+        std::vector<std::string> args = {"blame", "--incremental"};
+        args.insert(args.end(), ranges.begin(), ranges.end());
+        if (!result->commitHash.empty()) {
+            args.push_back(result->commitHash);
+        }
+        args.push_back("--");
+        args.push_back(filePath);
+
+        SystemCommand cmd;
+        cmd.setTimeout(COMMAND_TIMEOUT_MS);
+        bool stopped = false;
+        auto onOutput = [&](const std::string& chunk) {
+            trace.count("bytes", static_cast<int64_t>(chunk.size()));
+            if (!stopped && !parser.feed(chunk)) {
+                stopped = true;
+                cmd.cancel();
+            }
+        };
+        auto commandResult = cmd.executeWithCallback("git", args, onOutput, pImpl->repositoryPath);
+        if (stopped || commandResult.exitCode != 0) {
+            return nullptr;
+        }
+    }
+
+    GitBlameParser::finish(*result);
+    trace.count("hunks", static_cast<int64_t>(result->hunks.size()));
+    if (!result->commitHash.empty()) {
+        pImpl->blameCache.insert(result);
+    }
+    return result;
+}
+
+std::optional<std::string> GitManager::getFileContent(const std::string& revision,
+                                                      const std::string& filePath) const {
+    bool cacheable = ObjectCache::isObjectId(revision);
+    std::string key = cacheable ? ObjectCache::key(CachedObject::Blob, {revision, filePath}) : std::string();
+    if (cacheable) {
+        if (auto cached = pImpl->objectCache->find<std::string>(key)) {
+            return *cached;
+        }
+    }
+    if (auto* objects = pImpl->objects()) {
+        auto content = objects->readBlob(revision + ":" + filePath);
+        if (content && cacheable) {
+            pImpl->objectCache->insert(std::move(key), std::make_shared<const std::string>(*content),
+                                       content->capacity());
+        }
+        return content;
+    }
+    return std::nullopt;
+}
+
+std::vector<GitTreeEntry> GitManager::getTree(const std::string& treeish, const std::string& directory) const {
+    if (auto* objects = pImpl->objects()) {
+        if (auto entries = objects->readTree(directory.empty() ? treeish : treeish + ":" + directory)) {
+            return std::move(*entries);
+        }
+    }
+    return {};
+}
+
 GitOperationResult GitManager::executeGitCommand(const std::vector<std::string>& args,
                                                const std::string& workingDir,
-                                               ProgressCallback /*progressCallback*/) const {
-    std::string gitCommand = "git";
+                                               ProgressCallback progressCallback) const {
     std::string dir = workingDir.empty() ? pImpl->repositoryPath : workingDir;
-    
-    SystemCommand cmd;
-    auto result = cmd.execute(gitCommand, args, dir);
-    
-    GitCommandResult gitResult = GitCommandResult::Success;
-    if (result.exitCode != 0) {
-        if (result.output.find("not a git repository") != std::string::npos) {
-            gitResult = GitCommandResult::InvalidRepository;
-        } else if (result.exitCode == 128) {
-            gitResult = GitCommandResult::Failed;
-        } else {
-            gitResult = GitCommandResult::Failed;
-        }
+    if (!progressCallback) {
+        return runGit(args, dir, COMMAND_TIMEOUT_MS, nullptr);
     }
-    
-    return {gitResult, result.output, result.error, result.exitCode};
+    ProgressReporter reporter(std::move(progressCallback));
+    return runGit(args, dir, COMMAND_TIMEOUT_MS, &reporter);
+}
+
+GitOperationResult GitManager::executeRemoteCommand(std::vector<std::string> args,
+                                                  const std::string& workingDir,
+                                                  ProgressCallback progressCallback) const {
+    std::string dir = workingDir.empty() ? pImpl->repositoryPath : workingDir;
+    // Without a terminal git only prints meters when asked, and they are what keeps the timeout from firing
+    args.insert(args.begin() + 1, "--progress");
+    ProgressReporter reporter(std::move(progressCallback));
+    return runGit(args, dir, REMOTE_TIMEOUT_MS, &reporter);
 }
 
 std::vector<std::string> GitManager::parseGitOutput(const std::string& output, 
@@ -434,43 +1414,14 @@ GitFileChange GitManager::parseFileChange(const std::string& statusLine) const {
         }
     }
 
-    // Determine status based on flags
-    if (statusLine.substr(0, 2) == "??") {
-        change.status = FileStatus::Untracked;
-        change.isStaged = false;
-    } else if (statusLine.substr(0, 2) == "!!") {
-        change.status = FileStatus::Ignored;
-        change.isStaged = false;
-    } else if (stagedFlag == 'A') {
-        change.status = FileStatus::Added;
-        change.isStaged = true;
-    } else if (stagedFlag == 'M') {
-        change.status = FileStatus::Modified;
-        change.isStaged = true;
-    } else if (stagedFlag == 'D') {
-        change.status = FileStatus::Deleted;
-        change.isStaged = true;
-    } else if (stagedFlag == 'R') {
-        change.status = FileStatus::Renamed;
-        change.isStaged = true;
-    } else if (stagedFlag == 'C') {
-        change.status = FileStatus::Copied;
-        change.isStaged = true;
-    } else if (unstagedFlag == 'M') {
-        change.status = FileStatus::Modified;
-        change.isStaged = false;
-    } else if (unstagedFlag == 'D') {
-        change.status = FileStatus::Deleted;
-        change.isStaged = false;
-    } else if (unstagedFlag == 'U' || stagedFlag == 'U') {
-        change.status = FileStatus::Conflicted;
-        change.isStaged = false;
-    } else if (unstagedFlag == 'A') {
-        // Added but not staged (shouldn't happen in normal workflow)
-        change.status = FileStatus::Added;
-        change.isStaged = false;
+    // Paths with special characters are C-quoted; the cache feeds them back as literal pathspecs
+    change.filePath = GitUtils::unquotePath(change.filePath);
+    if (!change.oldPath.empty()) {
+        change.oldPath = GitUtils::unquotePath(change.oldPath);
     }
 
+    GitUtils::applyStatusCodes(stagedFlag, unstagedFlag, change);
+
     return change;
 }
 
@@ -490,117 +1441,138 @@ bool GitManager::hasStagedChanges() const {
     return getStatus().hasStagedChanges;
 }
 
+bool GitManager::setBackend(GitBackendType type) {
+    if (!isBackendAvailable(type)) {
+        return false;
+    }
+
+    pImpl->backendType = type;
+    pImpl->attachRepository();
+    return true;
+}
+
+GitBackendType GitManager::getBackend() const {
+    return pImpl->backendType;
+}
+
+bool GitManager::isBackendAvailable(GitBackendType type) {
+#ifdef USE_LIBGIT2
+    return type == GitBackendType::SystemGit || type == GitBackendType::LibGit2;
+#else
+    return type == GitBackendType::SystemGit;
+#endif
+}
+
 void GitManager::setLogCallback(LogCallback callback) {
     pImpl->logCallback = callback;
+    pImpl->attachTraceLog();
 }
 
-void GitManager::setProgressCallback(ProgressCallback callback) {
-    pImpl->progressCallback = callback;
+void GitManager::setTracingEnabled(bool enabled) {
+    Tracer::shared().setEnabled(enabled);
 }
 
-std::future<GitOperationResult> GitManager::cloneRepositoryAsync(const std::string& url, 
-                                                               const std::string& path,
-                                                               ProgressCallback progressCallback) {
-    return std::async(std::launch::async, [this, url, path, progressCallback]() {
-        return cloneRepository(url, path, progressCallback);
-    });
+bool GitManager::isTracingEnabled() {
+    return Tracer::shared().isEnabled();
 }
 
-// Additional method implementations would continue here...
-// For brevity, I'm showing the core structure and key methods
+std::vector<TraceMetric> GitManager::getTraceMetrics() {
+    return Tracer::shared().metrics();
+}
 
-// Branch operations
-std::vector<GitBranch> GitManager::getBranches(bool includeRemote) const {
-    std::vector<GitBranch> branches;
+std::vector<TraceMetric> GitManager::getStartupMetrics() {
+    auto milestones = Tracer::shared().milestones();
+    milestones.erase(std::remove_if(milestones.begin(), milestones.end(),
+                                    [](const TraceMetric& metric) { return metric.category != "startup"; }),
+                     milestones.end());
+    return milestones;
+}
 
-    // First, get current branch
-    std::string currentBranch = getCurrentBranch();
+void GitManager::clearTrace() {
+    Tracer::shared().clear();
+}
 
-    // Get all branches using for-each-ref (more reliable than branch command)
-    std::vector<std::string> args = {"for-each-ref", "--format=%(refname:short)|%(objectname:short)|%(committerdate:iso)|%(upstream:short)|%(upstream:track)|%(subject)"};
+bool GitManager::exportChromeTrace(const std::string& path) {
+    return Tracer::shared().writeChromeTrace(path);
+}
 
-    if (includeRemote) {
-        args.push_back("refs/heads");
-        args.push_back("refs/remotes");
-    } else {
-        args.push_back("refs/heads");
-    }
+ObjectCacheStatistics GitManager::getObjectCacheStatistics() const {
+    return pImpl->objectCache->statistics();
+}
 
-    auto result = executeGitCommand(args);
-    if (!result.isSuccess()) {
-        return branches;
-    }
+void GitManager::setObjectCacheLimits(size_t maxBytes, size_t maxEntries) {
+    pImpl->objectCache->setLimits(maxBytes, maxEntries);
+}
 
-    auto lines = parseGitOutput(result.output, "\n");
-    for (const auto& line : lines) {
-        if (line.empty()) continue;
+void GitManager::setProgressCallback(ProgressCallback callback) {
+    pImpl->progressCallback = callback;
+}
 
-        auto parts = GitUtils::split(line, "|");
-        if (parts.size() < 6) continue;
-
-        GitBranch branch;
-        branch.name = parts[0];
-        branch.fullName = parts[0];
-
-        // Check if it's a remote branch
-        if (branch.name.find("origin/") == 0 || branch.name.find("remotes/") == 0) {
-            branch.isRemote = true;
-            // Remove remote prefix
-            if (branch.name.find("remotes/") == 0) {
-                branch.name = branch.name.substr(8);
-            }
-        } else {
-            branch.isRemote = false;
-        }
+Task<GitOperationResult> GitManager::cloneRepositoryAsync(const std::string& url,
+                                                        const std::string& path,
+                                                        ProgressCallback progressCallback,
+                                                        CancellationToken token) {
+    return cloneRepositoryAsync(url, path, GitCloneOptions{}, std::move(progressCallback), std::move(token));
+}
 
-        // Check if current branch
-        branch.isCurrent = (branch.name == currentBranch || branch.fullName == currentBranch);
+Task<GitOperationResult> GitManager::cloneRepositoryAsync(const std::string& url,
+                                                        const std::string& path,
+                                                        const GitCloneOptions& options,
+                                                        ProgressCallback progressCallback,
+                                                        CancellationToken token) {
+    TaskOptions taskOptions{TaskPriority::Normal, TaskAccess::Write, path, std::move(token)};
+    return CommandScheduler::shared().start(std::move(taskOptions), [this, url, path, options, progressCallback]() {
+        return cloneRepository(url, path, options, progressCallback);
+    });
+}
 
-        // Parse upstream branch
-        if (!parts[3].empty()) {
-            branch.upstreamBranch = parts[3];
-        }
+Task<GitOperationResult> GitManager::fetchAsync(const std::string& remote, ProgressCallback progressCallback,
+                                                CancellationToken token) {
+    return fetchAsync(remote, GitFetchOptions{}, std::move(progressCallback), std::move(token));
+}
 
-        // Parse ahead/behind counts from tracking info
-        if (!parts[4].empty()) {
-            std::regex aheadRegex("ahead (\\d+)");
-            std::regex behindRegex("behind (\\d+)");
-            std::smatch matches;
+Task<GitOperationResult> GitManager::fetchAsync(const std::string& remote, const GitFetchOptions& options,
+                                                ProgressCallback progressCallback, CancellationToken token) {
+    return runAsync(TaskPriority::Background, TaskAccess::Write,
+                    [remote, options, progressCallback](GitManager& manager) {
+        return manager.fetch(remote, options, progressCallback);
+    }, std::move(token));
+}
 
-            if (std::regex_search(parts[4], matches, aheadRegex)) {
-                branch.aheadCount = std::stoi(matches[1]);
-            }
-            if (std::regex_search(parts[4], matches, behindRegex)) {
-                branch.behindCount = std::stoi(matches[1]);
-            }
-        }
+Task<GitOperationResult> GitManager::pullAsync(const std::string& remote, const std::string& branch,
+                                               ProgressCallback progressCallback, CancellationToken token) {
+    return runAsync(TaskPriority::Normal, TaskAccess::Write, [remote, branch, progressCallback](GitManager& manager) {
+        return manager.pull(remote, branch, progressCallback);
+    }, std::move(token));
+}
 
-        // Create minimal commit info from available data
-        if (!parts[1].empty()) {
-            GitCommit commit;
-            commit.shortHash = parts[1];
-            commit.hash = parts[1]; // We only have short hash for now
-            commit.shortMessage = parts[5];
-
-            // Parse date
-            if (!parts[2].empty()) {
-                try {
-                    // Parse ISO date format
-                    std::tm tm = {};
-                    std::istringstream ss(parts[2]);
-                    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-                    commit.timestamp = std::chrono::system_clock::from_time_t(std::mktime(&tm));
-                } catch (...) {
-                    commit.timestamp = std::chrono::system_clock::now();
-                }
-            }
-            branch.lastCommit = commit;
-        }
+Task<GitOperationResult> GitManager::pushAsync(const std::string& remote, const std::string& branch, bool force,
+                                               ProgressCallback progressCallback, CancellationToken token) {
+    return runAsync(TaskPriority::Normal, TaskAccess::Write,
+                    [remote, branch, force, progressCallback](GitManager& manager) {
+        return manager.push(remote, branch, force, progressCallback);
+    }, std::move(token));
+}
+
+// Additional method implementations would continue here...
+// For brevity, I'm showing the core structure and key methods
+
+// Branch operations
+std::vector<GitBranch> GitManager::getBranches(bool includeRemote) const {
+    if (auto refs = pImpl->refs()) {
+        return refs->toBranches(includeRemote);
+    }
 
-        branches.push_back(branch);
+    if (pImpl->backend) {
+        if (auto native = pImpl->backend->getBranches(includeRemote)) {
+            return std::move(*native);
+        }
     }
+    return {};
+}
 
-    return branches;
+std::shared_ptr<const RefSnapshot> GitManager::getRefSnapshot() const {
+    return pImpl->refs();
 }
 
 GitOperationResult GitManager::createBranch(const std::string& name, const std::string& startPoint) {
@@ -630,6 +1602,16 @@ GitOperationResult GitManager::checkoutBranch(const std::string& name) {
 
 // Stash operations
 std::vector<GitStash> GitManager::getStashes() const {
+    return pImpl->requests.share<std::vector<GitStash>>("stashes", [this]() { return listStashes(); });
+}
+
+std::vector<GitStash> GitManager::listStashes() const {
+    if (pImpl->backend) {
+        if (auto native = pImpl->backend->getStashes()) {
+            return std::move(*native);
+        }
+    }
+
     std::vector<GitStash> stashes;
 
     // Get stash list with more detailed information
@@ -653,11 +1635,7 @@ std::vector<GitStash> GitManager::getStashes() const {
         stash.index = index++;
 
         // Extract branch name from the message if present
-        std::regex branchRegex("On ([^:]+):");
-        std::smatch matches;
-        if (std::regex_search(stash.message, matches, branchRegex)) {
-            stash.branch = matches[1];
-        }
+        stash.branch = GitOutputParser::parseStashBranch(stash.message);
 
         // Parse timestamp
         try {
@@ -724,236 +1702,122 @@ GitOperationResult GitManager::stashClear() {
 }
 
 // Diff operations
-GitDiff GitManager::getCommitDiff(const std::string& commitHash) const {
-    GitDiff diff;
-
-    // Get diff for the first changed file in a commit
-    auto filesResult = executeGitCommand({"diff-tree", "--no-commit-id", "--name-status", "-r", commitHash});
-    if (!filesResult.isSuccess() || filesResult.output.empty()) {
-        return diff;
-    }
+GitPatch GitManager::readPatch(const std::vector<std::string>& args, GitPatch::Builder builder,
+                               bool differencesExit) const {
+    auto patch = runPatch(pImpl->repositoryPath, args, std::move(builder), differencesExit);
+    return patch ? std::move(*patch) : GitPatch{};
+}
 
-    auto files = parseGitOutput(filesResult.output, "\n");
-    if (files.empty()) {
-        return diff;
+std::vector<std::string> GitManager::worktreeDiffArguments(const std::string& filePath, bool staged) const {
+    std::vector<std::string> args = {"diff", "-M"};
+    if (staged) {
+        args.push_back("--cached");
     }
-
-    // Get the first file's diff
-    auto fileParts = GitUtils::split(files[0], "\t");
-    if (fileParts.size() < 2) {
-        return diff;
+    if (!filePath.empty()) {
+        args.push_back("--");
+        args.push_back(filePath);
     }
+    return args;
+}
 
-    std::string fileName = fileParts[1];
-    diff.filePath = fileName;
-
-    // Determine file status
-    if (fileParts[0] == "A") {
-        diff.isNewFile = true;
-    } else if (fileParts[0] == "D") {
-        diff.isDeletedFile = true;
+GitPatch GitManager::readWorktreePatch(const std::string& filePath, bool staged, GitPatch::Builder builder) const {
+    auto patch = readPatch(worktreeDiffArguments(filePath, staged), builder);
+    if (!patch.empty() || staged || filePath.empty()) {
+        return patch;
     }
 
-    // Get the actual diff content
-    // Use show for the commit to handle initial commits properly
-    auto diffResult = executeGitCommand({"show", commitHash, "--", fileName});
-    if (!diffResult.isSuccess()) {
-        return diff;
+    // An untracked file has no diff against the index; show it as a new file
+    auto untracked = executeGitCommand({"ls-files", "--others", "--exclude-standard", "--", filePath});
+    if (!untracked.isSuccess() || GitUtils::trim(untracked.output).empty()) {
+        return patch;
     }
+    return readPatch({"diff", "--no-index", "--", "/dev/null", filePath}, std::move(builder), true);
+}
 
-    // Parse diff hunks
-    auto lines = parseGitOutput(diffResult.output, "\n");
-    GitDiffHunk* currentHunk = nullptr;
+GitPatch GitManager::getDiffPatch(const std::string& filePath, bool staged, const GitDiffBudget& budget) const {
+    return readWorktreePatch(filePath, staged, GitPatch::Builder(budget));
+}
 
-    for (const auto& line : lines) {
-        if (line.empty()) continue;
+GitDiff GitManager::getDiff(const std::string& filePath, bool staged, const GitDiffBudget& budget) const {
+    auto patch = getDiffPatch(filePath, staged, budget);
+    size_t index = patch.findFile(filePath);
+    return index == std::string::npos ? GitDiff{} : patch.toDiff(index);
+}
 
-        // Check for hunk header
-        if (line.substr(0, 2) == "@@") {
-            std::regex hunkRegex("@@ -(\\d+)(?:,(\\d+))? \\+(\\d+)(?:,(\\d+))? @@");
-            std::smatch matches;
-            if (std::regex_search(line, matches, hunkRegex)) {
-                GitDiffHunk hunk;
-                hunk.header = line;
-                hunk.oldStart = std::stoi(matches[1]);
-                hunk.oldCount = matches[2].matched ? std::stoi(matches[2]) : 1;
-                hunk.newStart = std::stoi(matches[3]);
-                hunk.newCount = matches[4].matched ? std::stoi(matches[4]) : 1;
-                diff.hunks.push_back(hunk);
-                currentHunk = &diff.hunks.back();
-            }
-        } else if (currentHunk && !line.empty()) {
-            GitDiffLine diffLine;
-            if (line[0] == '+') {
-                diffLine.type = GitDiffLine::Type::Addition;
-                diffLine.content = line.substr(1);
-            } else if (line[0] == '-') {
-                diffLine.type = GitDiffLine::Type::Deletion;
-                diffLine.content = line.substr(1);
-            } else if (line[0] == ' ') {
-                diffLine.type = GitDiffLine::Type::Context;
-                diffLine.content = line.substr(1);
-            } else if (line.substr(0, 4) == "diff" || line.substr(0, 5) == "index" ||
-                      line.substr(0, 3) == "+++" || line.substr(0, 3) == "---") {
-                diffLine.type = GitDiffLine::Type::Header;
-                diffLine.content = line;
-            } else {
-                continue;
-            }
-            currentHunk->lines.push_back(diffLine);
-        }
-    }
+std::vector<GitDiff> GitManager::getDiffAll(bool staged, const GitDiffBudget& budget) const {
+    return getDiffPatch("", staged, budget).toDiffs();
+}
 
-    return diff;
+GitDiff GitManager::getDiffHunks(const std::string& filePath, bool staged, size_t firstHunk, size_t hunkCount,
+                                 const GitDiffBudget& budget) const {
+    // Same path-limited diff as getDiff, so hunk indices line up
+    auto patch = readWorktreePatch(filePath, staged, GitPatch::Builder(budget, firstHunk, hunkCount));
+    size_t index = patch.findFile(filePath);
+    return index == std::string::npos ? GitDiff{} : patch.toDiff(index);
 }
 
-std::vector<GitDiff> GitManager::getCommitDiffAll(const std::string& commitHash) const {
-    std::vector<GitDiff> diffs;
+GitPatch GitManager::getCommitPatch(const std::string& commitHash, const std::string& filePath,
+                                    const GitDiffBudget& budget) const {
+    return *pImpl->patch("", commitHash, filePath, budget);
+}
 
-    // Get all changed files in a commit
-    auto filesResult = executeGitCommand({"diff-tree", "--no-commit-id", "--name-status", "-r", commitHash});
-    if (!filesResult.isSuccess() || filesResult.output.empty()) {
-        return diffs;
+GitDiff GitManager::getCommitDiff(const std::string& commitHash, const std::string& filePath,
+                                  const GitDiffBudget& budget) const {
+    // Without a path this is the first changed file of the commit, as before
+    auto patch = pImpl->patch("", commitHash, filePath, budget);
+    if (patch->empty()) {
+        return {};
     }
 
-    auto files = parseGitOutput(filesResult.output, "\n");
+    size_t index = filePath.empty() ? std::string::npos : patch->findFile(filePath);
+    return patch->toDiff(index == std::string::npos ? 0 : index);
+}
 
-    for (const auto& file : files) {
-        if (file.empty()) continue;
-
-        auto fileParts = GitUtils::split(file, "\t");
-        if (fileParts.size() < 2) continue;
-
-        std::string fileName = fileParts[1];
-        GitDiff diff;
-        diff.filePath = fileName;
-
-        // Determine file status
-        if (fileParts[0] == "A") {
-            diff.isNewFile = true;
-        } else if (fileParts[0] == "D") {
-            diff.isDeletedFile = true;
-        } else if (fileParts[0].find("R") != std::string::npos && fileParts.size() >= 3) {
-            // Handle renames
-            diff.oldPath = fileParts[1];
-            diff.filePath = fileParts[2];
-        }
-
-        // Get the actual diff content for this file
-        // Use show for the commit to handle initial commits properly
-        auto diffResult = executeGitCommand({"show", commitHash, "--", fileName});
-        if (!diffResult.isSuccess()) {
-            continue;
-        }
+std::vector<GitDiff> GitManager::getCommitDiffAll(const std::string& commitHash, const GitDiffBudget& budget) const {
+    return pImpl->patch("", commitHash, "", budget)->toDiffs();
+}
 
-        // Check if binary
-        if (diffResult.output.find("Binary files") != std::string::npos) {
-            diff.isBinary = true;
-            diffs.push_back(diff);
-            continue;
-        }
+GitDiff GitManager::getCommitDiffHunks(const std::string& commitHash, const std::string& filePath,
+                                       size_t firstHunk, size_t hunkCount, const GitDiffBudget& budget) const {
+    auto patch = readPatch(commitPatchArguments(commitHash, filePath),
+                           GitPatch::Builder(budget, firstHunk, hunkCount));
+    size_t index = patch.findFile(filePath);
+    return index == std::string::npos ? GitDiff{} : patch.toDiff(index);
+}
 
-        // Parse diff hunks
-        auto lines = parseGitOutput(diffResult.output, "\n");
-        GitDiffHunk* currentHunk = nullptr;
-        int oldLineNum = 0, newLineNum = 0;
-
-        for (const auto& line : lines) {
-            if (line.empty()) continue;
-
-            // Check for hunk header
-            if (line.substr(0, 2) == "@@") {
-                std::regex hunkRegex("@@ -(\\d+)(?:,(\\d+))? \\+(\\d+)(?:,(\\d+))? @@");
-                std::smatch matches;
-                if (std::regex_search(line, matches, hunkRegex)) {
-                    GitDiffHunk hunk;
-                    hunk.header = line;
-                    hunk.oldStart = std::stoi(matches[1]);
-                    hunk.oldCount = matches[2].matched ? std::stoi(matches[2]) : 1;
-                    hunk.newStart = std::stoi(matches[3]);
-                    hunk.newCount = matches[4].matched ? std::stoi(matches[4]) : 1;
-                    diff.hunks.push_back(hunk);
-                    currentHunk = &diff.hunks.back();
-                    oldLineNum = hunk.oldStart;
-                    newLineNum = hunk.newStart;
-                }
-            } else if (currentHunk && !line.empty()) {
-                GitDiffLine diffLine;
-                if (line[0] == '+') {
-                    diffLine.type = GitDiffLine::Type::Addition;
-                    diffLine.content = line.substr(1);
-                    diffLine.newLineNumber = newLineNum++;
-                } else if (line[0] == '-') {
-                    diffLine.type = GitDiffLine::Type::Deletion;
-                    diffLine.content = line.substr(1);
-                    diffLine.oldLineNumber = oldLineNum++;
-                } else if (line[0] == ' ') {
-                    diffLine.type = GitDiffLine::Type::Context;
-                    diffLine.content = line.substr(1);
-                    diffLine.oldLineNumber = oldLineNum++;
-                    diffLine.newLineNumber = newLineNum++;
-                } else if (line.substr(0, 4) == "diff" || line.substr(0, 5) == "index" ||
-                          line.substr(0, 3) == "+++" || line.substr(0, 3) == "---") {
-                    diffLine.type = GitDiffLine::Type::Header;
-                    diffLine.content = line;
-                } else {
-                    continue;
-                }
-                currentHunk->lines.push_back(diffLine);
-            }
-        }
+GitDiff GitManager::getDiffBetweenCommits(const std::string& fromHash, const std::string& toHash,
+                                          const std::string& filePath, const GitDiffBudget& budget) const {
+    if (fromHash.empty()) {
+        return {};
+    }
+    auto patch = pImpl->patch(fromHash, toHash, filePath, budget);
+    if (patch->empty()) {
+        return {};
+    }
+    size_t index = filePath.empty() ? std::string::npos : patch->findFile(filePath);
+    return patch->toDiff(index == std::string::npos ? 0 : index);
+}
 
-        diffs.push_back(diff);
+GitDiff GitManager::parseDiff(const std::string& diffOutput, const std::string& filePath) const {
+    auto patch = GitPatch::parse(diffOutput);
+    if (patch.empty()) {
+        return {};
     }
 
-    return diffs;
+    size_t index = filePath.empty() ? std::string::npos : patch.findFile(filePath);
+    return patch.toDiff(index == std::string::npos ? 0 : index);
+}
+
+std::vector<GitDiff> GitManager::parseDiffs(const std::string& diffOutput) const {
+    return GitOutputParser::parseDiffs(diffOutput);
 }
 
 // Remote operations
 std::vector<GitRemote> GitManager::getRemotes() const {
-    std::vector<GitRemote> remotes;
-
-    auto result = pImpl->executeGitCommand("remote -v");
-    if (result.isSuccess()) {
-        std::istringstream stream(result.output);
-        std::string line;
-        std::set<std::string> seenNames;
-
-        while (std::getline(stream, line)) {
-            if (!line.empty()) {
-                auto parts = GitUtils::split(line, "\t");
-                if (parts.size() >= 2) {
-                    std::string name = parts[0];
-
-                    // Only add each remote once (git remote -v shows fetch and push URLs)
-                    if (seenNames.find(name) == seenNames.end()) {
-                        GitRemote remote;
-                        remote.name = name;
-
-                        // Parse URL and type from the second part
-                        auto urlParts = GitUtils::split(parts[1], " ");
-                        if (!urlParts.empty()) {
-                            remote.url = urlParts[0];
-                            remote.pushUrl = urlParts[0]; // Default to same as fetch
-                        }
-
-                        remotes.push_back(remote);
-                        seenNames.insert(name);
-                    }
-                }
-            }
-        }
-
-        // Get push URLs if different from fetch URLs
-        for (auto& remote : remotes) {
-            auto pushResult = pImpl->executeGitCommand("remote get-url --push " + remote.name);
-            if (pushResult.isSuccess() && !pushResult.output.empty()) {
-                remote.pushUrl = GitUtils::trim(pushResult.output);
-            }
-        }
+    if (auto refs = pImpl->refs()) {
+        return refs->remotes();
     }
-
-    return remotes;
+    return {};
 }
 
 GitOperationResult GitManager::addRemote(const std::string& name, const std::string& url) {
@@ -964,8 +1828,7 @@ GitOperationResult GitManager::addRemote(const std::string& name, const std::str
         return result;
     }
 
-    std::string command = "remote add " + name + " " + url;
-    return pImpl->executeGitCommand(command);
+    return executeGitCommand({"remote", "add", name, url});
 }
 
 GitOperationResult GitManager::removeRemote(const std::string& name) {
@@ -976,8 +1839,7 @@ GitOperationResult GitManager::removeRemote(const std::string& name) {
         return result;
     }
 
-    std::string command = "remote remove " + name;
-    return pImpl->executeGitCommand(command);
+    return executeGitCommand({"remote", "remove", name});
 }
 
 GitOperationResult GitManager::renameRemote(const std::string& oldName, const std::string& newName) {
@@ -988,11 +1850,15 @@ GitOperationResult GitManager::renameRemote(const std::string& oldName, const st
         return result;
     }
 
-    std::string command = "remote rename " + oldName + " " + newName;
-    return pImpl->executeGitCommand(command);
+    return executeGitCommand({"remote", "rename", oldName, newName});
 }
 
 GitOperationResult GitManager::fetch(const std::string& remote, ProgressCallback progressCallback) {
+    return fetch(remote, GitFetchOptions{}, std::move(progressCallback));
+}
+
+GitOperationResult GitManager::fetch(const std::string& remote, const GitFetchOptions& options,
+                                   ProgressCallback progressCallback) {
     if (remote.empty()) {
         GitOperationResult result;
         result.result = GitCommandResult::Failed;
@@ -1000,8 +1866,18 @@ GitOperationResult GitManager::fetch(const std::string& remote, ProgressCallback
         return result;
     }
 
-    std::vector<std::string> args = {"fetch", remote};
-    return executeGitCommand(args, "", progressCallback);
+    std::vector<std::string> args = {"fetch"};
+    if (const char* filter = filterSpec(options.filter)) {
+        args.push_back(filter);
+    }
+    if (options.depth > 0) {
+        args.push_back("--depth=" + std::to_string(options.depth));
+    }
+    if (options.prune) {
+        args.push_back("--prune");
+    }
+    args.push_back(remote);
+    return executeRemoteCommand(args, "", progressCallback);
 }
 
 GitOperationResult GitManager::pull(const std::string& remote, const std::string& branch, ProgressCallback progressCallback) {
@@ -1017,7 +1893,7 @@ GitOperationResult GitManager::pull(const std::string& remote, const std::string
         args.push_back(branch);
     }
 
-    return executeGitCommand(args, "", progressCallback);
+    return executeRemoteCommand(args, "", progressCallback);
 }
 
 GitOperationResult GitManager::push(const std::string& remote, const std::string& branch, bool force, ProgressCallback progressCallback) {
@@ -1036,51 +1912,21 @@ GitOperationResult GitManager::push(const std::string& remote, const std::string
         args.push_back("--force");
     }
 
-    return executeGitCommand(args, "", progressCallback);
+    return executeRemoteCommand(args, "", progressCallback);
 }
 
 // Tag operations
 std::vector<GitTag> GitManager::getTags() const {
-    std::vector<GitTag> tags;
-
-    // Get all tags with their details
-    auto result = pImpl->executeGitCommand(
-        "for-each-ref --format='%(refname:short)|%(objectname:short)|%(taggerdate:short)|%(subject)' refs/tags"
-    );
-
-    if (result.isSuccess()) {
-        std::istringstream stream(result.output);
-        std::string line;
-
-        while (std::getline(stream, line)) {
-            if (!line.empty()) {
-                auto parts = GitUtils::split(line, "|");
-                if (!parts.empty()) {
-                    GitTag tag;
-                    tag.name = parts[0];
-
-                    if (parts.size() > 1) {
-                        tag.commitHash = parts[1];
-                    }
-
-                    if (parts.size() > 2 && !parts[2].empty()) {
-                        tag.date = parts[2];
-                        tag.isAnnotated = true;
-                    } else {
-                        tag.isAnnotated = false;
-                    }
-
-                    if (parts.size() > 3) {
-                        tag.message = parts[3];
-                    }
+    if (auto refs = pImpl->refs()) {
+        return refs->toTags();
+    }
 
-                    tags.push_back(tag);
-                }
-            }
+    if (pImpl->backend) {
+        if (auto native = pImpl->backend->getTags()) {
+            return std::move(*native);
         }
     }
-
-    return tags;
+    return {};
 }
 
 GitOperationResult GitManager::createTag(const std::string& name, const std::string& message,
@@ -1092,21 +1938,19 @@ GitOperationResult GitManager::createTag(const std::string& name, const std::str
         return result;
     }
 
-    std::string command = "tag";
-
+    std::vector<std::string> args = {"tag"};
     if (!message.empty()) {
-        // Create annotated tag
-        command += " -a " + name + " -m \"" + message + "\"";
+        // Annotated tag
+        args.insert(args.end(), {"-a", name, "-m", message});
     } else {
-        // Create lightweight tag
-        command += " " + name;
+        args.push_back(name);
     }
 
     if (commitHash != "HEAD" && !commitHash.empty()) {
-        command += " " + commitHash;
+        args.push_back(commitHash);
     }
 
-    return pImpl->executeGitCommand(command);
+    return executeGitCommand(args);
 }
 
 GitOperationResult GitManager::deleteTag(const std::string& name) {
@@ -1117,13 +1961,11 @@ GitOperationResult GitManager::deleteTag(const std::string& name) {
         return result;
     }
 
-    std::string command = "tag -d " + name;
-    return pImpl->executeGitCommand(command);
+    return executeGitCommand({"tag", "-d", name});
 }
 
 GitOperationResult GitManager::pushTags(const std::string& remote) {
-    std::string command = "push " + remote + " --tags";
-    return pImpl->executeGitCommand(command);
+    return executeGitCommand({"push", remote, "--tags"});
 }
 
 }
@@ -1,11 +1,18 @@
 #pragma once
 
 #include "GitTypes.h"
+#include "CommandScheduler.h"
+#include "GitPatch.h"
+#include "HistoryCursor.h"
+#include "ObjectCache.h"
+#include "RefSnapshot.h"
+#include "RequestCoalescer.h"
+#include "Task.h"
+#include "Trace.h"
 #include <string>
 #include <vector>
 #include <memory>
 #include <functional>
-#include <future>
 
 namespace VersionTools {
 
@@ -19,6 +26,14 @@ enum class GitCommandResult {
     Cancelled
 };
 
+// Implementation used for the read paths (status, log, refs, stashes).
+// SystemGit forks the git executable for every query; LibGit2 keeps the
+// repository open in-process and falls back to SystemGit per call.
+enum class GitBackendType {
+    SystemGit,
+    LibGit2
+};
+
 struct GitOperationResult {
     GitCommandResult result;
     std::string output;
@@ -41,20 +56,48 @@ public:
     GitOperationResult initRepository(const std::string& path, bool bare = false);
     GitOperationResult cloneRepository(const std::string& url, const std::string& path, 
                                      ProgressCallback progressCallback = nullptr);
+    // Partial, shallow, single-branch and sparse clones. Network operations
+    // are only killed after two minutes without any progress from git, and
+    // progress is reported at most 20 times a second.
+    GitOperationResult cloneRepository(const std::string& url, const std::string& path,
+                                       const GitCloneOptions& options,
+                                       ProgressCallback progressCallback = nullptr);
     GitOperationResult openRepository(const std::string& path);
     bool isValidRepository(const std::string& path) const;
+    // Limits the worktree to the given directories (cone mode); an empty list
+    // restores the full checkout
+    GitOperationResult setSparseCheckout(const std::vector<std::string>& directories);
     
-    // Repository info
+    // Repository info. getRepositoryHead() only reads the git directory (no
+    // process, status left empty), enough to show the repository while
+    // getStatus() and the rest load; getRepositoryInfo() adds the status.
+    GitRepository getRepositoryHead() const;
     GitRepository getRepositoryInfo() const;
     GitStatus getStatus() const;
+    // Status limited to the given paths (relative to the repository path); never cached
+    GitStatus getStatus(const std::vector<std::string>& paths) const;
+    // One uncached scan for polling many repositories; nullopt when git failed.
+    // Leaves the index lock alone unless refreshIndex is set, which lets git
+    // write back refreshed stat data once so later scans stop rehashing files.
+    std::optional<GitStatus> queryStatus(bool refreshIndex = false) const;
     std::string getCurrentBranch() const;
     std::string getRepositoryPath() const;
     
-    // Commit operations
+    // Commit operations. The paths go to git over stdin (--pathspec-from-file),
+    // so any number of them takes one process and no command line limit applies.
+    // They are literal paths, never globs.
     GitOperationResult addFiles(const std::vector<std::string>& files);
     GitOperationResult addAllFiles();
     GitOperationResult removeFiles(const std::vector<std::string>& files, bool cached = false);
     GitOperationResult resetFiles(const std::vector<std::string>& files);
+    // Partial staging: the selected lines of filePath's unstaged diff go into
+    // the index, or those of its staged diff come back out of it. Hunks and
+    // lines are numbered as in getDiff(filePath, staged); see
+    // GitPatch::selectionPatch. Nothing selected is a success that runs nothing.
+    GitOperationResult stageLines(const std::string& filePath, const std::vector<GitLineSelection>& selection);
+    GitOperationResult unstageLines(const std::string& filePath, const std::vector<GitLineSelection>& selection);
+    // `git apply` with the patch on stdin, to the index only when cached
+    GitOperationResult applyPatch(const std::string& patch, bool cached = true, bool reverse = false);
     GitOperationResult resetHard(const std::string& commitHash = "HEAD");
     GitOperationResult commit(const std::string& message, bool amend = false);
     GitOperationResult commitWithFiles(const std::string& message, 
@@ -65,7 +108,37 @@ public:
                                           GitLogOptions options = GitLogOptions::None,
                                           const std::string& branch = "",
                                           const std::string& filePath = "") const;
+    // Same query as getCommitHistory, but each commit is handed to the visitor
+    // as soon as its record has been read, before git has finished the walk.
+    GitOperationResult streamCommitHistory(const CommitVisitor& visitor,
+                                           int maxCount = 0,
+                                           GitLogOptions options = GitLogOptions::None,
+                                           const std::string& branch = "",
+                                           const std::string& filePath = "") const;
+    // Cursor for paging through the whole history; without a file path it is
+    // served from the on-disk history cache, which is brought up to date first
+    HistoryCursor openHistory(GitLogOptions options = GitLogOptions::None,
+                              const std::string& branch = "",
+                              const std::string& filePath = "") const;
+    // Commits of the HEAD history (merges included) matching query, newest
+    // first; see CommitSearchIndex for the syntax. Messages and paths are
+    // read into the index by background tasks after the first search, so
+    // until the result is complete only subjects and authors of the
+    // remaining commits are matched.
+    GitCommitSearchResult searchCommits(const std::string& query, size_t offset = 0, size_t limit = 50) const;
+    // Speculative reads for history browsing: getCommit() and the whole-commit
+    // getCommitPatch() (default budget) of the given full hashes, nearest
+    // first, are read into the object cache by preemptible background tasks,
+    // which yield to any interactive work. A new call replaces what is left
+    // of the previous one; see CommitPrefetcher::neighbourRows for the usual
+    // choice of commits.
+    void prefetchCommits(const std::vector<std::string>& hashes) const;
+    void cancelPrefetch() const;
+    // Whole-commit patch (default budget) already in the object cache, nullptr otherwise; never runs git
+    std::shared_ptr<const GitPatch> findCommitPatch(const std::string& hash) const;
     std::optional<GitCommit> getCommit(const std::string& hash) const;
+    // Batched lookup over one cat-file round trip; unknown hashes are skipped
+    std::vector<GitCommit> getCommits(const std::vector<std::string>& hashes) const;
     std::vector<GitCommit> getCommitRange(const std::string& fromHash, 
                                         const std::string& toHash) const;
     
@@ -78,6 +151,10 @@ public:
     GitOperationResult checkoutBranch(const std::string& name);
     GitOperationResult mergeBranch(const std::string& branchName, bool noFastForward = false);
     GitOperationResult rebaseBranch(const std::string& branchName);
+
+    // Branches, tags, remotes and HEAD from one for-each-ref, reused until a ref
+    // or the config changes on disk. nullptr when git cannot be run.
+    std::shared_ptr<const RefSnapshot> getRefSnapshot() const;
     
     // Remote operations
     std::vector<GitRemote> getRemotes() const;
@@ -86,6 +163,8 @@ public:
     GitOperationResult renameRemote(const std::string& oldName, const std::string& newName);
     GitOperationResult fetch(const std::string& remote = "origin", 
                            ProgressCallback progressCallback = nullptr);
+    GitOperationResult fetch(const std::string& remote, const GitFetchOptions& options,
+                           ProgressCallback progressCallback = nullptr);
     GitOperationResult pull(const std::string& remote = "origin", 
                           const std::string& branch = "",
                           ProgressCallback progressCallback = nullptr);
@@ -94,15 +173,47 @@ public:
                           bool force = false,
                           ProgressCallback progressCallback = nullptr);
     
-    // Diff operations
-    GitDiff getDiff(const std::string& filePath, bool staged = false) const;
-    std::vector<GitDiff> getDiffAll(bool staged = false) const;
-    GitDiff getCommitDiff(const std::string& commitHash) const;
-    std::vector<GitDiff> getCommitDiffAll(const std::string& commitHash) const;
+    // Diff operations. Diffs are read within `budget`: hunks past it keep their
+    // header and ranges but come back with isLoaded false, to be fetched with
+    // getDiffHunks/getCommitDiffHunks as they scroll into view. Binary files
+    // are whatever git decides (attributes, then a NUL in the first 8000 bytes).
+    GitDiff getDiff(const std::string& filePath, bool staged = false, const GitDiffBudget& budget = {}) const;
+    std::vector<GitDiff> getDiffAll(bool staged = false, const GitDiffBudget& budget = {}) const;
+    GitDiff getCommitDiff(const std::string& commitHash, const std::string& filePath = "",
+                          const GitDiffBudget& budget = {}) const;
+    std::vector<GitDiff> getCommitDiffAll(const std::string& commitHash, const GitDiffBudget& budget = {}) const;
+    // Compact form of the same patches; views into them replace per-line strings
+    GitPatch getCommitPatch(const std::string& commitHash, const std::string& filePath = "",
+                            const GitDiffBudget& budget = {}) const;
+    GitPatch getDiffPatch(const std::string& filePath = "", bool staged = false,
+                          const GitDiffBudget& budget = {}) const;
     GitDiff getDiffBetweenCommits(const std::string& fromHash, 
                                 const std::string& toHash,
-                                const std::string& filePath = "") const;
+                                const std::string& filePath = "",
+                                const GitDiffBudget& budget = {}) const;
+    // One file's diff with only hunks [firstHunk, firstHunk + hunkCount) loaded, numbered as in
+    // GitDiff::hunks of getDiff/getCommitDiff for the same path. The first of them is loaded
+    // whatever its size, the rest while they fit the budget.
+    GitDiff getDiffHunks(const std::string& filePath, bool staged, size_t firstHunk, size_t hunkCount,
+                         const GitDiffBudget& budget = {}) const;
+    GitDiff getCommitDiffHunks(const std::string& commitHash, const std::string& filePath, size_t firstHunk,
+                               size_t hunkCount, const GitDiffBudget& budget = {}) const;
     
+    // Blame of filePath at revision, or of the working tree file when revision
+    // is empty, from `git blame --incremental`. Hunks reach the visitor while
+    // git is still running: lines [firstVisibleLine, firstVisibleLine +
+    // visibleLineCount) first when a range is given, then the rest. Committed
+    // blames are cached per (commit, path), so blaming them again replays the
+    // cached hunks without running git. nullptr when git failed or the
+    // visitor stopped.
+    std::shared_ptr<const GitBlame> blame(const std::string& filePath, const std::string& revision = "",
+                                          const BlameVisitor& visitor = nullptr, int firstVisibleLine = 0,
+                                          int visibleLineCount = 0) const;
+    
+    // Object access
+    std::optional<std::string> getFileContent(const std::string& revision, const std::string& filePath) const;
+    std::vector<GitTreeEntry> getTree(const std::string& treeish, const std::string& directory = "") const;
+
     // Tag operations
     std::vector<GitTag> getTags() const;
     GitOperationResult createTag(const std::string& name, const std::string& message = "",
@@ -131,24 +242,102 @@ public:
     bool hasStagedChanges() const;
     std::string getLastError() const;
     
-    // Async operations
-    std::future<GitOperationResult> cloneRepositoryAsync(const std::string& url, 
-                                                       const std::string& path,
-                                                       ProgressCallback progressCallback = nullptr);
-    std::future<GitOperationResult> fetchAsync(const std::string& remote = "origin",
-                                             ProgressCallback progressCallback = nullptr);
-    std::future<GitOperationResult> pullAsync(const std::string& remote = "origin",
-                                            const std::string& branch = "",
-                                            ProgressCallback progressCallback = nullptr);
-    std::future<GitOperationResult> pushAsync(const std::string& remote = "origin",
-                                            const std::string& branch = "",
-                                            bool force = false,
-                                            ProgressCallback progressCallback = nullptr);
-    
-    // Event callbacks
+    // Async operations. They run on CommandScheduler::shared(): clone, pull
+    // and push in the Normal lane, fetch in the Background lane, each as a
+    // Write task so they never overlap another index or ref update of the same
+    // repository. The result goes to the task's continuation on the executor
+    // passed to then(); cancelling the task (or the token) kills the running
+    // git process and the result then reports GitCommandResult::Cancelled.
+    Task<GitOperationResult> cloneRepositoryAsync(const std::string& url,
+                                                  const std::string& path,
+                                                  ProgressCallback progressCallback = nullptr,
+                                                  CancellationToken token = {});
+    Task<GitOperationResult> cloneRepositoryAsync(const std::string& url,
+                                                  const std::string& path,
+                                                  const GitCloneOptions& options,
+                                                  ProgressCallback progressCallback = nullptr,
+                                                  CancellationToken token = {});
+    Task<GitOperationResult> fetchAsync(const std::string& remote = "origin",
+                                        ProgressCallback progressCallback = nullptr,
+                                        CancellationToken token = {});
+    Task<GitOperationResult> fetchAsync(const std::string& remote,
+                                        const GitFetchOptions& options,
+                                        ProgressCallback progressCallback = nullptr,
+                                        CancellationToken token = {});
+    Task<GitOperationResult> pullAsync(const std::string& remote = "origin",
+                                       const std::string& branch = "",
+                                       ProgressCallback progressCallback = nullptr,
+                                       CancellationToken token = {});
+    Task<GitOperationResult> pushAsync(const std::string& remote = "origin",
+                                       const std::string& branch = "",
+                                       bool force = false,
+                                       ProgressCallback progressCallback = nullptr,
+                                       CancellationToken token = {});
+
+    // Runs work(*this) on the shared scheduler, keyed by this repository, and
+    // returns a Task of what it returns; any other operation goes async this
+    // way, e.g. runAsync(TaskPriority::Interactive, TaskAccess::Read,
+    // [](GitManager& m) { return m.getStatus(); }). The manager must outlive
+    // the task.
+    template <typename Work>
+    auto runAsync(TaskPriority priority, TaskAccess access, Work&& work, CancellationToken token = {}) {
+        TaskOptions options{priority, access, getRepositoryPath(), std::move(token)};
+        return CommandScheduler::shared().start(std::move(options), [this, work = std::forward<Work>(work)]() mutable {
+            return work(*this);
+        });
+    }
+    
+    // Status cache. While enabled, getStatus() serves a snapshot kept current
+    // from filesystem notifications and only re-queries the paths that changed.
+    // refreshStatus() returns what changed since the previous refresh (an empty
+    // delta when the cache is disabled).
+    GitStatusDelta refreshStatus() const;
+    void setStatusCacheEnabled(bool enabled);
+    bool isStatusCacheEnabled() const;
+    // Fill GitFileChange::linesAdded/linesDeleted in every status scan from
+    // `git diff --numstat` of the index and the worktree, run alongside the
+    // status itself. Off by default; costs two processes per scan.
+    void setStatusLineStatsEnabled(bool enabled);
+    bool isStatusLineStatsEnabled() const;
+    // True when the snapshot is kept current by filesystem notifications
+    bool isWatchingStatus() const;
+
+    // Request coalescing for this repository. Identical uncached status,
+    // history and stash queries running at the same time share one git
+    // process; UI layers queue their refreshes through refresh() so a burst
+    // runs once and results older than the newest request can be dropped.
+    RequestCoalescer& requests() const;
+
+    // Backend selection
+    bool setBackend(GitBackendType type);
+    GitBackendType getBackend() const;
+    static bool isBackendAvailable(GitBackendType type);
+
+    // Event callbacks. While tracing is enabled the log callback also gets a
+    // line for every git process run in this repository.
     void setLogCallback(LogCallback callback);
     void setProgressCallback(ProgressCallback callback);
 
+    // Tracing of every git process and parse step, shared by all managers;
+    // see Tracer for the raw spans. Nearly free while disabled.
+    static void setTracingEnabled(bool enabled);
+    static bool isTracingEnabled();
+    // Per command and parser totals of the recorded spans, slowest first
+    static std::vector<TraceMetric> getTraceMetrics();
+    // The "startup" stages of the repository opens so far (first paint,
+    // interactive...; see TraceSpan), recorded whether or not tracing is on;
+    // last is the latest open
+    static std::vector<TraceMetric> getStartupMetrics();
+    static void clearTrace();
+    // Chrome trace_event JSON, for chrome://tracing or Perfetto
+    static bool exportChromeTrace(const std::string& path);
+
+    // Commits, commit patches and blobs read by full object id are kept in a
+    // size-bounded cache (128 MB, 4096 entries by default) for as long as
+    // the repository stays attached; its hit, miss and eviction counts
+    ObjectCacheStatistics getObjectCacheStatistics() const;
+    void setObjectCacheLimits(size_t maxBytes, size_t maxEntries);
+
 private:
     class Impl;
     std::unique_ptr<Impl> pImpl;
@@ -156,13 +345,32 @@ private:
     GitOperationResult executeGitCommand(const std::vector<std::string>& args,
                                        const std::string& workingDir = "",
                                        ProgressCallback progressCallback = nullptr) const;
+    // clone/fetch/pull/push: adds --progress, uses the inactivity timeout for
+    // network operations and keeps the progress meters out of result.error
+    GitOperationResult executeRemoteCommand(std::vector<std::string> args,
+                                            const std::string& workingDir,
+                                            ProgressCallback progressCallback) const;
+    
+    // Streams `git <args>` into builder; an empty patch if git fails. `git diff --no-index`
+    // exits 1 when the files differ, which differencesExit accepts.
+    GitPatch readPatch(const std::vector<std::string>& args, GitPatch::Builder builder,
+                       bool differencesExit = false) const;
+    std::vector<std::string> worktreeDiffArguments(const std::string& filePath, bool staged) const;
+    GitPatch readWorktreePatch(const std::string& filePath, bool staged, GitPatch::Builder builder) const;
     
+    std::optional<GitStatus> scanStatus(const std::vector<std::string>& paths,
+                                        const std::string& workingDir) const;
+    std::vector<GitStash> listStashes() const;
+    std::vector<std::string> buildLogArguments(int maxCount, GitLogOptions options,
+                                               const std::string& branch,
+                                               const std::string& filePath) const;
     std::vector<std::string> parseGitOutput(const std::string& output, 
                                           const std::string& delimiter = "\n") const;
     GitCommit parseCommit(const std::string& commitData) const;
     GitBranch parseBranch(const std::string& branchData) const;
     GitFileChange parseFileChange(const std::string& statusLine) const;
     GitDiff parseDiff(const std::string& diffOutput, const std::string& filePath = "") const;
+    std::vector<GitDiff> parseDiffs(const std::string& diffOutput) const;
 };
 
 }
\ No newline at end of file
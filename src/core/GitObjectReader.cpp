@@ -0,0 +1,695 @@
+#include "GitObjectReader.h"
+#include "SystemCommand.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace VersionTools {
+
+namespace {
+
+constexpr auto DEFAULT_IDLE_TIMEOUT = std::chrono::seconds(30);
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+// Requests up to this size fit in the pipe without the child reading, so they are written inline
+constexpr size_t INLINE_WRITE_LIMIT = 4096;
+
+#ifndef _WIN32
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+#endif
+
+// A child process with a writable stdin and a buffered, readable stdout
+class CoProcess {
+public:
+    ~CoProcess() { stop(); }
+
+    bool start(const std::string& workingDirectory, const std::vector<std::string>& args);
+    bool isRunning() const;
+    bool write(const std::string& data);
+    bool readLine(std::string& line);
+    bool readExact(size_t count, std::string& data);
+    // Kill the child without releasing the handles, unblocking a concurrent write
+    void terminate();
+    void stop();
+
+private:
+    bool fill();
+
+    std::string buffer;
+    size_t bufferPos = 0;
+#ifdef _WIN32
+    HANDLE process = NULL;
+    HANDLE input = INVALID_HANDLE_VALUE;
+    HANDLE output = INVALID_HANDLE_VALUE;
+#else
+    pid_t pid = -1;
+    int input = -1;
+    int output = -1;
+#endif
+};
+
+#ifdef _WIN32
+bool CoProcess::start(const std::string& workingDirectory, const std::vector<std::string>& args) {
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.lpSecurityDescriptor = NULL;
+    sa.bInheritHandle = TRUE;
+
+    HANDLE childInput, childOutput;
+    if (!CreatePipe(&childInput, &input, &sa, 0)) {
+        return false;
+    }
+    if (!CreatePipe(&output, &childOutput, &sa, 0)) {
+        CloseHandle(childInput);
+        CloseHandle(input);
+        input = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    SetHandleInformation(input, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(output, HANDLE_FLAG_INHERIT, 0);
+
+    std::string cmdLine = "git";
+    for (const auto& arg : args) {
+        cmdLine += " " + arg;
+    }
+
+    STARTUPINFO si;
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.hStdInput = childInput;
+    si.hStdOutput = childOutput;
+    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    si.dwFlags |= STARTF_USESTDHANDLES;
+
+    BOOL success = CreateProcess(NULL, const_cast<char*>(cmdLine.c_str()), NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL,
+                                 workingDirectory.empty() ? NULL : workingDirectory.c_str(), &si, &pi);
+    CloseHandle(childInput);
+    CloseHandle(childOutput);
+
+    if (!success) {
+        stop();
+        return false;
+    }
+
+    CloseHandle(pi.hThread);
+    process = pi.hProcess;
+    return true;
+}
+
+bool CoProcess::isRunning() const {
+    return process != NULL;
+}
+
+bool CoProcess::write(const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        DWORD count = 0;
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size() - written, READ_CHUNK_SIZE));
+        if (!WriteFile(input, data.data() + written, chunk, &count, NULL)) {
+            return false;
+        }
+        written += count;
+    }
+    return true;
+}
+
+bool CoProcess::fill() {
+    char chunk[READ_CHUNK_SIZE];
+    DWORD count = 0;
+    if (!ReadFile(output, chunk, sizeof(chunk), &count, NULL) || count == 0) {
+        return false;
+    }
+    buffer.append(chunk, count);
+    return true;
+}
+
+void CoProcess::terminate() {
+    if (process != NULL) {
+        TerminateProcess(process, 1);
+    }
+}
+
+void CoProcess::stop() {
+    if (input != INVALID_HANDLE_VALUE) {
+        // EOF on stdin makes cat-file exit on its own
+        CloseHandle(input);
+        input = INVALID_HANDLE_VALUE;
+    }
+    if (output != INVALID_HANDLE_VALUE) {
+        CloseHandle(output);
+        output = INVALID_HANDLE_VALUE;
+    }
+    if (process != NULL) {
+        if (WaitForSingleObject(process, 1000) != WAIT_OBJECT_0) {
+            TerminateProcess(process, 1);
+        }
+        CloseHandle(process);
+        process = NULL;
+    }
+    buffer.clear();
+    bufferPos = 0;
+}
+#else
+bool CoProcess::start(const std::string& workingDirectory, const std::vector<std::string>& args) {
+    // stdin is a socket so that writes to an exited child fail with EPIPE instead of raising SIGPIPE
+    int inputPair[2], outputPipe[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, inputPair) == -1) {
+        return false;
+    }
+    if (pipe(outputPipe) == -1) {
+        close(inputPair[0]);
+        close(inputPair[1]);
+        return false;
+    }
+
+    // Keep other children (SystemCommand runs) from inheriting these and holding stdin open
+    for (int fd : {inputPair[0], inputPair[1], outputPipe[0], outputPipe[1]}) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(inputPair[0], SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+    // Launched like every SystemCommand: posix_spawn, the cached git lookup, default signal handling
+    int devNull = open("/dev/null", O_WRONLY);
+    if (devNull != -1) {
+        fcntl(devNull, F_SETFD, FD_CLOEXEC);
+    }
+    pid_t child = SystemCommand::spawn("git", args, workingDirectory, inputPair[1], outputPipe[1], devNull);
+    if (devNull != -1) {
+        close(devNull);
+    }
+    if (child == -1) {
+        close(inputPair[0]);
+        close(inputPair[1]);
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+        return false;
+    }
+
+    close(inputPair[1]);
+    close(outputPipe[1]);
+    pid = child;
+    input = inputPair[0];
+    output = outputPipe[0];
+    return true;
+}
+
+bool CoProcess::isRunning() const {
+    return pid != -1;
+}
+
+bool CoProcess::write(const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t count = send(input, data.data() + written, data.size() - written, SEND_FLAGS);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool CoProcess::fill() {
+    char chunk[READ_CHUNK_SIZE];
+    ssize_t count;
+    do {
+        count = read(output, chunk, sizeof(chunk));
+    } while (count == -1 && errno == EINTR);
+
+    if (count <= 0) {
+        return false;
+    }
+    buffer.append(chunk, static_cast<size_t>(count));
+    return true;
+}
+
+void CoProcess::terminate() {
+    if (pid != -1) {
+        kill(pid, SIGKILL);
+    }
+}
+
+void CoProcess::stop() {
+    if (input != -1) {
+        // EOF on stdin makes cat-file exit on its own
+        close(input);
+        input = -1;
+    }
+    if (output != -1) {
+        close(output);
+        output = -1;
+    }
+    if (pid != -1) {
+        int status = 0;
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+        }
+        pid = -1;
+    }
+    buffer.clear();
+    bufferPos = 0;
+}
+#endif
+
+bool CoProcess::readLine(std::string& line) {
+    while (true) {
+        size_t newline = buffer.find('\n', bufferPos);
+        if (newline != std::string::npos) {
+            line.assign(buffer, bufferPos, newline - bufferPos);
+            bufferPos = newline + 1;
+            return true;
+        }
+        // Compact before growing so the buffer never holds consumed data
+        buffer.erase(0, bufferPos);
+        bufferPos = 0;
+        if (!fill()) {
+            return false;
+        }
+    }
+}
+
+bool CoProcess::readExact(size_t count, std::string& data) {
+    data.clear();
+    data.reserve(count);
+    while (data.size() < count) {
+        if (bufferPos == buffer.size()) {
+            buffer.clear();
+            bufferPos = 0;
+            if (!fill()) {
+                return false;
+            }
+        }
+        size_t take = std::min(count - data.size(), buffer.size() - bufferPos);
+        data.append(buffer, bufferPos, take);
+        bufferPos += take;
+    }
+    return true;
+}
+
+// "<hash> <type> <size>", or "<spec> missing" / "<spec> ambiguous"
+bool parseHeader(const std::string& header, GitObject& object) {
+    size_t sizeStart = header.rfind(' ');
+    if (sizeStart == std::string::npos) {
+        return false;
+    }
+    std::string last = header.substr(sizeStart + 1);
+    if (last == "missing" || last == "ambiguous") {
+        return true;
+    }
+
+    size_t typeStart = header.rfind(' ', sizeStart - 1);
+    if (typeStart == std::string::npos || typeStart == 0) {
+        return false;
+    }
+    try {
+        object.size = static_cast<size_t>(std::stoull(last));
+    } catch (...) {
+        return false;
+    }
+    object.hash = header.substr(0, typeStart);
+    object.type = header.substr(typeStart + 1, sizeStart - typeStart - 1);
+    return true;
+}
+
+// "Name <email> 1600000000 +0100"
+void parseSignature(const std::string& value, std::string& name, std::string& email,
+                    std::chrono::system_clock::time_point& timestamp) {
+    size_t emailStart = value.find('<');
+    size_t emailEnd = value.find('>', emailStart == std::string::npos ? 0 : emailStart);
+    if (emailStart == std::string::npos || emailEnd == std::string::npos) {
+        name = value;
+        return;
+    }
+
+    name = value.substr(0, emailStart);
+    while (!name.empty() && name.back() == ' ') {
+        name.pop_back();
+    }
+    email = value.substr(emailStart + 1, emailEnd - emailStart - 1);
+
+    try {
+        timestamp = std::chrono::system_clock::time_point(std::chrono::seconds(std::stoll(value.substr(emailEnd + 1))));
+    } catch (...) {
+        timestamp = std::chrono::system_clock::now();
+    }
+}
+
+GitCommit parseCommitObject(const GitObject& object) {
+    GitCommit commit;
+    commit.hash = object.hash;
+    commit.shortHash = object.hash.substr(0, 7);
+
+    const std::string& data = object.data;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t end = data.find('\n', pos);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        if (end == pos) {
+            // Blank line ends the headers
+            pos = end + 1;
+            break;
+        }
+
+        std::string line = data.substr(pos, end - pos);
+        pos = end + 1;
+
+        // Continuation lines belong to multi-line headers such as gpgsig
+        if (line[0] == ' ') {
+            continue;
+        }
+
+        size_t space = line.find(' ');
+        std::string key = line.substr(0, space);
+        std::string value = space == std::string::npos ? "" : line.substr(space + 1);
+        if (key == "parent") {
+            commit.parentHashes.push_back(value);
+        } else if (key == "author") {
+            std::chrono::system_clock::time_point authorTime;
+            parseSignature(value, commit.author, commit.email, authorTime);
+        } else if (key == "committer") {
+            // History ordering and display use the committer time, as `%ct` does
+            std::string name, email;
+            parseSignature(value, name, email, commit.timestamp);
+        }
+    }
+
+    commit.message = pos < data.size() ? data.substr(pos) : "";
+    while (!commit.message.empty() && commit.message.back() == '\n') {
+        commit.message.pop_back();
+    }
+    commit.shortMessage = commit.message.substr(0, commit.message.find('\n'));
+    return commit;
+}
+
+// Binary tree format: "<mode> <name>\0<raw hash>" repeated
+std::vector<GitTreeEntry> parseTreeObject(const GitObject& object) {
+    static const char* hexDigits = "0123456789abcdef";
+    size_t hashBytes = object.hash.size() / 2;
+
+    std::vector<GitTreeEntry> entries;
+    const std::string& data = object.data;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t space = data.find(' ', pos);
+        size_t nul = space == std::string::npos ? space : data.find('\0', space);
+        if (nul == std::string::npos || nul + hashBytes >= data.size()) {
+            break;
+        }
+
+        GitTreeEntry entry;
+        entry.mode = data.substr(pos, space - pos);
+        entry.name = data.substr(space + 1, nul - space - 1);
+        entry.hash.reserve(hashBytes * 2);
+        for (size_t i = 0; i < hashBytes; ++i) {
+            auto byte = static_cast<unsigned char>(data[nul + 1 + i]);
+            entry.hash += hexDigits[byte >> 4];
+            entry.hash += hexDigits[byte & 0x0f];
+        }
+
+        if (entry.mode == "40000") {
+            entry.type = "tree";
+        } else if (entry.mode == "160000") {
+            entry.type = "commit";
+        } else {
+            entry.type = "blob";
+        }
+
+        entries.push_back(std::move(entry));
+        pos = nul + 1 + hashBytes;
+    }
+    return entries;
+}
+
+} // namespace
+
+class GitObjectReader::Impl {
+public:
+    std::string repositoryPath;
+    std::chrono::milliseconds idleTimeout = DEFAULT_IDLE_TIMEOUT;
+
+    // Serializes requests and guards everything below
+    std::mutex mutex;
+    std::condition_variable idleCondition;
+    CoProcess batch;       // git cat-file --batch
+    CoProcess batchCheck;  // git cat-file --batch-check
+    std::chrono::steady_clock::time_point lastUse;
+    bool stopping = false;
+    std::thread reaper;
+
+    explicit Impl(const std::string& path) : repositoryPath(path) {}
+
+    ~Impl() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        idleCondition.notify_all();
+        if (reaper.joinable()) {
+            reaper.join();
+        }
+        batch.stop();
+        batchCheck.stop();
+    }
+
+    // Stops the co-processes once no request has arrived for idleTimeout
+    void reapIdle() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (!batch.isRunning() && !batchCheck.isRunning()) {
+                idleCondition.wait(lock);
+                continue;
+            }
+            auto deadline = lastUse + idleTimeout;
+            if (std::chrono::steady_clock::now() >= deadline) {
+                batch.stop();
+                batchCheck.stop();
+                continue;
+            }
+            idleCondition.wait_until(lock, deadline);
+        }
+    }
+
+    // Caller holds the mutex
+    bool query(CoProcess& process, const char* mode, std::vector<GitObject>& objects, bool withContents) {
+        lastUse = std::chrono::steady_clock::now();
+
+        if (!process.isRunning()) {
+            if (!process.start(repositoryPath, {"cat-file", mode})) {
+                return false;
+            }
+            if (!reaper.joinable()) {
+                reaper = std::thread(&Impl::reapIdle, this);
+            }
+            idleCondition.notify_all();
+        }
+
+        // cat-file reads one name per line; names that cannot be sent are reported as missing
+        std::string request;
+        std::vector<GitObject*> pending;
+        pending.reserve(objects.size());
+        for (auto& object : objects) {
+            if (!object.spec.empty() && object.spec.find('\n') == std::string::npos) {
+                request += object.spec;
+                request += '\n';
+                pending.push_back(&object);
+            }
+        }
+        if (pending.empty()) {
+            return true;
+        }
+
+        // Large batches are written from a second thread while responses are read, or both pipes fill up
+        bool writeOk = true;
+        std::thread writer;
+        if (request.size() <= INLINE_WRITE_LIMIT) {
+            writeOk = process.write(request);
+        } else {
+            writer = std::thread([&process, &request, &writeOk] { writeOk = process.write(request); });
+        }
+
+        bool readOk = writeOk;
+        std::string header;
+        for (size_t i = 0; readOk && i < pending.size(); ++i) {
+            GitObject& object = *pending[i];
+            readOk = process.readLine(header) && parseHeader(header, object);
+            if (readOk && withContents && object.found()) {
+                std::string terminator;
+                readOk = process.readExact(object.size, object.data) && process.readExact(1, terminator);
+            }
+        }
+
+        if (!readOk) {
+            process.terminate();
+        }
+        if (writer.joinable()) {
+            writer.join();
+        }
+        if (!readOk || !writeOk) {
+            // Out of sync with the child; the next request starts a fresh one
+            process.stop();
+            for (auto* object : pending) {
+                object->hash.clear();
+                object->type.clear();
+                object->data.clear();
+            }
+            return false;
+        }
+
+        lastUse = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    std::vector<GitObject> lookup(const std::vector<std::string>& specs, bool withContents) {
+        std::vector<GitObject> objects(specs.size());
+        for (size_t i = 0; i < specs.size(); ++i) {
+            objects[i].spec = specs[i];
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (withContents) {
+            query(batch, "--batch", objects, true);
+        } else {
+            query(batchCheck, "--batch-check", objects, false);
+        }
+        return objects;
+    }
+};
+
+std::shared_ptr<GitObjectReader> GitObjectReader::forRepository(const std::string& repositoryPath) {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<GitObjectReader>> registry;
+
+    std::error_code error;
+    std::string key = std::filesystem::weakly_canonical(repositoryPath, error).string();
+    if (error) {
+        key = repositoryPath;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& slot = registry[key];
+    if (auto reader = slot.lock()) {
+        return reader;
+    }
+
+    // Drop entries whose readers have all been released
+    for (auto it = registry.begin(); it != registry.end();) {
+        if (it->second.expired() && it->first != key) {
+            it = registry.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    auto reader = std::make_shared<GitObjectReader>(repositoryPath);
+    slot = reader;
+    return reader;
+}
+
+GitObjectReader::GitObjectReader(const std::string& repositoryPath)
+    : pImpl(std::make_unique<Impl>(repositoryPath)) {
+}
+
+GitObjectReader::~GitObjectReader() = default;
+
+std::vector<GitObject> GitObjectReader::readObjects(const std::vector<std::string>& specs) {
+    return pImpl->lookup(specs, true);
+}
+
+std::vector<GitObject> GitObjectReader::readObjectInfo(const std::vector<std::string>& specs) {
+    return pImpl->lookup(specs, false);
+}
+
+std::optional<GitObject> GitObjectReader::readObject(const std::string& spec) {
+    auto objects = readObjects({spec});
+    if (!objects[0].found()) {
+        return std::nullopt;
+    }
+    return std::move(objects[0]);
+}
+
+std::optional<GitCommit> GitObjectReader::readCommit(const std::string& revision) {
+    auto object = readObject(revision + "^{commit}");
+    if (!object || object->type != "commit") {
+        return std::nullopt;
+    }
+    return parseCommitObject(*object);
+}
+
+std::vector<GitCommit> GitObjectReader::readCommits(const std::vector<std::string>& revisions) {
+    std::vector<std::string> specs;
+    specs.reserve(revisions.size());
+    for (const auto& revision : revisions) {
+        specs.push_back(revision + "^{commit}");
+    }
+
+    std::vector<GitCommit> commits;
+    commits.reserve(revisions.size());
+    for (const auto& object : readObjects(specs)) {
+        if (object.type == "commit") {
+            commits.push_back(parseCommitObject(object));
+        }
+    }
+    return commits;
+}
+
+std::optional<std::string> GitObjectReader::readBlob(const std::string& spec) {
+    auto object = readObject(spec);
+    if (!object || object->type != "blob") {
+        return std::nullopt;
+    }
+    return std::move(object->data);
+}
+
+std::optional<std::vector<GitTreeEntry>> GitObjectReader::readTree(const std::string& treeish) {
+    // "<rev>:<path>" swallows any suffix into the path, so peel commits with a second lookup
+    auto object = readObject(treeish);
+    if (object && object->type == "commit") {
+        object = readObject(object->data.substr(5, object->data.find('\n') - 5));
+    }
+    if (!object || object->type != "tree") {
+        return std::nullopt;
+    }
+    return parseTreeObject(*object);
+}
+
+void GitObjectReader::setIdleTimeout(std::chrono::milliseconds timeout) {
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        pImpl->idleTimeout = timeout;
+    }
+    pImpl->idleCondition.notify_all();
+}
+
+void GitObjectReader::shutdown() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->batch.stop();
+    pImpl->batchCheck.stop();
+}
+
+}
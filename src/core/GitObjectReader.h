@@ -0,0 +1,57 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace VersionTools {
+
+struct GitObject {
+    std::string spec;  // Object name as requested (hash, "HEAD:path", ...)
+    std::string hash;
+    std::string type;  // Empty when the object does not exist
+    size_t size = 0;
+    std::string data;  // Raw contents; left empty by info-only lookups
+    bool found() const { return !type.empty(); }
+};
+
+// Long-lived `git cat-file --batch` and `--batch-check` co-processes for one
+// repository. Requests are pipelined over stdin while the responses are read
+// back, so a batch of lookups costs a single round trip and thousands of
+// lookups cost one fork. The processes start on first use and exit again
+// once the reader has been idle for the idle timeout.
+class GitObjectReader {
+public:
+    // Shared reader for a repository; callers on the same path get the same co-processes
+    static std::shared_ptr<GitObjectReader> forRepository(const std::string& repositoryPath);
+
+    explicit GitObjectReader(const std::string& repositoryPath);
+    ~GitObjectReader();
+
+    GitObjectReader(const GitObjectReader&) = delete;
+    GitObjectReader& operator=(const GitObjectReader&) = delete;
+
+    // Results are returned in request order; missing objects have found() == false
+    std::vector<GitObject> readObjects(const std::vector<std::string>& specs);
+    std::vector<GitObject> readObjectInfo(const std::vector<std::string>& specs);
+    std::optional<GitObject> readObject(const std::string& spec);
+
+    // Typed lookups; std::nullopt when the object is missing or of another type
+    std::optional<GitCommit> readCommit(const std::string& revision);
+    std::vector<GitCommit> readCommits(const std::vector<std::string>& revisions);
+    std::optional<std::string> readBlob(const std::string& spec);
+    std::optional<std::vector<GitTreeEntry>> readTree(const std::string& treeish);
+
+    void setIdleTimeout(std::chrono::milliseconds timeout);
+    // Stop both co-processes now; the next request restarts them
+    void shutdown();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}
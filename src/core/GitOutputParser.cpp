@@ -0,0 +1,143 @@
+#include "GitOutputParser.h"
+#include "GitPatch.h"
+#include <charconv>
+
+namespace VersionTools {
+
+namespace {
+
+bool hasPrefix(std::string_view text, std::string_view prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Parses the unsigned decimal number at text[pos] and moves pos past it. from_chars alone
+// would also take a leading '-', and no count or line number git writes is negative.
+bool readNumber(std::string_view text, size_t& pos, int& value) {
+    if (pos >= text.size() || text[pos] < '0' || text[pos] > '9') {
+        return false;
+    }
+    const char* begin = text.data() + pos;
+    auto [end, error] = std::from_chars(begin, text.data() + text.size(), value);
+    if (error != std::errc() || end == begin) {
+        return false;
+    }
+    pos += static_cast<size_t>(end - begin);
+    return true;
+}
+
+bool readChar(std::string_view text, size_t& pos, char expected) {
+    if (pos >= text.size() || text[pos] != expected) {
+        return false;
+    }
+    ++pos;
+    return true;
+}
+
+// "<start>[,<count>]"
+bool readRange(std::string_view text, size_t& pos, int& start, int& count) {
+    if (!readNumber(text, pos, start)) {
+        return false;
+    }
+    count = 1;
+    return !readChar(text, pos, ',') || readNumber(text, pos, count);
+}
+
+// First "<keyword> <digits>" in the text
+bool findCount(std::string_view text, std::string_view keyword, int& value) {
+    for (size_t pos = text.find(keyword); pos != std::string_view::npos; pos = text.find(keyword, pos + 1)) {
+        size_t digits = pos + keyword.size();
+        if (readNumber(text, digits, value)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool GitOutputParser::parseHunkHeader(std::string_view line, GitHunkRange& range) {
+    if (!hasPrefix(line, "@@ -")) {
+        return false;
+    }
+    GitHunkRange parsed;
+    size_t pos = 4;
+    if (!readRange(line, pos, parsed.oldStart, parsed.oldCount) || !readChar(line, pos, ' ') ||
+        !readChar(line, pos, '+') || !readRange(line, pos, parsed.newStart, parsed.newCount) ||
+        line.compare(pos, 3, " @@") != 0) {
+        return false;
+    }
+    range = parsed;
+    return true;
+}
+
+void GitOutputParser::parseTrackingCounts(std::string_view track, int& ahead, int& behind) {
+    findCount(track, "ahead ", ahead);
+    findCount(track, "behind ", behind);
+}
+
+bool GitOutputParser::parseProgressLine(std::string_view line, GitProgressLine& progress) {
+    if (hasPrefix(line, "remote: ")) {
+        line.remove_prefix(8);
+    }
+    size_t colon = line.find(": ");
+    if (colon == 0 || colon == std::string_view::npos) {
+        return false;
+    }
+
+    GitProgressLine parsed;
+    parsed.operation = line.substr(0, colon);
+    if (parsed.operation == "fatal" || parsed.operation == "error" || parsed.operation == "warning" ||
+        parsed.operation == "hint") {
+        return false;
+    }
+
+    size_t pos = colon + 2;
+    while (pos < line.size() && line[pos] == ' ') {
+        ++pos;
+    }
+
+    int number = 0;
+    if (!readNumber(line, pos, number)) {
+        return false;
+    }
+    if (readChar(line, pos, '%')) {
+        // "NN% (current/total)"
+        size_t open = line.find('(', pos);
+        if (open == std::string_view::npos) {
+            return false;
+        }
+        pos = open + 1;
+        if (!readNumber(line, pos, parsed.current) || !readChar(line, pos, '/') ||
+            !readNumber(line, pos, parsed.total)) {
+            return false;
+        }
+    } else {
+        parsed.current = number;
+    }
+
+    parsed.done = line.find(", done.", pos) != std::string_view::npos;
+    progress = parsed;
+    return true;
+}
+
+std::string GitOutputParser::parseStashBranch(std::string_view subject) {
+    size_t start;
+    if (hasPrefix(subject, "On ")) {
+        start = 3;
+    } else if (hasPrefix(subject, "WIP on ")) {
+        start = 7;
+    } else {
+        return {};
+    }
+    size_t colon = subject.find(':', start);
+    if (colon == std::string_view::npos || colon == start) {
+        return {};
+    }
+    return std::string(subject.substr(start, colon - start));
+}
+
+std::vector<GitDiff> GitOutputParser::parseDiffs(std::string_view output) {
+    return GitPatch::parse(std::string(output)).toDiffs();
+}
+
+}
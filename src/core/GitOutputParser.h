@@ -0,0 +1,52 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VersionTools {
+
+struct GitHunkRange {
+    int oldStart = 0;
+    int oldCount = 1;
+    int newStart = 0;
+    int newCount = 1;
+};
+
+// One meter line of git's --progress output on stderr
+struct GitProgressLine {
+    std::string_view operation;  // "Receiving objects", "Resolving deltas", ...
+    int current = 0;
+    int total = 0;               // 0 when git only counts ("Enumerating objects: 1234")
+    bool done = false;           // The ", done." line that closes the meter
+};
+
+// Hand-written parsers for the small fixed formats in git's text output.
+// Everything works on string_views with std::from_chars, so no std::regex is
+// compiled or run on the hot paths (diff bodies can be hundreds of thousands
+// of lines).
+class GitOutputParser {
+public:
+    // "@@ -a[,b] +c[,d] @@ ..." - an omitted count means 1
+    static bool parseHunkHeader(std::string_view line, GitHunkRange& range);
+
+    // "[ahead N, behind M]" from %(upstream:track) or a v1 status header.
+    // Counts that are not mentioned are left untouched.
+    static void parseTrackingCounts(std::string_view track, int& ahead, int& behind);
+
+    // "[remote: ]<operation>: [NN% ](<current>/<total>)[, ...][, done.]" or
+    // "[remote: ]<operation>: <count>[, done.]". Lines are split on '\r' and '\n'
+    // by the caller; false for anything that is not a meter (fatal:, hints, ...).
+    static bool parseProgressLine(std::string_view line, GitProgressLine& progress);
+
+    // Branch named by a stash subject: "On <branch>: ..." or "WIP on <branch>: ...",
+    // empty for anything else
+    static std::string parseStashBranch(std::string_view subject);
+
+    // Unified `git diff` / `git show` output, one GitDiff per "diff --git" header.
+    // Shorthand for GitPatch::parse(...).toDiffs().
+    static std::vector<GitDiff> parseDiffs(std::string_view output);
+};
+
+}
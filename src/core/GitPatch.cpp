@@ -0,0 +1,540 @@
+#include "GitPatch.h"
+#include "GitOutputParser.h"
+#include "GitUtils.h"
+#include "Trace.h"
+#include <algorithm>
+#include <limits>
+
+namespace VersionTools {
+
+namespace {
+
+bool hasPrefix(std::string_view text, std::string_view prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+constexpr size_t NO_HUNK = std::numeric_limits<size_t>::max();
+
+} // namespace
+
+GitPatch GitPatch::parse(std::string text) {
+    TraceScope trace("parse", "diff");
+    trace.count("bytes", static_cast<int64_t>(text.size()));
+    GitPatch patch;
+    patch.buffer = std::move(text);
+
+    const size_t size = std::min<size_t>(patch.buffer.size(), std::numeric_limits<uint32_t>::max());
+    // Most of a patch is body lines; one per ~40 bytes avoids regrowth without a counting pass
+    patch.reserveLines(size / 40);
+
+    ParseState state;
+    size_t pos = 0;
+    while (pos < size) {
+        size_t end = patch.buffer.find('\n', pos);
+        if (end == std::string::npos || end > size) {
+            end = size;
+        }
+        size_t next = std::min(end + 1, size);
+        patch.consume(state, pos, end, next);
+        pos = next;
+    }
+
+    return patch;
+}
+
+void GitPatch::reserveLines(size_t count) {
+    lineOffsets.reserve(count);
+    lineLengths.reserve(count);
+    oldLineNumbers.reserve(count);
+    newLineNumbers.reserve(count);
+}
+
+bool GitPatch::consume(ParseState& state, size_t start, size_t end, size_t next) {
+    std::string_view line = std::string_view(buffer).substr(start, end - start);
+
+    // "\ No newline at end of file" annotates the previous line
+    if (!line.empty() && line[0] == '\\') {
+        if (state.hunk != NO_HUNK) {
+            if (!hunks[state.hunk].loaded) {
+                return false;
+            }
+            hunks[state.hunk].endOffset = static_cast<uint32_t>(next);
+        }
+        return true;
+    }
+
+    // Body lines are consumed by the hunk's counts, so a "--- x" deletion is never mistaken for a header
+    if (state.inBody()) {
+        auto& record = hunks[state.hunk];
+        char marker = line.empty() ? ' ' : line[0];
+        int32_t oldNumber = -1, newNumber = -1;
+        if (marker == '+') {
+            newNumber = state.newLineNum++;
+            --state.newRemaining;
+            ++record.added;
+        } else if (marker == '-') {
+            oldNumber = state.oldLineNum++;
+            --state.oldRemaining;
+            ++record.deleted;
+        } else {
+            oldNumber = state.oldLineNum++;
+            newNumber = state.newLineNum++;
+            --state.oldRemaining;
+            --state.newRemaining;
+        }
+        if (!record.loaded) {
+            return false;
+        }
+
+        size_t contentStart = line.empty() ? start : start + 1;
+        lineOffsets.push_back(static_cast<uint32_t>(contentStart));
+        lineLengths.push_back(static_cast<uint32_t>(end - contentStart));
+        oldLineNumbers.push_back(oldNumber);
+        newLineNumbers.push_back(newNumber);
+        ++record.lineCount;
+        record.endOffset = static_cast<uint32_t>(next);
+        return true;
+    }
+
+    if (hasPrefix(line, "diff --git ")) {
+        files.emplace_back();
+        state.file = files.size() - 1;
+        File* file = &files.back();
+        file->headerOffset = start;
+        file->firstHunk = hunks.size();
+        state.hunk = NO_HUNK;
+
+        // "a/<path> b/<path>" - only unambiguous when both sides match, renames are fixed up below
+        std::string_view names = line.substr(11);
+        size_t half = names.size() >= 5 ? (names.size() - 5) / 2 : 0;
+        if (half > 0 && hasPrefix(names, "a/") && names.compare(2 + half, 3, " b/") == 0) {
+            file->filePath = std::string(names.substr(2, half));
+        } else {
+            file->filePath = GitUtils::unquotePath(std::string(names));
+        }
+        return true;
+    }
+
+    if (state.file == std::string::npos) {
+        return true;
+    }
+    File* file = &files[state.file];
+
+    if (hasPrefix(line, "@@")) {
+        GitHunkRange range;
+        if (GitOutputParser::parseHunkHeader(line, range)) {
+            HunkRecord record;
+            record.headerOffset = static_cast<uint32_t>(start);
+            record.headerLength = static_cast<uint32_t>(line.size());
+            record.oldStart = range.oldStart;
+            record.oldCount = range.oldCount;
+            record.newStart = range.newStart;
+            record.newCount = range.newCount;
+            record.firstLine = static_cast<uint32_t>(lineOffsets.size());
+            record.lineCount = 0;
+            record.endOffset = static_cast<uint32_t>(next);
+            record.added = 0;
+            record.deleted = 0;
+            record.loaded = true;
+            hunks.push_back(record);
+            state.hunk = hunks.size() - 1;
+            ++file->hunkCount;
+            state.oldLineNum = range.oldStart;
+            state.newLineNum = range.newStart;
+            state.oldRemaining = range.oldCount;
+            state.newRemaining = range.newCount;
+        }
+    } else if (hasPrefix(line, "new file mode")) {
+        file->isNewFile = true;
+    } else if (hasPrefix(line, "deleted file mode")) {
+        file->isDeletedFile = true;
+    } else if (hasPrefix(line, "rename from ")) {
+        file->oldPath = GitUtils::unquotePath(std::string(line.substr(12)));
+    } else if (hasPrefix(line, "rename to ")) {
+        file->filePath = GitUtils::unquotePath(std::string(line.substr(10)));
+    } else if ((hasPrefix(line, "+++ ") || (hasPrefix(line, "--- ") && file->isDeletedFile)) &&
+               line.compare(4, 9, "/dev/null") != 0) {
+        // git terminates names containing spaces with a tab on these lines
+        std::string_view name = line.substr(4);
+        if (!name.empty() && name.back() == '\t') {
+            name.remove_suffix(1);
+        }
+        std::string path = GitUtils::unquotePath(std::string(name));
+        file->filePath = GitUtils::startsWith(path, "a/") || GitUtils::startsWith(path, "b/") ? path.substr(2) : path;
+    } else if (hasPrefix(line, "Binary files ")) {
+        file->isBinary = true;
+    }
+    return true;
+}
+
+GitPatch::Builder::Builder(const GitDiffBudget& budget, size_t firstHunk, size_t hunkCount)
+    : budget(budget),
+      windowStart(firstHunk),
+      windowEnd(hunkCount == std::string::npos ? std::string::npos : firstHunk + hunkCount),
+      forceFirst(firstHunk > 0 || hunkCount != std::string::npos) {
+}
+
+void GitPatch::Builder::feed(std::string_view chunk) {
+    size_t pos = 0;
+    while (pos < chunk.size()) {
+        size_t newline = chunk.find('\n', pos);
+        std::string_view piece = chunk.substr(pos, (newline == std::string_view::npos ? chunk.size() : newline) - pos);
+
+        // Only body lines are cut, so file and hunk headers always parse. The marker byte does not count
+        // towards the line length.
+        size_t limit = budget.maxLineLength > 0 && state.inBody() ? budget.maxLineLength + 1 : std::string::npos;
+        size_t room = pending.size() < limit ? limit - pending.size() : 0;
+        if (piece.size() > room) {
+            piece = piece.substr(0, room);
+            cut = true;
+        }
+
+        if (newline == std::string_view::npos) {
+            pending.append(piece);
+            return;
+        }
+        if (pending.empty()) {
+            addLine(piece, true);
+        } else {
+            pending.append(piece);
+            addLine(pending, true);
+            pending.clear();
+        }
+        cut = false;
+        pos = newline + 1;
+    }
+}
+
+GitPatch GitPatch::Builder::finish() {
+    if (!pending.empty()) {
+        addLine(pending, false);
+        pending.clear();
+    }
+    return std::move(patch);
+}
+
+void GitPatch::Builder::addLine(std::string_view line, bool complete) {
+    if (cut) {
+        // Never leave half a UTF-8 sequence at the end of a cut line
+        size_t lead = line.size();
+        while (lead > 1 && line.size() - lead < 3 && (static_cast<unsigned char>(line[lead - 1]) & 0xC0) == 0x80) {
+            --lead;
+        }
+        if (lead > 1) {
+            unsigned char byte = static_cast<unsigned char>(line[lead - 1]);
+            size_t sequence = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+            if (lead - 1 + sequence > line.size()) {
+                line = line.substr(0, lead - 1);
+            }
+        }
+    }
+
+    std::string& buffer = patch.buffer;
+    if (buffer.size() + line.size() + 1 > std::numeric_limits<uint32_t>::max()) {
+        return;
+    }
+
+    if (state.inBody() && patch.hunks[state.hunk].loaded && !admit(line.size() + 1)) {
+        unload();
+    }
+    const size_t start = buffer.size();
+
+    size_t hunks = patch.hunks.size();
+    buffer.append(line);
+    if (complete) {
+        buffer.push_back('\n');
+    }
+    if (!patch.consume(state, start, start + line.size(), buffer.size())) {
+        buffer.resize(start);
+        return;
+    }
+
+    if (patch.hunks.size() > hunks) {
+        size_t index = patch.hunks.size() - 1;
+        bool inWindow = index >= windowStart && index < windowEnd;
+        forced = forceFirst && index == windowStart;
+        if (!inWindow || (exhausted && !forced)) {
+            patch.hunks[index].loaded = false;
+            patch.files[state.file].isTruncated = true;
+        }
+    }
+    if (cut && state.file != std::string::npos) {
+        patch.files[state.file].hasLongLines = true;
+    }
+}
+
+bool GitPatch::Builder::admit(size_t bytes) {
+    keptBytes += bytes;
+    ++keptLines;
+    bool over = (budget.maxBytes > 0 && keptBytes > budget.maxBytes) ||
+                (budget.maxLines > 0 && keptLines > budget.maxLines);
+    if (over) {
+        exhausted = true;
+    }
+    return forced || !over;
+}
+
+void GitPatch::Builder::unload() {
+    // Hunks are kept whole: drop what was read of this one and count the rest without keeping it
+    auto& record = patch.hunks[state.hunk];
+    size_t bodyOffset = std::min<size_t>(record.headerOffset + record.headerLength + 1, patch.buffer.size());
+    keptBytes -= std::min<size_t>(keptBytes, patch.buffer.size() - bodyOffset);
+    keptLines -= std::min<size_t>(keptLines, record.lineCount);
+    patch.buffer.resize(bodyOffset);
+    patch.lineOffsets.resize(record.firstLine);
+    patch.lineLengths.resize(record.firstLine);
+    patch.oldLineNumbers.resize(record.firstLine);
+    patch.newLineNumbers.resize(record.firstLine);
+    record.lineCount = 0;
+    record.endOffset = static_cast<uint32_t>(bodyOffset);
+    record.loaded = false;
+    patch.files[state.file].isTruncated = true;
+}
+
+size_t GitPatch::findFile(const std::string& path) const {
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (files[i].filePath == path || files[i].oldPath == path) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+GitPatch::Hunk GitPatch::hunk(size_t index) const {
+    const auto& record = hunks[index];
+    return {std::string_view(buffer).substr(record.headerOffset, record.headerLength),
+            record.oldStart,
+            record.oldCount,
+            record.newStart,
+            record.newCount,
+            record.firstLine,
+            record.lineCount,
+            record.loaded,
+            record.added,
+            record.deleted};
+}
+
+GitPatch::Line GitPatch::line(size_t index) const {
+    return {lineType(index), lineContent(index), oldLineNumbers[index], newLineNumbers[index]};
+}
+
+GitDiffLine::Type GitPatch::lineType(size_t index) const {
+    // A line without a marker (empty context line) starts right after the previous newline
+    uint32_t offset = lineOffsets[index];
+    char marker = offset > 0 ? buffer[offset - 1] : '\n';
+    if (marker == '+') {
+        return GitDiffLine::Type::Addition;
+    }
+    if (marker == '-') {
+        return GitDiffLine::Type::Deletion;
+    }
+    return GitDiffLine::Type::Context;
+}
+
+std::string_view GitPatch::lineContent(size_t index) const {
+    return std::string_view(buffer).substr(lineOffsets[index], lineLengths[index]);
+}
+
+std::string_view GitPatch::hunkText(size_t fileIndex) const {
+    const auto& entry = files[fileIndex];
+    if (entry.hunkCount == 0) {
+        return {};
+    }
+    uint32_t begin = hunks[entry.firstHunk].headerOffset;
+    uint32_t end = hunks[entry.firstHunk + entry.hunkCount - 1].endOffset;
+    return std::string_view(buffer).substr(begin, end - begin);
+}
+
+std::string GitPatch::selectionPatch(size_t fileIndex, const std::vector<GitLineSelection>& selection,
+                                     bool reverse) const {
+    const auto& entry = files[fileIndex];
+    if (entry.isBinary || entry.hunkCount == 0) {
+        return {};
+    }
+
+    // Picked body lines per hunk of the file; an empty entry picks nothing
+    std::vector<std::vector<bool>> picked(entry.hunkCount);
+    for (const auto& range : selection) {
+        if (range.hunk >= entry.hunkCount) {
+            continue;
+        }
+        const auto& record = hunks[entry.firstHunk + range.hunk];
+        if (!record.loaded) {
+            return {};
+        }
+        auto& lines = picked[range.hunk];
+        lines.resize(record.lineCount, false);
+        if (range.lines.empty()) {
+            std::fill(lines.begin(), lines.end(), true);
+        }
+        for (size_t line : range.lines) {
+            if (line < lines.size()) {
+                lines[line] = true;
+            }
+        }
+    }
+
+    // An unpicked line that only exists on the side being produced goes, one of the other side stays as context
+    const char dropped = reverse ? '-' : '+';
+    std::string body;
+    bool changes = false;
+    bool everything = true;
+    long shift = 0;  // How far the recomputed side's start moves through the hunks left out before
+    for (size_t h = 0; h < entry.hunkCount; ++h) {
+        const auto& record = hunks[entry.firstHunk + h];
+        long originalDelta = reverse ? record.oldCount - record.newCount : record.newCount - record.oldCount;
+        if (picked[h].empty()) {
+            everything = everything && record.added + record.deleted == 0;
+            shift -= originalDelta;
+            continue;
+        }
+
+        std::string lines;
+        int oldCount = 0;
+        int newCount = 0;
+        bool hunkChanges = false;
+        bool keptLast = false;  // Whether "\ No newline at end of file" has a line to annotate
+        size_t index = 0;
+        size_t position = record.headerOffset + record.headerLength + 1;
+        while (position < record.endOffset) {
+            size_t end = buffer.find('\n', position);
+            if (end == std::string::npos || end > record.endOffset) {
+                end = record.endOffset;
+            }
+            std::string_view line = std::string_view(buffer).substr(position, end - position);
+            position = end + 1;
+
+            char marker = line.empty() ? ' ' : line[0];
+            if (marker == '\\') {
+                if (keptLast) {
+                    lines.append(line);
+                    lines.push_back('\n');
+                }
+                continue;
+            }
+            bool isChange = marker == '+' || marker == '-';
+            bool isPicked = index < picked[h].size() && picked[h][index];
+            ++index;
+            if (isChange && !isPicked) {
+                everything = false;
+                if (marker == dropped) {
+                    keptLast = false;
+                    continue;
+                }
+                marker = ' ';
+            }
+            lines.push_back(marker);
+            lines.append(line.empty() ? line : line.substr(1));
+            lines.push_back('\n');
+            keptLast = true;
+            oldCount += marker != '+';
+            newCount += marker != '-';
+            hunkChanges = hunkChanges || marker != ' ';
+        }
+
+        long delta = reverse ? oldCount - newCount : newCount - oldCount;
+        if (hunkChanges) {
+            long oldStart = reverse ? record.oldStart + shift : record.oldStart;
+            long newStart = reverse ? record.newStart : record.newStart + shift;
+            body += "@@ -" + std::to_string(oldStart) + "," + std::to_string(oldCount) + " +" +
+                    std::to_string(newStart) + "," + std::to_string(newCount) + " @@\n";
+            body += lines;
+            changes = true;
+        }
+        shift += delta - originalDelta;
+    }
+    if (!changes) {
+        return {};
+    }
+
+    // A creation taken back out, or a removal staged, only in part leaves the file in place:
+    // the header turns into that of a modification
+    std::string_view header =
+        std::string_view(buffer).substr(entry.headerOffset, hunks[entry.firstHunk].headerOffset - entry.headerOffset);
+    bool rewrite = !everything && (reverse ? entry.isNewFile : entry.isDeletedFile);
+    std::string patch;
+    size_t position = 0;
+    while (position < header.size()) {
+        size_t end = header.find('\n', position);
+        end = end == std::string_view::npos ? header.size() : end;
+        std::string_view line = header.substr(position, end - position);
+        position = end + 1;
+        if (rewrite && (hasPrefix(line, "new file mode") || hasPrefix(line, "deleted file mode"))) {
+            continue;
+        }
+        if (rewrite && (line == "--- /dev/null" || line == "+++ /dev/null")) {
+            const std::string& path = entry.filePath;
+            patch += line[0] == '-' ? "--- a/" + path : "+++ b/" + path;
+        } else {
+            patch.append(line);
+        }
+        patch.push_back('\n');
+    }
+    return patch + body;
+}
+
+void GitPatch::countLines(size_t fileIndex, size_t& added, size_t& deleted) const {
+    added = 0;
+    deleted = 0;
+    const auto& entry = files[fileIndex];
+    for (size_t h = entry.firstHunk; h < entry.firstHunk + entry.hunkCount; ++h) {
+        added += hunks[h].added;
+        deleted += hunks[h].deleted;
+    }
+}
+
+GitDiff GitPatch::toDiff(size_t fileIndex) const {
+    const auto& entry = files[fileIndex];
+    GitDiff diff;
+    diff.filePath = entry.filePath;
+    diff.oldPath = entry.oldPath;
+    diff.isBinary = entry.isBinary;
+    diff.isNewFile = entry.isNewFile;
+    diff.isDeletedFile = entry.isDeletedFile;
+    diff.isTruncated = entry.isTruncated;
+    diff.hasLongLines = entry.hasLongLines;
+    diff.hunks.reserve(entry.hunkCount);
+
+    for (size_t h = entry.firstHunk; h < entry.firstHunk + entry.hunkCount; ++h) {
+        Hunk view = hunk(h);
+        GitDiffHunk out;
+        out.header = std::string(view.header);
+        out.oldStart = view.oldStart;
+        out.oldCount = view.oldCount;
+        out.newStart = view.newStart;
+        out.newCount = view.newCount;
+        out.isLoaded = view.isLoaded;
+        out.lines.reserve(view.lineCount);
+        for (size_t i = view.firstLine; i < view.firstLine + view.lineCount; ++i) {
+            GitDiffLine diffLine;
+            diffLine.type = lineType(i);
+            diffLine.content = std::string(lineContent(i));
+            diffLine.oldLineNumber = oldLineNumbers[i];
+            diffLine.newLineNumber = newLineNumbers[i];
+            out.lines.push_back(std::move(diffLine));
+        }
+        diff.hunks.push_back(std::move(out));
+    }
+    return diff;
+}
+
+std::vector<GitDiff> GitPatch::toDiffs() const {
+    std::vector<GitDiff> diffs;
+    diffs.reserve(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        diffs.push_back(toDiff(i));
+    }
+    return diffs;
+}
+
+size_t GitPatch::memoryUsage() const {
+    size_t bytes = buffer.capacity() + files.capacity() * sizeof(File) + hunks.capacity() * sizeof(HunkRecord);
+    for (const auto& file : files) {
+        bytes += file.filePath.capacity() + file.oldPath.capacity();
+    }
+    bytes += lineOffsets.capacity() * sizeof(uint32_t) + lineLengths.capacity() * sizeof(uint32_t);
+    bytes += (oldLineNumbers.capacity() + newLineNumbers.capacity()) * sizeof(int32_t);
+    return bytes;
+}
+
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VersionTools {
+
+// Compact, read-only form of a multi-file unified diff.
+//
+// The patch text is kept in one buffer and hunks and lines are indexed as
+// offset/length records into it, stored as parallel arrays (16 bytes per
+// line; the line type is the marker byte in front of the content). Views
+// returned by the accessors point into text() and stay valid as long as the
+// GitPatch is alive, moves included. GitDiff values are only materialized by
+// toDiff()/toDiffs() for callers that still want the owning structs.
+//
+// Offsets are 32-bit, so patch text beyond 4 GiB is not indexed.
+//
+// A Builder reads the patch as it streams out of git and only keeps what
+// fits its GitDiffBudget. Every hunk is still indexed with its header and
+// ranges, but the body lines of hunks past the budget are dropped (they
+// still count towards countLines()); such hunks report !isLoaded and can be
+// fetched by index with a Builder limited to a window of hunks.
+class GitPatch {
+public:
+    struct File {
+        std::string filePath;
+        std::string oldPath;
+        bool isBinary = false;
+        bool isNewFile = false;
+        bool isDeletedFile = false;
+        bool isTruncated = false;   // At least one hunk was not loaded
+        bool hasLongLines = false;  // At least one line was cut at the budget's maxLineLength
+        size_t headerOffset = 0;    // Of its "diff --git" line in text()
+        size_t firstHunk = 0;
+        size_t hunkCount = 0;
+    };
+
+    struct Hunk {
+        std::string_view header;
+        int oldStart;
+        int oldCount;
+        int newStart;
+        int newCount;
+        size_t firstLine;
+        size_t lineCount;   // 0 when the hunk is not loaded
+        bool isLoaded;
+        size_t added;       // Counted for unloaded hunks too
+        size_t deleted;
+    };
+
+    struct Line {
+        GitDiffLine::Type type;
+        std::string_view content;
+        int oldLineNumber;
+        int newLineNumber;
+    };
+
+    class Builder;
+
+    GitPatch() = default;
+
+    // Takes ownership of `git diff` / `git diff-tree -p` output and indexes it
+    static GitPatch parse(std::string text);
+
+    const std::string& text() const { return buffer; }
+    bool empty() const { return files.empty(); }
+
+    size_t fileCount() const { return files.size(); }
+    const File& file(size_t index) const { return files[index]; }
+    // Index of the file whose new or old path matches, or npos
+    size_t findFile(const std::string& path) const;
+
+    size_t hunkCount() const { return hunks.size(); }
+    Hunk hunk(size_t index) const;
+
+    size_t lineCount() const { return lineOffsets.size(); }
+    Line line(size_t index) const;
+    GitDiffLine::Type lineType(size_t index) const;
+    std::string_view lineContent(size_t index) const;
+
+    // Patch text of a file's hunks, from the first "@@" header to the end of its last line.
+    // Only a patch as git wrote it when the file is not truncated.
+    std::string_view hunkText(size_t fileIndex) const;
+
+    // A patch of only the selected changes of a file, for `git apply --cached`:
+    // unselected additions are dropped and unselected deletions become
+    // context, and hunk ranges are recomputed. With reverse it is meant for
+    // `git apply --cached -R` (taking staged lines back out), so the roles of
+    // additions and deletions swap. Empty when nothing selected changes
+    // anything, the file is binary or a selected hunk is not loaded.
+    std::string selectionPatch(size_t fileIndex, const std::vector<GitLineSelection>& selection,
+                               bool reverse = false) const;
+
+    // Added and deleted line counts of one file without touching the content
+    void countLines(size_t fileIndex, size_t& added, size_t& deleted) const;
+
+    GitDiff toDiff(size_t fileIndex) const;
+    std::vector<GitDiff> toDiffs() const;
+
+    // Heap bytes held (text and index), for caches that are bounded by size
+    size_t memoryUsage() const;
+
+private:
+    struct HunkRecord {
+        uint32_t headerOffset;
+        uint32_t headerLength;
+        int32_t oldStart;
+        int32_t oldCount;
+        int32_t newStart;
+        int32_t newCount;
+        uint32_t firstLine;
+        uint32_t lineCount;
+        uint32_t endOffset;  // One past the last byte that belongs to the hunk
+        uint32_t added;
+        uint32_t deleted;
+        bool loaded;
+    };
+
+    // Where parsing is between two lines
+    struct ParseState {
+        size_t file = std::string::npos;
+        size_t hunk = std::string::npos;
+        int oldLineNum = 0;
+        int newLineNum = 0;
+        int oldRemaining = 0;
+        int newRemaining = 0;
+
+        bool inBody() const { return hunk != std::string::npos && (oldRemaining > 0 || newRemaining > 0); }
+    };
+
+    // Indexes the line buffer[start, end); next is just past its newline.
+    // Returns false for a body line of an unloaded hunk, which is not indexed.
+    bool consume(ParseState& state, size_t start, size_t end, size_t next);
+    void reserveLines(size_t count);
+
+    std::string buffer;
+    std::vector<File> files;
+    std::vector<HunkRecord> hunks;
+
+    // One entry per body line
+    std::vector<uint32_t> lineOffsets;  // Content start, just after the marker
+    std::vector<uint32_t> lineLengths;
+    std::vector<int32_t> oldLineNumbers;
+    std::vector<int32_t> newLineNumbers;
+};
+
+// Streaming, budgeted counterpart of GitPatch::parse. Chunks of patch text
+// are fed in the order git wrote them; hunks are kept whole or not at all.
+//
+//   GitPatch::Builder builder(budget);
+//   cmd.executeWithCallback("git", args, [&](const std::string& chunk) { builder.feed(chunk); });
+//   GitPatch patch = builder.finish();
+class GitPatch::Builder {
+public:
+    // Only hunks [firstHunk, firstHunk + hunkCount) of the patch are candidates
+    // for loading; the first of them is loaded whatever its size
+    explicit Builder(const GitDiffBudget& budget = {}, size_t firstHunk = 0, size_t hunkCount = std::string::npos);
+
+    void feed(std::string_view chunk);
+    GitPatch finish();
+
+private:
+    void addLine(std::string_view line, bool complete);
+    bool admit(size_t bytes);
+    void unload();
+
+    GitDiffBudget budget;
+    size_t windowStart;
+    size_t windowEnd;
+    bool forceFirst;
+
+    GitPatch patch;
+    ParseState state;
+    std::string pending;  // Start of a line the last chunk ended in
+    bool cut = false;     // The line being read is over maxLineLength; the rest of it is dropped
+    size_t keptBytes = 0;
+    size_t keptLines = 0;
+    bool exhausted = false;
+    bool forced = false;  // The current hunk is loaded regardless of the budget
+};
+
+}
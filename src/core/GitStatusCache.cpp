@@ -0,0 +1,263 @@
+#include "GitStatusCache.h"
+#include "FileWatcher.h"
+#include "GitUtils.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace VersionTools {
+
+namespace {
+
+// Past this many dirty paths one worktree scan is cheaper than a long pathspec list
+constexpr size_t MAX_PARTIAL_PATHS = 512;
+
+// Collapsed untracked directories are listed as "dir/"
+std::string withoutTrailingSlash(const std::string& path) {
+    return !path.empty() && path.back() == '/' ? path.substr(0, path.size() - 1) : path;
+}
+
+// True when path or one of its parent directories is in the set
+bool hasPrefixIn(const std::string& path, const std::set<std::string>& prefixes) {
+    if (prefixes.count(path)) {
+        return true;
+    }
+    for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        if (prefixes.count(path.substr(0, slash))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool sameChange(const GitFileChange& a, const GitFileChange& b) {
+    return a.status == b.status && a.oldPath == b.oldPath && a.linesAdded == b.linesAdded &&
+           a.linesDeleted == b.linesDeleted;
+}
+
+bool sameBranch(const GitStatus& a, const GitStatus& b) {
+    return a.currentBranch == b.currentBranch && a.upstreamBranch == b.upstreamBranch &&
+           a.aheadCount == b.aheadCount && a.behindCount == b.behindCount;
+}
+
+void diffChanges(const std::vector<GitFileChange>& before, const std::vector<GitFileChange>& after,
+                 GitStatusDelta& delta) {
+    // A path can be listed twice, e.g. a staged deletion and the untracked file left in its place
+    std::map<std::pair<std::string, bool>, const GitFileChange*> previous;
+    for (const auto& change : before) {
+        previous[{change.filePath, change.isStaged}] = &change;
+    }
+
+    for (const auto& change : after) {
+        auto it = previous.find({change.filePath, change.isStaged});
+        if (it == previous.end()) {
+            delta.added.push_back(change);
+            continue;
+        }
+        if (!sameChange(*it->second, change)) {
+            delta.changed.push_back(change);
+        }
+        previous.erase(it);
+    }
+
+    for (const auto& [key, change] : previous) {
+        delta.removed.push_back(*change);
+    }
+}
+
+} // namespace
+
+class GitStatusCache::Impl {
+public:
+    StatusQuery query;
+    std::mutex mutex;
+    FileWatcher watcher;
+
+    GitStatus snapshot;
+    bool valid = false;
+    bool needsFullScan = true;
+    std::set<std::string> dirtyPaths;
+
+    explicit Impl(StatusQuery statusQuery) : query(std::move(statusQuery)) {}
+
+    void onChanges(const std::vector<std::string>& paths, bool overflow) {
+        if (overflow) {
+            needsFullScan = true;
+        }
+        for (const auto& path : paths) {
+            if (path.compare(0, 5, ".git/") == 0) {
+                // HEAD, refs and info/exclude can change the status of any path, and so can the index:
+                // add -f, rm --cached or update-index stage paths the snapshot doesn't list yet
+                needsFullScan = true;
+            } else if (GitUtils::getFileName(path) == ".gitignore") {
+                needsFullScan = true;
+            } else {
+                dirtyPaths.insert(path);
+            }
+        }
+    }
+
+    // Pathspecs to re-query, or an empty list when nothing changed
+    std::vector<std::string> collectPathspecs() const {
+        // A pathspec inside a collapsed untracked directory reports nothing, so query the directory itself
+        std::set<std::string> collapsed;
+        for (const auto& change : snapshot.changes) {
+            if (!change.filePath.empty() && change.filePath.back() == '/') {
+                collapsed.insert(withoutTrailingSlash(change.filePath));
+            }
+        }
+
+        std::set<std::string> specs;
+        for (const auto& path : dirtyPaths) {
+            std::string spec = path;
+            for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+                if (collapsed.count(path.substr(0, slash))) {
+                    spec = path.substr(0, slash);
+                    break;
+                }
+            }
+            specs.insert(spec);
+        }
+        for (const auto& change : snapshot.changes) {
+            // Rename detection only pairs the two sides when both are in the pathspec
+            bool renamed = !change.oldPath.empty() && (specs.count(change.filePath) || specs.count(change.oldPath));
+            if (renamed) {
+                specs.insert(withoutTrailingSlash(change.filePath));
+                specs.insert(change.oldPath);
+            }
+        }
+
+        // A directory pathspec already covers everything below it
+        std::vector<std::string> result;
+        for (const auto& spec : specs) {
+            size_t slash = spec.rfind('/');
+            if (slash == std::string::npos || !hasPrefixIn(spec.substr(0, slash), specs)) {
+                result.push_back(spec);
+            }
+        }
+        return result;
+    }
+
+    GitStatusDelta fullScan() {
+        auto status = query({});
+        if (!status) {
+            return {};
+        }
+
+        GitStatusDelta delta;
+        diffChanges(snapshot.changes, status->changes, delta);
+        delta.branchChanged = !valid || !sameBranch(snapshot, *status);
+
+        snapshot = std::move(*status);
+        valid = true;
+        needsFullScan = false;
+        dirtyPaths.clear();
+        return delta;
+    }
+
+    GitStatusDelta partialScan(const std::vector<std::string>& pathspecs) {
+        auto status = query(pathspecs);
+        if (!status) {
+            return {};
+        }
+
+        // Every previous entry inside a queried pathspec is replaced by the fresh result
+        std::set<std::string> queried(pathspecs.begin(), pathspecs.end());
+        std::vector<GitFileChange> kept, replaced;
+        for (auto& change : snapshot.changes) {
+            bool covered = hasPrefixIn(withoutTrailingSlash(change.filePath), queried) ||
+                           (!change.oldPath.empty() && hasPrefixIn(change.oldPath, queried));
+            (covered ? replaced : kept).push_back(std::move(change));
+        }
+
+        GitStatusDelta delta;
+        diffChanges(replaced, status->changes, delta);
+        delta.branchChanged = !sameBranch(snapshot, *status);
+
+        for (auto& change : status->changes) {
+            kept.push_back(std::move(change));
+        }
+        // Same order as a full scan: tracked changes first, then untracked, each by path
+        std::stable_sort(kept.begin(), kept.end(), [](const GitFileChange& a, const GitFileChange& b) {
+            bool aUntracked = a.status == FileStatus::Untracked;
+            bool bUntracked = b.status == FileStatus::Untracked;
+            return aUntracked != bUntracked ? bUntracked : a.filePath < b.filePath;
+        });
+
+        snapshot.currentBranch = status->currentBranch;
+        snapshot.upstreamBranch = status->upstreamBranch;
+        snapshot.aheadCount = status->aheadCount;
+        snapshot.behindCount = status->behindCount;
+        snapshot.changes = std::move(kept);
+        GitUtils::summarizeStatus(snapshot);
+
+        dirtyPaths.clear();
+        return delta;
+    }
+
+    // Caller holds the mutex
+    GitStatusDelta refresh() {
+        if (watcher.isActive()) {
+            watcher.poll([this](const std::vector<std::string>& paths, bool overflow) { onChanges(paths, overflow); });
+        }
+
+        if (!valid || needsFullScan || !watcher.isActive()) {
+            return fullScan();
+        }
+
+        auto pathspecs = collectPathspecs();
+        if (pathspecs.empty()) {
+            return {};
+        }
+        if (pathspecs.size() > MAX_PARTIAL_PATHS) {
+            return fullScan();
+        }
+        return partialScan(pathspecs);
+    }
+};
+
+GitStatusCache::GitStatusCache(StatusQuery query) : pImpl(std::make_unique<Impl>(std::move(query))) {}
+
+GitStatusCache::~GitStatusCache() = default;
+
+bool GitStatusCache::startWatching(const std::string& workingDirectory) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->needsFullScan = true;
+    return pImpl->watcher.start(workingDirectory);
+}
+
+void GitStatusCache::stopWatching() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->watcher.stop();
+}
+
+bool GitStatusCache::isWatching() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    return pImpl->watcher.isActive();
+}
+
+GitStatus GitStatusCache::getStatus() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->refresh();
+    return pImpl->snapshot;
+}
+
+GitStatusDelta GitStatusCache::refresh() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    return pImpl->refresh();
+}
+
+void GitStatusCache::invalidate() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->needsFullScan = true;
+}
+
+GitStatusDelta GitStatusCache::diff(const GitStatus& before, const GitStatus& after) {
+    GitStatusDelta delta;
+    diffChanges(before.changes, after.changes, delta);
+    delta.branchChanged = !sameBranch(before, after);
+    return delta;
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace VersionTools {
+
+// Runs `git status` limited to the given pathspecs (all paths when empty);
+// std::nullopt when git failed
+using StatusQuery = std::function<std::optional<GitStatus>(const std::vector<std::string>& paths)>;
+
+// Holds the last GitStatus of a worktree and keeps it current from filesystem
+// change notifications. A refresh re-queries only the paths that changed since
+// the previous one and reports the difference as a GitStatusDelta; a full scan
+// happens only on the first refresh, when the OS dropped events, or when HEAD,
+// the index, the refs or ignore rules changed. Without a watcher every refresh is a full
+// scan, so the cache is always safe to use.
+class GitStatusCache {
+public:
+    explicit GitStatusCache(StatusQuery query);
+    ~GitStatusCache();
+
+    GitStatusCache(const GitStatusCache&) = delete;
+    GitStatusCache& operator=(const GitStatusCache&) = delete;
+
+    // workingDirectory must be the worktree root; status paths are relative to it
+    bool startWatching(const std::string& workingDirectory);
+    void stopWatching();
+    bool isWatching() const;
+
+    // Refreshes, then returns the current snapshot
+    GitStatus getStatus();
+    // Brings the snapshot up to date and returns what changed since the previous refresh
+    GitStatusDelta refresh();
+    // Forces the next refresh to rescan the whole worktree
+    void invalidate();
+
+    // What turns before into after, entries matched by (filePath, isStaged); for consumers
+    // that keep their own snapshot and must see every change since it
+    static GitStatusDelta diff(const GitStatus& before, const GitStatus& after);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}
@@ -0,0 +1,205 @@
+#include "GitStatusParser.h"
+#include "GitUtils.h"
+#include "Trace.h"
+#include <algorithm>
+#include <charconv>
+#include <unordered_map>
+
+namespace VersionTools {
+
+namespace {
+
+// Fixed field counts before the path: "1 XY sub mH mI mW hH hI <path>", etc.
+constexpr int ORDINARY_FIELDS = 8;
+constexpr int RENAME_FIELDS = 9;
+constexpr int UNMERGED_FIELDS = 10;
+
+// Splits NUL-terminated records off the front of the output
+class RecordReader {
+public:
+    explicit RecordReader(std::string_view data) : data(data) {}
+
+    bool next(std::string_view& record) {
+        if (pos >= data.size()) {
+            return false;
+        }
+        size_t end = data.find('\0', pos);
+        if (end == std::string_view::npos) {
+            end = data.size();
+        }
+        record = data.substr(pos, end - pos);
+        pos = end + 1;
+        return true;
+    }
+
+private:
+    std::string_view data;
+    size_t pos = 0;
+};
+
+// The path is whatever follows the fixed fields, spaces included
+std::string_view pathAfterFields(std::string_view record, int fields) {
+    size_t pos = 0;
+    for (int i = 0; i < fields; ++i) {
+        pos = record.find(' ', pos);
+        if (pos == std::string_view::npos) {
+            return {};
+        }
+        ++pos;
+    }
+    return record.substr(pos);
+}
+
+int parseCount(std::string_view text) {
+    int value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+void parseHeader(std::string_view header, GitStatus& status) {
+    size_t space = header.find(' ');
+    if (space == std::string_view::npos) {
+        return;
+    }
+    std::string_view key = header.substr(0, space);
+    std::string_view value = header.substr(space + 1);
+
+    if (key == "branch.head") {
+        // Same spelling as the libgit2 backend uses for a detached HEAD
+        status.currentBranch = value == "(detached)" ? "HEAD (no branch)" : std::string(value);
+    } else if (key == "branch.upstream") {
+        status.upstreamBranch = std::string(value);
+    } else if (key == "branch.ab") {
+        // "+<ahead> -<behind>"
+        size_t split = value.find(' ');
+        if (split != std::string_view::npos && split > 1 && value.size() > split + 2) {
+            status.aheadCount = parseCount(value.substr(1, split - 1));
+            status.behindCount = parseCount(value.substr(split + 2));
+        }
+    }
+}
+
+struct LineStats {
+    size_t added = 0;
+    size_t deleted = 0;
+};
+
+// "<added>\t<deleted>\t<path>\0", or "<added>\t<deleted>\t\0<old>\0<new>\0" for a rename;
+// keys are views into the output, which outlives the map
+std::unordered_map<std::string_view, LineStats> parseNumstat(std::string_view output) {
+    std::unordered_map<std::string_view, LineStats> stats;
+    stats.reserve(static_cast<size_t>(std::count(output.begin(), output.end(), '\0')));
+
+    RecordReader reader(output);
+    std::string_view record;
+    while (reader.next(record)) {
+        size_t first = record.find('\t');
+        size_t second = first == std::string_view::npos ? first : record.find('\t', first + 1);
+        if (second == std::string_view::npos) {
+            continue;
+        }
+
+        std::string_view path = record.substr(second + 1);
+        if (path.empty()) {
+            std::string_view origin;
+            if (!reader.next(origin) || !reader.next(path)) {
+                break;
+            }
+        }
+        LineStats& entry = stats[path];
+        entry.added = static_cast<size_t>(parseCount(record.substr(0, first)));
+        entry.deleted = static_cast<size_t>(parseCount(record.substr(first + 1, second - first - 1)));
+    }
+    return stats;
+}
+
+// v2 writes '.' for an unmodified side where v1 wrote a space
+char statusCode(char code) {
+    return code == '.' ? ' ' : code;
+}
+
+} // namespace
+
+GitStatus GitStatusParser::parse(std::string_view output) {
+    TraceScope trace("parse", "status");
+    trace.count("bytes", static_cast<int64_t>(output.size()));
+    GitStatus status;
+    status.changes.reserve(static_cast<size_t>(std::count(output.begin(), output.end(), '\0')));
+
+    RecordReader reader(output);
+    std::string_view record;
+    while (reader.next(record)) {
+        if (record.size() < 3) {
+            continue;
+        }
+
+        char kind = record[0];
+        if (kind == '#') {
+            parseHeader(record.substr(2), status);
+            continue;
+        }
+
+        GitFileChange change;
+        std::string_view path;
+        switch (kind) {
+            case '1':
+                path = pathAfterFields(record, ORDINARY_FIELDS);
+                break;
+            case '2': {
+                path = pathAfterFields(record, RENAME_FIELDS);
+                // The rename source is the next record
+                std::string_view origin;
+                if (reader.next(origin)) {
+                    change.oldPath = std::string(origin);
+                }
+                break;
+            }
+            case 'u':
+                path = pathAfterFields(record, UNMERGED_FIELDS);
+                break;
+            case '?':
+            case '!':
+                path = record.substr(2);
+                break;
+            default:
+                continue;
+        }
+        if (path.empty()) {
+            continue;
+        }
+
+        change.filePath = std::string(path);
+        if (kind == '?' || kind == '!') {
+            GitUtils::applyStatusCodes(kind, kind, change);
+        } else if (kind == 'u') {
+            // Whatever the XY pair ("AA", "DU", ...): read as index codes they would look staged
+            change.status = FileStatus::Conflicted;
+            change.isStaged = false;
+        } else if (record.size() > 3) {
+            GitUtils::applyStatusCodes(statusCode(record[2]), statusCode(record[3]), change);
+        }
+        status.changes.push_back(std::move(change));
+    }
+
+    GitUtils::summarizeStatus(status);
+    return status;
+}
+
+void GitStatusParser::mergeLineStats(GitStatus& status, std::string_view indexNumstat,
+                                     std::string_view worktreeNumstat) {
+    TraceScope trace("parse", "numstat");
+    trace.count("bytes", static_cast<int64_t>(indexNumstat.size() + worktreeNumstat.size()));
+    auto staged = parseNumstat(indexNumstat);
+    auto unstaged = parseNumstat(worktreeNumstat);
+
+    for (auto& change : status.changes) {
+        const auto& stats = change.isStaged ? staged : unstaged;
+        auto it = stats.find(change.filePath);
+        if (it != stats.end()) {
+            change.linesAdded = it->second.added;
+            change.linesDeleted = it->second.deleted;
+        }
+    }
+}
+
+}
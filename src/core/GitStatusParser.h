@@ -0,0 +1,24 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <string_view>
+
+namespace VersionTools {
+
+// Parser for `git status --porcelain=v2 -z --branch`.
+// Works in one pass over string_views into the command output; the only
+// strings it allocates are the final filePath/oldPath of each change and
+// the branch names. NUL termination keeps paths with spaces, quotes or
+// newlines unambiguous, so no unquoting is needed.
+class GitStatusParser {
+public:
+    static GitStatus parse(std::string_view output);
+
+    // Fills linesAdded/linesDeleted from `git diff --cached --numstat -z` and
+    // `git diff --numstat -z`, matched by path through one hash map per side:
+    // staged changes take the index counts, the others the worktree counts.
+    // Binary files ("-") and untracked files keep 0.
+    static void mergeLineStats(GitStatus& status, std::string_view indexNumstat, std::string_view worktreeNumstat);
+};
+
+}
@@ -5,6 +5,7 @@
 #include <memory>
 #include <chrono>
 #include <optional>
+#include <functional>
 
 namespace VersionTools {
 
@@ -35,6 +36,16 @@ struct GitCommit {
     std::chrono::system_clock::time_point timestamp;
     std::vector<std::string> parentHashes;
     bool isMerge() const { return parentHashes.size() > 1; }
+    // Heap and inline bytes, for caches that are bounded by size
+    size_t memoryUsage() const {
+        size_t bytes = sizeof(GitCommit) + hash.capacity() + shortHash.capacity() + author.capacity() +
+                       email.capacity() + message.capacity() + shortMessage.capacity() +
+                       parentHashes.capacity() * sizeof(std::string);
+        for (const auto& parent : parentHashes) {
+            bytes += parent.capacity();
+        }
+        return bytes;
+    }
 };
 
 struct GitBranch {
@@ -78,6 +89,14 @@ struct GitDiffHunk {
     int oldCount;
     int newStart;
     int newCount;
+    bool isLoaded = true;  // False when the diff was over its budget: lines is empty, fetch it by index
+};
+
+// Lines of one hunk picked for partial staging: hunk indexes GitDiff::hunks,
+// lines index its GitDiffHunk::lines
+struct GitLineSelection {
+    size_t hunk = 0;
+    std::vector<size_t> lines;  // Empty for the whole hunk
 };
 
 struct GitDiff {
@@ -86,9 +105,29 @@ struct GitDiff {
     bool isBinary = false;
     bool isNewFile = false;
     bool isDeletedFile = false;
+    bool isTruncated = false;   // Some hunks are not loaded
+    bool hasLongLines = false;  // Some lines were cut at GitDiffBudget::maxLineLength
     std::vector<GitDiffHunk> hunks;
 };
 
+// How much of a diff is read into memory. Past the budget the rest of the
+// patch is still read through, but hunks only keep their header and ranges
+// and come back unloaded; 0 disables a limit.
+struct GitDiffBudget {
+    size_t maxBytes = 4 * 1024 * 1024;  // Body text kept across the whole patch
+    size_t maxLines = 50000;
+    size_t maxLineLength = 16 * 1024;   // Longer lines (minified files) are cut
+
+    static GitDiffBudget unlimited() { return {0, 0, 0}; }
+};
+
+struct GitTreeEntry {
+    std::string mode;  // Octal file mode as stored in the tree, e.g. "100644"
+    std::string type;  // "blob", "tree" or "commit" (submodule)
+    std::string hash;
+    std::string name;
+};
+
 struct GitStatus {
     std::string currentBranch;
     std::string upstreamBranch;
@@ -100,6 +139,17 @@ struct GitStatus {
     std::vector<GitFileChange> changes;
 };
 
+// Difference between two status snapshots, keyed by (filePath, isStaged): a
+// path can have a staged and an unstaged entry at once, and one that gets
+// staged or unstaged is removed from one side and added to the other
+struct GitStatusDelta {
+    std::vector<GitFileChange> added;    // Entries that were not listed before
+    std::vector<GitFileChange> removed;  // Entries that are no longer listed (previous entry)
+    std::vector<GitFileChange> changed;  // Entries whose status, rename source or line counts changed
+    bool branchChanged = false;          // Branch, upstream or ahead/behind counts changed
+    bool isEmpty() const { return added.empty() && removed.empty() && changed.empty() && !branchChanged; }
+};
+
 struct GitRepository {
     std::string path;
     std::string workingDirectory;
@@ -107,6 +157,7 @@ struct GitRepository {
     bool isBare = false;
     bool isShallow = false;
     std::string head;
+    std::string headCommit;  // Empty for an unborn branch
     GitStatus status;
 };
 
@@ -143,4 +194,75 @@ inline GitLogOptions operator&(GitLogOptions a, GitLogOptions b) {
     return static_cast<GitLogOptions>(static_cast<int>(a) & static_cast<int>(b));
 }
 
+// Partial clone filter (--filter); objects left out are fetched on demand
+enum class GitObjectFilter {
+    None,
+    BlobNone,  // blob:none - full history, file contents only when checked out
+    TreeNone   // tree:0 - commits only, trees and blobs on demand
+};
+
+struct GitCloneOptions {
+    GitObjectFilter filter = GitObjectFilter::None;
+    int depth = 0;              // > 0 for a shallow clone of that many commits
+    bool singleBranch = false;  // Only fetch `branch` (or the remote HEAD)
+    std::string branch;         // Branch to check out; the remote HEAD when empty
+    std::vector<std::string> sparsePaths;  // Cone-mode directories to check out, all files when empty
+};
+
+struct GitFetchOptions {
+    GitObjectFilter filter = GitObjectFilter::None;
+    int depth = 0;  // > 0 to fetch (or deepen a shallow clone to) that many commits
+    bool prune = false;
+};
+
+// A commit lines of a blame are attributed to
+struct GitBlameCommit {
+    std::string hash;  // All zeros for lines not committed yet
+    std::string author;
+    std::string authorEmail;
+    std::chrono::system_clock::time_point authorTime;
+    std::string summary;
+    std::string previousHash;  // Commit the lines' previous version is in, empty at a boundary
+    bool isBoundary = false;   // The lines are older than the blamed history (root or shallow)
+};
+
+// A run of consecutive lines last changed by the same commit
+struct GitBlameHunk {
+    size_t commit = 0;         // Index into GitBlame::commits
+    std::string originalPath;  // The file's path in that commit
+    int originalLine = 0;      // 1-based, in the commit's version of the file
+    int finalLine = 0;         // 1-based, in the blamed version
+    int lineCount = 0;
+};
+
+struct GitBlame {
+    std::string filePath;
+    std::string commitHash;  // Blamed revision; empty for the working tree
+    std::string blobId;      // Blob blamed; empty for the working tree
+    std::vector<GitBlameCommit> commits;
+    std::vector<GitBlameHunk> hunks;  // In finalLine order, one line range after another
+
+    int lineCount() const { return hunks.empty() ? 0 : hunks.back().finalLine + hunks.back().lineCount - 1; }
+};
+
+// One page of commit search hits, newest first. Subjects and authors of the
+// whole history are searchable at once, bodies and touched paths of
+// indexedCommits of them (newest first) until the index has caught up.
+struct GitCommitSearchResult {
+    std::vector<GitCommit> commits;
+    bool hasMore = false;
+    size_t indexedCommits = 0;
+    size_t totalCommits = 0;
+
+    bool isComplete() const { return indexedCommits == totalCommits; }
+};
+
+// Receives blame hunks as git attributes them, which is not line order.
+// Return false to stop.
+using BlameVisitor = std::function<bool(const GitBlameHunk& hunk, const GitBlameCommit& commit)>;
+
+// Receives commits one at a time while the history is still being read.
+// Return false to stop the walk early.
+using CommitVisitor = std::function<bool(const GitCommit& commit)>;
+
 }
\ No newline at end of file
@@ -120,6 +120,38 @@ std::string GitUtils::makeRelativePath(const std::string& from, const std::strin
     }
 }
 
+std::string GitUtils::unquotePath(const std::string& path) {
+    // git C-quotes paths containing special characters: "dir/caf\303\251 \"x\".txt"
+    if (path.size() < 2 || path.front() != '"' || path.back() != '"') {
+        return path;
+    }
+
+    std::string result;
+    result.reserve(path.size());
+    for (size_t i = 1; i + 1 < path.size(); ++i) {
+        char c = path[i];
+        if (c != '\\' || i + 2 >= path.size()) {
+            result += c;
+            continue;
+        }
+
+        char next = path[++i];
+        if (next >= '0' && next <= '7' && i + 2 < path.size() - 1) {
+            // Octal escape for bytes outside printable ASCII
+            int value = (next - '0') * 64 + (path[i + 1] - '0') * 8 + (path[i + 2] - '0');
+            result += static_cast<char>(value);
+            i += 2;
+            continue;
+        }
+
+        static const std::string escapes = "ntrabfv";
+        static const std::string replacements = "\n\t\r\a\b\f\v";
+        size_t escape = escapes.find(next);
+        result += escape == std::string::npos ? next : replacements[escape];
+    }
+    return result;
+}
+
 // Git-specific utilities
 std::string GitUtils::shortenHash(const std::string& hash, int length) {
     if (hash.length() <= static_cast<size_t>(length)) {
@@ -398,7 +430,21 @@ bool GitUtils::isValidCommitMessage(const std::string& message) {
 
 bool GitUtils::isBinaryFile(const std::string& filePath) {
     std::string ext = toLower(getFileExtension(filePath));
-    return std::find(BINARY_EXTENSIONS.begin(), BINARY_EXTENSIONS.end(), ext) != BINARY_EXTENSIONS.end();
+    if (std::find(BINARY_EXTENSIONS.begin(), BINARY_EXTENSIONS.end(), ext) != BINARY_EXTENSIONS.end()) {
+        return true;
+    }
+
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    char buffer[BINARY_SNIFF_BYTES];
+    file.read(buffer, sizeof(buffer));
+    return isBinaryContent(std::string_view(buffer, static_cast<size_t>(file.gcount())));
+}
+
+bool GitUtils::isBinaryContent(std::string_view content) {
+    return content.substr(0, BINARY_SNIFF_BYTES).find('\0') != std::string_view::npos;
 }
 
 std::string GitUtils::detectFileEncoding(const std::string& filePath) {
@@ -495,6 +541,59 @@ std::string GitUtils::extractHunkHeader(const std::string& line) {
     return line;
 }
 
+// Status utilities
+void GitUtils::applyStatusCodes(char indexStatus, char worktreeStatus, GitFileChange& change) {
+    change.isStaged = false;
+
+    if (indexStatus == '?' && worktreeStatus == '?') {
+        change.status = FileStatus::Untracked;
+    } else if (indexStatus == '!' && worktreeStatus == '!') {
+        change.status = FileStatus::Ignored;
+    } else if (indexStatus == 'A') {
+        change.status = FileStatus::Added;
+        change.isStaged = true;
+    } else if (indexStatus == 'M') {
+        change.status = FileStatus::Modified;
+        change.isStaged = true;
+    } else if (indexStatus == 'D') {
+        change.status = FileStatus::Deleted;
+        change.isStaged = true;
+    } else if (indexStatus == 'R') {
+        change.status = FileStatus::Renamed;
+        change.isStaged = true;
+    } else if (indexStatus == 'C') {
+        change.status = FileStatus::Copied;
+        change.isStaged = true;
+    } else if (worktreeStatus == 'M') {
+        change.status = FileStatus::Modified;
+    } else if (worktreeStatus == 'D') {
+        change.status = FileStatus::Deleted;
+    } else if (worktreeStatus == 'U' || indexStatus == 'U') {
+        change.status = FileStatus::Conflicted;
+    } else if (worktreeStatus == 'A') {
+        // Added but not staged (shouldn't happen in normal workflow)
+        change.status = FileStatus::Added;
+    }
+}
+
+void GitUtils::summarizeStatus(GitStatus& status) {
+    status.hasUncommittedChanges = false;
+    status.hasStagedChanges = false;
+    status.hasUnstagedChanges = false;
+
+    for (const auto& change : status.changes) {
+        // Any change (including untracked files) means we have uncommitted changes
+        if (change.status != FileStatus::Ignored) {
+            status.hasUncommittedChanges = true;
+        }
+        if (change.isStaged) {
+            status.hasStagedChanges = true;
+        } else if (change.status != FileStatus::Untracked) {
+            status.hasUnstagedChanges = true;
+        }
+    }
+}
+
 // Progress and status utilities
 std::string GitUtils::formatProgress(int current, int total, const std::string& operation) {
     if (total <= 0) {
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "GitTypes.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
 #include <algorithm>
@@ -30,6 +32,7 @@ public:
     static std::string joinPaths(const std::string& path1, const std::string& path2);
     static bool isAbsolutePath(const std::string& path);
     static std::string makeRelativePath(const std::string& from, const std::string& to);
+    static std::string unquotePath(const std::string& path);
     
     // Git-specific utilities
     static std::string shortenHash(const std::string& hash, int length = 7);
@@ -59,6 +62,12 @@ public:
     static int countLinesAdded(const std::string& diff);
     static int countLinesRemoved(const std::string& diff);
     static std::string extractHunkHeader(const std::string& line);
+
+    // Status utilities
+    // Maps a porcelain XY status pair (index, worktree) onto change.status / change.isStaged
+    static void applyStatusCodes(char indexStatus, char worktreeStatus, GitFileChange& change);
+    // Recomputes the has*Changes flags of a status from its change list
+    static void summarizeStatus(GitStatus& status);
     
     // Configuration utilities
     static std::string getGitConfigPath(bool global = false);
@@ -68,7 +77,10 @@ public:
     // Validation utilities
     static bool isValidEmail(const std::string& email);
     static bool isValidCommitMessage(const std::string& message);
+    // Known binary extension, or binary content on disk (see isBinaryContent)
     static bool isBinaryFile(const std::string& filePath);
+    // git's own heuristic: a NUL byte within the first 8000 bytes
+    static bool isBinaryContent(std::string_view content);
     static std::string detectFileEncoding(const std::string& filePath);
     
     // Progress and status utilities
@@ -80,6 +92,7 @@ private:
     static const std::string WHITESPACE_CHARS;
     static const std::vector<std::string> INVALID_BRANCH_CHARS;
     static const std::vector<std::string> BINARY_EXTENSIONS;
+    static constexpr size_t BINARY_SNIFF_BYTES = 8000;  // FIRST_FEW_BYTES in git's xdiff-interface.c
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "GraphLayout.h"
+#include <algorithm>
+
+namespace VersionTools {
+
+uint16_t GraphLayout::takeFreeLane() {
+    for (size_t lane = 0; lane < laneCommits.size(); ++lane) {
+        if (laneCommits[lane].empty()) {
+            return static_cast<uint16_t>(lane);
+        }
+    }
+    laneCommits.emplace_back();
+    laneColors.push_back(0);
+    return static_cast<uint16_t>(laneCommits.size() - 1);
+}
+
+void GraphLayout::append(const GitCommit& commit) {
+    GraphRow row;
+    row.firstEdge = static_cast<uint32_t>(edges.size());
+
+    auto waiting = waitingLane.find(commit.hash);
+    bool continued = waiting != waitingLane.end();
+    uint16_t lane = continued ? waiting->second : 0;
+
+    // Every other lane open above passes through; new lanes below only ever take free ones
+    for (size_t other = 0; other < laneCommits.size(); ++other) {
+        if (!laneCommits[other].empty() && !(continued && other == lane)) {
+            auto passing = static_cast<uint16_t>(other);
+            edges.push_back({passing, passing, laneColors[other], GraphEdgeType::Through});
+        }
+    }
+
+    if (continued) {
+        waitingLane.erase(waiting);
+        edges.push_back({lane, lane, laneColors[lane], GraphEdgeType::Incoming});
+    } else {
+        // A branch tip: nothing above points here
+        lane = takeFreeLane();
+        laneColors[lane] = nextColor++;
+    }
+    row.lane = lane;
+    row.color = laneColors[lane];
+    laneCommits[lane].clear();
+
+    for (size_t i = 0; i < commit.parentHashes.size(); ++i) {
+        const std::string& parent = commit.parentHashes[i];
+        auto existing = waitingLane.find(parent);
+        if (existing != waitingLane.end()) {
+            // Another child already waits for this parent: join its lane
+            uint16_t target = existing->second;
+            edges.push_back({lane, target, laneColors[target], GraphEdgeType::Outgoing});
+            continue;
+        }
+
+        uint16_t target;
+        if (i == 0) {
+            target = lane;
+        } else {
+            target = takeFreeLane();
+            laneColors[target] = nextColor++;
+        }
+        laneCommits[target] = parent;
+        waitingLane.emplace(parent, target);
+        edges.push_back({lane, target, laneColors[target], GraphEdgeType::Outgoing});
+    }
+
+    while (!laneCommits.empty() && laneCommits.back().empty()) {
+        laneCommits.pop_back();
+        laneColors.pop_back();
+    }
+
+    row.edgeCount = static_cast<uint32_t>(edges.size()) - row.firstEdge;
+    uint16_t width = static_cast<uint16_t>(lane + 1);
+    for (uint32_t i = row.firstEdge; i < edges.size(); ++i) {
+        width = std::max<uint16_t>(width, std::max(edges[i].from, edges[i].to) + 1);
+    }
+    row.width = width;
+    widest = std::max(widest, row.width);
+    rows.push_back(row);
+}
+
+void GraphLayout::append(const std::vector<GitCommit>& commits) {
+    rows.reserve(rows.size() + commits.size());
+    for (const auto& commit : commits) {
+        append(commit);
+    }
+}
+
+void GraphLayout::clear() {
+    rows.clear();
+    edges.clear();
+    widest = 0;
+    laneCommits.clear();
+    laneColors.clear();
+    waitingLane.clear();
+    nextColor = 0;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace VersionTools {
+
+enum class GraphEdgeType : uint8_t {
+    Incoming,  // Top of the row at `from` down to the commit dot at `to`
+    Outgoing,  // Commit dot at `from` down to the bottom of the row at `to`
+    Through    // Top of the row at `from` to the bottom at `to`, passing the dot
+};
+
+struct GraphEdge {
+    uint16_t from = 0;
+    uint16_t to = 0;
+    uint16_t color = 0;  // Stable per line of history; renderers take it modulo their palette
+    GraphEdgeType type = GraphEdgeType::Through;
+};
+
+// One history row: the commit dot and the edges crossing the row
+struct GraphRow {
+    uint16_t lane = 0;   // Column of the commit dot
+    uint16_t color = 0;
+    uint16_t width = 0;  // Columns touched by this row, for sizing the graph column
+    uint32_t firstEdge = 0;
+    uint32_t edgeCount = 0;
+};
+
+// Lane layout for a commit graph, built in a single streaming pass. Feed it
+// commits in topological order (children before parents, as HistoryCursor
+// returns them) one page at a time; rows already laid out never change, so
+// a view only has to lay out and draw the page it just loaded.
+//
+// Each commit takes over the lane that was waiting for it (or the first free
+// lane when nothing was), its first parent continues in the same lane and
+// colour, and further parents get a free lane of their own unless a lane is
+// already waiting for them. Lanes are reused as soon as they free up, so the
+// graph stays as narrow as the open branches allow.
+//
+// Parents that never arrive (a shallow clone, or a history with merges
+// hidden) keep their lane open to the bottom, so lay out histories opened
+// with GitLogOptions::ShowMerges.
+class GraphLayout {
+public:
+    void append(const GitCommit& commit);
+    void append(const std::vector<GitCommit>& commits);
+    void clear();
+
+    size_t size() const { return rows.size(); }
+    const GraphRow& row(size_t index) const { return rows[index]; }
+    const GraphEdge& edge(size_t index) const { return edges[index]; }
+    // Widest row so far
+    uint16_t maxWidth() const { return widest; }
+
+private:
+    uint16_t takeFreeLane();
+
+    std::vector<GraphRow> rows;
+    std::vector<GraphEdge> edges;
+    uint16_t widest = 0;
+
+    // Open lanes: the commit each one waits for (empty when free) and its colour
+    std::vector<std::string> laneCommits;
+    std::vector<uint16_t> laneColors;
+    std::unordered_map<std::string, uint16_t> waitingLane;
+    uint16_t nextColor = 0;
+};
+
+}
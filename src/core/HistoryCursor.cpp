@@ -0,0 +1,43 @@
+#include "HistoryCursor.h"
+#include "GitHistoryCache.h"
+#include <algorithm>
+
+namespace VersionTools {
+
+HistoryCursor::HistoryCursor(std::shared_ptr<const GitHistoryCache> cache) : cache(std::move(cache)) {}
+
+HistoryCursor::HistoryCursor(std::vector<GitCommit> commits) : commits(std::move(commits)) {}
+
+std::vector<GitCommit> HistoryCursor::next(size_t pageSize) {
+    auto result = page(current, pageSize);
+    current += result.size();
+    return result;
+}
+
+std::vector<GitCommit> HistoryCursor::page(size_t offset, size_t count) const {
+    size_t total = size();
+    if (offset >= total) {
+        return {};
+    }
+    size_t end = offset + std::min(count, total - offset);
+
+    if (!cache) {
+        return std::vector<GitCommit>(commits.begin() + offset, commits.begin() + end);
+    }
+    std::vector<GitCommit> result;
+    result.reserve(end - offset);
+    for (size_t i = offset; i < end; ++i) {
+        result.push_back(cache->commit(i));
+    }
+    return result;
+}
+
+void HistoryCursor::seek(size_t position) {
+    current = std::min(position, size());
+}
+
+size_t HistoryCursor::size() const {
+    return cache ? cache->size() : commits.size();
+}
+
+}
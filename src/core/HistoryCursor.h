@@ -0,0 +1,38 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <memory>
+#include <vector>
+
+namespace VersionTools {
+
+class GitHistoryCache;
+
+// Page-wise access to a commit history. Cursors opened on an on-disk
+// GitHistoryCache decode only the rows that are asked for, so paging
+// through a long session costs O(page) per page instead of re-running
+// `git log` with a growing limit. Path-limited histories have no cache and
+// are walked once into memory when the cursor is opened.
+class HistoryCursor {
+public:
+    explicit HistoryCursor(std::shared_ptr<const GitHistoryCache> cache);
+    explicit HistoryCursor(std::vector<GitCommit> commits);
+
+    // The next pageSize commits from the current position; empty at the end
+    std::vector<GitCommit> next(size_t pageSize);
+    // Random access for virtualized views; does not move the cursor
+    std::vector<GitCommit> page(size_t offset, size_t count) const;
+
+    void seek(size_t position);
+    size_t position() const { return current; }
+    size_t size() const;
+    bool atEnd() const { return current >= size(); }
+    bool isCached() const { return cache != nullptr; }
+
+private:
+    std::shared_ptr<const GitHistoryCache> cache;
+    std::vector<GitCommit> commits;
+    size_t current = 0;
+};
+
+}
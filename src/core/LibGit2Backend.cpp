@@ -0,0 +1,465 @@
+#include "LibGit2Backend.h"
+#include "GitOutputParser.h"
+#include "GitUtils.h"
+#include <git2.h>
+#include <algorithm>
+#include <ctime>
+
+namespace VersionTools {
+
+namespace {
+
+std::string oidToString(const git_oid* oid) {
+    char buffer[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(buffer, sizeof(buffer), oid);
+    return buffer;
+}
+
+std::chrono::system_clock::time_point toTimePoint(git_time_t seconds) {
+    return std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+}
+
+// Same shape as `git for-each-ref --format=%(taggerdate:short)`: the date in the tagger's own timezone
+std::string formatShortDate(const git_time& when) {
+    std::time_t local = static_cast<std::time_t>(when.time + static_cast<git_time_t>(when.offset) * 60);
+    std::tm* tm = std::gmtime(&local);
+    if (!tm) {
+        return "";
+    }
+    char buffer[16];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d", tm);
+    return buffer;
+}
+
+std::string firstLine(const char* text) {
+    if (!text) {
+        return "";
+    }
+    std::string line(text);
+    size_t newline = line.find('\n');
+    return newline == std::string::npos ? line : line.substr(0, newline);
+}
+
+GitCommit makeCommit(git_commit* commit) {
+    GitCommit result;
+    result.hash = oidToString(git_commit_id(commit));
+    result.shortHash = GitUtils::shortenHash(result.hash);
+
+    if (const git_signature* author = git_commit_author(commit)) {
+        result.author = author->name ? author->name : "";
+        result.email = author->email ? author->email : "";
+    }
+
+    // The CLI path uses the subject for both fields, keep the two backends interchangeable
+    const char* summary = git_commit_summary(commit);
+    result.shortMessage = summary ? summary : "";
+    result.message = result.shortMessage;
+    result.timestamp = toTimePoint(git_commit_time(commit));
+
+    unsigned int parentCount = git_commit_parentcount(commit);
+    result.parentHashes.reserve(parentCount);
+    for (unsigned int i = 0; i < parentCount; ++i) {
+        result.parentHashes.push_back(oidToString(git_commit_parent_id(commit, i)));
+    }
+
+    return result;
+}
+
+// Porcelain-style XY codes so that status mapping stays shared with the CLI parser
+char indexStatusCode(unsigned int flags) {
+    if (flags & GIT_STATUS_INDEX_NEW) return 'A';
+    if (flags & GIT_STATUS_INDEX_MODIFIED) return 'M';
+    if (flags & GIT_STATUS_INDEX_DELETED) return 'D';
+    if (flags & GIT_STATUS_INDEX_RENAMED) return 'R';
+    if (flags & GIT_STATUS_INDEX_TYPECHANGE) return 'T';
+    return ' ';
+}
+
+char worktreeStatusCode(unsigned int flags) {
+    if (flags & GIT_STATUS_WT_MODIFIED) return 'M';
+    if (flags & GIT_STATUS_WT_DELETED) return 'D';
+    if (flags & GIT_STATUS_WT_RENAMED) return 'R';
+    if (flags & GIT_STATUS_WT_TYPECHANGE) return 'T';
+    return ' ';
+}
+
+GitFileChange makeFileChange(const git_status_entry* entry) {
+    GitFileChange change;
+    change.status = FileStatus::Modified;
+
+    char x = indexStatusCode(entry->status);
+    char y = worktreeStatusCode(entry->status);
+    if (entry->status & GIT_STATUS_CONFLICTED) {
+        x = y = 'U';
+    } else if (entry->status & GIT_STATUS_IGNORED) {
+        x = y = '!';
+    } else if (entry->status & GIT_STATUS_WT_NEW) {
+        x = y = '?';
+    }
+    GitUtils::applyStatusCodes(x, y, change);
+
+    const git_diff_delta* delta = entry->head_to_index ? entry->head_to_index : entry->index_to_workdir;
+    if (delta) {
+        change.filePath = delta->new_file.path ? delta->new_file.path : "";
+        if ((entry->status & GIT_STATUS_INDEX_RENAMED) && delta->old_file.path) {
+            change.oldPath = delta->old_file.path;
+        }
+    }
+
+    return change;
+}
+
+std::string unbornBranchName(git_repository* repository) {
+    git_reference* head = nullptr;
+    if (git_reference_lookup(&head, repository, "HEAD") != 0) {
+        return "";
+    }
+    const char* target = git_reference_symbolic_target(head);
+    std::string name = target ? GitUtils::getShortBranchName(target) : "";
+    git_reference_free(head);
+    return name;
+}
+
+void fillTrackingInfo(git_repository* repository, git_reference* branch, std::string& upstreamName,
+                      int& aheadCount, int& behindCount) {
+    git_reference* upstream = nullptr;
+    if (git_branch_upstream(&upstream, branch) != 0) {
+        return;
+    }
+
+    upstreamName = git_reference_shorthand(upstream);
+
+    const git_oid* local = git_reference_target(branch);
+    const git_oid* remote = git_reference_target(upstream);
+    size_t ahead = 0, behind = 0;
+    if (local && remote && git_graph_ahead_behind(&ahead, &behind, repository, local, remote) == 0) {
+        aheadCount = static_cast<int>(ahead);
+        behindCount = static_cast<int>(behind);
+    }
+
+    git_reference_free(upstream);
+}
+
+int pushRevision(git_repository* repository, git_revwalk* walk, const std::string& revision) {
+    if (revision.find("..") != std::string::npos) {
+        return git_revwalk_push_range(walk, revision.c_str());
+    }
+
+    git_object* object = nullptr;
+    int error = git_revparse_single(&object, repository, revision.c_str());
+    if (error != 0) {
+        return error;
+    }
+
+    git_object* commit = nullptr;
+    error = git_object_peel(&commit, object, GIT_OBJECT_COMMIT);
+    if (error == 0) {
+        error = git_revwalk_push(walk, git_object_id(commit));
+        git_object_free(commit);
+    }
+    git_object_free(object);
+    return error;
+}
+
+struct TagCollector {
+    git_repository* repository;
+    std::vector<GitTag>* tags;
+};
+
+int collectTag(const char* name, git_oid* oid, void* payload) {
+    auto* collector = static_cast<TagCollector*>(payload);
+
+    GitTag tag;
+    tag.name = GitUtils::startsWith(name, "refs/tags/") ? std::string(name + 10) : std::string(name);
+    tag.commitHash = GitUtils::shortenHash(oidToString(oid));
+    tag.isAnnotated = false;
+
+    git_object* object = nullptr;
+    if (git_object_lookup(&object, collector->repository, oid, GIT_OBJECT_ANY) == 0) {
+        if (git_object_type(object) == GIT_OBJECT_TAG) {
+            auto* annotated = reinterpret_cast<git_tag*>(object);
+            tag.isAnnotated = true;
+            tag.message = firstLine(git_tag_message(annotated));
+            if (const git_signature* tagger = git_tag_tagger(annotated)) {
+                tag.date = formatShortDate(tagger->when);
+                tag.timestamp = toTimePoint(tagger->when.time);
+            }
+        } else if (git_object_type(object) == GIT_OBJECT_COMMIT) {
+            auto* commit = reinterpret_cast<git_commit*>(object);
+            const char* summary = git_commit_summary(commit);
+            tag.message = summary ? summary : "";
+            tag.timestamp = toTimePoint(git_commit_time(commit));
+        }
+        git_object_free(object);
+    }
+
+    collector->tags->push_back(tag);
+    return 0;
+}
+
+struct StashCollector {
+    git_repository* repository;
+    std::vector<GitStash>* stashes;
+};
+
+int collectStash(size_t index, const char* message, const git_oid* stashId, void* payload) {
+    auto* collector = static_cast<StashCollector*>(payload);
+
+    GitStash stash;
+    stash.name = "stash@{" + std::to_string(index) + "}";
+    stash.message = message ? message : "";
+    stash.index = static_cast<int>(index);
+
+    stash.branch = GitOutputParser::parseStashBranch(stash.message);
+
+    git_commit* commit = nullptr;
+    if (git_commit_lookup(&commit, collector->repository, stashId) == 0) {
+        stash.timestamp = toTimePoint(git_commit_time(commit));
+        git_commit_free(commit);
+    } else {
+        stash.timestamp = std::chrono::system_clock::now();
+    }
+
+    collector->stashes->push_back(stash);
+    return 0;
+}
+
+} // namespace
+
+LibGit2Backend::LibGit2Backend() = default;
+
+LibGit2Backend::~LibGit2Backend() {
+    close();
+}
+
+bool LibGit2Backend::open(const std::string& repositoryPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (repository) {
+        git_repository_free(repository);
+        repository = nullptr;
+    }
+    return git_repository_open_ext(&repository, repositoryPath.c_str(), 0, nullptr) == 0;
+}
+
+void LibGit2Backend::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (repository) {
+        git_repository_free(repository);
+        repository = nullptr;
+    }
+}
+
+bool LibGit2Backend::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return repository != nullptr;
+}
+
+std::optional<GitStatus> LibGit2Backend::getStatus() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!repository) {
+        return std::nullopt;
+    }
+
+    git_status_options options = GIT_STATUS_OPTIONS_INIT;
+    options.show = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
+    options.flags = GIT_STATUS_OPT_INCLUDE_UNTRACKED | GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX;
+
+    git_status_list* list = nullptr;
+    if (git_status_list_new(&list, repository, &options) != 0) {
+        return std::nullopt;
+    }
+
+    GitStatus status;
+    size_t count = git_status_list_entrycount(list);
+    status.changes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const git_status_entry* entry = git_status_byindex(list, i);
+        if (entry && entry->status != GIT_STATUS_CURRENT) {
+            status.changes.push_back(makeFileChange(entry));
+        }
+    }
+    git_status_list_free(list);
+
+    git_reference* head = nullptr;
+    int error = git_repository_head(&head, repository);
+    if (error == GIT_EUNBORNBRANCH) {
+        status.currentBranch = unbornBranchName(repository);
+    } else if (error == 0) {
+        if (git_repository_head_detached(repository) == 1) {
+            status.currentBranch = "HEAD (no branch)";
+        } else {
+            status.currentBranch = git_reference_shorthand(head);
+            fillTrackingInfo(repository, head, status.upstreamBranch, status.aheadCount, status.behindCount);
+        }
+        git_reference_free(head);
+    }
+
+    return status;
+}
+
+std::optional<std::string> LibGit2Backend::getCurrentBranch() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!repository) {
+        return std::nullopt;
+    }
+
+    git_reference* head = nullptr;
+    int error = git_repository_head(&head, repository);
+    if (error == GIT_EUNBORNBRANCH) {
+        std::string name = unbornBranchName(repository);
+        return name.empty() ? std::nullopt : std::optional<std::string>(name);
+    }
+    if (error != 0) {
+        return std::nullopt;
+    }
+
+    std::string branch;
+    if (git_repository_head_detached(repository) == 1) {
+        const git_oid* target = git_reference_target(head);
+        branch = target ? "HEAD detached at " + GitUtils::shortenHash(oidToString(target)) : "unknown";
+    } else {
+        branch = git_reference_shorthand(head);
+    }
+    git_reference_free(head);
+    return branch;
+}
+
+bool LibGit2Backend::walkCommitHistory(int maxCount,
+                                       GitLogOptions options,
+                                       const std::string& branch,
+                                       const std::string& filePath,
+                                       const CommitVisitor& visitor) {
+    // Path-limited history (and --follow) needs per-commit tree diffs; git itself is faster at that
+    if (!filePath.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!repository) {
+        return false;
+    }
+
+    git_revwalk* walk = nullptr;
+    if (git_revwalk_new(&walk, repository) != 0) {
+        return false;
+    }
+
+    git_revwalk_sorting(walk, GIT_SORT_TIME);
+    if ((options & GitLogOptions::FirstParentOnly) != GitLogOptions::None) {
+        git_revwalk_simplify_first_parent(walk);
+    }
+
+    int error = branch.empty() ? git_revwalk_push_head(walk) : pushRevision(repository, walk, branch);
+    if (error != 0) {
+        git_revwalk_free(walk);
+        return false;
+    }
+
+    bool showMerges = (options & GitLogOptions::ShowMerges) != GitLogOptions::None;
+    int visited = 0;
+    bool keepGoing = true;
+
+    git_oid oid;
+    while (keepGoing && (maxCount <= 0 || visited < maxCount) && git_revwalk_next(&oid, walk) == 0) {
+        git_commit* commit = nullptr;
+        if (git_commit_lookup(&commit, repository, &oid) != 0) {
+            continue;
+        }
+        if (showMerges || git_commit_parentcount(commit) <= 1) {
+            ++visited;
+            keepGoing = visitor(makeCommit(commit));
+        }
+        git_commit_free(commit);
+    }
+
+    git_revwalk_free(walk);
+    return true;
+}
+
+std::optional<std::vector<GitBranch>> LibGit2Backend::getBranches(bool includeRemote) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!repository) {
+        return std::nullopt;
+    }
+
+    git_branch_iterator* iterator = nullptr;
+    if (git_branch_iterator_new(&iterator, repository, includeRemote ? GIT_BRANCH_ALL : GIT_BRANCH_LOCAL) != 0) {
+        return std::nullopt;
+    }
+
+    std::vector<GitBranch> branches;
+    git_reference* ref = nullptr;
+    git_branch_t type;
+    while (git_branch_next(&ref, &type, iterator) == 0) {
+        GitBranch branch;
+        const char* name = nullptr;
+        branch.name = git_branch_name(&name, ref) == 0 && name ? name : git_reference_shorthand(ref);
+        branch.fullName = branch.name;
+        branch.isRemote = type == GIT_BRANCH_REMOTE;
+        branch.isCurrent = !branch.isRemote && git_branch_is_head(ref) == 1;
+
+        if (!branch.isRemote) {
+            fillTrackingInfo(repository, ref, branch.upstreamBranch, branch.aheadCount, branch.behindCount);
+        }
+
+        git_reference* resolved = nullptr;
+        if (git_reference_resolve(&resolved, ref) == 0) {
+            git_commit* commit = nullptr;
+            if (const git_oid* target = git_reference_target(resolved)) {
+                if (git_commit_lookup(&commit, repository, target) == 0) {
+                    branch.lastCommit = makeCommit(commit);
+                    git_commit_free(commit);
+                }
+            }
+            git_reference_free(resolved);
+        }
+
+        branches.push_back(branch);
+        git_reference_free(ref);
+    }
+    git_branch_iterator_free(iterator);
+
+    // for-each-ref order: refs/heads before refs/remotes, each sorted by name
+    std::stable_sort(branches.begin(), branches.end(), [](const GitBranch& a, const GitBranch& b) {
+        if (a.isRemote != b.isRemote) {
+            return !a.isRemote;
+        }
+        return a.name < b.name;
+    });
+
+    return branches;
+}
+
+std::optional<std::vector<GitTag>> LibGit2Backend::getTags() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!repository) {
+        return std::nullopt;
+    }
+
+    std::vector<GitTag> tags;
+    TagCollector collector{repository, &tags};
+    if (git_tag_foreach(repository, collectTag, &collector) != 0) {
+        return std::nullopt;
+    }
+
+    std::sort(tags.begin(), tags.end(), [](const GitTag& a, const GitTag& b) { return a.name < b.name; });
+    return tags;
+}
+
+std::optional<std::vector<GitStash>> LibGit2Backend::getStashes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!repository) {
+        return std::nullopt;
+    }
+
+    std::vector<GitStash> stashes;
+    StashCollector collector{repository, &stashes};
+    int error = git_stash_foreach(repository, collectStash, &collector);
+    if (error != 0 && error != GIT_ENOTFOUND) {
+        return std::nullopt;
+    }
+
+    return stashes;
+}
+
+} // namespace VersionTools
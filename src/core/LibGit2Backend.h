@@ -0,0 +1,41 @@
+#pragma once
+
+#include "GitBackend.h"
+#include <mutex>
+
+struct git_repository;
+
+namespace VersionTools {
+
+// libgit2 implementation of the GitManager read paths. Keeps a single
+// git_repository handle open for the lifetime of the session so that
+// status/log/ref queries never fork a git process.
+class LibGit2Backend : public GitBackend {
+public:
+    LibGit2Backend();
+    ~LibGit2Backend() override;
+
+    const char* name() const override { return "libgit2"; }
+
+    bool open(const std::string& repositoryPath) override;
+    void close() override;
+    bool isOpen() const override;
+
+    std::optional<GitStatus> getStatus() override;
+    std::optional<std::string> getCurrentBranch() override;
+    bool walkCommitHistory(int maxCount,
+                           GitLogOptions options,
+                           const std::string& branch,
+                           const std::string& filePath,
+                           const CommitVisitor& visitor) override;
+    std::optional<std::vector<GitBranch>> getBranches(bool includeRemote) override;
+    std::optional<std::vector<GitTag>> getTags() override;
+    std::optional<std::vector<GitStash>> getStashes() override;
+
+private:
+    // git_repository is not safe for concurrent use; every query holds this lock
+    mutable std::mutex mutex;
+    git_repository* repository = nullptr;
+};
+
+}
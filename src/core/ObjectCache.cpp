@@ -0,0 +1,147 @@
+#include "ObjectCache.h"
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace VersionTools {
+
+class ObjectCache::Shard {
+public:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const void> value;
+        size_t bytes;
+    };
+
+    std::mutex mutex;
+    std::list<Entry> entries;  // Most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;  // Views into Entry::key
+    size_t bytes = 0;
+
+    // Drops the oldest entries over the limits, keeping the newest; returns how many went
+    uint64_t trim(size_t maxBytes, size_t maxEntries) {
+        uint64_t evicted = 0;
+        while (entries.size() > 1 && (entries.size() > maxEntries || bytes > maxBytes)) {
+            bytes -= entries.back().bytes;
+            index.erase(entries.back().key);
+            entries.pop_back();
+            ++evicted;
+        }
+        return evicted;
+    }
+};
+
+ObjectCache::ObjectCache(size_t maxBytes, size_t maxEntries, size_t shardCount)
+    : shards(std::make_unique<Shard[]>(std::max<size_t>(shardCount, 1))),
+      shardCount(std::max<size_t>(shardCount, 1)),
+      maxBytes(maxBytes),
+      maxEntries(maxEntries) {
+}
+
+ObjectCache::~ObjectCache() = default;
+
+ObjectCache::Shard& ObjectCache::shardFor(const std::string& key) const {
+    return shards[std::hash<std::string>()(key) % shardCount];
+}
+
+std::shared_ptr<const void> ObjectCache::findEntry(const std::string& key) {
+    auto& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    hits.fetch_add(1, std::memory_order_relaxed);
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->value;
+}
+
+bool ObjectCache::contains(const std::string& key) const {
+    auto& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.index.count(key) != 0;
+}
+
+void ObjectCache::insertEntry(std::string key, std::shared_ptr<const void> value, size_t bytes) {
+    if (!value) {
+        return;
+    }
+    bytes += sizeof(Shard::Entry) + key.capacity();
+    // Each shard gets an even share of the limits
+    size_t shardBytes = maxBytes.load(std::memory_order_relaxed) / shardCount;
+    size_t shardEntries = std::max<size_t>(maxEntries.load(std::memory_order_relaxed) / shardCount, 1);
+
+    auto& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        auto entry = it->second;
+        shard.bytes -= entry->bytes;
+        shard.index.erase(it);
+        shard.entries.erase(entry);
+    }
+    shard.entries.push_front({std::move(key), std::move(value), bytes});
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.bytes += bytes;
+    insertions.fetch_add(1, std::memory_order_relaxed);
+    evictions.fetch_add(shard.trim(shardBytes, shardEntries), std::memory_order_relaxed);
+}
+
+void ObjectCache::clear() {
+    for (size_t i = 0; i < shardCount; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        shards[i].index.clear();
+        shards[i].entries.clear();
+        shards[i].bytes = 0;
+    }
+}
+
+void ObjectCache::setLimits(size_t newMaxBytes, size_t newMaxEntries) {
+    maxBytes.store(newMaxBytes, std::memory_order_relaxed);
+    maxEntries.store(newMaxEntries, std::memory_order_relaxed);
+    size_t shardBytes = newMaxBytes / shardCount;
+    size_t shardEntries = std::max<size_t>(newMaxEntries / shardCount, 1);
+    for (size_t i = 0; i < shardCount; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        evictions.fetch_add(shards[i].trim(shardBytes, shardEntries), std::memory_order_relaxed);
+    }
+}
+
+ObjectCacheStatistics ObjectCache::statistics() const {
+    ObjectCacheStatistics statistics;
+    statistics.hits = hits.load(std::memory_order_relaxed);
+    statistics.misses = misses.load(std::memory_order_relaxed);
+    statistics.insertions = insertions.load(std::memory_order_relaxed);
+    statistics.evictions = evictions.load(std::memory_order_relaxed);
+    statistics.maxBytes = maxBytes.load(std::memory_order_relaxed);
+    statistics.maxEntries = maxEntries.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < shardCount; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        statistics.entries += shards[i].entries.size();
+        statistics.bytes += shards[i].bytes;
+    }
+    return statistics;
+}
+
+std::string ObjectCache::key(CachedObject kind, std::initializer_list<std::string_view> ids) {
+    std::string result(1, static_cast<char>(kind));
+    bool first = true;
+    for (auto id : ids) {
+        if (!first) {
+            result += '\0';
+        }
+        result.append(id);
+        first = false;
+    }
+    return result;
+}
+
+bool ObjectCache::isObjectId(std::string_view text) {
+    auto isHexDigit = [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); };
+    return (text.size() == 40 || text.size() == 64) && std::all_of(text.begin(), text.end(), isHexDigit);
+}
+
+}
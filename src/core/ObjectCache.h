@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace VersionTools {
+
+// What a cache entry holds; part of its key, so ids of different kinds never collide
+enum class CachedObject : char {
+    Commit = 'c',  // GitCommit with the full message
+    Patch = 'p',   // GitPatch of a commit or a pair of commits, per path and diff budget
+    Blob = 'b',    // File content as std::string
+};
+
+// Totals since the cache was created; entries and bytes as of now
+struct ObjectCacheStatistics {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t maxEntries = 0;
+    size_t maxBytes = 0;
+
+    double hitRate() const { return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses); }
+};
+
+// Objects read from git, keyed by ids of immutable objects (full commit and
+// blob hashes), so an entry never goes stale. Each entry is charged what it
+// really holds in memory; the least recently used ones are dropped once the
+// entries add up to more than the byte or entry limit. Keys are spread over
+// shards with a lock each, so scheduler workers reading in parallel rarely
+// wait for one another. Thread-safe.
+class ObjectCache {
+public:
+    explicit ObjectCache(size_t maxBytes = 128 * 1024 * 1024, size_t maxEntries = 4096, size_t shardCount = 8);
+    ~ObjectCache();
+
+    ObjectCache(const ObjectCache&) = delete;
+    ObjectCache& operator=(const ObjectCache&) = delete;
+
+    // nullptr when missing; counted as a hit or a miss
+    template <typename T>
+    std::shared_ptr<const T> find(const std::string& key) {
+        return std::static_pointer_cast<const T>(findEntry(key));
+    }
+    // bytes is what the value holds, as from GitPatch::memoryUsage(). An
+    // entry larger than a shard's share of maxBytes is still kept as the
+    // newest of its shard until something else arrives there.
+    template <typename T>
+    void insert(std::string key, std::shared_ptr<const T> value, size_t bytes) {
+        insertEntry(std::move(key), std::move(value), bytes);
+    }
+    // Neither a hit nor a miss, and leaves the entry's age alone
+    bool contains(const std::string& key) const;
+    void clear();
+
+    // Shrinking evicts at once
+    void setLimits(size_t maxBytes, size_t maxEntries);
+    ObjectCacheStatistics statistics() const;
+
+    // "<kind><id>\0<id>..." for the ids that identify the object together
+    static std::string key(CachedObject kind, std::initializer_list<std::string_view> ids);
+    // A full SHA-1 or SHA-256 hex object id; names like HEAD or branches can move, so they are never keys
+    static bool isObjectId(std::string_view text);
+
+private:
+    std::shared_ptr<const void> findEntry(const std::string& key);
+    void insertEntry(std::string key, std::shared_ptr<const void> value, size_t bytes);
+
+    class Shard;
+    Shard& shardFor(const std::string& key) const;
+
+    std::unique_ptr<Shard[]> shards;
+    size_t shardCount;
+    std::atomic<size_t> maxBytes;
+    std::atomic<size_t> maxEntries;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> insertions{0};
+    std::atomic<uint64_t> evictions{0};
+};
+
+}
@@ -0,0 +1,442 @@
+#include "RefSnapshot.h"
+#include "GitOutputParser.h"
+#include "GitUtils.h"
+#include "SystemCommand.h"
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+namespace VersionTools {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// One for-each-ref record: fields are %00 separated, records end with a newline
+constexpr char REF_FORMAT[] = "--format=%(refname)%00%(objectname)%00%(objecttype)%00%(upstream:short)%00"
+                              "%(upstream:track)%00%(creatordate:unix)%00%(taggerdate:short)%00%(subject)%00"
+                              "%(authorname)%00%(authoremail)";
+constexpr size_t REF_FIELDS = 10;
+
+struct GitDirectories {
+    fs::path gitDir;     // Per-worktree: HEAD lives here
+    fs::path commonDir;  // Shared: refs, packed-refs, config
+};
+
+std::string readFirstLine(const fs::path& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return line;
+}
+
+// Same lookup as git: a .git directory, a "gitdir:" file (worktrees, submodules) or a bare repository
+bool resolveGitDirectories(const std::string& workingDirectory, GitDirectories& directories) {
+    std::error_code error;
+    fs::path root(workingDirectory);
+    fs::path dotGit = root / ".git";
+
+    if (fs::is_directory(dotGit, error)) {
+        directories.gitDir = dotGit;
+    } else if (fs::is_regular_file(dotGit, error)) {
+        std::string line = readFirstLine(dotGit);
+        if (line.compare(0, 8, "gitdir: ") != 0) {
+            return false;
+        }
+        fs::path target(line.substr(8));
+        directories.gitDir = target.is_relative() ? root / target : target;
+    } else if (fs::exists(root / "HEAD", error) && fs::exists(root / "refs", error)) {
+        directories.gitDir = root;
+    } else {
+        return false;
+    }
+
+    std::string common = readFirstLine(directories.gitDir / "commondir");
+    if (common.empty()) {
+        directories.commonDir = directories.gitDir;
+    } else {
+        fs::path target(common);
+        directories.commonDir = target.is_relative() ? directories.gitDir / target : target;
+    }
+    return true;
+}
+
+// Commit a ref points at, from its loose file or packed-refs, following symbolic refs; empty when unborn
+std::string resolveRef(const GitDirectories& directories, std::string refName) {
+    for (int depth = 0; depth < 5; ++depth) {
+        std::string line = readFirstLine(directories.commonDir / refName);
+        if (line.compare(0, 5, "ref: ") == 0) {
+            refName = line.substr(5);
+            continue;
+        }
+        if (!line.empty()) {
+            return GitUtils::trim(line);
+        }
+
+        // "<hash> <refname>" lines; '#' starts the header, '^' the peeled commit of the tag above
+        std::ifstream packed(directories.commonDir / "packed-refs");
+        std::string entry;
+        while (std::getline(packed, entry)) {
+            size_t space = entry.find(' ');
+            if (entry.empty() || entry[0] == '#' || entry[0] == '^' || space == std::string::npos) {
+                continue;
+            }
+            if (GitUtils::trim(entry.substr(space + 1)) == refName) {
+                return entry.substr(0, space);
+            }
+        }
+        return "";
+    }
+    return "";
+}
+
+// Spelling of `git branch --show-current` with the rev-parse fallback GitManager has always used
+std::string headName(const std::string& branch, const std::string& commit) {
+    if (!branch.empty()) {
+        return branch;
+    }
+    if (!commit.empty()) {
+        return "HEAD detached at " + GitUtils::shortenHash(commit);
+    }
+    return "unknown";
+}
+
+std::chrono::system_clock::time_point parseUnixTime(std::string_view text) {
+    long long seconds = 0;
+    std::from_chars(text.data(), text.data() + text.size(), seconds);
+    return std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+}
+
+std::string_view stripPrefix(std::string_view text, std::string_view prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0 ? text.substr(prefix.size()) : text;
+}
+
+// "remote.<name>.<key>\n<value>" entries from `config -z --get-regexp`; names may contain dots
+std::vector<GitRemote> parseRemotes(std::string_view output) {
+    std::vector<GitRemote> remotes;
+    std::vector<bool> hasPushUrl;
+
+    size_t pos = 0;
+    while (pos < output.size()) {
+        size_t end = output.find('\0', pos);
+        if (end == std::string_view::npos) {
+            end = output.size();
+        }
+        std::string_view entry = output.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t newline = entry.find('\n');
+        std::string_view key = entry.substr(0, newline);
+        std::string_view value = newline == std::string_view::npos ? std::string_view() : entry.substr(newline + 1);
+        size_t dot = key.rfind('.');
+        if (key.compare(0, 7, "remote.") != 0 || dot == std::string_view::npos || dot <= 7) {
+            continue;
+        }
+        std::string_view name = key.substr(7, dot - 7);
+        std::string_view variable = key.substr(dot + 1);
+        if (variable != "url" && variable != "pushurl") {
+            continue;
+        }
+
+        // Config order, like `git remote`; the first url wins, as for `git remote get-url`
+        size_t index = 0;
+        while (index < remotes.size() && remotes[index].name != name) {
+            ++index;
+        }
+        if (index == remotes.size()) {
+            remotes.push_back({std::string(name), "", ""});
+            hasPushUrl.push_back(false);
+        }
+        GitRemote& remote = remotes[index];
+        if (variable == "url" && remote.url.empty()) {
+            remote.url = std::string(value);
+            if (!hasPushUrl[index]) {
+                remote.pushUrl = remote.url;
+            }
+        } else if (variable == "pushurl" && !hasPushUrl[index]) {
+            remote.pushUrl = std::string(value);
+            hasPushUrl[index] = true;
+        }
+    }
+
+    // A remote with only a pushurl is not listed by `git remote -v` as fetchable either
+    std::vector<GitRemote> configured;
+    for (auto& remote : remotes) {
+        if (!remote.url.empty()) {
+            configured.push_back(std::move(remote));
+        }
+    }
+    return configured;
+}
+
+// Modification time and size of everything a ref read depends on
+struct StampEntry {
+    std::string path;
+    long long modified;
+    uintmax_t size;
+    bool operator==(const StampEntry& other) const {
+        return modified == other.modified && size == other.size && path == other.path;
+    }
+};
+using RefStamp = std::vector<StampEntry>;
+
+void addStamp(RefStamp& stamp, const fs::path& path) {
+    std::error_code error;
+    auto time = fs::last_write_time(path, error);
+    long long modified = error ? -1 : static_cast<long long>(time.time_since_epoch().count());
+    uintmax_t size = fs::is_regular_file(path, error) ? fs::file_size(path, error) : 0;
+    stamp.push_back({path.string(), modified, size});
+}
+
+RefStamp computeStamp(const GitDirectories& directories) {
+    RefStamp stamp;
+    addStamp(stamp, directories.gitDir / "HEAD");
+    addStamp(stamp, directories.commonDir / "packed-refs");
+    addStamp(stamp, directories.commonDir / "config");
+
+    // Refs are written through a lock file renamed into place, which touches the containing directory
+    std::error_code error;
+    fs::path refs = directories.commonDir / "refs";
+    addStamp(stamp, refs);
+    for (fs::recursive_directory_iterator it(refs, error), end; !error && it != end; it.increment(error)) {
+        if (it->is_directory(error)) {
+            addStamp(stamp, it->path());
+        }
+    }
+    return stamp;
+}
+
+} // namespace
+
+std::optional<RefSnapshot> RefSnapshot::load(const std::string& workingDirectory) {
+    GitDirectories directories;
+    if (!resolveGitDirectories(workingDirectory, directories)) {
+        return std::nullopt;
+    }
+
+    SystemCommand cmd;
+    auto refs = cmd.execute("git", {"for-each-ref", REF_FORMAT, "refs/heads", "refs/remotes", "refs/tags"},
+                            workingDirectory);
+    if (refs.exitCode != 0) {
+        return std::nullopt;
+    }
+
+    RefSnapshot snapshot;
+    std::string_view output(refs.output);
+    size_t pos = 0;
+    while (pos < output.size()) {
+        size_t end = output.find('\n', pos);
+        if (end == std::string_view::npos) {
+            end = output.size();
+        }
+        std::string_view record = output.substr(pos, end - pos);
+        pos = end + 1;
+
+        std::string_view fields[REF_FIELDS];
+        size_t count = 0;
+        size_t start = 0;
+        while (count < REF_FIELDS) {
+            size_t split = record.find('\0', start);
+            if (split == std::string_view::npos) {
+                fields[count++] = record.substr(start);
+                break;
+            }
+            fields[count++] = record.substr(start, split - start);
+            start = split + 1;
+        }
+        if (count < REF_FIELDS) {
+            continue;
+        }
+
+        Ref ref;
+        ref.fullName = std::string(fields[0]);
+        ref.objectHash = std::string(fields[1]);
+        ref.isAnnotatedTag = fields[2] == "tag";
+        ref.upstream = std::string(fields[3]);
+        GitOutputParser::parseTrackingCounts(fields[4], ref.aheadCount, ref.behindCount);
+        ref.timestamp = parseUnixTime(fields[5]);
+        ref.tagDate = std::string(fields[6]);
+        ref.subject = std::string(fields[7]);
+        ref.author = std::string(fields[8]);
+        std::string_view email = fields[9];
+        if (email.size() >= 2 && email.front() == '<' && email.back() == '>') {
+            email = email.substr(1, email.size() - 2);
+        }
+        ref.email = std::string(email);
+
+        std::string_view fullName = fields[0];
+        if (fullName.compare(0, 11, "refs/heads/") == 0) {
+            ref.name = std::string(stripPrefix(fullName, "refs/heads/"));
+            snapshot.locals.push_back(std::move(ref));
+        } else if (fullName.compare(0, 13, "refs/remotes/") == 0) {
+            ref.name = std::string(stripPrefix(fullName, "refs/remotes/"));
+            snapshot.remoteRefs.push_back(std::move(ref));
+        } else {
+            ref.name = std::string(stripPrefix(fullName, "refs/tags/"));
+            snapshot.tagRefs.push_back(std::move(ref));
+        }
+    }
+
+    // Exit status 1 only means no remote is configured
+    auto config = cmd.execute("git", {"config", "-z", "--get-regexp", "^remote\\."}, workingDirectory);
+    if (config.exitCode == 0) {
+        snapshot.remoteList = parseRemotes(config.output);
+    }
+
+    std::string headLine = readFirstLine(directories.gitDir / "HEAD");
+    if (headLine.compare(0, 5, "ref: ") == 0) {
+        std::string target = headLine.substr(5);
+        snapshot.head = GitUtils::startsWith(target, "refs/heads/") ? target.substr(11) : target;
+        for (const auto& branch : snapshot.locals) {
+            if (branch.fullName == target) {
+                snapshot.headCommit = branch.objectHash;
+                break;
+            }
+        }
+    } else {
+        snapshot.headCommit = GitUtils::trim(headLine);
+    }
+
+    return snapshot;
+}
+
+std::optional<GitRepository> RefSnapshot::readHead(const std::string& workingDirectory) {
+    GitDirectories directories;
+    if (!resolveGitDirectories(workingDirectory, directories)) {
+        return std::nullopt;
+    }
+    std::string headLine = readFirstLine(directories.gitDir / "HEAD");
+    if (headLine.empty()) {
+        return std::nullopt;
+    }
+
+    GitRepository repo;
+    repo.path = workingDirectory;
+    repo.workingDirectory = workingDirectory;
+    repo.gitDirectory = directories.gitDir.string();
+    repo.isBare = directories.gitDir == fs::path(workingDirectory);
+    std::error_code error;
+    repo.isShallow = fs::exists(directories.commonDir / "shallow", error);
+
+    std::string branch;
+    if (headLine.compare(0, 5, "ref: ") == 0) {
+        std::string target = headLine.substr(5);
+        branch = GitUtils::startsWith(target, "refs/heads/") ? target.substr(11) : target;
+        repo.headCommit = resolveRef(directories, target);
+    } else {
+        repo.headCommit = GitUtils::trim(headLine);
+    }
+    repo.head = headName(branch, repo.headCommit);
+    return repo;
+}
+
+std::string RefSnapshot::currentBranchName() const {
+    return headName(head, headCommit);
+}
+
+std::vector<GitBranch> RefSnapshot::toBranches(bool includeRemote) const {
+    std::vector<GitBranch> branches;
+    branches.reserve(locals.size() + (includeRemote ? remoteRefs.size() : 0));
+
+    auto append = [&branches](const Ref& ref, bool isRemote, bool isCurrent) {
+        GitBranch branch;
+        branch.name = ref.name;
+        branch.fullName = ref.name;
+        branch.isRemote = isRemote;
+        branch.isCurrent = isCurrent;
+        branch.upstreamBranch = ref.upstream;
+        branch.aheadCount = ref.aheadCount;
+        branch.behindCount = ref.behindCount;
+
+        GitCommit commit;
+        commit.hash = ref.objectHash;
+        commit.shortHash = GitUtils::shortenHash(ref.objectHash);
+        commit.author = ref.author;
+        commit.email = ref.email;
+        commit.shortMessage = ref.subject;
+        commit.message = ref.subject;
+        commit.timestamp = ref.timestamp;
+        branch.lastCommit = std::move(commit);
+
+        branches.push_back(std::move(branch));
+    };
+
+    for (const auto& ref : locals) {
+        append(ref, false, ref.name == head);
+    }
+    if (includeRemote) {
+        for (const auto& ref : remoteRefs) {
+            append(ref, true, false);
+        }
+    }
+    return branches;
+}
+
+std::vector<GitTag> RefSnapshot::toTags() const {
+    std::vector<GitTag> tags;
+    tags.reserve(tagRefs.size());
+    for (const auto& ref : tagRefs) {
+        GitTag tag;
+        tag.name = ref.name;
+        tag.commitHash = GitUtils::shortenHash(ref.objectHash);
+        tag.isAnnotated = ref.isAnnotatedTag;
+        tag.date = ref.isAnnotatedTag ? ref.tagDate : "";
+        tag.message = ref.subject;
+        tag.timestamp = ref.timestamp;
+        tags.push_back(std::move(tag));
+    }
+    return tags;
+}
+
+class RefSnapshotCache::Impl {
+public:
+    std::string workingDirectory;
+    std::mutex mutex;
+    GitDirectories directories;
+    bool resolved = false;
+    RefStamp stamp;
+    std::shared_ptr<const RefSnapshot> snapshot;
+};
+
+RefSnapshotCache::RefSnapshotCache(const std::string& workingDirectory) : pImpl(std::make_unique<Impl>()) {
+    pImpl->workingDirectory = workingDirectory;
+}
+
+RefSnapshotCache::~RefSnapshotCache() = default;
+
+std::shared_ptr<const RefSnapshot> RefSnapshotCache::get() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    if (!pImpl->resolved) {
+        if (!resolveGitDirectories(pImpl->workingDirectory, pImpl->directories)) {
+            return nullptr;
+        }
+        pImpl->resolved = true;
+    }
+
+    // Stamped before reading, so a ref written during the read shows up as a change next time
+    RefStamp current = computeStamp(pImpl->directories);
+    if (pImpl->snapshot && current == pImpl->stamp) {
+        return pImpl->snapshot;
+    }
+
+    auto fresh = RefSnapshot::load(pImpl->workingDirectory);
+    if (!fresh) {
+        pImpl->snapshot.reset();
+        return nullptr;
+    }
+    pImpl->snapshot = std::make_shared<const RefSnapshot>(std::move(*fresh));
+    pImpl->stamp = std::move(current);
+    return pImpl->snapshot;
+}
+
+void RefSnapshotCache::invalidate() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->snapshot.reset();
+}
+
+}
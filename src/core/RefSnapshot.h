@@ -0,0 +1,83 @@
+#pragma once
+
+#include "GitTypes.h"
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace VersionTools {
+
+// Every branch, remote-tracking branch and tag with HEAD and the configured
+// remotes, read in one `for-each-ref` and one `config --get-regexp` call.
+// HEAD itself is read from the git directory, so no fork is spent on it.
+class RefSnapshot {
+public:
+    struct Ref {
+        std::string fullName;    // "refs/heads/main"
+        std::string name;        // "main", "origin/main", "v1.0"
+        std::string objectHash;  // Tag object for annotated tags, otherwise the commit
+        bool isAnnotatedTag = false;
+        std::string upstream;  // Local branches only, e.g. "origin/main"
+        int aheadCount = 0;
+        int behindCount = 0;
+        std::string subject;     // Tag message for annotated tags, otherwise the commit subject
+        std::string author;
+        std::string email;
+        std::string tagDate;     // "YYYY-MM-DD", annotated tags only
+        std::chrono::system_clock::time_point timestamp;  // Tagger or committer date
+    };
+
+    // nullopt when the directory is not a repository or git cannot be run
+    static std::optional<RefSnapshot> load(const std::string& workingDirectory);
+    // Directories and HEAD of the repository from a few small file reads, with
+    // the loose ref or packed-refs for the commit; no process runs and status
+    // stays empty. nullopt when the directory is not a repository.
+    static std::optional<GitRepository> readHead(const std::string& workingDirectory);
+
+    const std::vector<Ref>& localBranches() const { return locals; }
+    const std::vector<Ref>& remoteBranches() const { return remoteRefs; }
+    const std::vector<Ref>& tags() const { return tagRefs; }
+    const std::vector<GitRemote>& remotes() const { return remoteList; }
+
+    // Short branch name HEAD points at (also for an unborn branch), empty when detached
+    const std::string& headBranch() const { return head; }
+    // Commit HEAD resolves to, empty for an unborn branch
+    const std::string& headHash() const { return headCommit; }
+    bool isDetached() const { return head.empty() && !headCommit.empty(); }
+
+    // Same shapes and spellings as the GitManager getters have always returned
+    std::string currentBranchName() const;
+    std::vector<GitBranch> toBranches(bool includeRemote) const;
+    std::vector<GitTag> toTags() const;
+
+private:
+    std::vector<Ref> locals;
+    std::vector<Ref> remoteRefs;
+    std::vector<Ref> tagRefs;
+    std::vector<GitRemote> remoteList;
+    std::string head;
+    std::string headCommit;
+};
+
+// Hands out the last RefSnapshot until HEAD, packed-refs, the refs/ tree or
+// the config change on disk; the check is a handful of stat calls, so
+// callers can ask for the snapshot on every getter.
+class RefSnapshotCache {
+public:
+    explicit RefSnapshotCache(const std::string& workingDirectory);
+    ~RefSnapshotCache();
+
+    RefSnapshotCache(const RefSnapshotCache&) = delete;
+    RefSnapshotCache& operator=(const RefSnapshotCache&) = delete;
+
+    // nullptr when the snapshot cannot be built
+    std::shared_ptr<const RefSnapshot> get();
+    void invalidate();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}
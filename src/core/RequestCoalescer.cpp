@@ -0,0 +1,115 @@
+#include "RequestCoalescer.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace VersionTools {
+
+namespace {
+
+struct Refresh {
+    uint64_t requested = 0;
+    bool queued = false;
+    bool running = false;
+    bool trailing = false;
+    TaskOptions options;
+    std::function<void(uint64_t)> work;
+};
+
+}
+
+class RequestCoalescer::Impl {
+public:
+    explicit Impl(CommandScheduler& scheduler) : scheduler(scheduler) {}
+
+    CommandScheduler& scheduler;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<void>> flights;
+    std::unordered_map<std::string, Refresh> refreshes;
+
+    // Called with the mutex held
+    static void post(const std::shared_ptr<Impl>& self, const std::string& key, Refresh& refresh) {
+        refresh.queued = true;
+        self->scheduler.post(refresh.options, [self, key]() { run(self, key); });
+    }
+
+    static void run(const std::shared_ptr<Impl>& self, const std::string& key) {
+        uint64_t generation;
+        std::function<void(uint64_t)> work;
+        {
+            std::lock_guard<std::mutex> lock(self->mutex);
+            Refresh& refresh = self->refreshes[key];
+            refresh.queued = false;
+            refresh.running = true;
+            generation = refresh.requested;
+            work = refresh.work;
+        }
+
+        try {
+            work(generation);
+        } catch (...) {
+        }
+
+        std::lock_guard<std::mutex> lock(self->mutex);
+        Refresh& refresh = self->refreshes[key];
+        refresh.running = false;
+        if (refresh.trailing) {
+            refresh.trailing = false;
+            post(self, key, refresh);
+        } else {
+            // Nothing needs the closure until the next request; let go of what it captured
+            refresh.work = nullptr;
+        }
+    }
+};
+
+RequestCoalescer::RequestCoalescer(CommandScheduler& scheduler) : pImpl(std::make_shared<Impl>(scheduler)) {}
+
+RequestCoalescer::~RequestCoalescer() = default;
+
+uint64_t RequestCoalescer::refresh(const std::string& key, TaskOptions options,
+                                   std::function<void(uint64_t generation)> work) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    Refresh& refresh = pImpl->refreshes[key];
+    uint64_t generation = ++refresh.requested;
+    refresh.work = std::move(work);
+    refresh.options = std::move(options);
+
+    if (refresh.queued) {
+        // The queued run reads the generation when it starts, so it covers this request
+        return generation;
+    }
+    if (refresh.running) {
+        refresh.trailing = true;
+        return generation;
+    }
+    Impl::post(pImpl, key, refresh);
+    return generation;
+}
+
+uint64_t RequestCoalescer::generation(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    auto it = pImpl->refreshes.find(key);
+    return it != pImpl->refreshes.end() ? it->second.requested : 0;
+}
+
+bool RequestCoalescer::isCurrent(const std::string& key, uint64_t generation) const {
+    return generation >= this->generation(key);
+}
+
+std::shared_ptr<void> RequestCoalescer::join(const std::string& key,
+                                             const std::function<std::shared_ptr<void>()>& start, bool& leader) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    auto& flight = pImpl->flights[key];
+    leader = !flight;
+    if (leader) {
+        flight = start();
+    }
+    return flight;
+}
+
+void RequestCoalescer::leave(const std::string& key) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->flights.erase(key);
+}
+
+}
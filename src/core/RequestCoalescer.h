@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CommandScheduler.h"
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace VersionTools {
+
+// Collapses duplicate read requests in front of GitManager.
+//
+// share() is single-flight: while a call for a key is running, other callers
+// with the same key wait for its result instead of starting their own git
+// process. A key must always name the same result type, and work must not
+// call share() with its own key.
+//
+// refresh() coalesces bursts. A request made while a run for the key is
+// still queued rides along with that run; one made while it is running
+// queues a single trailing run, however many arrive. So a burst of N
+// requests costs at most two runs, and the last one sees the final state.
+// Every request gets a generation number; a result computed for an older
+// generation than the newest request can be dropped with isCurrent()
+// instead of repainting, since the trailing run is already on its way.
+class RequestCoalescer {
+public:
+    explicit RequestCoalescer(CommandScheduler& scheduler = CommandScheduler::shared());
+    ~RequestCoalescer();
+
+    RequestCoalescer(const RequestCoalescer&) = delete;
+    RequestCoalescer& operator=(const RequestCoalescer&) = delete;
+
+    // Followers get whatever the leader got, including its exception
+    template <typename T>
+    T share(const std::string& key, const std::function<T()>& work) {
+        auto promise = std::make_shared<std::promise<T>>();
+        bool leader = false;
+        auto flight = std::static_pointer_cast<std::shared_future<T>>(join(
+            key, [&promise]() { return std::make_shared<std::shared_future<T>>(promise->get_future().share()); },
+            leader));
+        if (leader) {
+            try {
+                promise->set_value(work());
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+            leave(key);
+        }
+        return flight->get();
+    }
+
+    // Runs work on the scheduler with the newest generation it covers; a
+    // request that rides along replaces the queued work with its own.
+    // Returns this request's generation.
+    uint64_t refresh(const std::string& key, TaskOptions options, std::function<void(uint64_t generation)> work);
+
+    // Newest generation requested for key, 0 before the first request
+    uint64_t generation(const std::string& key) const;
+    // False once a newer request for key was made
+    bool isCurrent(const std::string& key, uint64_t generation) const;
+
+private:
+    std::shared_ptr<void> join(const std::string& key, const std::function<std::shared_ptr<void>()>& start,
+                               bool& leader);
+    void leave(const std::string& key);
+
+    class Impl;
+    std::shared_ptr<Impl> pImpl;  // Shared with queued refresh runs, which may outlive the coalescer
+};
+
+}
@@ -1,36 +1,394 @@
 #include "SystemCommand.h"
+#include "CancellationToken.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <future>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
 
 #ifdef _WIN32
 #include <process.h>
 #include <windows.h>
 #else
+#include <climits>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/event.h>
+#define VT_KQUEUE_EXIT 1
+#endif
+
+extern char** environ;
+
+// posix_spawn can only change the child's directory through this extension
+#if defined(__APPLE__) || (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29)))
+#define VT_SPAWN_ADDCHDIR 1
+#endif
 #endif
 
 namespace VersionTools {
 
+namespace {
+
+#ifdef _WIN32
+// Anonymous pipes cannot be used with OVERLAPPED I/O, so the read end is a uniquely named pipe
+bool createOverlappedPipe(HANDLE& readEnd, HANDLE& writeEnd, SECURITY_ATTRIBUTES* sa) {
+    static std::atomic<unsigned long> serial{0};
+    char name[MAX_PATH];
+    snprintf(name, sizeof(name), "\\\\.\\pipe\\VersionTools.%lu.%lu", GetCurrentProcessId(), ++serial);
+
+    readEnd = CreateNamedPipeA(name, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                               PIPE_TYPE_BYTE | PIPE_WAIT, 1, 4096, 4096, 0, NULL);
+    if (readEnd == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    writeEnd = CreateFileA(name, GENERIC_WRITE, 0, sa, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (writeEnd == INVALID_HANDLE_VALUE) {
+        CloseHandle(readEnd);
+        readEnd = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    return true;
+}
+
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+
+struct OverlappedReader {
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    OVERLAPPED overlapped = {};
+    char buffer[READ_CHUNK_SIZE];
+    std::string* sink = nullptr;
+    const OutputCallback* callback = nullptr;
+    bool open = false;
+
+    // Queue the next read; completion (synchronous or not) is reported through the event
+    void start() {
+        ResetEvent(overlapped.hEvent);
+        if (!ReadFile(handle, buffer, sizeof(buffer), NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+            open = false;
+        }
+    }
+
+    void complete() {
+        DWORD bytesRead = 0;
+        if (!GetOverlappedResult(handle, &overlapped, &bytesRead, FALSE)) {
+            open = false;
+            return;
+        }
+        if (callback && *callback) {
+            (*callback)(std::string(buffer, bytesRead));
+        } else {
+            sink->append(buffer, bytesRead);
+        }
+        start();
+    }
+};
+#else
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+
+// Without an exit descriptor the wait for output is cut into slices this long, and the child is
+// checked for between them
+constexpr int EXIT_CHECK_INTERVAL_MS = 50;
+
+// A descriptor that becomes readable once the child exits, even while a grandchild still holds
+// the pipes open: a pidfd on Linux, a kqueue watching NOTE_EXIT on macOS and the BSDs. -1 when
+// the system has neither (Linux before 5.3)
+int openExitFd(pid_t pid) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#elif defined(VT_KQUEUE_EXIT)
+    int queue = kqueue();
+    if (queue == -1) {
+        return -1;
+    }
+    fcntl(queue, F_SETFD, FD_CLOEXEC);
+    struct kevent change;
+    EV_SET(&change, static_cast<uintptr_t>(pid), EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, 0);
+    if (kevent(queue, &change, 1, nullptr, 0, nullptr) == 0) {
+        return queue;
+    }
+#ifdef EVFILT_USER
+    // ESRCH: the child is already a zombie, so the queue is made readable right away instead
+    if (errno == ESRCH) {
+        struct kevent trigger[2];
+        EV_SET(&trigger[0], 0, EVFILT_USER, EV_ADD | EV_ONESHOT, 0, 0, 0);
+        EV_SET(&trigger[1], 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, 0);
+        if (kevent(queue, trigger, 2, nullptr, 0, nullptr) == 0) {
+            return queue;
+        }
+    }
+#endif
+    close(queue);
+    return -1;
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// True once the child has exited; the zombie stays for reapChild() to collect
+bool childHasExited(pid_t pid) {
+    siginfo_t info;
+    info.si_pid = 0;
+    while (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOHANG | WNOWAIT) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return info.si_pid != 0;
+}
+
+// Close-on-exec so concurrent launches on other threads don't leak this run's pipes into their
+// children, which would hold the pipes open past this child's exit
+bool openPipe(int fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+bool isExecutableFile(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) && access(path.c_str(), X_OK) == 0;
+}
+
+// What execvp would run for command under searchPath, or "" when nothing on the path matches
+std::string searchPath(const std::string& command, const std::string& searchPath) {
+    size_t start = 0;
+    while (start <= searchPath.size()) {
+        size_t end = searchPath.find(':', start);
+        if (end == std::string::npos) {
+            end = searchPath.size();
+        }
+        // An empty entry means the current directory; relative entries are fixed to it now, since the
+        // child changes directory before it execs
+        std::string directory = end == start ? "." : searchPath.substr(start, end - start);
+        if (directory[0] != '/') {
+            char cwd[PATH_MAX];
+            if (!getcwd(cwd, sizeof(cwd))) {
+                start = end + 1;
+                continue;
+            }
+            directory = std::string(cwd) + "/" + directory;
+        }
+        std::string candidate = directory + "/" + command;
+        if (isExecutableFile(candidate)) {
+            return candidate;
+        }
+        start = end + 1;
+    }
+    return {};
+}
+
+// The PATH search happens once per command name and PATH value rather than on every launch
+std::string findExecutable(const std::string& command, const char* pathOverride) {
+    if (command.find('/') != std::string::npos) {
+        return command;
+    }
+    const char* pathValue = pathOverride ? pathOverride : getenv("PATH");
+    std::string path = pathValue ? pathValue : "/usr/bin:/bin";
+
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::string> resolved;
+    std::string key = command + '\0' + path;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = resolved.find(key);
+    // Rechecked so an upgrade that moves git is noticed; misses are not cached
+    if (it != resolved.end() && isExecutableFile(it->second)) {
+        return it->second;
+    }
+    std::string found = searchPath(command, path);
+    if (!found.empty()) {
+        resolved[key] = found;
+    }
+    return found;
+}
+
+// A child that exits without reading all of its input must not take this process down with SIGPIPE
+ssize_t writeWithoutSigpipe(int fd, const char* data, size_t size) {
+#ifdef F_SETNOSIGPIPE
+    // Set on the descriptor when the pipe was opened
+    return write(fd, data, size);
+#else
+    sigset_t pipeSignal, previous, pending;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    sigpending(&pending);
+    bool wasPending = sigismember(&pending, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &previous);
+    ssize_t written = write(fd, data, size);
+    int error = errno;
+    if (written < 0 && error == EPIPE && !wasPending) {
+        // Take the signal this write raised off the thread before unblocking
+        timespec zero = {0, 0};
+        sigtimedwait(&pipeSignal, nullptr, &zero);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    errno = error;
+    return written;
+#endif
+}
+
+// Owns the pointer arrays posix_spawn takes; the strings themselves stay in the vectors they point into
+std::vector<char*> pointerArray(std::vector<std::string>& strings) {
+    std::vector<char*> pointers;
+    pointers.reserve(strings.size() + 1);
+    for (auto& string : strings) {
+        pointers.push_back(&string[0]);
+    }
+    pointers.push_back(nullptr);
+    return pointers;
+}
+
+// Starts executable on the given descriptors (-1 leaves that one inherited). The child gets default
+// signal handling whatever this process set up. 0, or the errno of the failed launch
+int launchProcess(const std::string& executable, char** argv, char** envp, const std::string& workingDirectory,
+                  int inputFd, int outputFd, int errorFd, pid_t& pid) {
+#ifdef VT_SPAWN_ADDCHDIR
+    // posix_spawn shares the parent's memory until the exec (vfork or CLONE_VM underneath), so the
+    // launch costs the same however large this process's heap is; fork copied its page tables
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    // dup2 clears close-on-exec on the new descriptors, the originals close with the exec
+    if (inputFd != -1) {
+        posix_spawn_file_actions_adddup2(&actions, inputFd, STDIN_FILENO);
+    }
+    if (outputFd != -1) {
+        posix_spawn_file_actions_adddup2(&actions, outputFd, STDOUT_FILENO);
+    }
+    if (errorFd != -1) {
+        posix_spawn_file_actions_adddup2(&actions, errorFd, STDERR_FILENO);
+    }
+    if (!workingDirectory.empty()) {
+        posix_spawn_file_actions_addchdir_np(&actions, workingDirectory.c_str());
+    }
+
+    // A GUI may ignore SIGPIPE or block signals on its threads; git gets the defaults
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attributes, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    int spawnError = posix_spawn(&pid, executable.c_str(), &actions, &attributes, argv, envp);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    return spawnError;
+#else
+    // No posix_spawn chdir here: fork, but with nothing left for the child except async-signal-safe calls
+    sigset_t signals;
+    sigemptyset(&signals);
+    pid = fork();
+    if (pid == 0) {
+        if (inputFd != -1) {
+            dup2(inputFd, STDIN_FILENO);
+        }
+        if (outputFd != -1) {
+            dup2(outputFd, STDOUT_FILENO);
+        }
+        if (errorFd != -1) {
+            dup2(errorFd, STDERR_FILENO);
+        }
+        signal(SIGPIPE, SIG_DFL);
+        sigprocmask(SIG_SETMASK, &signals, nullptr);
+        if (!workingDirectory.empty() && chdir(workingDirectory.c_str()) != 0) {
+            _exit(127);
+        }
+        execve(executable.c_str(), argv, envp);
+        _exit(127);
+    }
+    return pid == -1 ? errno : 0;
+#endif
+}
+#endif
+
+// Ties a run to the thread's current cancellation token for its duration
+class CancellationLink {
+  public:
+    explicit CancellationLink(SystemCommand& command)
+        : token(CancellationToken::current()), id(token.subscribe([&command]() { command.cancel(); })) {}
+    ~CancellationLink() { token.unsubscribe(id); }
+
+  private:
+    CancellationToken token;
+    uint64_t id;
+};
+
+} // namespace
+
 class SystemCommand::Impl {
   public:
     std::map<std::string, std::string> environmentVariables;
-    int timeoutMs = 30000; // 30 seconds default
-    bool cancelled = false;
+    int timeoutMs = 30000; // 30 seconds without output
+    OutputCallback errorCallback;
+    std::optional<std::string> input;  // For the child's stdin
+
+    std::chrono::steady_clock::time_point nextDeadline() const {
+        return timeoutMs > 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs)
+                             : std::chrono::steady_clock::time_point::max();
+    }
+    std::atomic<bool> cancelled{false};
+
+    // Filled in by the platform runs for the process span
+    bool tracing = false;
+    int64_t spawnUs = -1;        // Parent side of the launch, until posix_spawn returns
+    int64_t firstOutputUs = -1;  // Launch to the first byte on either pipe
+    int64_t pipeBytes[2] = {0, 0};
+    int64_t inputBytes = 0;
 
 #ifdef _WIN32
     HANDLE process = INVALID_HANDLE_VALUE;
     HANDLE thread = INVALID_HANDLE_VALUE;
 #else
-    pid_t childPid = -1;
+    std::atomic<pid_t> childPid{-1};
+    // Held by cancel() around its check and kill, and by reapChild() around the reap and the reset,
+    // so cancel() never signals a pid that has been reaped (and may already be reused)
+    std::mutex pidMutex;
+
+    // Waits for the child to exit and reaps it. The wait itself leaves the zombie in place (WNOWAIT),
+    // so it runs without the lock and cancel() can still reach a running child meanwhile.
+    int reapChild(pid_t pid) {
+        siginfo_t info;
+        while (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOWAIT) < 0 && errno == EINTR) {
+        }
+        std::lock_guard<std::mutex> lock(pidMutex);
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        childPid = -1;
+        return status;
+    }
 #endif
 
     std::string buildCommandLine(const std::string& command, const std::vector<std::string>& args) {
@@ -47,12 +405,77 @@ class SystemCommand::Impl {
         return cmdLine;
     }
 
+    // "git status" for `git -c a=b --no-optional-locks status ...`: the program and its first operand
+    static std::string processName(const std::string& command, const std::vector<std::string>& args) {
+        size_t slash = command.find_last_of("/\\");
+        std::string name = slash == std::string::npos ? command : command.substr(slash + 1);
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "-c" || args[i] == "-C") {
+                ++i;
+            } else if (!args[i].empty() && args[i][0] != '-') {
+                return name + " " + args[i];
+            }
+        }
+        return name;
+    }
+
+    void beginTrace(TraceScope& trace, const std::string& command, const std::vector<std::string>& args,
+                    const std::string& workingDirectory) {
+        tracing = trace.active();
+        spawnUs = -1;
+        firstOutputUs = -1;
+        pipeBytes[0] = pipeBytes[1] = 0;
+        inputBytes = 0;
+        if (tracing) {
+            trace.setName(processName(command, args));
+            trace.setDetail(buildCommandLine(command, args));
+            trace.setDirectory(workingDirectory);
+        }
+    }
+
+    void endTrace(TraceScope& trace, const SystemCommandResult& result) {
+        if (!tracing) {
+            return;
+        }
+        if (spawnUs >= 0) {
+            trace.count("spawn_us", spawnUs);
+        }
+        if (firstOutputUs >= 0) {
+            trace.count("first_output_us", firstOutputUs);
+        }
+        trace.count("stdout_bytes", pipeBytes[0]);
+        trace.count("stderr_bytes", pipeBytes[1]);
+        trace.count("bytes", pipeBytes[0] + pipeBytes[1]);
+        if (input) {
+            trace.count("stdin_bytes", inputBytes);
+        }
+        trace.count("exit_code", result.exitCode);
+    }
+
     std::vector<std::string> buildArgVector(const std::string& command, const std::vector<std::string>& args) {
         std::vector<std::string> argv;
         argv.push_back(command);
         argv.insert(argv.end(), args.begin(), args.end());
         return argv;
     }
+
+#ifndef _WIN32
+    // The parent's environment with the overrides applied, built before the launch so the child only execs
+    std::vector<std::string> buildEnvironment() const {
+        std::vector<std::string> envp;
+        for (char** entry = environ; entry && *entry; ++entry) {
+            std::string_view variable(*entry);
+            std::string_view name = variable.substr(0, variable.find('='));
+            if (environmentVariables.find(std::string(name)) == environmentVariables.end()) {
+                envp.emplace_back(variable);
+            }
+        }
+        for (const auto& [key, value] : environmentVariables) {
+            envp.push_back(key + "=" + value);
+        }
+        return envp;
+    }
+#endif
 };
 
 SystemCommand::SystemCommand() : pImpl(std::make_unique<Impl>()) {}
@@ -64,17 +487,26 @@ SystemCommand::~SystemCommand() {
 SystemCommandResult SystemCommand::execute(const std::string& command, const std::vector<std::string>& args,
                                            const std::string& workingDirectory) {
     pImpl->cancelled = false;
+    CancellationLink link(*this);
+    if (pImpl->cancelled) {
+        return {-1, "", "Command was cancelled"};
+    }
 
+    TraceScope trace("process", {});
+    pImpl->beginTrace(trace, command, args, workingDirectory);
 #ifdef _WIN32
-    return executeWindows(command, args, workingDirectory);
+    auto result = executeWindows(command, args, workingDirectory, nullptr);
 #else
-    return executeUnix(command, args, workingDirectory);
+    auto result = executeUnix(command, args, workingDirectory, nullptr);
 #endif
+    pImpl->endTrace(trace, result);
+    return result;
 }
 
 #ifdef _WIN32
 SystemCommandResult SystemCommand::executeWindows(const std::string& command, const std::vector<std::string>& args,
-                                                  const std::string& workingDirectory) {
+                                                  const std::string& workingDirectory,
+                                                  const OutputCallback& outputCallback) {
     SECURITY_ATTRIBUTES sa;
     sa.nLength = sizeof(SECURITY_ATTRIBUTES);
     sa.lpSecurityDescriptor = NULL;
@@ -83,8 +515,17 @@ SystemCommandResult SystemCommand::executeWindows(const std::string& command, co
     HANDLE hStdoutRead, hStdoutWrite;
     HANDLE hStderrRead, hStderrWrite;
 
-    // Create pipes for stdout and stderr
-    if (!CreatePipe(&hStdoutRead, &hStdoutWrite, &sa, 0) || !CreatePipe(&hStderrRead, &hStderrWrite, &sa, 0)) {
+    // Create pipes for stdout and stderr; only the inheritable write ends go to the child
+    if (!createOverlappedPipe(hStdoutRead, hStdoutWrite, &sa)) {
+        SystemCommandResult result;
+        result.exitCode = -1;
+        result.output = "";
+        result.error = "Failed to create pipes";
+        return result;
+    }
+    if (!createOverlappedPipe(hStderrRead, hStderrWrite, &sa)) {
+        CloseHandle(hStdoutRead);
+        CloseHandle(hStdoutWrite);
         SystemCommandResult result;
         result.exitCode = -1;
         result.output = "";
@@ -92,9 +533,26 @@ SystemCommandResult SystemCommand::executeWindows(const std::string& command, co
         return result;
     }
 
-    // Make sure the read handles are not inherited
-    SetHandleInformation(hStdoutRead, HANDLE_FLAG_INHERIT, 0);
-    SetHandleInformation(hStderrRead, HANDLE_FLAG_INHERIT, 0);
+    // With input the child reads a pipe whose write end stays here
+    HANDLE hStdinRead = INVALID_HANDLE_VALUE, hStdinWrite = INVALID_HANDLE_VALUE;
+    if (pImpl->input) {
+        if (!CreatePipe(&hStdinRead, &hStdinWrite, &sa, 0) ||
+            !SetHandleInformation(hStdinWrite, HANDLE_FLAG_INHERIT, 0)) {
+            if (hStdinRead != INVALID_HANDLE_VALUE) {
+                CloseHandle(hStdinRead);
+                CloseHandle(hStdinWrite);
+            }
+            CloseHandle(hStdoutRead);
+            CloseHandle(hStdoutWrite);
+            CloseHandle(hStderrRead);
+            CloseHandle(hStderrWrite);
+            SystemCommandResult result;
+            result.exitCode = -1;
+            result.output = "";
+            result.error = "Failed to create pipes";
+            return result;
+        }
+    }
 
     STARTUPINFO si;
     PROCESS_INFORMATION pi;
@@ -102,7 +560,7 @@ SystemCommandResult SystemCommand::executeWindows(const std::string& command, co
     si.cb = sizeof(si);
     si.hStdError = hStderrWrite;
     si.hStdOutput = hStdoutWrite;
-    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdInput = pImpl->input ? hStdinRead : GetStdHandle(STD_INPUT_HANDLE);
     si.dwFlags |= STARTF_USESTDHANDLES;
 
     std::string cmdLine = pImpl->buildCommandLine(command, args);
@@ -122,10 +580,16 @@ SystemCommandResult SystemCommand::executeWindows(const std::string& command, co
 
     CloseHandle(hStdoutWrite);
     CloseHandle(hStderrWrite);
+    if (hStdinRead != INVALID_HANDLE_VALUE) {
+        CloseHandle(hStdinRead);
+    }
 
     if (!success) {
         CloseHandle(hStdoutRead);
         CloseHandle(hStderrRead);
+        if (hStdinWrite != INVALID_HANDLE_VALUE) {
+            CloseHandle(hStdinWrite);
+        }
         SystemCommandResult result;
         result.exitCode = -1;
         result.output = "";
@@ -136,41 +600,121 @@ SystemCommandResult SystemCommand::executeWindows(const std::string& command, co
     pImpl->process = pi.hProcess;
     pImpl->thread = pi.hThread;
 
-    // Read output
+    // Anonymous pipes block, so the input goes from a thread of its own; it ends when the child
+    // has read everything or is gone
+    std::thread inputWriter;
+    if (hStdinWrite != INVALID_HANDLE_VALUE) {
+        inputWriter = std::thread([handle = hStdinWrite, &input = *pImpl->input, &written = pImpl->inputBytes]() {
+            while (static_cast<size_t>(written) < input.size()) {
+                DWORD chunk = static_cast<DWORD>(std::min<size_t>(input.size() - written, READ_CHUNK_SIZE));
+                DWORD count = 0;
+                if (!WriteFile(handle, input.data() + written, chunk, &count, NULL)) {
+                    break;
+                }
+                written += count;
+            }
+            CloseHandle(handle);
+        });
+    }
+
+    // Drain both pipes while waiting; a child blocked on a full pipe would otherwise never exit
     std::string output, error;
-    DWORD bytesRead;
-    char buffer[4096];
+    // Heap allocated: each reader carries a 64 KB buffer
+    auto readers = std::make_unique<OverlappedReader[]>(2);
+    readers[0].handle = hStdoutRead;
+    readers[0].sink = &output;
+    readers[0].callback = &outputCallback;
+    readers[1].handle = hStderrRead;
+    readers[1].sink = &error;
+    readers[1].callback = &pImpl->errorCallback;
+    for (int i = 0; i < 2; ++i) {
+        auto& reader = readers[i];
+        reader.overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        reader.open = reader.overlapped.hEvent != NULL;
+        if (reader.open) {
+            reader.start();
+        }
+    }
 
-    // Wait for process completion with timeout
-    DWORD waitResult = WaitForSingleObject(pi.hProcess, pImpl->timeoutMs);
+    auto deadline = pImpl->nextDeadline();
+    bool exited = false;
+    bool timedOut = false;
 
-    if (waitResult == WAIT_TIMEOUT || pImpl->cancelled) {
-        TerminateProcess(pi.hProcess, -1);
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-        CloseHandle(hStdoutRead);
-        CloseHandle(hStderrRead);
-        SystemCommandResult result;
-        result.exitCode = -1;
-        result.output = "";
-        result.error = "Process timed out or was cancelled";
-        return result;
+    while (readers[0].open || readers[1].open || !exited) {
+        if (pImpl->cancelled) {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            timedOut = true;
+            break;
+        }
+        auto remaining = deadline == std::chrono::steady_clock::time_point::max()
+                             ? std::chrono::milliseconds(INFINITE)
+                             : std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+
+        HANDLE handles[3];
+        OverlappedReader* owners[3] = {nullptr, nullptr, nullptr};
+        DWORD count = 0;
+        for (int i = 0; i < 2; ++i) {
+            auto& reader = readers[i];
+            if (reader.open) {
+                owners[count] = &reader;
+                handles[count++] = reader.overlapped.hEvent;
+            }
+        }
+        if (!exited) {
+            handles[count++] = pi.hProcess;
+        }
+
+        // After exit only collect what is already buffered; a grandchild may hold the pipes open
+        DWORD waitMs = exited ? 0 : static_cast<DWORD>(std::min<long long>(remaining.count(), INFINITE));
+        DWORD waitResult = WaitForMultipleObjects(count, handles, FALSE, waitMs);
+        if (waitResult == WAIT_TIMEOUT) {
+            if (exited) {
+                break;
+            }
+            continue;
+        }
+        if (waitResult == WAIT_FAILED || waitResult >= WAIT_OBJECT_0 + count) {
+            break;
+        }
+
+        DWORD index = waitResult - WAIT_OBJECT_0;
+        if (owners[index]) {
+            owners[index]->complete();
+            deadline = pImpl->nextDeadline();
+        } else {
+            exited = true;
+        }
     }
 
-    // Read stdout
-    while (ReadFile(hStdoutRead, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0) {
-        buffer[bytesRead] = '\0';
-        output += buffer;
+    bool aborted = timedOut || pImpl->cancelled;
+    if (aborted) {
+        TerminateProcess(pi.hProcess, -1);
     }
 
-    // Read stderr
-    while (ReadFile(hStderrRead, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0) {
-        buffer[bytesRead] = '\0';
-        error += buffer;
+    for (int i = 0; i < 2; ++i) {
+        auto& reader = readers[i];
+        if (reader.open) {
+            CancelIo(reader.handle);
+            DWORD ignored = 0;
+            GetOverlappedResult(reader.handle, &reader.overlapped, &ignored, TRUE);
+        }
+        if (reader.overlapped.hEvent) {
+            CloseHandle(reader.overlapped.hEvent);
+        }
     }
 
-    DWORD exitCode;
-    GetExitCodeProcess(pi.hProcess, &exitCode);
+    DWORD exitCode = static_cast<DWORD>(-1);
+    if (!aborted) {
+        WaitForSingleObject(pi.hProcess, INFINITE);
+        GetExitCodeProcess(pi.hProcess, &exitCode);
+    }
+    if (inputWriter.joinable()) {
+        inputWriter.join();
+    }
 
     CloseHandle(pi.hProcess);
     CloseHandle(pi.hThread);
@@ -181,6 +725,12 @@ SystemCommandResult SystemCommand::executeWindows(const std::string& command, co
     pImpl->thread = INVALID_HANDLE_VALUE;
 
     SystemCommandResult result;
+    if (aborted) {
+        result.exitCode = -1;
+        result.output = "";
+        result.error = "Process timed out or was cancelled";
+        return result;
+    }
     result.exitCode = static_cast<int>(exitCode);
     result.output = output;
     result.error = error;
@@ -190,19 +740,51 @@ SystemCommandResult SystemCommand::executeWindows(const std::string& command, co
 #else // Unix/Linux/macOS
 
 SystemCommandResult SystemCommand::executeUnix(const std::string& command, const std::vector<std::string>& args,
-                                               const std::string& workingDirectory) {
-    int pipeOut[2], pipeErr[2];
+                                               const std::string& workingDirectory,
+                                               const OutputCallback& outputCallback) {
+    // Everything the child needs is prepared here; the launch itself only execs
+    auto pathOverride = pImpl->environmentVariables.find("PATH");
+    std::string executable =
+        findExecutable(command, pathOverride == pImpl->environmentVariables.end() ? nullptr
+                                                                                   : pathOverride->second.c_str());
+    if (executable.empty()) {
+        SystemCommandResult result;
+        result.exitCode = -1;
+        result.output = "";
+        result.error = "Command not found: " + command;
+        return result;
+    }
 
-    if (pipe(pipeOut) == -1 || pipe(pipeErr) == -1) {
+    auto argvStrings = pImpl->buildArgVector(command, args);
+    auto argv = pointerArray(argvStrings);
+    std::vector<std::string> envpStrings;
+    std::vector<char*> envp;
+    if (!pImpl->environmentVariables.empty()) {
+        envpStrings = pImpl->buildEnvironment();
+        envp = pointerArray(envpStrings);
+    }
+    char** childEnvironment = envp.empty() ? environ : envp.data();
+
+    int pipeOut[2], pipeErr[2];
+    if (!openPipe(pipeOut)) {
         SystemCommandResult result;
         result.exitCode = -1;
         result.output = "";
         result.error = "Failed to create pipes";
         return result;
     }
-
-    pid_t pid = fork();
-    if (pid == -1) {
+    if (!openPipe(pipeErr)) {
+        close(pipeOut[0]);
+        close(pipeOut[1]);
+        SystemCommandResult result;
+        result.exitCode = -1;
+        result.output = "";
+        result.error = "Failed to create pipes";
+        return result;
+    }
+    // With input the child reads a pipe the loop below writes as it drains the output
+    int pipeIn[2] = {-1, -1};
+    if (pImpl->input && !openPipe(pipeIn)) {
         close(pipeOut[0]);
         close(pipeOut[1]);
         close(pipeErr[0]);
@@ -210,74 +792,131 @@ SystemCommandResult SystemCommand::executeUnix(const std::string& command, const
         SystemCommandResult result;
         result.exitCode = -1;
         result.output = "";
-        result.error = "Failed to fork process";
+        result.error = "Failed to create pipes";
         return result;
     }
 
-    if (pid == 0) {
-        // Child process
-        close(pipeOut[0]);
-        close(pipeErr[0]);
+    auto launched = pImpl->tracing ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    auto microsecondsSinceLaunch = [&launched]() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - launched)
+            .count();
+    };
 
-        dup2(pipeOut[1], STDOUT_FILENO);
-        dup2(pipeErr[1], STDERR_FILENO);
+    pid_t pid = -1;
+    int spawnError = launchProcess(executable, argv.data(), childEnvironment, workingDirectory, pipeIn[0],
+                                   pipeOut[1], pipeErr[1], pid);
 
+    if (spawnError != 0) {
+        close(pipeOut[0]);
         close(pipeOut[1]);
+        close(pipeErr[0]);
         close(pipeErr[1]);
-
-        // Change working directory if specified
-        if (!workingDirectory.empty()) {
-            if (chdir(workingDirectory.c_str()) != 0) {
-                exit(EXIT_FAILURE);
-            }
-        }
-
-        // Set environment variables
-        for (const auto& [key, value] : pImpl->environmentVariables) {
-            setenv(key.c_str(), value.c_str(), 1);
-        }
-
-        // Prepare arguments
-        auto argv = pImpl->buildArgVector(command, args);
-        std::vector<char*> cArgs;
-        for (const auto& arg : argv) {
-            cArgs.push_back(const_cast<char*>(arg.c_str()));
+        if (pipeIn[0] != -1) {
+            close(pipeIn[0]);
+            close(pipeIn[1]);
         }
-        cArgs.push_back(nullptr);
-
-        execvp(command.c_str(), cArgs.data());
-        exit(EXIT_FAILURE);
+        SystemCommandResult result;
+        result.exitCode = -1;
+        result.output = "";
+        result.error = "Failed to start " + command + ": " + strerror(spawnError);
+        return result;
     }
 
     // Parent process
+    if (pImpl->tracing) {
+        pImpl->spawnUs = microsecondsSinceLaunch();
+    }
     pImpl->childPid = pid;
     close(pipeOut[1]);
     close(pipeErr[1]);
 
-    // Set non-blocking mode for reading
+    // Non-blocking so that each wakeup can drain a pipe completely, or fill the input pipe
     fcntl(pipeOut[0], F_SETFL, O_NONBLOCK);
     fcntl(pipeErr[0], F_SETFL, O_NONBLOCK);
+    int inputFd = pipeIn[1];
+    if (inputFd != -1) {
+        close(pipeIn[0]);
+        fcntl(inputFd, F_SETFL, O_NONBLOCK);
+#ifdef F_SETNOSIGPIPE
+        fcntl(inputFd, F_SETNOSIGPIPE, 1);
+#endif
+    }
 
-    std::string output, error;
-    char buffer[4096];
+    // Readable when the child exits, even if a grandchild still holds the pipes open
+    int exitFd = openExitFd(pid);
 
-    auto startTime = std::chrono::steady_clock::now();
-    auto timeout = std::chrono::milliseconds(pImpl->timeoutMs);
+    std::string output, error;
+    std::vector<char> buffer(READ_CHUNK_SIZE);
+    int fds[2] = {pipeOut[0], pipeErr[0]};
+    std::string* sinks[2] = {&output, &error};
+    bool exited = false;
+    int status = 0;
+
+    auto deadline = pImpl->nextDeadline();
+
+    auto closePipes = [&]() {
+        for (int& fd : fds) {
+            if (fd != -1) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (inputFd != -1) {
+            close(inputFd);
+            inputFd = -1;
+        }
+        if (exitFd != -1) {
+            close(exitFd);
+            exitFd = -1;
+        }
+    };
+
+    // As much of the input as the pipe takes; closed once all of it is written or the child stops reading
+    auto writeInput = [&]() {
+        const std::string& input = *pImpl->input;
+        while (static_cast<size_t>(pImpl->inputBytes) < input.size()) {
+            ssize_t written = writeWithoutSigpipe(inputFd, input.data() + pImpl->inputBytes,
+                                                  input.size() - pImpl->inputBytes);
+            if (written > 0) {
+                pImpl->inputBytes += written;
+                deadline = pImpl->nextDeadline();
+                continue;
+            }
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                return;
+            }
+            break;
+        }
+        close(inputFd);
+        inputFd = -1;
+    };
+    if (inputFd != -1) {
+        writeInput();
+    }
 
-    while (true) {
+    while (fds[0] != -1 || fds[1] != -1 || !exited) {
         if (pImpl->cancelled) {
-            kill(pid, SIGTERM);
-            break;
+            // Once reaped the pid is no longer ours to signal
+            if (!exited) {
+                kill(pid, SIGTERM);
+                pImpl->reapChild(pid);
+            }
+            closePipes();
+            SystemCommandResult result;
+            result.exitCode = -1;
+            result.output = output;
+            result.error = error;
+            return result;
         }
 
-        // Check timeout
-        auto elapsed = std::chrono::steady_clock::now() - startTime;
-        if (elapsed > timeout) {
-            kill(pid, SIGTERM);
-            waitpid(pid, nullptr, 0); // Clean up zombie
-            close(pipeOut[0]);
-            close(pipeErr[0]);
-            pImpl->childPid = -1;
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            // Once reaped the pid is no longer ours to signal
+            if (!exited) {
+                kill(pid, SIGTERM);
+                pImpl->reapChild(pid); // Clean up zombie
+            }
+            closePipes();
             SystemCommandResult result;
             result.exitCode = -1;
             result.output = "";
@@ -285,55 +924,110 @@ SystemCommandResult SystemCommand::executeUnix(const std::string& command, const
             return result;
         }
 
-        // Check if process is still running
-        int status;
-        pid_t result = waitpid(pid, &status, WNOHANG);
-
-        // Read from pipes
-        ssize_t bytesRead;
-        while ((bytesRead = read(pipeOut[0], buffer, sizeof(buffer))) > 0) {
-            output.append(buffer, bytesRead);
+        if (fds[0] == -1 && fds[1] == -1 && exitFd == -1 && inputFd == -1) {
+            // Both pipes hit EOF and there is no exit descriptor to wait on: the child is exiting
+            status = pImpl->reapChild(pid);
+            exited = true;
+            break;
         }
 
-        while ((bytesRead = read(pipeErr[0], buffer, sizeof(buffer))) > 0) {
-            error.append(buffer, bytesRead);
+        if (exited && inputFd != -1) {
+            close(inputFd);
+            inputFd = -1;
         }
-
-        if (result == pid) {
-            // Process has finished
-            // Final read to get any remaining output
-            ssize_t bytesRead;
-            while ((bytesRead = read(pipeOut[0], buffer, sizeof(buffer))) > 0) {
-                output.append(buffer, bytesRead);
+        pollfd pollFds[4];
+        nfds_t count = 0;
+        for (int fd : fds) {
+            if (fd != -1) {
+                pollFds[count++] = {fd, POLLIN, 0};
             }
+        }
+        if (exitFd != -1 && !exited) {
+            pollFds[count++] = {exitFd, POLLIN, 0};
+        }
+        if (inputFd != -1) {
+            pollFds[count++] = {inputFd, POLLOUT, 0};
+        }
 
-            while ((bytesRead = read(pipeErr[0], buffer, sizeof(buffer))) > 0) {
-                error.append(buffer, bytesRead);
+        // Once the child is gone only drain what is already buffered, a grandchild may keep the pipes
+        // open. The exit descriptor reports that exit; without one it is checked for every slice.
+        int waitMs = -1;
+        if (exited) {
+            waitMs = 0;
+        } else if (deadline != std::chrono::steady_clock::time_point::max()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+            waitMs = static_cast<int>(std::min<long long>(remaining.count() + 1, INT_MAX));
+        }
+        if (exitFd == -1 && !exited && (waitMs < 0 || waitMs > EXIT_CHECK_INTERVAL_MS)) {
+            waitMs = EXIT_CHECK_INTERVAL_MS;
+        }
+        int ready = poll(pollFds, count, waitMs);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            break;
+        }
+        if (ready == 0 && exited) {
+            break;
+        }
+        if (exitFd == -1 && !exited && childHasExited(pid)) {
+            status = pImpl->reapChild(pid);
+            exited = true;
+        }
 
-            close(pipeOut[0]);
-            close(pipeErr[0]);
+        for (nfds_t i = 0; i < count; ++i) {
+            if (pollFds[i].revents == 0) {
+                continue;
+            }
 
-            pImpl->childPid = -1;
+            if (pollFds[i].fd == exitFd) {
+                status = pImpl->reapChild(pid);
+                exited = true;
+                continue;
+            }
+            if (pollFds[i].fd == inputFd) {
+                writeInput();
+                continue;
+            }
 
-            int exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-            SystemCommandResult result;
-            result.exitCode = exitCode;
-            result.output = output;
-            result.error = error;
-            return result;
+            int slot = pollFds[i].fd == fds[0] ? 0 : 1;
+            while (true) {
+                ssize_t bytesRead = read(fds[slot], buffer.data(), buffer.size());
+                if (bytesRead > 0) {
+                    deadline = pImpl->nextDeadline();
+                    pImpl->pipeBytes[slot] += bytesRead;
+                    if (pImpl->tracing && pImpl->firstOutputUs < 0) {
+                        pImpl->firstOutputUs = microsecondsSinceLaunch();
+                    }
+                    if (slot == 0 && outputCallback) {
+                        outputCallback(std::string(buffer.data(), bytesRead));
+                    } else if (slot == 1 && pImpl->errorCallback) {
+                        pImpl->errorCallback(std::string(buffer.data(), bytesRead));
+                    } else {
+                        sinks[slot]->append(buffer.data(), bytesRead);
+                    }
+                    continue;
+                }
+                if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                    break;
+                }
+                // EOF or hard error
+                close(fds[slot]);
+                fds[slot] = -1;
+                break;
+            }
         }
+    }
 
-        // Small delay to prevent busy waiting
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (!exited) {
+        status = pImpl->reapChild(pid);
     }
+    closePipes();
 
-    // Should not reach here, but handle cleanup if it does
-    close(pipeOut[0]);
-    close(pipeErr[0]);
-    pImpl->childPid = -1;
+    int exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
     SystemCommandResult result;
-    result.exitCode = -1;
+    result.exitCode = exitCode;
     result.output = output;
     result.error = error;
     return result;
@@ -343,27 +1037,21 @@ SystemCommandResult SystemCommand::executeUnix(const std::string& command, const
 SystemCommandResult SystemCommand::executeWithCallback(const std::string& command, const std::vector<std::string>& args,
                                                        OutputCallback outputCallback,
                                                        const std::string& workingDirectory) {
-    // For now, execute normally and call callback with full output
-    // TODO: Implement real-time streaming
-    auto result = execute(command, args, workingDirectory);
-    if (outputCallback) {
-        outputCallback(result.output);
-        if (!result.error.empty()) {
-            outputCallback(result.error);
-        }
+    pImpl->cancelled = false;
+    CancellationLink link(*this);
+    if (pImpl->cancelled) {
+        return {-1, "", "Command was cancelled"};
     }
-    return result;
-}
 
-void SystemCommand::executeAsync(const std::string& command, const std::vector<std::string>& args,
-                                 std::function<void(const SystemCommandResult&)> callback,
-                                 const std::string& workingDirectory) {
-    std::thread([this, command, args, callback, workingDirectory]() {
-        auto result = execute(command, args, workingDirectory);
-        if (callback) {
-            callback(result);
-        }
-    }).detach();
+    TraceScope trace("process", {});
+    pImpl->beginTrace(trace, command, args, workingDirectory);
+#ifdef _WIN32
+    auto result = executeWindows(command, args, workingDirectory, outputCallback);
+#else
+    auto result = executeUnix(command, args, workingDirectory, outputCallback);
+#endif
+    pImpl->endTrace(trace, result);
+    return result;
 }
 
 void SystemCommand::cancel() {
@@ -374,8 +1062,11 @@ void SystemCommand::cancel() {
         TerminateProcess(pImpl->process, -1);
     }
 #else
-    if (pImpl->childPid != -1) {
-        kill(pImpl->childPid, SIGTERM);
+    // Read once: the worker thread may reap the child at any time, and kill(-1) would signal every process
+    std::lock_guard<std::mutex> lock(pImpl->pidMutex);
+    pid_t pid = pImpl->childPid.load();
+    if (pid > 0) {
+        kill(pid, SIGTERM);
     }
 #endif
 }
@@ -392,20 +1083,57 @@ void SystemCommand::setTimeout(int timeoutMs) {
     pImpl->timeoutMs = timeoutMs;
 }
 
+void SystemCommand::setErrorCallback(OutputCallback errorCallback) {
+    pImpl->errorCallback = std::move(errorCallback);
+}
+
+void SystemCommand::setInput(std::string input) {
+    pImpl->input = std::move(input);
+}
+
 bool SystemCommand::isCommandAvailable(const std::string& command) {
 #ifdef _WIN32
-    std::string cmd = "where " + command + " >nul 2>&1";
-    return system(cmd.c_str()) == 0;
+    char found[MAX_PATH];
+    return SearchPathA(NULL, command.c_str(), ".exe", MAX_PATH, found, NULL) > 0;
 #else
-    std::string cmd = "command -v " + command + " >/dev/null 2>&1";
-    return system(cmd.c_str()) == 0;
+    return !findExecutable(command, nullptr).empty();
 #endif
 }
 
+#ifndef _WIN32
+int SystemCommand::spawn(const std::string& command, const std::vector<std::string>& args,
+                         const std::string& workingDirectory, int inputFd, int outputFd, int errorFd) {
+    std::string executable = findExecutable(command, nullptr);
+    if (executable.empty()) {
+        errno = ENOENT;
+        return -1;
+    }
+    std::vector<std::string> argvStrings = {command};
+    argvStrings.insert(argvStrings.end(), args.begin(), args.end());
+    auto argv = pointerArray(argvStrings);
+
+    pid_t pid = -1;
+    int spawnError = launchProcess(executable, argv.data(), environ, workingDirectory, inputFd, outputFd, errorFd, pid);
+    if (spawnError != 0) {
+        errno = spawnError;
+        return -1;
+    }
+    return pid;
+}
+#endif
+
 std::string SystemCommand::getGitCommand() {
+#ifndef _WIN32
+    // Resolved once per PATH, like every launch
+    std::string resolved = findExecutable("git", nullptr);
+    if (!resolved.empty()) {
+        return resolved;
+    }
+#else
     if (isCommandAvailable("git")) {
         return "git";
     }
+#endif
 
 #ifdef _WIN32
     // Try common Git installation paths on Windows
@@ -26,18 +26,14 @@ public:
                                const std::vector<std::string>& args = {},
                                const std::string& workingDirectory = "");
     
-    // Execute command with real-time output callback
+    // Execute command with real-time output callback. stdout is handed to the
+    // callback chunk by chunk as it is read and is not kept in the result;
+    // stderr is still collected into result.error.
     SystemCommandResult executeWithCallback(const std::string& command,
                                            const std::vector<std::string>& args,
                                            OutputCallback outputCallback,
                                            const std::string& workingDirectory = "");
     
-    // Execute command asynchronously
-    void executeAsync(const std::string& command,
-                     const std::vector<std::string>& args,
-                     std::function<void(const SystemCommandResult&)> callback,
-                     const std::string& workingDirectory = "");
-    
     // Cancel running command
     void cancel();
     
@@ -45,14 +41,34 @@ public:
     void setEnvironmentVariable(const std::string& name, const std::string& value);
     void clearEnvironmentVariables();
     
-    // Set timeout (in milliseconds)
+    // Kill the command after timeoutMs without any output on stdout or stderr;
+    // every chunk read restarts the clock. <= 0 disables the timeout.
     void setTimeout(int timeoutMs);
+
+    // Hand stderr to the callback chunk by chunk instead of collecting it into
+    // result.error (git writes its progress meters there)
+    void setErrorCallback(OutputCallback errorCallback);
+
+    // Write input to the child's stdin, then close it, while reading its
+    // output, so neither side blocks on a full pipe; git reads pathspecs and
+    // patches this way (`--pathspec-from-file=-`, `apply -`). Without it the
+    // child inherits this process's stdin.
+    void setInput(std::string input);
     
-    // Check if command is available
+    // Check if command is available on PATH (no shell is started)
     static bool isCommandAvailable(const std::string& command);
     
-    // Get system command for git
+    // Get system command for git: the resolved path on Unix, cached the way every launch resolves it
     static std::string getGitCommand();
+
+#ifndef _WIN32
+    // Starts command the way execute() does (the cached PATH lookup, posix_spawn, default signal
+    // handling in the child) on the caller's descriptors, -1 leaving one inherited; for children that
+    // outlive a single call, such as GitObjectReader's cat-file. The caller reaps it. The pid, or -1
+    // with errno set
+    static int spawn(const std::string& command, const std::vector<std::string>& args,
+                     const std::string& workingDirectory, int inputFd, int outputFd, int errorFd);
+#endif
     
 private:
     class Impl;
@@ -61,11 +77,13 @@ private:
 #ifdef _WIN32
     SystemCommandResult executeWindows(const std::string& command,
                                        const std::vector<std::string>& args,
-                                       const std::string& workingDirectory);
+                                       const std::string& workingDirectory,
+                                       const OutputCallback& outputCallback);
 #else
     SystemCommandResult executeUnix(const std::string& command,
                                     const std::vector<std::string>& args,
-                                    const std::string& workingDirectory);
+                                    const std::string& workingDirectory,
+                                    const OutputCallback& outputCallback);
 #endif
 };
 
@@ -0,0 +1,266 @@
+#pragma once
+
+#include "CancellationToken.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define VERSIONTOOLS_TASK_COROUTINES 1
+#endif
+
+namespace VersionTools {
+
+// Where a continuation runs: posts the function to the Qt event loop, the
+// main dispatch queue, a scheduler lane... An executor whose loop is gone may
+// drop the function instead of running it.
+using Executor = std::function<void(std::function<void()>)>;
+
+// Error of a task dropped before its work started, e.g. by CommandScheduler::cancelAll()
+class TaskCancelled : public std::runtime_error {
+public:
+    TaskCancelled() : std::runtime_error("Cancelled") {}
+};
+
+// Runs the continuation right away, on the thread that finished the task
+inline Executor inlineExecutor() {
+    return [](std::function<void()> work) { work(); };
+}
+
+template <typename T>
+class Task;
+template <typename T>
+class TaskSource;
+
+namespace detail {
+
+struct TaskVoid {};
+
+template <typename T>
+struct TaskCallback {
+    using type = std::function<void(const T&)>;
+};
+
+template <>
+struct TaskCallback<void> {
+    using type = std::function<void()>;
+};
+
+template <typename T>
+struct TaskState {
+    using Value = std::conditional_t<std::is_void_v<T>, TaskVoid, T>;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+    std::optional<Value> value;
+    std::exception_ptr error;
+    std::function<void()> continuation;
+    CancellationToken token;
+
+    // The first completion wins; later ones are ignored
+    void complete(std::optional<Value> result, std::exception_ptr exception) {
+        std::function<void()> next;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (done) {
+                return;
+            }
+            value = std::move(result);
+            error = std::move(exception);
+            done = true;
+            next = std::move(continuation);
+        }
+        finished.notify_all();
+        if (next) {
+            next();
+        }
+    }
+
+    // Runs next on the completing thread, or right away when already done
+    void setContinuation(std::function<void()> next) {
+        if (!tryContinuation(next)) {
+            next();
+        }
+    }
+
+    // False, leaving next alone, when already done
+    bool tryContinuation(std::function<void()>& next) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (done) {
+            return false;
+        }
+        continuation = std::move(next);
+        return true;
+    }
+
+    bool isDone() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return done;
+    }
+};
+
+template <typename T>
+struct TaskPromiseBase;
+template <typename T>
+struct TaskPromise;
+
+}
+
+// Result of an operation running elsewhere, handed to a continuation instead
+// of a thread blocked in std::future::get(). then() delivers it on an
+// executor of the caller's choice; with C++20 a coroutine can co_await the
+// task, or task.on(executor) to resume on that executor, and a coroutine can
+// itself return a Task.
+//
+// Copies refer to the same operation. cancel() cancels the token the
+// operation runs under: its running git process is killed, and GitManager
+// operations then report GitCommandResult::Cancelled in their result.
+template <typename T>
+class Task {
+public:
+    using Callback = typename detail::TaskCallback<T>::type;
+    using ErrorCallback = std::function<void(std::exception_ptr)>;
+
+    Task() = default;
+
+    bool isValid() const { return state != nullptr; }
+    bool isReady() const { return state->isDone(); }
+
+    // One continuation per task. onResult gets the result on the executor;
+    // when the work threw, onError gets the exception instead (dropped when
+    // there is no onError).
+    void then(Executor executor, Callback onResult, ErrorCallback onError = nullptr) const {
+        state->setContinuation([state = state, executor = std::move(executor), onResult = std::move(onResult),
+                                onError = std::move(onError)]() {
+            executor([state, onResult, onError]() {
+                if (state->error) {
+                    if (onError) {
+                        onError(state->error);
+                    }
+                } else if (onResult) {
+                    if constexpr (std::is_void_v<T>) {
+                        onResult();
+                    } else {
+                        onResult(*state->value);
+                    }
+                }
+            });
+        });
+    }
+
+    void cancel() const { state->token.cancel(); }
+    CancellationToken token() const { return state->token; }
+
+    // Blocking, for callers without an event loop. Like the scheduler's
+    // futures, never from a task on the scheduler that runs this one.
+    void wait() const {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [this] { return state->done; });
+    }
+    // Rethrows what the work threw
+    T get() const {
+        wait();
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return *state->value;
+        }
+    }
+
+#ifdef VERSIONTOOLS_TASK_COROUTINES
+    using promise_type = detail::TaskPromise<T>;
+
+    class Awaiter {
+    public:
+        bool await_ready() const { return state->isDone(); }
+        // Not suspended when the task finished since await_ready()
+        bool await_suspend(std::coroutine_handle<> handle) const {
+            std::function<void()> resume = [executor = executor, handle]() {
+                executor([handle]() { handle.resume(); });
+            };
+            return state->tryContinuation(resume);
+        }
+        T await_resume() const { return Task(state).get(); }
+
+    private:
+        friend class Task;
+        Awaiter(std::shared_ptr<detail::TaskState<T>> state, Executor executor)
+            : state(std::move(state)), executor(std::move(executor)) {}
+
+        std::shared_ptr<detail::TaskState<T>> state;
+        Executor executor;
+    };
+
+    // Resumes on the thread that finished the task
+    Awaiter operator co_await() const { return Awaiter(state, inlineExecutor()); }
+    Awaiter on(Executor executor) const { return Awaiter(state, std::move(executor)); }
+#endif
+
+private:
+    friend class TaskSource<T>;
+    friend struct detail::TaskPromiseBase<T>;
+
+    explicit Task(std::shared_ptr<detail::TaskState<T>> state) : state(std::move(state)) {}
+
+    std::shared_ptr<detail::TaskState<T>> state;
+};
+
+// Completing side of a Task, kept by whoever runs the work. Copies complete
+// the same task; only the first completion counts.
+template <typename T>
+class TaskSource {
+public:
+    explicit TaskSource(CancellationToken token = {}) : state(std::make_shared<detail::TaskState<T>>()) {
+        state->token = std::move(token);
+    }
+
+    Task<T> task() const { return Task<T>(state); }
+    const CancellationToken& token() const { return state->token; }
+
+    template <typename... Args>
+    void setValue(Args&&... args) const {
+        state->complete(typename detail::TaskState<T>::Value(std::forward<Args>(args)...), nullptr);
+    }
+    void setException(std::exception_ptr error) const { state->complete(std::nullopt, std::move(error)); }
+
+private:
+    std::shared_ptr<detail::TaskState<T>> state;
+};
+
+#ifdef VERSIONTOOLS_TASK_COROUTINES
+namespace detail {
+
+// Coroutines returning a Task start at once and complete it on co_return
+template <typename T>
+struct TaskPromiseBase {
+    std::shared_ptr<TaskState<T>> state = std::make_shared<TaskState<T>>();
+
+    Task<T> get_return_object() { return Task<T>(state); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void unhandled_exception() { state->complete(std::nullopt, std::current_exception()); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase<T> {
+    void return_value(T value) { this->state->complete(std::move(value), nullptr); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase<void> {
+    void return_void() { state->complete(TaskVoid{}, nullptr); }
+};
+
+}
+#endif
+
+}
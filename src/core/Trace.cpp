@@ -0,0 +1,396 @@
+#include "Trace.h"
+#include "GitUtils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+
+namespace VersionTools {
+
+namespace {
+
+constexpr size_t DEFAULT_CAPACITY = 100000;
+
+// Plain integers only: operator new may run before or after any dynamic initialisation
+thread_local uint64_t allocationCount = 0;
+thread_local uint32_t threadSlot = 0;
+std::atomic<uint32_t> nextThreadSlot{0};
+
+void appendJsonString(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+std::string formatMilliseconds(int64_t microseconds) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.1f ms", static_cast<double>(microseconds) / 1000.0);
+    return text;
+}
+
+}
+
+int64_t TraceSpan::counter(std::string_view counterName) const {
+    for (const auto& [key, value] : counters) {
+        if (counterName == key) {
+            return value;
+        }
+    }
+    return 0;
+}
+
+std::string TraceSpan::summary() const {
+    std::string text = detail.empty() ? name : detail;
+    text += ": " + formatMilliseconds(duration.count());
+    for (const auto& [key, value] : counters) {
+        std::string_view counterName = key;
+        if (counterName == "spawn_us") {
+            text += ", spawn " + formatMilliseconds(value);
+        } else if (counterName == "bytes") {
+            text += ", " + GitUtils::formatFileSize(static_cast<size_t>(value));
+        } else if (counterName == "allocations") {
+            text += ", " + std::to_string(value) + " allocations";
+        } else if (counterName == "exit_code" && value != 0) {
+            text += ", exit " + std::to_string(value);
+        }
+    }
+    return text;
+}
+
+class Tracer::Impl {
+public:
+    mutable std::mutex mutex;
+    std::deque<TraceSpan> spans;
+    size_t capacity = DEFAULT_CAPACITY;
+    std::vector<std::pair<uint64_t, std::shared_ptr<std::function<void(const TraceSpan&)>>>> listeners;
+    std::map<std::pair<std::string, std::string>, TraceMetric> milestones;
+    uint64_t nextListenerId = 1;
+};
+
+Tracer::Tracer() : epoch(std::chrono::steady_clock::now()), pImpl(std::make_unique<Impl>()) {}
+
+Tracer::~Tracer() = default;
+
+Tracer& Tracer::shared() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::setEnabled(bool value) {
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+void Tracer::setCapacity(size_t spans) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->capacity = std::max<size_t>(spans, 1);
+    while (pImpl->spans.size() > pImpl->capacity) {
+        pImpl->spans.pop_front();
+    }
+}
+
+void Tracer::record(TraceSpan span) {
+    std::vector<std::shared_ptr<std::function<void(const TraceSpan&)>>> listeners;
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        for (const auto& entry : pImpl->listeners) {
+            listeners.push_back(entry.second);
+        }
+        if (pImpl->spans.size() >= pImpl->capacity) {
+            pImpl->spans.pop_front();
+        }
+        pImpl->spans.push_back(std::move(span));
+        if (listeners.empty()) {
+            return;
+        }
+        span = pImpl->spans.back();
+    }
+
+    for (const auto& listener : listeners) {
+        try {
+            (*listener)(span);
+        } catch (...) {
+        }
+    }
+}
+
+void Tracer::recordInterval(const char* category, std::string_view name,
+                            std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    if (!isEnabled()) {
+        return;
+    }
+    TraceSpan span;
+    span.category = category;
+    span.name = name;
+    span.start = sinceStart(begin);
+    span.duration = std::chrono::duration_cast<std::chrono::microseconds>(end - begin);
+    span.thread = threadNumber();
+    record(std::move(span));
+}
+
+void Tracer::recordMilestone(const char* category, std::string_view name,
+                             std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - begin);
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        auto& milestone = pImpl->milestones[{category, std::string(name)}];
+        ++milestone.count;
+        milestone.total += duration;
+        milestone.max = std::max(milestone.max, duration);
+        milestone.last = duration;
+    }
+    recordInterval(category, name, begin, end);
+}
+
+std::vector<TraceMetric> Tracer::milestones() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    std::vector<TraceMetric> milestones;
+    milestones.reserve(pImpl->milestones.size());
+    for (const auto& [key, milestone] : pImpl->milestones) {
+        milestones.push_back(milestone);
+        milestones.back().category = key.first;
+        milestones.back().name = key.second;
+    }
+    return milestones;
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    pImpl->spans.clear();
+}
+
+std::vector<TraceSpan> Tracer::spans() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    return {pImpl->spans.begin(), pImpl->spans.end()};
+}
+
+std::vector<TraceMetric> Tracer::metrics() const {
+    std::map<std::pair<std::string, std::string>, TraceMetric> byName;
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        for (const auto& span : pImpl->spans) {
+            auto& metric = byName[{span.category, span.name}];
+            ++metric.count;
+            metric.total += span.duration;
+            metric.max = std::max(metric.max, span.duration);
+            metric.last = span.duration;
+            for (const auto& [key, value] : span.counters) {
+                metric.counters[key] += value;
+            }
+        }
+    }
+
+    std::vector<TraceMetric> metrics;
+    metrics.reserve(byName.size());
+    for (auto& [key, metric] : byName) {
+        metric.category = key.first;
+        metric.name = key.second;
+        metrics.push_back(std::move(metric));
+    }
+    std::sort(metrics.begin(), metrics.end(),
+              [](const TraceMetric& a, const TraceMetric& b) { return a.total > b.total; });
+    return metrics;
+}
+
+std::string Tracer::chromeTrace() const {
+    auto recorded = spans();
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& span : recorded) {
+        out += first ? "\n" : ",\n";
+        first = false;
+
+        // Complete events; nesting on one thread shows parse work around the process it reads from
+        out += "{\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(span.thread);
+        out += ",\"ts\":" + std::to_string(span.start.count());
+        out += ",\"dur\":" + std::to_string(span.duration.count());
+        out += ",\"cat\":";
+        appendJsonString(out, span.category);
+        out += ",\"name\":";
+        appendJsonString(out, span.name);
+        out += ",\"args\":{";
+        bool firstArg = true;
+        auto separator = [&]() {
+            if (!firstArg) {
+                out += ',';
+            }
+            firstArg = false;
+        };
+        if (!span.detail.empty()) {
+            separator();
+            out += "\"detail\":";
+            appendJsonString(out, span.detail);
+        }
+        if (!span.directory.empty()) {
+            separator();
+            out += "\"directory\":";
+            appendJsonString(out, span.directory);
+        }
+        for (const auto& [key, value] : span.counters) {
+            separator();
+            appendJsonString(out, key);
+            out += ':' + std::to_string(value);
+        }
+        out += "}}";
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Tracer::writeChromeTrace(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file << chromeTrace();
+    return static_cast<bool>(file);
+}
+
+uint64_t Tracer::subscribe(std::function<void(const TraceSpan& span)> listener) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    uint64_t id = pImpl->nextListenerId++;
+    pImpl->listeners.emplace_back(id, std::make_shared<std::function<void(const TraceSpan&)>>(std::move(listener)));
+    return id;
+}
+
+void Tracer::unsubscribe(uint64_t id) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    auto& listeners = pImpl->listeners;
+    listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+                                   [id](const auto& entry) { return entry.first == id; }),
+                    listeners.end());
+}
+
+uint64_t Tracer::threadAllocations() {
+    return allocationCount;
+}
+
+uint32_t Tracer::threadNumber() {
+    if (threadSlot == 0) {
+        threadSlot = ++nextThreadSlot;
+    }
+    return threadSlot;
+}
+
+std::chrono::microseconds Tracer::sinceStart(std::chrono::steady_clock::time_point at) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(at - epoch);
+}
+
+TraceScope::TraceScope(const char* category, std::string_view name) {
+    if (!Tracer::shared().isEnabled()) {
+        return;
+    }
+    span = std::make_unique<TraceSpan>();
+    span->category = category;
+    span->name = name;
+    allocationsAtStart = Tracer::threadAllocations();
+    begin = std::chrono::steady_clock::now();
+}
+
+TraceScope::~TraceScope() {
+    if (!span) {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    Tracer& tracer = Tracer::shared();
+    span->start = tracer.sinceStart(begin);
+    span->duration = std::chrono::duration_cast<std::chrono::microseconds>(end - begin);
+    span->thread = Tracer::threadNumber();
+#ifdef VT_TRACE_ALLOCATIONS
+    count("allocations", static_cast<int64_t>(Tracer::threadAllocations() - allocationsAtStart));
+#endif
+    tracer.record(std::move(*span));
+}
+
+void TraceScope::setName(std::string name) {
+    if (span) {
+        span->name = std::move(name);
+    }
+}
+
+void TraceScope::setDetail(std::string detail) {
+    if (span) {
+        span->detail = std::move(detail);
+    }
+}
+
+void TraceScope::setDirectory(std::string directory) {
+    if (span) {
+        span->directory = std::move(directory);
+    }
+}
+
+void TraceScope::count(const char* counter, int64_t value) {
+    if (!span) {
+        return;
+    }
+    for (auto& [key, total] : span->counters) {
+        if (std::string_view(key) == counter) {
+            total += value;
+            return;
+        }
+    }
+    span->counters.emplace_back(counter, value);
+}
+
+}
+
+#ifdef VT_TRACE_ALLOCATIONS
+// Counting replacements for the global allocation functions; the sized and
+// aligned forms of delete fall back to these
+void* operator new(std::size_t size) {
+    ++VersionTools::allocationCount;
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    ++VersionTools::allocationCount;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+#endif
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace VersionTools {
+
+// A finished span. Categories in use: "process" for every child process
+// SystemCommand runs, "parse" for the status, log and diff parsers, and
+// "startup" for the stages of opening a repository in a frontend, each timed
+// from the open request: "first paint" (HEAD shown), "status", "history",
+// "refs", and "interactive" once all of them have arrived. The startup
+// stages are milestones, kept even while tracing is off.
+struct TraceSpan {
+    const char* category = "";
+    std::string name;         // "git status", "status", "diff"
+    std::string detail;       // Full command line for processes
+    std::string directory;    // Working directory of a process
+    std::chrono::microseconds start{0};  // Since the tracer was created
+    std::chrono::microseconds duration{0};
+    uint32_t thread = 0;      // Small per-thread number, stable for the run
+    // "bytes" and "allocations" on every span that has them; processes add
+    // spawn_us, first_output_us, stdout_bytes, stderr_bytes and exit_code,
+    // and stdin_bytes when they were given input
+    std::vector<std::pair<const char*, int64_t>> counters;
+
+    int64_t counter(std::string_view counterName) const;
+    // One line for logs: "git status --porcelain=v2 -z: 12.4 ms, spawn 0.8 ms, 4.2 KB"
+    std::string summary() const;
+};
+
+// Spans of one category and name added up
+struct TraceMetric {
+    std::string category;
+    std::string name;
+    uint64_t count = 0;
+    std::chrono::microseconds total{0};
+    std::chrono::microseconds max{0};
+    std::chrono::microseconds last{0};        // Of the most recent span
+    std::map<std::string, int64_t> counters;  // Totals of every counter
+};
+
+// Process-wide span recorder. Disabled it costs one relaxed atomic load per
+// span; enabled, finished spans go to a bounded buffer (oldest dropped first)
+// and to the listeners. Allocation counts are only collected in builds with
+// VT_TRACE_ALLOCATIONS, which replaces the global operator new.
+class Tracer {
+public:
+    static Tracer& shared();
+
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool value);
+    // Spans kept for spans(), metrics() and the Chrome trace; 100000 by default
+    void setCapacity(size_t spans);
+
+    void record(TraceSpan span);
+    // Records [begin, end) as a span of the calling thread, for intervals no
+    // single block covers; nothing while disabled
+    void recordInterval(const char* category, std::string_view name, std::chrono::steady_clock::time_point begin,
+                        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now());
+    // Like recordInterval(), but also added to milestones() whether or not
+    // tracing is enabled: for the few numbers a budget is enforced on
+    void recordMilestone(const char* category, std::string_view name, std::chrono::steady_clock::time_point begin,
+                         std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now());
+    // Every milestone recorded since the start, sorted by category and name;
+    // clear() leaves them alone
+    std::vector<TraceMetric> milestones() const;
+    void clear();
+
+    std::vector<TraceSpan> spans() const;
+    // Sorted by total time, largest first
+    std::vector<TraceMetric> metrics() const;
+
+    // chrome://tracing / Perfetto "trace_event" JSON of the recorded spans
+    std::string chromeTrace() const;
+    bool writeChromeTrace(const std::string& path) const;
+
+    // Called on the recording thread for every span; returns an id for unsubscribe
+    uint64_t subscribe(std::function<void(const TraceSpan& span)> listener);
+    void unsubscribe(uint64_t id);
+
+    // Allocations made by the calling thread so far; 0 without VT_TRACE_ALLOCATIONS
+    static uint64_t threadAllocations();
+    static uint32_t threadNumber();
+    // Offset of a time point from the tracer's start, as used by TraceSpan::start
+    std::chrono::microseconds sinceStart(std::chrono::steady_clock::time_point at) const;
+
+private:
+    Tracer();
+    ~Tracer();
+
+    std::atomic<bool> enabled{false};
+    const std::chrono::steady_clock::time_point epoch;
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+// Times the enclosing block as one span. Inert when tracing is off at
+// construction; check active() before computing anything expensive for it.
+class TraceScope {
+public:
+    TraceScope(const char* category, std::string_view name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    bool active() const { return span != nullptr; }
+    void setName(std::string name);
+    void setDetail(std::string detail);
+    void setDirectory(std::string directory);
+    // Adds to the counter, creating it at 0
+    void count(const char* counter, int64_t value);
+
+private:
+    std::unique_ptr<TraceSpan> span;
+    std::chrono::steady_clock::time_point begin;
+    uint64_t allocationsAtStart = 0;
+};
+
+}
@@ -0,0 +1,252 @@
+#include "Workspace.h"
+#include "CommandScheduler.h"
+#include "GitManager.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace VersionTools {
+
+namespace {
+
+constexpr size_t OPERATION_COUNT = 3;
+
+struct Repository {
+    explicit Repository(const std::string& path) : path(path), manager(path) {
+        // A watcher per repository would exhaust inotify watches long before the workspace is large
+        manager.setStatusCacheEnabled(false);
+    }
+
+    std::string path;
+    GitManager manager;
+    std::atomic<long long> lastElapsedMs[OPERATION_COUNT] = {};
+    bool indexRefreshed = false;  // Only touched by the repository's own (serialized) tasks
+};
+
+// Shared by every task of one batch; the last one to finish fulfils the promise
+struct Batch {
+    std::atomic<size_t> remaining{0};
+    std::promise<void> done;
+    WorkspaceCallback onResult;
+};
+
+void fillTracking(const GitManager& manager, WorkspaceResult& result) {
+    auto refs = manager.getRefSnapshot();
+    if (!refs) {
+        result.success = false;
+        result.error = "Could not read the refs";
+        return;
+    }
+    result.currentBranch = refs->currentBranchName();
+    for (const auto& ref : refs->localBranches()) {
+        if (ref.name == refs->headBranch()) {
+            result.upstreamBranch = ref.upstream;
+            result.aheadCount = ref.aheadCount;
+            result.behindCount = ref.behindCount;
+            break;
+        }
+    }
+}
+
+void runOperation(Repository& repository, WorkspaceOperation operation, const GitFetchOptions& fetchOptions,
+                  WorkspaceResult& result) {
+    const GitManager& manager = repository.manager;
+    result.success = true;
+
+    switch (operation) {
+        case WorkspaceOperation::Status: {
+            // The first scan may lock the index to store refreshed stat data; later polls stay lock-free
+            auto status = manager.queryStatus(!repository.indexRefreshed);
+            repository.indexRefreshed = true;
+            if (!status) {
+                result.success = false;
+                result.error = "git status failed";
+                return;
+            }
+            result.currentBranch = status->currentBranch;
+            result.upstreamBranch = status->upstreamBranch;
+            result.aheadCount = status->aheadCount;
+            result.behindCount = status->behindCount;
+            for (const auto& change : status->changes) {
+                if (change.status == FileStatus::Untracked) {
+                    ++result.untrackedCount;
+                } else if (change.status == FileStatus::Conflicted) {
+                    ++result.conflictedCount;
+                } else if (change.isStaged) {
+                    ++result.stagedCount;
+                } else {
+                    ++result.unstagedCount;
+                }
+            }
+            return;
+        }
+        case WorkspaceOperation::Fetch: {
+            // origin, else the first configured remote; nothing to do without one
+            auto remotes = manager.getRemotes();
+            if (remotes.empty()) {
+                fillTracking(manager, result);
+                return;
+            }
+            auto origin = std::find_if(remotes.begin(), remotes.end(),
+                                       [](const GitRemote& remote) { return remote.name == "origin"; });
+            const std::string& remote = origin != remotes.end() ? origin->name : remotes.front().name;
+
+            auto fetched = repository.manager.fetch(remote, fetchOptions);
+            if (!fetched.isSuccess()) {
+                result.success = false;
+                result.error = fetched.error;
+                return;
+            }
+            fillTracking(manager, result);
+            return;
+        }
+        case WorkspaceOperation::Tracking:
+            fillTracking(manager, result);
+            return;
+    }
+}
+
+}
+
+class Workspace::Impl {
+public:
+    explicit Impl(size_t concurrency) : scheduler(concurrency) {}
+
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<Repository>> repositories;
+    // Last member: its destructor cancels and drains the tasks before anything else goes away
+    CommandScheduler scheduler;
+
+    std::future<void> run(WorkspaceOperation operation, WorkspaceCallback onResult, const GitFetchOptions& fetchOptions,
+                          CancellationToken token) {
+        std::vector<std::shared_ptr<Repository>> batchRepositories;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batchRepositories = repositories;
+        }
+
+        auto batch = std::make_shared<Batch>();
+        batch->onResult = std::move(onResult);
+        auto future = batch->done.get_future();
+        if (batchRepositories.empty()) {
+            batch->done.set_value();
+            return future;
+        }
+
+        // Longest first: the slow repositories start right away instead of trailing the batch
+        size_t slot = static_cast<size_t>(operation);
+        std::stable_sort(batchRepositories.begin(), batchRepositories.end(), [slot](const auto& a, const auto& b) {
+            return a->lastElapsedMs[slot].load() > b->lastElapsedMs[slot].load();
+        });
+
+        TaskPriority priority =
+            operation == WorkspaceOperation::Fetch ? TaskPriority::Background : TaskPriority::Interactive;
+        batch->remaining = batchRepositories.size();
+        for (const auto& repository : batchRepositories) {
+            TaskOptions options{priority, TaskAccess::Write, repository->path, token};
+            scheduler.post(std::move(options), [repository, batch, operation, fetchOptions, token, slot]() {
+                WorkspaceResult result;
+                result.repositoryPath = repository->path;
+                result.operation = operation;
+
+                if (token.isCancelled()) {
+                    result.cancelled = true;
+                    result.error = "Cancelled";
+                } else {
+                    auto start = std::chrono::steady_clock::now();
+                    runOperation(*repository, operation, fetchOptions, result);
+                    if (!result.success && token.isCancelled()) {
+                        result.cancelled = true;
+                        result.error = "Cancelled";
+                    }
+                    result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start);
+                    repository->lastElapsedMs[slot] = result.elapsed.count();
+                }
+
+                if (batch->onResult) {
+                    try {
+                        batch->onResult(result);
+                    } catch (...) {
+                    }
+                }
+                if (--batch->remaining == 0) {
+                    batch->done.set_value();
+                }
+            });
+        }
+        return future;
+    }
+};
+
+Workspace::Workspace(size_t concurrency) : pImpl(std::make_unique<Impl>(std::max<size_t>(concurrency, 1))) {}
+
+Workspace::~Workspace() = default;
+
+bool Workspace::addRepository(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        for (const auto& repository : pImpl->repositories) {
+            if (repository->path == path) {
+                return false;
+            }
+        }
+    }
+
+    // Opened outside the lock; validating forks nothing but touches the disk
+    auto repository = std::make_shared<Repository>(path);
+    if (!repository->manager.isValidRepository(path)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    for (const auto& existing : pImpl->repositories) {
+        if (existing->path == path) {
+            return false;
+        }
+    }
+    pImpl->repositories.push_back(std::move(repository));
+    return true;
+}
+
+bool Workspace::removeRepository(const std::string& path) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    auto& repositories = pImpl->repositories;
+    auto it = std::find_if(repositories.begin(), repositories.end(),
+                           [&](const auto& repository) { return repository->path == path; });
+    if (it == repositories.end()) {
+        return false;
+    }
+    // Running tasks keep their own reference
+    repositories.erase(it);
+    return true;
+}
+
+std::vector<std::string> Workspace::repositories() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    std::vector<std::string> paths;
+    paths.reserve(pImpl->repositories.size());
+    for (const auto& repository : pImpl->repositories) {
+        paths.push_back(repository->path);
+    }
+    return paths;
+}
+
+size_t Workspace::concurrency() const {
+    return pImpl->scheduler.workerCount();
+}
+
+std::future<void> Workspace::refreshStatus(WorkspaceCallback onResult, CancellationToken token) {
+    return pImpl->run(WorkspaceOperation::Status, std::move(onResult), {}, std::move(token));
+}
+
+std::future<void> Workspace::refreshTracking(WorkspaceCallback onResult, CancellationToken token) {
+    return pImpl->run(WorkspaceOperation::Tracking, std::move(onResult), {}, std::move(token));
+}
+
+std::future<void> Workspace::fetchAll(WorkspaceCallback onResult, const GitFetchOptions& options,
+                                      CancellationToken token) {
+    return pImpl->run(WorkspaceOperation::Fetch, std::move(onResult), options, std::move(token));
+}
+
+}
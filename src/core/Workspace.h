@@ -0,0 +1,82 @@
+#pragma once
+
+#include "CancellationToken.h"
+#include "GitTypes.h"
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace VersionTools {
+
+enum class WorkspaceOperation {
+    Status,    // Working tree scan plus branch and ahead/behind
+    Tracking,  // Branch and ahead/behind from the refs only
+    Fetch      // Fetch, then branch and ahead/behind
+};
+
+// One repository's outcome of a workspace-wide operation
+struct WorkspaceResult {
+    std::string repositoryPath;
+    WorkspaceOperation operation = WorkspaceOperation::Status;
+    bool success = false;
+    bool cancelled = false;
+    std::string error;
+
+    std::string currentBranch;
+    std::string upstreamBranch;
+    int aheadCount = 0;
+    int behindCount = 0;
+
+    // Status only
+    size_t stagedCount = 0;
+    size_t unstagedCount = 0;
+    size_t untrackedCount = 0;
+    size_t conflictedCount = 0;
+
+    std::chrono::milliseconds elapsed{0};
+};
+
+// Called on a worker thread as soon as each repository finishes
+using WorkspaceCallback = std::function<void(const WorkspaceResult& result)>;
+
+// A set of repositories, each with its own GitManager, that status, tracking
+// and fetch run across in parallel. Work goes to a CommandScheduler owned by
+// the workspace with `concurrency` workers, so at most that many repositories
+// are busy at once; idle workers pick up the next repository from the shared
+// queue, and repositories are queued slowest first (by their previous run of
+// the same operation) so a batch takes about as long as its slowest member.
+// Operations on one repository never overlap, and status and tracking
+// refreshes overtake queued fetches.
+//
+// Repositories can be added and removed while a batch runs; the batch keeps
+// the set it started with.
+class Workspace {
+public:
+    explicit Workspace(size_t concurrency = 8);
+    // Cancels running batches and waits for them
+    ~Workspace();
+
+    Workspace(const Workspace&) = delete;
+    Workspace& operator=(const Workspace&) = delete;
+
+    // False when the path is not a repository or is already in the workspace
+    bool addRepository(const std::string& path);
+    bool removeRepository(const std::string& path);
+    std::vector<std::string> repositories() const;
+    size_t concurrency() const;
+
+    // The futures become ready after the callback ran for every repository
+    std::future<void> refreshStatus(WorkspaceCallback onResult, CancellationToken token = {});
+    std::future<void> refreshTracking(WorkspaceCallback onResult, CancellationToken token = {});
+    std::future<void> fetchAll(WorkspaceCallback onResult, const GitFetchOptions& options = {},
+                               CancellationToken token = {});
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}
@@ -0,0 +1,130 @@
+import Foundation
+
+// Reader for the core FlatRecords layout (src/core/FlatRecords.h): one buffer from the bridge holding
+// fixed-size records, a uint32 extras array and a string table. Fields are read in place at the offsets
+// the core pins with static_asserts; Strings are only created when a field is asked for
+final class FlatRecordBuffer {
+    enum Kind: UInt16 {
+        case fileChanges = 1
+        case commits = 2
+    }
+
+    private static let magic: UInt32 = 0x42465456
+    private static let version: UInt16 = 1
+
+    private let storage: NSData
+    private let bytes: UnsafeRawBufferPointer
+    let recordCount: Int
+    let split: Int
+    private let recordSize: Int
+    private let recordsOffset: Int
+    private let extrasOffset: Int
+    private let stringsOffset: Int
+
+    init?(_ data: Data?, kind: Kind) {
+        guard let data = data else { return nil }
+        // The bridge's NSData comes back as the same object, so bytes stays valid as long as storage lives
+        storage = data as NSData
+        guard storage.length >= 40 else { return nil }
+        bytes = UnsafeRawBufferPointer(start: storage.bytes, count: storage.length)
+
+        guard bytes.load(fromByteOffset: 0, as: UInt32.self) == FlatRecordBuffer.magic,
+              bytes.load(fromByteOffset: 4, as: UInt16.self) == FlatRecordBuffer.version,
+              bytes.load(fromByteOffset: 6, as: UInt16.self) == kind.rawValue else {
+            return nil
+        }
+        recordCount = Int(bytes.load(fromByteOffset: 8, as: UInt32.self))
+        recordSize = Int(bytes.load(fromByteOffset: 12, as: UInt32.self))
+        split = Int(bytes.load(fromByteOffset: 20, as: UInt32.self))
+        recordsOffset = Int(bytes.load(fromByteOffset: 24, as: UInt32.self))
+        extrasOffset = Int(bytes.load(fromByteOffset: 28, as: UInt32.self))
+        stringsOffset = Int(bytes.load(fromByteOffset: 32, as: UInt32.self))
+        let stringsSize = Int(bytes.load(fromByteOffset: 36, as: UInt32.self))
+        guard stringsOffset + stringsSize == bytes.count,
+              recordsOffset + recordCount * recordSize <= extrasOffset else {
+            return nil
+        }
+    }
+
+    func load<T>(_ record: Int, _ field: Int, as type: T.Type) -> T {
+        bytes.load(fromByteOffset: recordsOffset + record * recordSize + field, as: type)
+    }
+
+    func extra(_ index: Int) -> Int {
+        Int(bytes.load(fromByteOffset: extrasOffset + index * 4, as: UInt32.self))
+    }
+
+    // A FlatRecords::String at the given field, optionally skipping its first bytes
+    func string(_ record: Int, _ field: Int, from skip: Int = 0) -> String {
+        let offset = Int(load(record, field, as: UInt32.self))
+        return string(offset: offset, length: Int(load(record, field + 4, as: UInt32.self)), from: skip)
+    }
+
+    func string(offset: Int, length: Int, from skip: Int = 0, to end: Int? = nil) -> String {
+        let start = stringsOffset + offset + min(skip, length)
+        let stop = stringsOffset + offset + min(end ?? length, length)
+        return String(decoding: UnsafeRawBufferPointer(rebasing: bytes[start..<max(start, stop)]), as: UTF8.self)
+    }
+
+    // Same hash as FlatRecords::fileChangeId, for changes that did not come from a buffer
+    static func fileChangeId(_ path: String, staged: Bool) -> UInt64 {
+        var hash: UInt64 = 0xcbf29ce484222325
+        for byte in path.utf8 {
+            hash = (hash ^ UInt64(byte)) &* 0x100000001b3
+        }
+        return (hash ^ (staged ? 1 : 0)) &* 0x100000001b3
+    }
+}
+
+// Changes straight from a getFileChangesBuffer result. Staged changes come first; `staged` and
+// `unstaged` are views of the two groups over the same buffer
+struct FlatFileChanges: RandomAccessCollection {
+    private let buffer: FlatRecordBuffer?
+    let startIndex: Int
+    let endIndex: Int
+
+    init() {
+        buffer = nil
+        startIndex = 0
+        endIndex = 0
+    }
+
+    init?(_ data: Data?) {
+        guard let buffer = FlatRecordBuffer(data, kind: .fileChanges) else { return nil }
+        self.init(buffer, 0..<buffer.recordCount)
+    }
+
+    private init(_ buffer: FlatRecordBuffer?, _ range: Range<Int>) {
+        self.buffer = buffer
+        startIndex = range.lowerBound
+        endIndex = range.upperBound
+    }
+
+    var staged: FlatFileChanges {
+        FlatFileChanges(buffer, startIndex..<min(max(buffer?.split ?? 0, startIndex), endIndex))
+    }
+
+    var unstaged: FlatFileChanges {
+        FlatFileChanges(buffer, max(min(buffer?.split ?? 0, endIndex), startIndex)..<endIndex)
+    }
+
+    subscript(position: Int) -> GitFileChangeWrapper {
+        GitFileChangeWrapper(buffer!, record: position)
+    }
+}
+
+// Commits straight from a history buffer; each one is decoded when it is read
+struct FlatCommits: RandomAccessCollection {
+    private let buffer: FlatRecordBuffer?
+    let startIndex = 0
+    let endIndex: Int
+
+    init(_ data: Data?) {
+        buffer = FlatRecordBuffer(data, kind: .commits)
+        endIndex = buffer?.recordCount ?? 0
+    }
+
+    subscript(position: Int) -> GitCommitWrapper {
+        GitCommitWrapper(buffer!, record: position)
+    }
+}
@@ -9,15 +9,22 @@ class GitManagerWrapper: ObservableObject {
     @Published var currentBranch: String?
     @Published var repositoryStatus: GitRepositoryStatus?
     @Published var commitHistory: [GitCommitWrapper] = []
-    @Published var stagedChanges: [GitFileChangeWrapper] = []
-    @Published var unstagedChanges: [GitFileChangeWrapper] = []
+    @Published var stagedChanges = FlatFileChanges()
+    @Published var unstagedChanges = FlatFileChanges()
     @Published var localBranches: [GitBranchWrapper] = []
     @Published var remoteBranches: [GitBranchWrapper] = []
     @Published var allBranches: [GitBranchWrapper] = []
     @Published var currentBranchInfo: GitBranchWrapper?
     @Published var stashes: [GitStashWrapper] = []  // 添加 stash 列表
+    @Published var hasMoreCommitHistory = false
+    @Published var searchResults: [GitCommitWrapper] = []
+    @Published var hasMoreSearchResults = false
+    @Published var isSearchComplete = true  // False while older bodies and paths are still being indexed
     
     private var gitBridge: GitBridge
+    private let historyPageSize = 100
+    private var searchQuery = ""
+    private var lastPrefetchRow: Int?
     
     init() {
         self.gitBridge = GitBridge()
@@ -26,14 +33,23 @@ class GitManagerWrapper: ObservableObject {
     // MARK: - Repository Operations
     
     func openRepository(path: String) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.beginStartup()
+        // A write of the current repository, so it waits for the reads still using its caches
+        gitBridge.schedule(.interactive, writes: true) {
             let success = self.gitBridge.openRepository(path)
             
             DispatchQueue.main.async {
                 if success {
                     self.repositoryPath = path
                     self.repositoryName = URL(fileURLWithPath: path).lastPathComponent
-                    self.refreshAll()
+                    self.gitBridge.recordStartupStage("first paint")
+                    Task { @MainActor in
+                        async let status: Void = self.startupStage("status", kind: "status", load: self.statusLoader)
+                        async let history: Void = self.startupStage("history", kind: "history", load: self.historyLoader)
+                        async let refs: Void = self.startupStage("refs", kind: "branches", load: self.branchesLoader)
+                        _ = await (status, history, refs)
+                        self.gitBridge.recordStartupStage("interactive")
+                    }
                 } else {
                     self.showError("Failed to open repository at \(path)")
                 }
@@ -50,67 +66,84 @@ class GitManagerWrapper: ObservableObject {
     @MainActor
     func refreshStatus() async {
         isLoading = true
-        
-        await withTaskGroup(of: Void.self) { group in
-            group.addTask {
-                await self.loadStatus()
-            }
-            group.addTask {
-                await self.loadChanges()
-            }
-        }
-        
+        await refreshed("status", load: statusLoader)
         isLoading = false
     }
     
     @MainActor
     func refreshCommitHistory() async {
         isLoading = true
-        await loadCommitHistoryAsync()
+        await refreshed("history", load: historyLoader)
         isLoading = false
     }
     
     @MainActor
     func refreshBranches() async {
         isLoading = true
-        await loadBranchesAsync()
+        await refreshed("branches", load: branchesLoader)
         isLoading = false
     }
     
     // MARK: - Synchronous Wrappers
     
     func refreshStatus() {
-        Task {
-            await refreshStatus()
-        }
+        requestRefresh("status", load: statusLoader)
     }
     
     func refreshBranches() {
-        Task {
-            await refreshBranches()
-        }
+        requestRefresh("branches", load: branchesLoader)
     }
     
     func loadCommitHistory() {
-        Task {
-            await loadCommitHistoryAsync()
-        }
+        requestRefresh("history", load: historyLoader)
     }
     
     func loadBranches() {
-        Task {
-            await loadBranchesAsync()
+        requestRefresh("branches", load: branchesLoader)
+    }
+    
+    // MARK: - Coalesced Refreshes
+    
+    // Async refreshes waiting for a result of their kind to be applied; main thread only
+    private var refreshWaiters: [String: [CheckedContinuation<Void, Never>]] = [:]
+    
+    // Runs load on the core scheduler, coalesced with the other refreshes of the same kind: requests
+    // made while one is queued share it, and requests made while one runs share a single trailing run.
+    // The result is applied on the main thread unless a newer request was made meanwhile; the run
+    // covering that request applies instead, so a burst repaints once
+    private func requestRefresh(_ kind: String, load: @escaping () -> () -> Void) {
+        gitBridge.requestRefresh(kind, priority: .interactive) { generation in
+            let apply = load()
+            DispatchQueue.main.async {
+                guard self.gitBridge.isCurrentRefresh(kind, generation: generation) else { return }
+                apply()
+                self.refreshWaiters.removeValue(forKey: kind)?.forEach { $0.resume() }
+            }
         }
     }
     
-    // MARK: - Private Loading Methods
+    @MainActor
+    private func refreshed(_ kind: String, load: @escaping () -> () -> Void) async {
+        await withCheckedContinuation { continuation in
+            refreshWaiters[kind, default: []].append(continuation)
+            requestRefresh(kind, load: load)
+        }
+    }
     
+    // Loads one kind like refreshAll() does, then records the startup stage it completes
     @MainActor
-    private func loadStatus() async {
-        let statusDict = gitBridge.getRepositoryStatus()
-
-        if let dict = statusDict as? [String: Any] {
-            repositoryStatus = GitRepositoryStatus(
+    private func startupStage(_ stage: String, kind: String, load: @escaping () -> () -> Void) async {
+        await refreshed(kind, load: load)
+        gitBridge.recordStartupStage(stage)
+    }
+    
+    // MARK: - Private Loading Methods
+    
+    // Loaders run on a scheduler worker and return the closure that publishes their result
+    private func statusLoader() -> () -> Void {
+        var status: GitRepositoryStatus?
+        if let dict = gitBridge.getRepositoryStatus() as? [String: Any] {
+            status = GitRepositoryStatus(
                 currentBranch: dict["currentBranch"] as? String ?? "",
                 upstreamBranch: dict["upstreamBranch"] as? String,
                 aheadCount: dict["aheadCount"] as? Int ?? 0,
@@ -120,69 +153,92 @@ class GitManagerWrapper: ObservableObject {
                 stashCount: dict["stashCount"] as? Int ?? 0,
                 hasUncommittedChanges: dict["hasUncommittedChanges"] as? Bool ?? false
             )
-            currentBranch = repositoryStatus?.currentBranch
+        }
+
+        // One buffer for every change; rows build their strings when they are shown
+        let changes = FlatFileChanges(gitBridge.getFileChangesBuffer()) ?? FlatFileChanges()
+        let staged = changes.staged
+        let unstaged = changes.unstaged
+
+        return {
+            if let status = status {
+                self.repositoryStatus = status
+                self.currentBranch = status.currentBranch
+            }
+            self.stagedChanges = staged
+            self.unstagedChanges = unstaged
         }
     }
     
-    @MainActor
-    private func loadChanges() async {
-        let changesArray = gitBridge.getFileChanges()
-
-        var staged: [GitFileChangeWrapper] = []
-        var unstaged: [GitFileChangeWrapper] = []
-
-        if let changes = changesArray as? [[String: Any]] {
-            for change in changes {
-                let wrapper = GitFileChangeWrapper(
-                    filePath: change["filePath"] as? String ?? "",
-                    fileName: change["fileName"] as? String ?? "",
-                    directoryPath: change["directoryPath"] as? String ?? "",
-                    status: GitFileStatus(rawValue: change["status"] as? Int ?? 0) ?? .modified,
-                    isStaged: change["isStaged"] as? Bool ?? false,
-                    linesAdded: change["linesAdded"] as? Int ?? 0,
-                    linesDeleted: change["linesDeleted"] as? Int ?? 0
-                )
+    private func historyLoader() -> () -> Void {
+        // Reopening the cursor picks up new commits; the on-disk cache makes this cheap
+        let total = gitBridge.openCommitHistory()
+        let page = Array(FlatCommits(gitBridge.nextCommitHistoryPageBuffer(Int32(historyPageSize))))
 
-                if wrapper.isStaged {
-                    staged.append(wrapper)
-                } else {
-                    unstaged.append(wrapper)
-                }
-            }
+        return {
+            self.commitHistory = page
+            self.hasMoreCommitHistory = page.count < total
         }
+    }
+    
+    // Appends the next page of history; called as the list scrolls to its end
+    @MainActor
+    func loadMoreCommitHistory() {
+        guard hasMoreCommitHistory else { return }
 
-        stagedChanges = staged
-        unstagedChanges = unstaged
+        let page = FlatCommits(gitBridge.nextCommitHistoryPageBuffer(Int32(historyPageSize)))
+        commitHistory.append(contentsOf: page)
+        hasMoreCommitHistory = !page.isEmpty
+    }
+    
+    // Search as you type: the newest query replaces one still queued, and stale pages are dropped
+    func searchCommits(_ query: String) {
+        searchQuery = query
+        guard !query.isEmpty else {
+            searchResults = []
+            hasMoreSearchResults = false
+            isSearchComplete = true
+            return
+        }
+        requestRefresh("search") { self.searchLoader(query: query, offset: 0) }
     }
     
+    // Appends the next page of hits; called as the results scroll to their end
     @MainActor
-    private func loadCommitHistoryAsync() async {
-        let commitsArray = gitBridge.getCommitHistory(100)
-
-        var commits: [GitCommitWrapper] = []
-        if let commitsData = commitsArray as? [[String: Any]] {
-            for commitData in commitsData {
-                let commit = GitCommitWrapper(
-                    hash: commitData["hash"] as? String ?? "",
-                    shortHash: commitData["shortHash"] as? String ?? "",
-                    author: commitData["author"] as? String ?? "",
-                    email: commitData["email"] as? String ?? "",
-                    message: commitData["message"] as? String ?? "",
-                    shortMessage: commitData["shortMessage"] as? String ?? "",
-                    fullMessage: commitData["message"] as? String ?? "",
-                    timestamp: commitData["timestamp"] as? Date ?? Date(),
-                    parentHashes: commitData["parentHashes"] as? [String] ?? [],
-                    isMerge: commitData["isMerge"] as? Bool ?? false
-                )
-                commits.append(commit)
+    func loadMoreSearchResults() {
+        guard hasMoreSearchResults, !searchQuery.isEmpty else { return }
+        let query = searchQuery
+        let offset = searchResults.count
+        requestRefresh("search") { self.searchLoader(query: query, offset: offset) }
+    }
+    
+    private func searchLoader(query: String, offset: Int) -> () -> Void {
+        let page = gitBridge.searchCommits(query, offset: Int32(offset), count: Int32(historyPageSize))
+        let commits = Array(FlatCommits(page["commits"] as? Data))
+        let hasMore = page["hasMore"] as? Bool ?? false
+        let isComplete = page["isComplete"] as? Bool ?? true
+
+        return {
+            guard query == self.searchQuery else { return }
+            if offset == 0 {
+                self.searchResults = commits
+            } else {
+                self.searchResults.append(contentsOf: commits)
+            }
+            self.hasMoreSearchResults = hasMore
+            self.isSearchComplete = isComplete
+            if !isComplete && offset == 0 {
+                // Run the query again once more of the history is indexed
+                DispatchQueue.main.asyncAfter(deadline: .now() + 1) {
+                    if query == self.searchQuery && !self.isSearchComplete {
+                        self.searchCommits(query)
+                    }
+                }
             }
         }
-
-        commitHistory = commits
     }
     
-    @MainActor
-    private func loadBranchesAsync() async {
+    private func branchesLoader() -> () -> Void {
         let branchesArray = gitBridge.getBranches()
 
         var branches: [GitBranchWrapper] = []
@@ -219,16 +275,18 @@ class GitManagerWrapper: ObservableObject {
             }
         }
 
-        localBranches = branches.filter { !$0.isRemote }
-        remoteBranches = branches.filter { $0.isRemote }
-        allBranches = branches
-        currentBranchInfo = branches.first { $0.isCurrent }
+        return {
+            self.localBranches = branches.filter { !$0.isRemote }
+            self.remoteBranches = branches.filter { $0.isRemote }
+            self.allBranches = branches
+            self.currentBranchInfo = branches.first { $0.isCurrent }
+        }
     }
     
     // MARK: - File Operations
     
     func stageFile(_ filePath: String) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.stageFile(filePath)
             if success {
                 DispatchQueue.main.async {
@@ -239,7 +297,7 @@ class GitManagerWrapper: ObservableObject {
     }
     
     func unstageFile(_ filePath: String) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.unstageFile(filePath)
             if success {
                 DispatchQueue.main.async {
@@ -249,8 +307,41 @@ class GitManagerWrapper: ObservableObject {
         }
     }
     
+    func stageFiles(_ filePaths: [String]) {
+        gitBridge.schedule(.normal, writes: true) {
+            if self.gitBridge.stageFiles(filePaths) {
+                DispatchQueue.main.async {
+                    self.refreshStatus()
+                }
+            }
+        }
+    }
+    
+    func unstageFiles(_ filePaths: [String]) {
+        gitBridge.schedule(.normal, writes: true) {
+            if self.gitBridge.unstageFiles(filePaths) {
+                DispatchQueue.main.async {
+                    self.refreshStatus()
+                }
+            }
+        }
+    }
+    
+    // Lines of one hunk of the working tree diff into the index, or out of it when staged;
+    // an empty selection takes the whole hunk
+    func stageLines(_ lines: [Int], ofHunk hunkIndex: Int, filePath: String, staged: Bool) {
+        gitBridge.schedule(.normal, writes: true) {
+            let indices = lines.map { NSNumber(value: $0) }
+            if self.gitBridge.stageLines(indices, ofHunk: hunkIndex, inFile: filePath, staged: staged) {
+                DispatchQueue.main.async {
+                    self.refreshStatus()
+                }
+            }
+        }
+    }
+    
     func stageAllChanges() {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.stageAllFiles()
             if success {
                 DispatchQueue.main.async {
@@ -261,7 +352,7 @@ class GitManagerWrapper: ObservableObject {
     }
     
     func unstageAllChanges() {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.unstageAllFiles()
             if success {
                 DispatchQueue.main.async {
@@ -274,7 +365,7 @@ class GitManagerWrapper: ObservableObject {
     // MARK: - Commit Operations
     
     func commit(message: String, completion: @escaping (Bool) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.commit(message)
             DispatchQueue.main.async {
                 if success {
@@ -288,7 +379,7 @@ class GitManagerWrapper: ObservableObject {
     // MARK: - Branch Operations
     
     func checkoutBranch(_ branchName: String, completion: @escaping (Bool) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.checkoutBranch(branchName)
             DispatchQueue.main.async {
                 if success {
@@ -300,7 +391,7 @@ class GitManagerWrapper: ObservableObject {
     }
     
     func createBranch(_ branchName: String, completion: @escaping (Bool) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.createBranch(branchName)
             DispatchQueue.main.async {
                 if success {
@@ -312,7 +403,7 @@ class GitManagerWrapper: ObservableObject {
     }
 
     func deleteBranch(_ branchName: String, completion: @escaping (Bool) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.deleteBranch(branchName)
             DispatchQueue.main.async {
                 if success {
@@ -327,7 +418,7 @@ class GitManagerWrapper: ObservableObject {
 
     func executeCommand(_ command: String) async throws -> String {
         return await withCheckedContinuation { continuation in
-            DispatchQueue.global(qos: .userInitiated).async {
+            gitBridge.schedule(.normal, writes: true) {
                 let result = self.gitBridge.executeRawCommand(command)
                 continuation.resume(returning: result ?? "")
             }
@@ -337,7 +428,7 @@ class GitManagerWrapper: ObservableObject {
     // MARK: - Diff and Detail Operations
     
     func loadCommitChanges(commitHash: String, completion: @escaping ([GitFileChangeWrapper]) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.interactive, writes: false) {
             let changesArray = self.gitBridge.getCommitChanges(commitHash)
 
             var changes: [GitFileChangeWrapper] = []
@@ -362,47 +453,30 @@ class GitManagerWrapper: ObservableObject {
         }
     }
     
+    // Warms the commits around a selected history row, ahead in the direction the selection moved.
+    // Not interactive: that would preempt the very prefetch it starts
+    func prefetchCommits(aroundRow row: Int) {
+        let direction = row < (lastPrefetchRow ?? row) ? -1 : 1
+        lastPrefetchRow = row
+        gitBridge.schedule(.normal, writes: false) {
+            self.gitBridge.prefetchCommits(aroundRow: row, direction: direction)
+        }
+    }
+
     func loadFileDiff(filePath: String, commitHash: String, completion: @escaping (GitDiffWrapper?) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.interactive, writes: false) {
             let diffDict = self.gitBridge.getFileDiff(filePath, commitHash: commitHash)
 
             var diff: GitDiffWrapper?
             if let diffData = diffDict as? [String: Any] {
-                var hunks: [GitDiffHunkWrapper] = []
-                if let hunksArray = diffData["hunks"] as? [[String: Any]] {
-                    for hunkData in hunksArray {
-                        var lines: [GitDiffLineWrapper] = []
-                        if let linesArray = hunkData["lines"] as? [[String: Any]] {
-                            for lineData in linesArray {
-                                let lineType = GitDiffLineType(rawValue: lineData["type"] as? Int ?? 0) ?? .context
-                                let line = GitDiffLineWrapper(
-                                    type: lineType,
-                                    content: lineData["content"] as? String ?? "",
-                                    oldLineNumber: lineData["oldLineNumber"] as? Int ?? 0,
-                                    newLineNumber: lineData["newLineNumber"] as? Int ?? 0
-                                )
-                                lines.append(line)
-                            }
-                        }
-
-                        let hunk = GitDiffHunkWrapper(
-                            header: hunkData["header"] as? String ?? "",
-                            oldStart: hunkData["oldStart"] as? Int ?? 0,
-                            oldCount: hunkData["oldCount"] as? Int ?? 0,
-                            newStart: hunkData["newStart"] as? Int ?? 0,
-                            newCount: hunkData["newCount"] as? Int ?? 0,
-                            lines: lines
-                        )
-                        hunks.append(hunk)
-                    }
-                }
-
+                let hunksArray = diffData["hunks"] as? [[String: Any]] ?? []
                 diff = GitDiffWrapper(
                     filePath: diffData["filePath"] as? String ?? "",
                     isBinary: diffData["isBinary"] as? Bool ?? false,
                     isNewFile: diffData["isNewFile"] as? Bool ?? false,
                     isDeletedFile: diffData["isDeletedFile"] as? Bool ?? false,
-                    hunks: hunks,
+                    isTruncated: diffData["isTruncated"] as? Bool ?? false,
+                    hunks: hunksArray.map(GitDiffHunkWrapper.init(dictionary:)),
                     rawContent: diffData["rawContent"] as? String ?? ""
                 )
             }
@@ -413,8 +487,28 @@ class GitManagerWrapper: ObservableObject {
         }
     }
     
+    // Hunks a truncated diff left unloaded, keyed by their index in GitDiffWrapper.hunks
+    func loadFileDiffHunks(filePath: String, commitHash: String, range: Range<Int>,
+                           completion: @escaping ([Int: GitDiffHunkWrapper]) -> Void) {
+        gitBridge.schedule(.interactive, writes: false) {
+            let hunksArray = self.gitBridge.getFileDiffHunks(filePath, commitHash: commitHash,
+                                                             first: range.lowerBound, count: range.count)
+
+            var hunks: [Int: GitDiffHunkWrapper] = [:]
+            for case let hunkData as [String: Any] in hunksArray ?? [] {
+                if let index = hunkData["index"] as? Int {
+                    hunks[index] = GitDiffHunkWrapper(dictionary: hunkData)
+                }
+            }
+
+            DispatchQueue.main.async {
+                completion(hunks)
+            }
+        }
+    }
+    
     func loadBranchCommits(branchName: String, completion: @escaping ([GitCommitWrapper]) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.interactive, writes: false) {
             let commitsArray = self.gitBridge.getBranchCommits(branchName, maxCount: 50)
 
             var commits: [GitCommitWrapper] = []
@@ -445,7 +539,7 @@ class GitManagerWrapper: ObservableObject {
     // MARK: - Stash Operations
 
     func loadStashes() {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.interactive, writes: false) {
             let stashesArray = self.gitBridge.getStashes()
 
             var stashList: [GitStashWrapper] = []
@@ -469,7 +563,7 @@ class GitManagerWrapper: ObservableObject {
     }
 
     func createStash(message: String, completion: @escaping (Bool) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.createStash(message)
             DispatchQueue.main.async {
                 if success {
@@ -482,7 +576,7 @@ class GitManagerWrapper: ObservableObject {
     }
 
     func applyStash(index: Int, completion: @escaping (Bool) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.applyStash(Int32(index))
             DispatchQueue.main.async {
                 if success {
@@ -494,7 +588,7 @@ class GitManagerWrapper: ObservableObject {
     }
 
     func popStash(index: Int, completion: @escaping (Bool) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.popStash(Int32(index))
             DispatchQueue.main.async {
                 if success {
@@ -507,7 +601,7 @@ class GitManagerWrapper: ObservableObject {
     }
 
     func dropStash(index: Int, completion: @escaping (Bool) -> Void) {
-        DispatchQueue.global(qos: .userInitiated).async {
+        gitBridge.schedule(.normal, writes: true) {
             let success = self.gitBridge.dropStash(Int32(index))
             DispatchQueue.main.async {
                 if success {
@@ -540,22 +634,77 @@ struct GitRepositoryStatus {
 }
 
 struct GitFileChangeWrapper: Hashable, Identifiable {
-    let id = UUID()
-    let filePath: String
-    let fileName: String
-    let directoryPath: String
+    // Changes read from a status buffer keep their strings there until a row asks for them
+    private enum Storage {
+        case values(filePath: String, fileName: String, directoryPath: String)
+        case flat(FlatRecordBuffer, record: Int)
+    }
+
+    let id: UInt64
     let status: GitFileStatus
     let isStaged: Bool
     let linesAdded: Int
     let linesDeleted: Int
-    
+    private let storage: Storage
+
+    init(filePath: String, fileName: String, directoryPath: String, status: GitFileStatus, isStaged: Bool,
+         linesAdded: Int, linesDeleted: Int) {
+        self.id = FlatRecordBuffer.fileChangeId(filePath, staged: isStaged)
+        self.status = status
+        self.isStaged = isStaged
+        self.linesAdded = linesAdded
+        self.linesDeleted = linesDeleted
+        self.storage = .values(filePath: filePath, fileName: fileName, directoryPath: directoryPath)
+    }
+
+    // Field offsets of FlatRecords::FileChange
+    init(_ buffer: FlatRecordBuffer, record: Int) {
+        self.id = buffer.load(record, 24, as: UInt64.self)
+        self.status = GitFileStatus(rawValue: Int(buffer.load(record, 20, as: UInt8.self))) ?? .modified
+        self.isStaged = buffer.load(record, 21, as: UInt8.self) != 0
+        self.linesAdded = Int(buffer.load(record, 12, as: UInt32.self))
+        self.linesDeleted = Int(buffer.load(record, 16, as: UInt32.self))
+        self.storage = .flat(buffer, record: record)
+    }
+
+    var filePath: String {
+        switch storage {
+        case .values(let filePath, _, _):
+            return filePath
+        case .flat(let buffer, let record):
+            return buffer.string(record, 0)
+        }
+    }
+
+    var fileName: String {
+        switch storage {
+        case .values(_, let fileName, _):
+            return fileName
+        case .flat(let buffer, let record):
+            return buffer.string(record, 0, from: Int(buffer.load(record, 8, as: UInt32.self)))
+        }
+    }
+
+    var directoryPath: String {
+        switch storage {
+        case .values(_, _, let directoryPath):
+            return directoryPath
+        case .flat(let buffer, let record):
+            // Everything before the slash that ends the directory
+            let nameStart = Int(buffer.load(record, 8, as: UInt32.self))
+            let offset = Int(buffer.load(record, 0, as: UInt32.self))
+            return buffer.string(offset: offset, length: Int(buffer.load(record, 4, as: UInt32.self)),
+                                 to: max(nameStart - 1, 0))
+        }
+    }
+
+    // The id already covers path and staged; the path is only compared when two ids collide
     static func == (lhs: GitFileChangeWrapper, rhs: GitFileChangeWrapper) -> Bool {
-        lhs.filePath == rhs.filePath && lhs.isStaged == rhs.isStaged
+        lhs.id == rhs.id && lhs.isStaged == rhs.isStaged && lhs.filePath == rhs.filePath
     }
     
     func hash(into hasher: inout Hasher) {
-        hasher.combine(filePath)
-        hasher.combine(isStaged)
+        hasher.combine(id)
     }
     
     static let preview = GitFileChangeWrapper(
@@ -580,6 +729,46 @@ enum GitFileStatus: Int {
     case ignored = 7
 }
 
+// One row of the commit graph as laid out by the core GraphLayout
+struct CommitGraphRow {
+    enum EdgeType: Int {
+        case incoming, outgoing, through
+    }
+
+    struct Edge {
+        let type: EdgeType
+        let from: Int
+        let to: Int
+        let color: Int
+    }
+
+    let lane: Int
+    let color: Int
+    let width: Int
+    let edges: [Edge]
+
+    // Reads the graph fields of a FlatRecords::Commit; nil for rows that were not laid out
+    init?(_ buffer: FlatRecordBuffer, record: Int) {
+        let lane = Int(buffer.load(record, 64, as: Int32.self))
+        guard lane >= 0 else { return nil }
+        self.lane = lane
+        self.color = Int(buffer.load(record, 68, as: UInt32.self))
+        self.width = Int(buffer.load(record, 72, as: UInt32.self))
+        let firstEdge = Int(buffer.load(record, 76, as: UInt32.self))
+        let edgeCount = Int(buffer.load(record, 80, as: UInt32.self))
+        var edges: [Edge] = []
+        edges.reserveCapacity(edgeCount)
+        for edge in 0..<edgeCount {
+            let index = firstEdge + edge * 4
+            if let type = EdgeType(rawValue: buffer.extra(index)) {
+                edges.append(Edge(type: type, from: buffer.extra(index + 1), to: buffer.extra(index + 2),
+                                  color: buffer.extra(index + 3)))
+            }
+        }
+        self.edges = edges
+    }
+}
+
 struct GitCommitWrapper: Identifiable {
     let id = UUID()
     let hash: String
@@ -592,6 +781,43 @@ struct GitCommitWrapper: Identifiable {
     let timestamp: Date
     let parentHashes: [String]
     let isMerge: Bool
+    var graph: CommitGraphRow? = nil
+    
+    // Field offsets of FlatRecords::Commit
+    init(_ buffer: FlatRecordBuffer, record: Int) {
+        let message = buffer.string(record, 32)
+        let firstParent = Int(buffer.load(record, 56, as: UInt32.self))
+        let parentCount = Int(buffer.load(record, 60, as: UInt32.self))
+        self.hash = buffer.string(record, 0)
+        self.shortHash = buffer.string(record, 8)
+        self.author = buffer.string(record, 16)
+        self.email = buffer.string(record, 24)
+        self.message = message
+        self.shortMessage = buffer.string(record, 40)
+        self.fullMessage = message
+        self.timestamp = Date(timeIntervalSince1970: TimeInterval(buffer.load(record, 48, as: Int64.self)))
+        self.parentHashes = (0..<parentCount).map { parent -> String in
+            let index = firstParent + parent * 2
+            return buffer.string(offset: buffer.extra(index), length: buffer.extra(index + 1))
+        }
+        self.isMerge = parentCount > 1
+        self.graph = CommitGraphRow(buffer, record: record)
+    }
+    
+    init(hash: String, shortHash: String, author: String, email: String, message: String, shortMessage: String,
+         fullMessage: String, timestamp: Date, parentHashes: [String], isMerge: Bool, graph: CommitGraphRow? = nil) {
+        self.hash = hash
+        self.shortHash = shortHash
+        self.author = author
+        self.email = email
+        self.message = message
+        self.shortMessage = shortMessage
+        self.fullMessage = fullMessage
+        self.timestamp = timestamp
+        self.parentHashes = parentHashes
+        self.isMerge = isMerge
+        self.graph = graph
+    }
     
     var formattedDate: String {
         let formatter = DateFormatter()
@@ -633,7 +859,8 @@ struct GitDiffWrapper {
     let isBinary: Bool
     let isNewFile: Bool
     let isDeletedFile: Bool
-    let hunks: [GitDiffHunkWrapper]
+    let isTruncated: Bool  // Some hunks were over the diff budget and are loaded as they scroll into view
+    var hunks: [GitDiffHunkWrapper]
     let rawContent: String
 }
 
@@ -643,9 +870,33 @@ struct GitDiffHunkWrapper {
     let oldCount: Int
     let newStart: Int
     let newCount: Int
+    let isLoaded: Bool
     let lines: [GitDiffLineWrapper]
 }
 
+extension GitDiffHunkWrapper {
+    // A hunk dictionary from getFileDiff or getFileDiffHunks
+    init(dictionary hunkData: [String: Any]) {
+        let linesArray = hunkData["lines"] as? [[String: Any]] ?? []
+        self.init(
+            header: hunkData["header"] as? String ?? "",
+            oldStart: hunkData["oldStart"] as? Int ?? 0,
+            oldCount: hunkData["oldCount"] as? Int ?? 0,
+            newStart: hunkData["newStart"] as? Int ?? 0,
+            newCount: hunkData["newCount"] as? Int ?? 0,
+            isLoaded: hunkData["isLoaded"] as? Bool ?? true,
+            lines: linesArray.map { lineData in
+                GitDiffLineWrapper(
+                    type: GitDiffLineType(rawValue: lineData["type"] as? Int ?? 0) ?? .context,
+                    content: lineData["content"] as? String ?? "",
+                    oldLineNumber: lineData["oldLineNumber"] as? Int ?? 0,
+                    newLineNumber: lineData["newLineNumber"] as? Int ?? 0
+                )
+            }
+        )
+    }
+}
+
 struct GitDiffLineWrapper {
     let type: GitDiffLineType
     let content: String
@@ -726,19 +977,55 @@ extension GitManagerWrapper {
         return false
     }
 
-    func fetch(remoteName: String) -> Bool {
-        // TODO: Implement in GitBridge
-        return false
+    // Completions run on the main thread; no thread waits while git talks to the remote
+    func fetch(remoteName: String, completion: @escaping (Bool) -> Void) {
+        gitBridge.fetch(remoteName) { success, error in
+            self.remoteOperationFinished(success, error: error, completion: completion)
+        }
     }
 
-    func pull(remoteName: String, branch: String) -> Bool {
-        // TODO: Implement in GitBridge
-        return false
+    func pull(remoteName: String, branch: String, completion: @escaping (Bool) -> Void) {
+        gitBridge.pull(remoteName, branch: branch) { success, error in
+            self.remoteOperationFinished(success, error: error, completion: completion)
+        }
     }
 
-    func push(remoteName: String, branch: String, force: Bool) -> Bool {
-        // TODO: Implement in GitBridge
-        return false
+    func push(remoteName: String, branch: String, force: Bool, completion: @escaping (Bool) -> Void) {
+        gitBridge.push(remoteName, branch: branch, force: force) { success, error in
+            self.remoteOperationFinished(success, error: error, completion: completion)
+        }
+    }
+
+    func fetch(remoteName: String) async -> Bool {
+        await withCheckedContinuation { continuation in
+            fetch(remoteName: remoteName) { continuation.resume(returning: $0) }
+        }
+    }
+
+    func pull(remoteName: String, branch: String) async -> Bool {
+        await withCheckedContinuation { continuation in
+            pull(remoteName: remoteName, branch: branch) { continuation.resume(returning: $0) }
+        }
+    }
+
+    func push(remoteName: String, branch: String, force: Bool) async -> Bool {
+        await withCheckedContinuation { continuation in
+            push(remoteName: remoteName, branch: branch, force: force) { continuation.resume(returning: $0) }
+        }
+    }
+
+    // Kills the git process of a fetch, pull or push in progress; its completion then reports failure
+    func cancelRemoteOperations() {
+        gitBridge.cancelScheduledWork()
+    }
+
+    private func remoteOperationFinished(_ success: Bool, error: String?, completion: (Bool) -> Void) {
+        if success {
+            refreshAll()
+        } else if let error = error {
+            showError(error)
+        }
+        completion(success)
     }
 
     // MARK: - Tag Operations
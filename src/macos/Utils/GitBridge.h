@@ -1,23 +1,80 @@
 #import <Foundation/Foundation.h>
 
+// Lanes of the shared core scheduler, highest first
+typedef NS_ENUM(NSInteger, GitTaskPriority) {
+    GitTaskPriorityInteractive,
+    GitTaskPriorityNormal,
+    GitTaskPriorityBackground
+};
+
 // C++ to Swift bridge for Git operations
 @interface GitBridge : NSObject
 
 - (instancetype)init;
+
+// Runs the block on the core command scheduler instead of a global queue, so
+// the app's git work shares one bounded pool; blocks that write are
+// serialized with the other writes to the open repository
+- (void)schedule:(GitTaskPriority)priority writes:(BOOL)writes block:(void (^)(void))block;
+// Cancels queued and running work for the open repository (kills its git processes)
+- (void)cancelScheduledWork;
+// Coalesced refresh of one kind ("status", "history", ...) on the core scheduler: requests made while one
+// is queued share it, requests made while one runs share a single trailing run. The block gets the
+// generation it covers; results for which isCurrentRefresh:generation: is NO are stale and can be dropped
+- (uint64_t)requestRefresh:(NSString*)kind
+                 priority:(GitTaskPriority)priority
+                    block:(void (^)(uint64_t generation))block;
+- (BOOL)isCurrentRefresh:(NSString*)kind generation:(uint64_t)generation;
 - (BOOL)openRepository:(NSString*)path;
+// Startup milestones of an open (see GitManager::getStartupMetrics): beginStartup when the user asks
+// for the repository, then one recordStartupStage: per stage, timed from it; main thread only
+- (void)beginStartup;
+- (void)recordStartupStage:(NSString*)stage;
 - (NSArray*)getFileChanges;
 - (NSArray*)getCommitHistory:(int)maxCount;
+// Delivers the history in pages while git is still walking it; return NO from the handler to stop
+- (BOOL)streamCommitHistory:(int)maxCount pageSize:(int)pageSize handler:(BOOL (^)(NSArray* page))handler;
+// Cursor over the cached history: open (returns the total count), then page forward or jump to any offset
+- (NSInteger)openCommitHistory;
+- (NSArray*)nextCommitHistoryPage:(int)pageSize;
+- (NSArray*)getCommitHistoryPage:(int)offset count:(int)count;
+// Flat-buffer forms of getFileChanges, getCommitHistory and the history pages: one NSData in the
+// core FlatRecords layout (fixed-size records plus a string table) instead of an object per field.
+// Swift reads them through FlatFileChanges and FlatCommits without copying
+- (NSData*)getFileChangesBuffer;
+- (NSData*)getCommitHistoryBuffer:(int)maxCount;
+- (NSData*)nextCommitHistoryPageBuffer:(int)pageSize;
+- (NSData*)getCommitHistoryPageBuffer:(int)offset count:(int)count;
+// A page of commit search hits: "commits" (a commit buffer, no graph), "hasMore", and "isComplete",
+// which is NO while messages and paths of older commits are still being indexed
+- (NSDictionary*)searchCommits:(NSString*)query offset:(int)offset count:(int)count;
 - (NSArray*)getBranches;
 - (NSDictionary*)getRepositoryStatus;
 - (NSArray*)getCommitChanges:(NSString*)commitHash;
+// Warms changes and diffs of the history rows next to the selected one, the direction of travel
+// first (1 down the history, -1 up), on the core's background lane; getCommitChanges and
+// getFileDiff use what is ready
+- (void)prefetchCommitsAroundRow:(NSInteger)row direction:(NSInteger)direction;
+// Within the core's default diff budget; hunks past it have isLoaded NO and no lines
 - (NSDictionary*)getFileDiff:(NSString*)filePath commitHash:(NSString*)commitHash;
+// Hunks [first, first + count) of the same diff, as getFileDiff's hunk dictionaries plus "index"
+- (NSArray*)getFileDiffHunks:(NSString*)filePath commitHash:(NSString*)commitHash
+                       first:(NSInteger)first count:(NSInteger)count;
 - (NSArray*)getBranchCommits:(NSString*)branchName maxCount:(int)maxCount;
+- (NSData*)getFileContent:(NSString*)filePath atRevision:(NSString*)revision;
 
 // File operations
 - (BOOL)stageFile:(NSString*)filePath;
 - (BOOL)unstageFile:(NSString*)filePath;
 - (BOOL)stageAllFiles;
 - (BOOL)unstageAllFiles;
+// Any number of paths in one git process, fed over stdin
+- (BOOL)stageFiles:(NSArray<NSString*>*)filePaths;
+- (BOOL)unstageFiles:(NSArray<NSString*>*)filePaths;
+// Lines of one hunk of the file's unstaged diff into the index, or with staged
+// out of its staged diff; indices as in getDiff's hunks, none for the whole hunk
+- (BOOL)stageLines:(NSArray<NSNumber*>*)lineIndices ofHunk:(NSInteger)hunkIndex
+            inFile:(NSString*)filePath staged:(BOOL)staged;
 
 // Commit operations
 - (BOOL)commit:(NSString*)message;
@@ -36,6 +93,14 @@
 - (BOOL)popStash:(int)index;
 - (BOOL)dropStash:(int)index;
 
+// Remote operations. They run on the core scheduler without holding a thread while git works, and
+// call completion on the main queue; cancelScheduledWork kills the git process, which then completes
+// with success NO
+- (void)fetch:(NSString*)remote completion:(void (^)(BOOL success, NSString* error))completion;
+- (void)pull:(NSString*)remote branch:(NSString*)branch completion:(void (^)(BOOL success, NSString* error))completion;
+- (void)push:(NSString*)remote branch:(NSString*)branch force:(BOOL)force
+  completion:(void (^)(BOOL success, NSString* error))completion;
+
 // Raw command execution
 - (NSString*)executeRawCommand:(NSString*)command;
 
@@ -1,13 +1,95 @@
 #import "GitBridge.h"
+#include "core/CommandScheduler.h"
+#include "core/CommitPrefetcher.h"
+#include "core/FlatRecords.h"
 #include "core/GitManager.h"
+#include "core/GraphLayout.h"
 #include "core/GitUtils.h"
 #include "core/SystemCommand.h"
+#include "core/Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string_view>
 
 using namespace VersionTools;
 
+// History rows warmed ahead of the selection in the direction the user is moving
+static constexpr size_t PREFETCH_COMMIT_COUNT = 8;
+
+// Patch content is not guaranteed to be UTF-8; fall back to Latin-1 rather than returning nil
+static NSString *stringFromView(std::string_view text) {
+    NSString *string = [[NSString alloc] initWithBytes:text.data() length:text.size() encoding:NSUTF8StringEncoding];
+    if (!string) {
+        string = [[NSString alloc] initWithBytes:text.data() length:text.size() encoding:NSISOLatin1StringEncoding];
+    }
+    return string;
+}
+
+// Hands the buffer to NSData without copying; NSData frees it when Swift lets go
+static NSData *dataFromBuffer(std::string buffer) {
+    auto *owned = new std::string(std::move(buffer));
+    return [[NSData alloc] initWithBytesNoCopy:owned->data()
+                                        length:owned->size()
+                                   deallocator:^(void *, NSUInteger) {
+                                       delete owned;
+                                   }];
+}
+
+// Continuations of core tasks run on the main queue
+static Executor mainQueueExecutor() {
+    return [](std::function<void()> work) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            work();
+        });
+    };
+}
+
+static void completeOnMainQueue(const Task<GitOperationResult>& task, void (^completion)(BOOL, NSString *)) {
+    task.then(mainQueueExecutor(), [completion](const GitOperationResult& result) {
+        if (completion) {
+            completion(result.isSuccess(), result.isSuccess() ? nil : stringFromView(result.error));
+        }
+    }, [completion](std::exception_ptr error) {
+        // Dropped by cancelScheduledWork before it started, or the work threw
+        if (completion) {
+            NSString *message = @"Cancelled";
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception& e) {
+                message = [NSString stringWithUTF8String:e.what()] ?: message;
+            } catch (...) {
+            }
+            completion(NO, message);
+        }
+    });
+}
+
+static NSDictionary *lineDictionary(GitDiffLine::Type type, std::string_view content, int oldLineNumber,
+                                    int newLineNumber) {
+    int lineType = 0; // context
+    if (type == GitDiffLine::Type::Addition) lineType = 1;
+    else if (type == GitDiffLine::Type::Deletion) lineType = 2;
+    else if (type == GitDiffLine::Type::Header) lineType = 3;
+
+    return @{
+        @"type": @(lineType),
+        @"content": stringFromView(content),
+        @"oldLineNumber": @(oldLineNumber),
+        @"newLineNumber": @(newLineNumber)
+    };
+}
+
 @interface GitBridge() {
     std::unique_ptr<GitManager> gitManager;
+    std::unique_ptr<HistoryCursor> historyCursor;
+    GraphLayout historyGraph;  // Rows 0..size() of the cursor's history
+    // History refreshes run on the scheduler while pages load on the main thread; recursive
+    // because the page methods open the cursor on first use
+    std::recursive_mutex historyMutex;
+    std::chrono::steady_clock::time_point startupBegan;  // Of the latest open, see beginStartup
 }
 @end
 
@@ -17,16 +99,62 @@ using namespace VersionTools;
     self = [super init];
     if (self) {
         gitManager = std::make_unique<GitManager>();
+        // The changes list shows +/- counts
+        gitManager->setStatusLineStatsEnabled(true);
     }
     return self;
 }
 
+- (void)schedule:(GitTaskPriority)priority writes:(BOOL)writes block:(void (^)(void))block {
+    TaskOptions options;
+    options.priority = static_cast<TaskPriority>(priority);
+    options.access = writes ? TaskAccess::Write : TaskAccess::Read;
+    options.repository = gitManager->getRepositoryPath();
+    CommandScheduler::shared().post(std::move(options), [block]() {
+        @autoreleasepool {
+            block();
+        }
+    });
+}
+
+- (void)cancelScheduledWork {
+    CommandScheduler::shared().cancelAll(gitManager->getRepositoryPath());
+}
+
+- (uint64_t)requestRefresh:(NSString *)kind
+                 priority:(GitTaskPriority)priority
+                    block:(void (^)(uint64_t generation))block {
+    TaskOptions options;
+    options.priority = static_cast<TaskPriority>(priority);
+    options.repository = gitManager->getRepositoryPath();
+    return gitManager->requests().refresh([kind UTF8String], std::move(options), [block](uint64_t generation) {
+        @autoreleasepool {
+            block(generation);
+        }
+    });
+}
+
+- (BOOL)isCurrentRefresh:(NSString *)kind generation:(uint64_t)generation {
+    return gitManager->requests().isCurrent([kind UTF8String], generation);
+}
+
 - (BOOL)openRepository:(NSString *)path {
     std::string cppPath = [path UTF8String];
     auto result = gitManager->openRepository(cppPath);
+    std::lock_guard<std::recursive_mutex> lock(historyMutex);
+    historyCursor.reset();
+    historyGraph.clear();
     return result.isSuccess();
 }
 
+- (void)beginStartup {
+    startupBegan = std::chrono::steady_clock::now();
+}
+
+- (void)recordStartupStage:(NSString *)stage {
+    Tracer::shared().recordMilestone("startup", [stage UTF8String], startupBegan);
+}
+
 - (NSArray *)getFileChanges {
     auto status = gitManager->getStatus();
     NSMutableArray *changes = [NSMutableArray array];
@@ -90,6 +218,134 @@ using namespace VersionTools;
     return commitArray;
 }
 
+- (BOOL)streamCommitHistory:(int)maxCount pageSize:(int)pageSize handler:(BOOL (^)(NSArray *page))handler {
+    std::vector<GitCommit> page;
+    size_t limit = pageSize > 0 ? static_cast<size_t>(pageSize) : 100;
+    page.reserve(limit);
+
+    auto result = gitManager->streamCommitHistory([&](const GitCommit& commit) {
+        page.push_back(commit);
+        if (page.size() < limit) {
+            return true;
+        }
+        @autoreleasepool {
+            BOOL keepGoing = handler([self convertCommitsToArray:page]);
+            page.clear();
+            return static_cast<bool>(keepGoing);
+        }
+    }, maxCount);
+
+    if (!page.empty()) {
+        handler([self convertCommitsToArray:page]);
+    }
+    return result.isSuccess() || result.result == GitCommandResult::Cancelled;
+}
+
+- (NSInteger)openCommitHistory {
+    std::lock_guard<std::recursive_mutex> lock(historyMutex);
+    // Merges are shown: the graph needs every parent to close its lanes
+    historyCursor = std::make_unique<HistoryCursor>(gitManager->openHistory(GitLogOptions::ShowMerges));
+    historyGraph.clear();
+    return static_cast<NSInteger>(historyCursor->size());
+}
+
+// The layout is a single pass from the top, so rows are laid out up to the deepest one asked for
+- (void)layOutHistoryGraphTo:(size_t)rowCount {
+    rowCount = std::min(rowCount, historyCursor->size());
+    if (historyGraph.size() < rowCount) {
+        historyGraph.append(historyCursor->page(historyGraph.size(), rowCount - historyGraph.size()));
+    }
+}
+
+- (NSArray *)nextCommitHistoryPage:(int)pageSize {
+    std::lock_guard<std::recursive_mutex> lock(historyMutex);
+    if (!historyCursor) {
+        [self openCommitHistory];
+    }
+    size_t offset = historyCursor->position();
+    auto commits = historyCursor->next(pageSize > 0 ? static_cast<size_t>(pageSize) : 100);
+    [self layOutHistoryGraphTo:offset + commits.size()];
+    return [self convertCommitsToArray:commits graphRow:offset];
+}
+
+- (NSArray *)getCommitHistoryPage:(int)offset count:(int)count {
+    std::lock_guard<std::recursive_mutex> lock(historyMutex);
+    if (!historyCursor) {
+        [self openCommitHistory];
+    }
+    if (offset < 0 || count <= 0) {
+        return @[];
+    }
+    auto commits = historyCursor->page(static_cast<size_t>(offset), static_cast<size_t>(count));
+    [self layOutHistoryGraphTo:static_cast<size_t>(offset) + commits.size()];
+    return [self convertCommitsToArray:commits graphRow:static_cast<size_t>(offset)];
+}
+
+- (void)prefetchCommitsAroundRow:(NSInteger)row direction:(NSInteger)direction {
+    std::vector<std::string> hashes;
+    {
+        std::lock_guard<std::recursive_mutex> lock(historyMutex);
+        if (!historyCursor || row < 0 || static_cast<size_t>(row) >= historyCursor->size()) {
+            return;
+        }
+        auto rows = CommitPrefetcher::neighbourRows(static_cast<size_t>(row), static_cast<int>(direction),
+                                                    PREFETCH_COMMIT_COUNT, historyCursor->size());
+        if (rows.empty()) {
+            return;
+        }
+        auto [low, high] = std::minmax_element(rows.begin(), rows.end());
+        auto commits = historyCursor->page(*low, *high - *low + 1);
+        for (size_t r : rows) {
+            if (r - *low < commits.size()) {
+                hashes.push_back(commits[r - *low].hash);
+            }
+        }
+    }
+    gitManager->prefetchCommits(hashes);
+}
+
+- (NSData *)getFileChangesBuffer {
+    return dataFromBuffer(FlatRecords::encodeFileChanges(gitManager->getStatus().changes));
+}
+
+- (NSData *)getCommitHistoryBuffer:(int)maxCount {
+    return dataFromBuffer(FlatRecords::encodeCommits(gitManager->getCommitHistory(maxCount)));
+}
+
+- (NSData *)nextCommitHistoryPageBuffer:(int)pageSize {
+    std::lock_guard<std::recursive_mutex> lock(historyMutex);
+    if (!historyCursor) {
+        [self openCommitHistory];
+    }
+    size_t offset = historyCursor->position();
+    auto commits = historyCursor->next(pageSize > 0 ? static_cast<size_t>(pageSize) : 100);
+    [self layOutHistoryGraphTo:offset + commits.size()];
+    return dataFromBuffer(FlatRecords::encodeCommits(commits, &historyGraph, offset));
+}
+
+- (NSData *)getCommitHistoryPageBuffer:(int)offset count:(int)count {
+    std::lock_guard<std::recursive_mutex> lock(historyMutex);
+    if (!historyCursor) {
+        [self openCommitHistory];
+    }
+    std::vector<GitCommit> commits;
+    if (offset >= 0 && count > 0) {
+        commits = historyCursor->page(static_cast<size_t>(offset), static_cast<size_t>(count));
+        [self layOutHistoryGraphTo:static_cast<size_t>(offset) + commits.size()];
+    }
+    return dataFromBuffer(FlatRecords::encodeCommits(commits, &historyGraph, static_cast<size_t>(std::max(offset, 0))));
+}
+
+- (NSDictionary *)searchCommits:(NSString *)query offset:(int)offset count:(int)count {
+    auto result = gitManager->searchCommits([query UTF8String], static_cast<size_t>(std::max(offset, 0)),
+                                            static_cast<size_t>(std::max(count, 0)));
+    return @{
+        @"commits": dataFromBuffer(FlatRecords::encodeCommits(result.commits)),
+        @"hasMore": @(result.hasMore),
+        @"isComplete": @(result.isComplete())
+    };
+}
+
 - (NSArray *)getBranches {
     auto branches = gitManager->getBranches(true);
     NSMutableArray *branchArray = [NSMutableArray array];
@@ -163,30 +419,36 @@ using namespace VersionTools;
     };
 }
 
+// The prefetched whole-commit patch when there is one, else read now into holder
+static const GitPatch& commitPatch(GitManager& manager, const std::string& hash,
+                                   std::shared_ptr<const GitPatch>& cached, GitPatch& holder) {
+    cached = manager.findCommitPatch(hash);
+    if (cached) {
+        return *cached;
+    }
+    holder = manager.getCommitPatch(hash);
+    return holder;
+}
+
 - (NSArray *)getCommitChanges:(NSString *)commitHash {
     std::string hash = [commitHash UTF8String];
-    auto diffs = gitManager->getCommitDiffAll(hash);
+    std::shared_ptr<const GitPatch> cached;
+    GitPatch holder;
+    const GitPatch& patch = commitPatch(*gitManager, hash, cached, holder);
     NSMutableArray *changes = [NSMutableArray array];
     
-    for (const auto& diff : diffs) {
-        NSString *filePath = [NSString stringWithUTF8String:diff.filePath.c_str()];
-        NSString *fileName = [NSString stringWithUTF8String:GitUtils::getFileName(diff.filePath).c_str()];
-        NSString *dirPath = [NSString stringWithUTF8String:GitUtils::getDirectory(diff.filePath).c_str()];
+    for (size_t i = 0; i < patch.fileCount(); ++i) {
+        const auto& file = patch.file(i);
+        NSString *filePath = [NSString stringWithUTF8String:file.filePath.c_str()];
+        NSString *fileName = [NSString stringWithUTF8String:GitUtils::getFileName(file.filePath).c_str()];
+        NSString *dirPath = [NSString stringWithUTF8String:GitUtils::getDirectory(file.filePath).c_str()];
         
-        int linesAdded = 0, linesDeleted = 0;
-        for (const auto& hunk : diff.hunks) {
-            for (const auto& line : hunk.lines) {
-                if (line.type == GitDiffLine::Type::Addition) {
-                    linesAdded++;
-                } else if (line.type == GitDiffLine::Type::Deletion) {
-                    linesDeleted++;
-                }
-            }
-        }
+        size_t linesAdded = 0, linesDeleted = 0;
+        patch.countLines(i, linesAdded, linesDeleted);
         
         FileStatus status = FileStatus::Modified;
-        if (diff.isNewFile) status = FileStatus::Added;
-        else if (diff.isDeletedFile) status = FileStatus::Deleted;
+        if (file.isNewFile) status = FileStatus::Added;
+        else if (file.isDeletedFile) status = FileStatus::Deleted;
         
         NSDictionary *changeDict = @{
             @"filePath": filePath,
@@ -208,78 +470,90 @@ using namespace VersionTools;
     std::string path = [filePath UTF8String];
     std::string hash = [commitHash UTF8String];
     
-    auto diff = gitManager->getCommitDiff(hash);
-    if (diff.filePath != path) {
-        // If not found in single file diff, try getting from all diffs
-        auto allDiffs = gitManager->getCommitDiffAll(hash);
-        bool found = false;
-        for (const auto& d : allDiffs) {
-            if (d.filePath == path) {
-                diff = d;
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            return nil;
-        }
+    // A prefetched patch of the whole commit serves the file while it has all of its hunks; otherwise a
+    // path-limited diff-tree, a single git process regardless of how many files the commit touched
+    auto cached = gitManager->findCommitPatch(hash);
+    size_t cachedIndex = cached ? cached->findFile(path) : std::string::npos;
+    GitPatch pathPatch;
+    if (cachedIndex == std::string::npos || cached->file(cachedIndex).isTruncated) {
+        cached.reset();
+        pathPatch = gitManager->getCommitPatch(hash, path);
     }
+    const GitPatch& patch = cached ? *cached : pathPatch;
+    size_t fileIndex = patch.findFile(path);
+    if (fileIndex == std::string::npos || patch.file(fileIndex).filePath != path) {
+        return nil;
+    }
+    const auto& file = patch.file(fileIndex);
     
+    // Strings are created straight from views into the patch buffer
     NSMutableArray *hunks = [NSMutableArray array];
-    for (const auto& hunk : diff.hunks) {
-        NSMutableArray *lines = [NSMutableArray array];
+    for (size_t h = file.firstHunk; h < file.firstHunk + file.hunkCount; ++h) {
+        auto hunk = patch.hunk(h);
+        NSMutableArray *lines = [NSMutableArray arrayWithCapacity:hunk.lineCount];
         
-        for (const auto& line : hunk.lines) {
-            int lineType = 0; // context
-            if (line.type == GitDiffLine::Type::Addition) lineType = 1;
-            else if (line.type == GitDiffLine::Type::Deletion) lineType = 2;
-            else if (line.type == GitDiffLine::Type::Header) lineType = 3;
-            
-            NSDictionary *lineDict = @{
-                @"type": @(lineType),
-                @"content": [NSString stringWithUTF8String:line.content.c_str()],
-                @"oldLineNumber": @(line.oldLineNumber),
-                @"newLineNumber": @(line.newLineNumber)
-            };
-            
-            [lines addObject:lineDict];
+        for (size_t i = hunk.firstLine; i < hunk.firstLine + hunk.lineCount; ++i) {
+            auto line = patch.line(i);
+            [lines addObject:lineDictionary(line.type, line.content, line.oldLineNumber, line.newLineNumber)];
         }
         
         NSDictionary *hunkDict = @{
-            @"header": [NSString stringWithUTF8String:hunk.header.c_str()],
+            @"header": stringFromView(hunk.header),
             @"oldStart": @(hunk.oldStart),
             @"oldCount": @(hunk.oldCount),
             @"newStart": @(hunk.newStart),
             @"newCount": @(hunk.newCount),
+            @"isLoaded": @(hunk.isLoaded),
             @"lines": lines
         };
         
         [hunks addObject:hunkDict];
     }
     
-    // Generate raw content for copying
-    std::string rawContent;
-    for (const auto& hunk : diff.hunks) {
-        rawContent += hunk.header + "\n";
+    return @{
+        @"filePath": [NSString stringWithUTF8String:file.filePath.c_str()],
+        @"isBinary": @(file.isBinary),
+        @"isNewFile": @(file.isNewFile),
+        @"isDeletedFile": @(file.isDeletedFile),
+        @"isTruncated": @(file.isTruncated),
+        @"hasLongLines": @(file.hasLongLines),
+        @"hunks": hunks,
+        // Raw content for copying is the hunk section of the patch as git wrote it (only whole when not truncated)
+        @"rawContent": stringFromView(patch.hunkText(fileIndex))
+    };
+}
+
+- (NSArray *)getFileDiffHunks:(NSString *)filePath commitHash:(NSString *)commitHash
+                        first:(NSInteger)first count:(NSInteger)count {
+    std::string path = [filePath UTF8String];
+    std::string hash = [commitHash UTF8String];
+    size_t start = static_cast<size_t>(std::max<NSInteger>(first, 0));
+    size_t length = static_cast<size_t>(std::max<NSInteger>(count, 0));
+    auto diff = gitManager->getCommitDiffHunks(hash, path, start, length);
+
+    // Only the requested range, each hunk tagged with its index in the file's diff
+    NSMutableArray *hunks = [NSMutableArray array];
+    size_t end = std::min(diff.hunks.size(), start + length);
+    for (size_t h = start; h < end; ++h) {
+        const auto& hunk = diff.hunks[h];
+        NSMutableArray *lines = [NSMutableArray arrayWithCapacity:hunk.lines.size()];
         for (const auto& line : hunk.lines) {
-            if (line.type == GitDiffLine::Type::Addition) {
-                rawContent += "+" + line.content + "\n";
-            } else if (line.type == GitDiffLine::Type::Deletion) {
-                rawContent += "-" + line.content + "\n";
-            } else {
-                rawContent += " " + line.content + "\n";
-            }
+            [lines addObject:lineDictionary(line.type, line.content, line.oldLineNumber, line.newLineNumber)];
         }
+        
+        [hunks addObject:@{
+            @"index": @(h),
+            @"header": stringFromView(hunk.header),
+            @"oldStart": @(hunk.oldStart),
+            @"oldCount": @(hunk.oldCount),
+            @"newStart": @(hunk.newStart),
+            @"newCount": @(hunk.newCount),
+            @"isLoaded": @(hunk.isLoaded),
+            @"lines": lines
+        }];
     }
     
-    return @{
-        @"filePath": [NSString stringWithUTF8String:diff.filePath.c_str()],
-        @"isBinary": @(diff.isBinary),
-        @"isNewFile": @(diff.isNewFile),
-        @"isDeletedFile": @(diff.isDeletedFile),
-        @"hunks": hunks,
-        @"rawContent": [NSString stringWithUTF8String:rawContent.c_str()]
-    };
+    return hunks;
 }
 
 - (NSArray *)getBranchCommits:(NSString *)branchName maxCount:(int)maxCount {
@@ -289,6 +563,14 @@ using namespace VersionTools;
     return [self convertCommitsToArray:commits];
 }
 
+- (NSData *)getFileContent:(NSString *)filePath atRevision:(NSString *)revision {
+    auto content = gitManager->getFileContent([revision UTF8String], [filePath UTF8String]);
+    if (!content) {
+        return nil;
+    }
+    return [NSData dataWithBytes:content->data() length:content->size()];
+}
+
 // File operations
 - (BOOL)stageFile:(NSString *)filePath {
     std::string path = [filePath UTF8String];
@@ -312,6 +594,41 @@ using namespace VersionTools;
     return result.isSuccess();
 }
 
+static std::vector<std::string> pathVector(NSArray<NSString *> *filePaths) {
+    std::vector<std::string> paths;
+    paths.reserve(filePaths.count);
+    for (NSString *path in filePaths) {
+        paths.emplace_back([path UTF8String]);
+    }
+    return paths;
+}
+
+- (BOOL)stageFiles:(NSArray<NSString *> *)filePaths {
+    return gitManager->addFiles(pathVector(filePaths)).isSuccess();
+}
+
+- (BOOL)unstageFiles:(NSArray<NSString *> *)filePaths {
+    if (filePaths.count == 0) {
+        return YES;
+    }
+    return gitManager->resetFiles(pathVector(filePaths)).isSuccess();
+}
+
+- (BOOL)stageLines:(NSArray<NSNumber *> *)lineIndices ofHunk:(NSInteger)hunkIndex
+            inFile:(NSString *)filePath staged:(BOOL)staged {
+    if (hunkIndex < 0) {
+        return NO;
+    }
+    GitLineSelection selection;
+    selection.hunk = static_cast<size_t>(hunkIndex);
+    for (NSNumber *line in lineIndices) {
+        selection.lines.push_back(line.unsignedIntegerValue);
+    }
+    std::string path = [filePath UTF8String];
+    auto result = staged ? gitManager->unstageLines(path, {selection}) : gitManager->stageLines(path, {selection});
+    return result.isSuccess();
+}
+
 // Commit operations
 - (BOOL)commit:(NSString *)message {
     std::string msg = [message UTF8String];
@@ -395,6 +712,22 @@ using namespace VersionTools;
     return result.isSuccess();
 }
 
+// Remote operations
+- (void)fetch:(NSString *)remote completion:(void (^)(BOOL, NSString *))completion {
+    completeOnMainQueue(gitManager->fetchAsync([remote UTF8String]), completion);
+}
+
+- (void)pull:(NSString *)remote branch:(NSString *)branch completion:(void (^)(BOOL, NSString *))completion {
+    std::string branchName = branch ? [branch UTF8String] : "";
+    completeOnMainQueue(gitManager->pullAsync([remote UTF8String], branchName), completion);
+}
+
+- (void)push:(NSString *)remote branch:(NSString *)branch force:(BOOL)force
+  completion:(void (^)(BOOL, NSString *))completion {
+    std::string branchName = branch ? [branch UTF8String] : "";
+    completeOnMainQueue(gitManager->pushAsync([remote UTF8String], branchName, force), completion);
+}
+
 // Raw command execution
 - (NSString *)executeRawCommand:(NSString *)command {
     if (!gitManager) {
@@ -416,9 +749,16 @@ using namespace VersionTools;
 
 // Helper method to convert commits to NSArray
 - (NSArray *)convertCommitsToArray:(const std::vector<GitCommit>&)commits {
+    return [self convertCommitsToArray:commits graphRow:SIZE_MAX];
+}
+
+// graphRow is the history row of commits[0]; rows that are laid out get graphLane, graphColor,
+// graphWidth and graphEdges (flat type, from, to, color quadruples)
+- (NSArray *)convertCommitsToArray:(const std::vector<GitCommit>&)commits graphRow:(size_t)graphRow {
     NSMutableArray *commitArray = [NSMutableArray array];
     
-    for (const auto& commit : commits) {
+    for (size_t index = 0; index < commits.size(); ++index) {
+        const auto& commit = commits[index];
         NSString *hash = [NSString stringWithUTF8String:commit.hash.c_str()];
         NSString *shortHash = [NSString stringWithUTF8String:commit.shortHash.c_str()];
         NSString *author = [NSString stringWithUTF8String:commit.author.c_str()];
@@ -434,7 +774,7 @@ using namespace VersionTools;
             [parents addObject:[NSString stringWithUTF8String:parent.c_str()]];
         }
         
-        NSDictionary *commitDict = @{
+        NSMutableDictionary *commitDict = [@{
             @"hash": hash,
             @"shortHash": shortHash,
             @"author": author,
@@ -444,7 +784,23 @@ using namespace VersionTools;
             @"timestamp": date,
             @"parentHashes": parents,
             @"isMerge": @(commit.isMerge())
-        };
+        } mutableCopy];
+
+        if (graphRow != SIZE_MAX && graphRow + index < historyGraph.size()) {
+            const auto& row = historyGraph.row(graphRow + index);
+            NSMutableArray *edges = [NSMutableArray arrayWithCapacity:row.edgeCount * 4];
+            for (uint32_t i = 0; i < row.edgeCount; ++i) {
+                const auto& edge = historyGraph.edge(row.firstEdge + i);
+                [edges addObject:@(static_cast<int>(edge.type))];
+                [edges addObject:@(edge.from)];
+                [edges addObject:@(edge.to)];
+                [edges addObject:@(edge.color)];
+            }
+            commitDict[@"graphLane"] = @(row.lane);
+            commitDict[@"graphColor"] = @(row.color);
+            commitDict[@"graphWidth"] = @(row.width);
+            commitDict[@"graphEdges"] = edges;
+        }
         
         [commitArray addObject:commitDict];
     }
@@ -37,7 +37,7 @@ struct ChangesView: View {
             List {
                 if !gitManager.stagedChanges.isEmpty {
                     Section {
-                        ForEach(gitManager.stagedChanges, id: \.filePath) { change in
+                        ForEach(gitManager.stagedChanges) { change in
                             FileChangeRow(
                                 change: change,
                                 isSelected: selectedFiles.contains(change),
@@ -57,7 +57,7 @@ struct ChangesView: View {
                 
                 if !gitManager.unstagedChanges.isEmpty {
                     Section {
-                        ForEach(gitManager.unstagedChanges, id: \.filePath) { change in
+                        ForEach(gitManager.unstagedChanges) { change in
                             FileChangeRow(
                                 change: change,
                                 isSelected: selectedFiles.contains(change),
@@ -60,7 +60,7 @@ struct CommitDialogView: View {
                     
                     ScrollView {
                         LazyVStack(alignment: .leading, spacing: 4) {
-                            ForEach(gitManager.stagedChanges.prefix(5), id: \.filePath) { change in
+                            ForEach(gitManager.stagedChanges.prefix(5)) { change in
                                 HStack {
                                     StatusIndicatorView(status: change.status)
                                     Text(change.fileName)
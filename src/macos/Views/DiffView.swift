@@ -8,6 +8,10 @@ struct DiffView: View {
     @State private var showingLineNumbers = true
     @State private var wrapLines = false
     @State private var selectedHunk: Int?
+    @State private var requestedHunks = Set<Int>()
+    
+    // Hunks fetched together when an unloaded one scrolls into view
+    private static let hunkPageSize = 16
     
     var body: some View {
         VStack(spacing: 0) {
@@ -66,7 +70,8 @@ struct DiffView: View {
                         diff: diff,
                         showLineNumbers: showingLineNumbers,
                         wrapLines: wrapLines,
-                        selectedHunk: $selectedHunk
+                        selectedHunk: $selectedHunk,
+                        onNeedHunk: loadHunks(from:)
                     )
                 }
             } else {
@@ -86,10 +91,40 @@ struct DiffView: View {
     }
     
     private func loadDiff() {
+        requestedHunks.removeAll()
         gitManager.loadFileDiff(filePath: file.filePath, commitHash: commitHash) { diff in
             diffContent = diff
         }
     }
+    
+    // Fetches the run of unloaded hunks starting at index, up to a page of them
+    private func loadHunks(from index: Int) {
+        guard let diff = diffContent, !requestedHunks.contains(index) else { return }
+        var end = index
+        while end < diff.hunks.count && end - index < DiffView.hunkPageSize && !diff.hunks[end].isLoaded {
+            end += 1
+        }
+        guard end > index else { return }
+        requestedHunks.formUnion(index..<end)
+        
+        let filePath = file.filePath
+        let hash = commitHash
+        gitManager.loadFileDiffHunks(filePath: filePath, commitHash: hash, range: index..<end) { hunks in
+            // The view may have moved on to another file while the hunks loaded
+            guard filePath == file.filePath, hash == commitHash, var current = diffContent else { return }
+            for (hunkIndex, hunk) in hunks where hunkIndex < current.hunks.count {
+                current.hunks[hunkIndex] = hunk
+            }
+            diffContent = current
+            
+            // Only the first hunk of a page is loaded whatever its size; ask again for what did not fit
+            let missing = (index..<end).filter { !current.hunks[$0].isLoaded }
+            requestedHunks.subtract(missing)
+            if let next = missing.first, next > index {
+                loadHunks(from: next)
+            }
+        }
+    }
 }
 
 struct DiffContentView: View {
@@ -97,6 +132,7 @@ struct DiffContentView: View {
     let showLineNumbers: Bool
     let wrapLines: Bool
     @Binding var selectedHunk: Int?
+    let onNeedHunk: (Int) -> Void
     
     var body: some View {
         ScrollView([.horizontal, .vertical]) {
@@ -108,7 +144,8 @@ struct DiffContentView: View {
                         showLineNumbers: showLineNumbers,
                         wrapLines: wrapLines,
                         isSelected: selectedHunk == hunkIndex,
-                        onSelect: { selectedHunk = hunkIndex }
+                        onSelect: { selectedHunk = hunkIndex },
+                        onNeedLines: { onNeedHunk(hunkIndex) }
                     )
                 }
             }
@@ -126,6 +163,7 @@ struct DiffHunkView: View {
     let wrapLines: Bool
     let isSelected: Bool
     let onSelect: () -> Void
+    let onNeedLines: () -> Void
     
     var body: some View {
         VStack(alignment: .leading, spacing: 0) {
@@ -153,13 +191,27 @@ struct DiffHunkView: View {
                 onSelect()
             }
             
-            // Hunk lines
-            ForEach(Array(hunk.lines.enumerated()), id: \.offset) { lineIndex, line in
-                DiffLineView(
-                    line: line,
-                    showLineNumbers: showLineNumbers,
-                    wrapLines: wrapLines
-                )
+            // Hunk lines; a hunk past the diff budget asks for them once it is on screen
+            if hunk.isLoaded {
+                ForEach(Array(hunk.lines.enumerated()), id: \.offset) { lineIndex, line in
+                    DiffLineView(
+                        line: line,
+                        showLineNumbers: showLineNumbers,
+                        wrapLines: wrapLines
+                    )
+                }
+            } else {
+                HStack(spacing: 8) {
+                    ProgressView()
+                        .controlSize(.small)
+                    Text("Loading \(max(hunk.oldCount, hunk.newCount)) lines...")
+                        .font(.caption)
+                        .foregroundColor(.secondary)
+                }
+                .padding(.vertical, 4)
+                .onAppear {
+                    onNeedLines()
+                }
             }
         }
         .padding(.bottom, 16)
@@ -7,18 +7,9 @@ struct HistoryView: View {
     @State private var showingBranchFilter = false
     @State private var selectedBranch: String = "All Branches"
     
+    // The whole history is searched in the core index, not just the pages loaded so far
     var filteredCommits: [GitCommitWrapper] {
-        let commits = gitManager.commitHistory
-        
-        if searchText.isEmpty {
-            return commits
-        }
-        
-        return commits.filter { commit in
-            commit.message.localizedCaseInsensitiveContains(searchText) ||
-            commit.author.localizedCaseInsensitiveContains(searchText) ||
-            commit.hash.localizedCaseInsensitiveContains(searchText)
-        }
+        searchText.isEmpty ? gitManager.commitHistory : gitManager.searchResults
     }
     
     var body: some View {
@@ -33,6 +24,12 @@ struct HistoryView: View {
                         
                         TextField("Search commits...", text: $searchText)
                             .textFieldStyle(.plain)
+                        
+                        if !searchText.isEmpty && !gitManager.isSearchComplete {
+                            ProgressView()
+                                .controlSize(.small)
+                                .help("Indexing commit messages and paths")
+                        }
                     }
                     .padding(.horizontal, 8)
                     .padding(.vertical, 6)
@@ -53,6 +50,7 @@ struct HistoryView: View {
                             CommitRowView(
                                 commit: commit,
                                 isSelected: selectedCommit?.hash == commit.hash,
+                                showsGraph: searchText.isEmpty,
                                 onSelect: { selectedCommit = commit }
                             )
                             .background(
@@ -60,6 +58,14 @@ struct HistoryView: View {
                                     .fill(selectedCommit?.hash == commit.hash ? Color.blue.opacity(0.1) : Color.clear)
                             )
                             .padding(.horizontal)
+                            .onAppear {
+                                // Page in more history (or hits) when the last loaded row scrolls into view
+                                if searchText.isEmpty && commit.hash == gitManager.commitHistory.last?.hash {
+                                    gitManager.loadMoreCommitHistory()
+                                } else if !searchText.isEmpty && commit.hash == gitManager.searchResults.last?.hash {
+                                    gitManager.loadMoreSearchResults()
+                                }
+                            }
                         }
                     }
                 }
@@ -83,6 +89,16 @@ struct HistoryView: View {
                 selectedCommit = firstCommit
             }
         }
+        .onChange(of: searchText) {
+            gitManager.searchCommits(searchText)
+        }
+        .onChange(of: selectedCommit?.hash) {
+            // Rows of commitHistory are rows of the core's history; search results are not prefetched
+            if searchText.isEmpty, let hash = selectedCommit?.hash,
+               let row = gitManager.commitHistory.firstIndex(where: { $0.hash == hash }) {
+                gitManager.prefetchCommits(aroundRow: row)
+            }
+        }
         .refreshable {
             await gitManager.refreshCommitHistory()
         }
@@ -92,25 +108,32 @@ struct HistoryView: View {
 struct CommitRowView: View {
     let commit: GitCommitWrapper
     let isSelected: Bool
+    var showsGraph: Bool = true
     let isLast: Bool = false
     let onSelect: () -> Void
     
     var body: some View {
         HStack(spacing: 12) {
-            // Timeline indicator
-            VStack {
-                Circle()
-                    .fill(isSelected ? Color.blue : Color.secondary)
-                    .frame(width: 8, height: 8)
-                
-                if !isLast { // Not the last commit
-                    Rectangle()
-                        .fill(Color.secondary.opacity(0.3))
-                        .frame(width: 1)
-                        .frame(maxHeight: .infinity)
+            if showsGraph, let graph = commit.graph {
+                // Lanes come laid out from the core; rows are unpadded so the lines join up
+                CommitGraphView(row: graph, isSelected: isSelected)
+            } else {
+                // Timeline indicator
+                VStack {
+                    Circle()
+                        .fill(isSelected ? Color.blue : Color.secondary)
+                        .frame(width: 8, height: 8)
+                    
+                    if !isLast { // Not the last commit
+                        Rectangle()
+                            .fill(Color.secondary.opacity(0.3))
+                            .frame(width: 1)
+                            .frame(maxHeight: .infinity)
+                    }
                 }
+                .frame(width: 8)
+                .padding(.vertical, 8)
             }
-            .frame(width: 8)
             
             VStack(alignment: .leading, spacing: 4) {
                 // Commit message
@@ -153,8 +176,8 @@ struct CommitRowView: View {
                     Spacer()
                 }
             }
+            .padding(.vertical, 8)
         }
-        .padding(.vertical, 8)
         .contentShape(Rectangle())
         .onTapGesture {
             onSelect()
@@ -165,6 +188,49 @@ struct CommitRowView: View {
     }
 }
 
+// Draws one row of the core GraphLayout: edges from the top of the row or the
+// dot to the bottom, then the dot itself
+struct CommitGraphView: View {
+    let row: CommitGraphRow
+    let isSelected: Bool
+
+    private static let laneWidth: CGFloat = 14
+    private static let palette: [Color] = [.blue, .green, .orange, .purple, .pink, .teal, .red, .indigo]
+
+    private static func color(_ index: Int) -> Color {
+        palette[index % palette.count]
+    }
+
+    var body: some View {
+        Canvas { context, size in
+            let middle = size.height / 2
+            func x(_ lane: Int) -> CGFloat {
+                CGFloat(lane) * Self.laneWidth + Self.laneWidth / 2
+            }
+
+            for edge in row.edges {
+                var path = Path()
+                switch edge.type {
+                case .incoming:
+                    path.move(to: CGPoint(x: x(edge.from), y: 0))
+                    path.addLine(to: CGPoint(x: x(edge.to), y: middle))
+                case .outgoing:
+                    path.move(to: CGPoint(x: x(edge.from), y: middle))
+                    path.addLine(to: CGPoint(x: x(edge.to), y: size.height))
+                case .through:
+                    path.move(to: CGPoint(x: x(edge.from), y: 0))
+                    path.addLine(to: CGPoint(x: x(edge.to), y: size.height))
+                }
+                context.stroke(path, with: .color(Self.color(edge.color)), lineWidth: 1.5)
+            }
+
+            let dot = CGRect(x: x(row.lane) - 4, y: middle - 4, width: 8, height: 8)
+            context.fill(Path(ellipseIn: dot), with: .color(isSelected ? .blue : Self.color(row.color)))
+        }
+        .frame(width: CGFloat(max(row.width, 1)) * Self.laneWidth)
+    }
+}
+
 struct CommitDetailView: View {
     let commit: GitCommitWrapper
     @ObservedObject var gitManager: GitManagerWrapper
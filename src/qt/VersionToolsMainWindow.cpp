@@ -4,6 +4,7 @@
 #include "widgets/HistoryWidget.h"
 #include "widgets/BranchesWidget.h"
 #include "utils/GitWorker.h"
+#include "models/HistoryModel.h"
 #include "dialogs/SettingsDialog.h"
 #include "core/GitManager.h"
 
@@ -55,8 +56,9 @@ VersionToolsMainWindow::VersionToolsMainWindow(QWidget *parent)
     QSettings settings;
     QString lastRepo = settings.value("lastRepository").toString();
     if (!lastRepo.isEmpty() && QDir(lastRepo).exists()) {
-        QTimer::singleShot(100, [this, lastRepo]() {
-            onRepositoryOpened(lastRepo);
+        // Through the worker, so the manager opens it too; as soon as the event loop runs
+        QTimer::singleShot(0, this, [this, lastRepo]() {
+            m_gitWorker->openRepository(lastRepo);
         });
     }
 }
@@ -198,12 +200,26 @@ void VersionToolsMainWindow::connectSignals()
     
     connect(m_gitWorker, &GitWorker::repositoryOpened,
             this, &VersionToolsMainWindow::onRepositoryOpened);
+    connect(m_gitWorker, &GitWorker::repositoryHeadRead,
+            this, &VersionToolsMainWindow::onRepositoryHeadRead);
     connect(m_gitWorker, &GitWorker::statusChanged,
             this, &VersionToolsMainWindow::onRepositoryStatusChanged);
     connect(m_gitWorker, &GitWorker::operationStarted,
             this, &VersionToolsMainWindow::onGitOperationStarted);
     connect(m_gitWorker, &GitWorker::operationFinished,
             this, &VersionToolsMainWindow::onGitOperationFinished);
+
+    // Status deltas and history pages go straight into the item models
+    connect(m_gitWorker, &GitWorker::statusChanged,
+            m_changesWidget, &ChangesWidget::applyStatus);
+    connect(m_gitWorker, &GitWorker::historyLoaded,
+            m_historyWidget->model(), &HistoryModel::setHistory);
+    connect(m_gitWorker, &GitWorker::historyPageLoaded,
+            m_historyWidget->model(), &HistoryModel::appendPage);
+    connect(m_historyWidget->model(), &HistoryModel::pageRequested,
+            m_gitWorker, &GitWorker::loadHistoryPage);
+    connect(m_gitWorker, &GitWorker::branchesLoaded,
+            m_branchesWidget, &BranchesWidget::setBranches);
 }
 
 void VersionToolsMainWindow::openRepository()
@@ -275,23 +291,24 @@ void VersionToolsMainWindow::onRepositoryOpened(const QString &path)
     // Update sidebar with repository info
     m_sidebarWidget->setRepositoryPath(path);
     
-    // Refresh all widgets
+    // Clear all widgets; the worker streams status, history and branches into them as they load
     m_changesWidget->setRepository(path);
     m_historyWidget->setRepository(path);
     m_branchesWidget->setRepository(path);
-    
-    // Get current branch
-    m_gitWorker->refreshStatus();
 }
 
-void VersionToolsMainWindow::onRepositoryStatusChanged()
+void VersionToolsMainWindow::onRepositoryHeadRead(const VersionTools::GitRepository &repository)
 {
-    m_currentBranch = QString::fromStdString(m_gitManager->getCurrentBranch());
+    m_currentBranch = QString::fromStdString(repository.head);
+    updateWindowTitle();
     updateStatusBar();
-    
-    // Update sidebar status
-    auto status = m_gitManager->getStatus();
-    m_sidebarWidget->updateStatus(status);
+    m_sidebarWidget->setBranchName(m_currentBranch);
+}
+
+void VersionToolsMainWindow::onRepositoryStatusChanged()
+{
+    // Update sidebar status; the worker already read it, asking the manager again would scan twice
+    m_sidebarWidget->updateStatus(m_gitWorker->status());
 }
 
 void VersionToolsMainWindow::onGitOperationStarted(const QString &operation)
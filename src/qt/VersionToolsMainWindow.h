@@ -24,6 +24,7 @@ class GitWorker;
 
 namespace VersionTools {
 class GitManager;
+struct GitRepository;
 }
 
 class VersionToolsMainWindow : public QMainWindow
@@ -45,6 +46,7 @@ private slots:
     void showAbout();
     void onSidebarSelectionChanged(int index);
     void onRepositoryOpened(const QString &path);
+    void onRepositoryHeadRead(const VersionTools::GitRepository &repository);
     void onRepositoryStatusChanged();
     void onGitOperationStarted(const QString &operation);
     void onGitOperationFinished(const QString &operation, bool success);
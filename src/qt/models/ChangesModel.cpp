@@ -0,0 +1,283 @@
+#include "ChangesModel.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+using namespace VersionTools;
+
+namespace {
+
+// Rows handed to the view per fetchMore()
+constexpr size_t FETCH_BATCH = 256;
+// A delta touching more row ranges than this resets the model instead; every range moves the rows after it
+constexpr size_t MAX_INCREMENTAL_RANGES = 64;
+
+bool byPath(const GitFileChange &a, const GitFileChange &b)
+{
+    return a.filePath < b.filePath;
+}
+
+}
+
+ChangesModel::ChangesModel(bool staged, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_staged(staged)
+{
+}
+
+void ChangesModel::setChanges(const std::vector<GitFileChange> &changes)
+{
+    beginResetModel();
+    m_changes.clear();
+    for (const auto &change : changes) {
+        if (change.isStaged == m_staged) {
+            m_changes.push_back(change);
+        }
+    }
+    std::sort(m_changes.begin(), m_changes.end(), byPath);
+    m_fetched = std::min(FETCH_BATCH, m_changes.size());
+    endResetModel();
+}
+
+void ChangesModel::clear()
+{
+    beginResetModel();
+    m_changes.clear();
+    m_fetched = 0;
+    endResetModel();
+}
+
+void ChangesModel::applyDelta(const GitStatusDelta &delta)
+{
+    std::vector<std::string> removed;
+    std::vector<GitFileChange> inserted;
+
+    // Entries are keyed by (path, isStaged), so only those of this half touch its rows; a path that
+    // changed sides arrives as removed from one half and added to the other.
+    // Updates in place first, while the row numbers are still those the view knows
+    auto place = [&](const GitFileChange &change) {
+        if (change.isStaged != m_staged) {
+            return;
+        }
+        size_t row = lowerBound(change.filePath);
+        if (row < m_changes.size() && m_changes[row].filePath == change.filePath) {
+            m_changes[row] = change;
+            if (row < m_fetched) {
+                QModelIndex changed = index(static_cast<int>(row));
+                emit dataChanged(changed, changed);
+            }
+        } else {
+            inserted.push_back(change);
+        }
+    };
+    for (const auto &change : delta.changed) {
+        place(change);
+    }
+    for (const auto &change : delta.added) {
+        place(change);
+    }
+    for (const auto &change : delta.removed) {
+        if (change.isStaged == m_staged && contains(change.filePath)) {
+            removed.push_back(change.filePath);
+        }
+    }
+    if (removed.empty() && inserted.empty()) {
+        return;
+    }
+
+    std::vector<size_t> positions;
+    positions.reserve(removed.size());
+    for (const auto &path : removed) {
+        positions.push_back(lowerBound(path));
+    }
+    std::sort(positions.begin(), positions.end(), std::greater<size_t>());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+    std::sort(inserted.begin(), inserted.end(), byPath);
+
+    size_t ranges = 0;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (i == 0 || positions[i] + 1 != positions[i - 1]) {
+            ++ranges;
+        }
+    }
+    for (size_t i = 0; i < inserted.size(); ++i) {
+        if (i == 0 || lowerBound(inserted[i].filePath) != lowerBound(inserted[i - 1].filePath)) {
+            ++ranges;
+        }
+    }
+    if (ranges > MAX_INCREMENTAL_RANGES) {
+        resetWith(std::move(removed), std::move(inserted));
+        return;
+    }
+
+    // Bottom up, so the rows above each range keep their numbers
+    for (size_t i = 0; i < positions.size();) {
+        size_t last = positions[i];
+        size_t first = last;
+        while (++i < positions.size() && positions[i] + 1 == first) {
+            first = positions[i];
+        }
+        removeRange(first, last - first + 1);
+    }
+    for (auto end = inserted.end(); end != inserted.begin();) {
+        size_t position = lowerBound((end - 1)->filePath);
+        auto begin = end - 1;
+        while (begin != inserted.begin() && lowerBound((begin - 1)->filePath) == position) {
+            --begin;
+        }
+        insertRange(position, begin, end);
+        end = begin;
+    }
+}
+
+void ChangesModel::resetWith(std::vector<std::string> removed, std::vector<GitFileChange> inserted)
+{
+    std::sort(removed.begin(), removed.end());
+
+    beginResetModel();
+    std::vector<GitFileChange> rows;
+    rows.reserve(m_changes.size() + inserted.size());
+    auto next = removed.begin();
+    auto kept = [&](const GitFileChange &change) {
+        next = std::lower_bound(next, removed.end(), change.filePath);
+        return next == removed.end() || *next != change.filePath;
+    };
+    std::vector<GitFileChange> remaining;
+    remaining.reserve(m_changes.size());
+    for (auto &change : m_changes) {
+        if (kept(change)) {
+            remaining.push_back(std::move(change));
+        }
+    }
+    std::merge(std::make_move_iterator(remaining.begin()), std::make_move_iterator(remaining.end()),
+               std::make_move_iterator(inserted.begin()), std::make_move_iterator(inserted.end()),
+               std::back_inserter(rows), byPath);
+    m_changes = std::move(rows);
+    m_fetched = std::min(std::max(m_fetched, FETCH_BATCH), m_changes.size());
+    endResetModel();
+}
+
+void ChangesModel::removeRange(size_t first, size_t count)
+{
+    auto begin = m_changes.begin() + static_cast<std::ptrdiff_t>(first);
+    auto end = begin + static_cast<std::ptrdiff_t>(count);
+    // Rows past m_fetched were never shown and go without signals
+    size_t visibleEnd = std::min(first + count, m_fetched);
+    if (first >= visibleEnd) {
+        m_changes.erase(begin, end);
+        return;
+    }
+    beginRemoveRows(QModelIndex(), static_cast<int>(first), static_cast<int>(visibleEnd - 1));
+    m_changes.erase(begin, end);
+    m_fetched -= visibleEnd - first;
+    endRemoveRows();
+}
+
+void ChangesModel::insertRange(size_t position, std::vector<GitFileChange>::iterator begin,
+                               std::vector<GitFileChange>::iterator end)
+{
+    size_t count = static_cast<size_t>(end - begin);
+    // Among the shown rows they are shown at once; past them they wait for fetchMore(), except
+    // that a model which handed out every row (and is not a full batch yet) grows at the end
+    size_t visible = 0;
+    if (position < m_fetched) {
+        visible = count;
+    } else if (position == m_fetched && m_fetched == m_changes.size() && m_fetched < FETCH_BATCH) {
+        visible = std::min(count, FETCH_BATCH - m_fetched);
+    }
+
+    auto at = m_changes.begin() + static_cast<std::ptrdiff_t>(position);
+    if (visible == 0) {
+        m_changes.insert(at, std::make_move_iterator(begin), std::make_move_iterator(end));
+        return;
+    }
+    beginInsertRows(QModelIndex(), static_cast<int>(position), static_cast<int>(position + visible - 1));
+    m_changes.insert(at, std::make_move_iterator(begin), std::make_move_iterator(end));
+    m_fetched += visible;
+    endInsertRows();
+}
+
+size_t ChangesModel::lowerBound(const std::string &path) const
+{
+    auto it = std::lower_bound(m_changes.begin(), m_changes.end(), path,
+                               [](const GitFileChange &change, const std::string &value) {
+                                   return change.filePath < value;
+                               });
+    return static_cast<size_t>(it - m_changes.begin());
+}
+
+bool ChangesModel::contains(const std::string &path) const
+{
+    size_t row = lowerBound(path);
+    return row < m_changes.size() && m_changes[row].filePath == path;
+}
+
+const GitFileChange *ChangesModel::changeAt(int row) const
+{
+    if (row < 0 || static_cast<size_t>(row) >= m_fetched) {
+        return nullptr;
+    }
+    return &m_changes[static_cast<size_t>(row)];
+}
+
+int ChangesModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_fetched);
+}
+
+QVariant ChangesModel::data(const QModelIndex &index, int role) const
+{
+    const GitFileChange *change = index.isValid() ? changeAt(index.row()) : nullptr;
+    if (!change) {
+        return QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case FilePathRole:
+        return QString::fromStdString(change->filePath);
+    case Qt::ToolTipRole:
+        if (!change->oldPath.empty()) {
+            return tr("%1 (from %2)").arg(QString::fromStdString(change->filePath),
+                                          QString::fromStdString(change->oldPath));
+        }
+        return QString::fromStdString(change->filePath);
+    case OldPathRole:
+        return QString::fromStdString(change->oldPath);
+    case StatusRole:
+        return static_cast<int>(change->status);
+    case LinesAddedRole:
+        return static_cast<qulonglong>(change->linesAdded);
+    case LinesDeletedRole:
+        return static_cast<qulonglong>(change->linesDeleted);
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> ChangesModel::roleNames() const
+{
+    auto roles = QAbstractListModel::roleNames();
+    roles.insert(FilePathRole, "filePath");
+    roles.insert(OldPathRole, "oldPath");
+    roles.insert(StatusRole, "status");
+    roles.insert(LinesAddedRole, "linesAdded");
+    roles.insert(LinesDeletedRole, "linesDeleted");
+    return roles;
+}
+
+bool ChangesModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_fetched < m_changes.size();
+}
+
+void ChangesModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid() || m_fetched >= m_changes.size()) {
+        return;
+    }
+    size_t count = std::min(FETCH_BATCH, m_changes.size() - m_fetched);
+    beginInsertRows(QModelIndex(), static_cast<int>(m_fetched), static_cast<int>(m_fetched + count - 1));
+    m_fetched += count;
+    endInsertRows();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <string>
+#include <vector>
+#include "core/GitTypes.h"
+
+// The staged or the unstaged half of the working tree status, sorted by path.
+// Status deltas turn into inserts, removals and dataChanged() of just the rows
+// they touch, so views keep their selection and scroll position. Rows reach
+// the view in batches through canFetchMore()/fetchMore(), so a list of 100k
+// changes costs the view only the rows scrolled to.
+class ChangesModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        FilePathRole = Qt::UserRole + 1,
+        OldPathRole,
+        StatusRole,
+        LinesAddedRole,
+        LinesDeletedRole
+    };
+
+    explicit ChangesModel(bool staged, QObject *parent = nullptr);
+
+    // Replaces every row, keeping the changes of this model's half
+    void setChanges(const std::vector<VersionTools::GitFileChange> &changes);
+    // Applies what changed since the status the rows were built from; an entry
+    // whose isStaged flipped is removed from one model and added to the other
+    void applyDelta(const VersionTools::GitStatusDelta &delta);
+    void clear();
+
+    // nullptr past the fetched rows
+    const VersionTools::GitFileChange *changeAt(int row) const;
+    // Including the rows not fetched yet
+    int totalCount() const { return static_cast<int>(m_changes.size()); }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private:
+    // Index of path in m_changes, or where it would be inserted
+    size_t lowerBound(const std::string &path) const;
+    bool contains(const std::string &path) const;
+    // Rebuilds the rows in one pass; for deltas that would scatter into many row ranges
+    void resetWith(std::vector<std::string> removed, std::vector<VersionTools::GitFileChange> inserted);
+    void removeRange(size_t first, size_t count);
+    void insertRange(size_t position, std::vector<VersionTools::GitFileChange>::iterator begin,
+                     std::vector<VersionTools::GitFileChange>::iterator end);
+
+    bool m_staged;
+    std::vector<VersionTools::GitFileChange> m_changes;  // Sorted by filePath
+    size_t m_fetched = 0;                                // Rows [0, m_fetched) are shown to the view
+};
@@ -0,0 +1,158 @@
+#include "HistoryModel.h"
+#include <QDateTime>
+#include <algorithm>
+#include <chrono>
+
+using namespace VersionTools;
+
+namespace {
+
+// Commits asked for per fetchMore()
+constexpr int PAGE_SIZE = 200;
+
+}
+
+HistoryModel::HistoryModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+void HistoryModel::clear()
+{
+    beginResetModel();
+    m_commits.clear();
+    m_totalCount = 0;
+    m_pagePending = false;
+    endResetModel();
+}
+
+void HistoryModel::setHistory(int totalCount, const std::vector<GitCommit> &firstPage)
+{
+    // A page still asked of the previous history is not delivered any more
+    m_pagePending = false;
+
+    // New commits on top of the rows already shown: insert just those
+    if (!m_commits.empty()) {
+        const std::string &top = m_commits.front().hash;
+        auto it = std::find_if(firstPage.begin(), firstPage.end(),
+                               [&](const GitCommit &commit) { return commit.hash == top; });
+        int added = static_cast<int>(it - firstPage.begin());
+        if (it != firstPage.end() && totalCount == m_totalCount + added) {
+            if (added > 0) {
+                beginInsertRows(QModelIndex(), 0, added - 1);
+                m_commits.insert(m_commits.begin(), firstPage.begin(), it);
+                m_totalCount = totalCount;
+                endInsertRows();
+            }
+            return;
+        }
+    }
+
+    beginResetModel();
+    m_commits = firstPage;
+    m_totalCount = std::max(totalCount, static_cast<int>(firstPage.size()));
+    endResetModel();
+}
+
+void HistoryModel::appendPage(int offset, const std::vector<GitCommit> &commits)
+{
+    if (offset != static_cast<int>(m_commits.size())) {
+        return;
+    }
+    m_pagePending = false;
+    if (commits.empty()) {
+        // The history ended early; stop asking
+        m_totalCount = static_cast<int>(m_commits.size());
+        return;
+    }
+    beginInsertRows(QModelIndex(), offset, offset + static_cast<int>(commits.size()) - 1);
+    m_commits.insert(m_commits.end(), commits.begin(), commits.end());
+    m_totalCount = std::max(m_totalCount, static_cast<int>(m_commits.size()));
+    endInsertRows();
+}
+
+const GitCommit *HistoryModel::commitAt(int row) const
+{
+    if (row < 0 || static_cast<size_t>(row) >= m_commits.size()) {
+        return nullptr;
+    }
+    return &m_commits[static_cast<size_t>(row)];
+}
+
+int HistoryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_commits.size());
+}
+
+int HistoryModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant HistoryModel::data(const QModelIndex &index, int role) const
+{
+    const GitCommit *commit = index.isValid() ? commitAt(index.row()) : nullptr;
+    if (!commit) {
+        return QVariant();
+    }
+
+    if (role == HashRole) {
+        return QString::fromStdString(commit->hash);
+    }
+    if (role == Qt::ToolTipRole) {
+        return QString::fromStdString(commit->message);
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case SubjectColumn:
+        return QString::fromStdString(commit->shortMessage);
+    case AuthorColumn:
+        return QString::fromStdString(commit->author);
+    case DateColumn: {
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(commit->timestamp.time_since_epoch());
+        return QDateTime::fromSecsSinceEpoch(seconds.count());
+    }
+    case HashColumn:
+        return QString::fromStdString(commit->shortHash);
+    default:
+        return QVariant();
+    }
+}
+
+QVariant HistoryModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case SubjectColumn:
+        return tr("Subject");
+    case AuthorColumn:
+        return tr("Author");
+    case DateColumn:
+        return tr("Date");
+    case HashColumn:
+        return tr("Commit");
+    default:
+        return QVariant();
+    }
+}
+
+bool HistoryModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !m_pagePending && static_cast<int>(m_commits.size()) < m_totalCount;
+}
+
+void HistoryModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    // One page in flight at a time; the view asks again once it has arrived and is scrolled through
+    m_pagePending = true;
+    int offset = static_cast<int>(m_commits.size());
+    emit pageRequested(offset, std::min(PAGE_SIZE, m_totalCount - offset));
+}
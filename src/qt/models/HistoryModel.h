@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <vector>
+#include "core/GitTypes.h"
+
+// Commit history, loaded a page at a time as the view scrolls: fetchMore()
+// asks for the next page through pageRequested() and the rows appear when
+// appendPage() delivers it. A reloaded history that only gained commits on
+// top inserts just those rows, so a refresh after a commit or pull does not
+// reset the view.
+class HistoryModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        SubjectColumn,
+        AuthorColumn,
+        DateColumn,
+        HashColumn,
+        ColumnCount
+    };
+
+    enum Roles {
+        HashRole = Qt::UserRole + 1
+    };
+
+    explicit HistoryModel(QObject *parent = nullptr);
+
+    void clear();
+    // nullptr past the loaded rows
+    const VersionTools::GitCommit *commitAt(int row) const;
+    int totalCount() const { return m_totalCount; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+public slots:
+    // First page of a freshly opened history of totalCount commits
+    void setHistory(int totalCount, const std::vector<VersionTools::GitCommit> &firstPage);
+    // Rows [offset, offset + commits.size()); a page that does not continue the loaded rows is dropped
+    void appendPage(int offset, const std::vector<VersionTools::GitCommit> &commits);
+
+signals:
+    // Answered with appendPage()
+    void pageRequested(int offset, int count);
+
+private:
+    std::vector<VersionTools::GitCommit> m_commits;
+    int m_totalCount = 0;
+    bool m_pagePending = false;
+};
@@ -1,45 +1,316 @@
 #include "GitWorker.h"
+#include "core/CommandScheduler.h"
 #include "core/GitManager.h"
+#include "core/GitStatusCache.h"
+#include "core/Trace.h"
 #include <QDebug>
+#include <QMetaObject>
+#include <QPointer>
 
 using namespace VersionTools;
 
+namespace {
+
+// First page of the history, and the size of the pages models ask for afterwards
+constexpr size_t HISTORY_PAGE_SIZE = 200;
+
+struct StatusScan {
+    std::shared_ptr<const GitStatus> status;
+    GitStatusDelta delta;
+};
+
+struct HistoryStart {
+    std::shared_ptr<const HistoryCursor> cursor;
+    std::vector<GitCommit> firstPage;
+};
+
+}
+
+// Continuations run on the context's event loop, and are dropped once it is destroyed
+static Executor eventLoopExecutor(QObject *context)
+{
+    QPointer<QObject> guard(context);
+    return [guard](std::function<void()> work) {
+        if (guard) {
+            QMetaObject::invokeMethod(guard, std::move(work), Qt::QueuedConnection);
+        }
+    };
+}
+
 GitWorker::GitWorker(VersionTools::GitManager *gitManager, QObject *parent)
     : QObject(parent)
     , m_gitManager(gitManager)
+    , m_statusPollTimer(new QTimer(this))
+    , m_refreshTimer(new QTimer(this))
+    , m_status(std::make_shared<const GitStatus>())
 {
+    // Cheap while nothing changed: the status cache only drains pending file events
+    m_statusPollTimer->setInterval(1000);
+    connect(m_statusPollTimer, &QTimer::timeout, this, &GitWorker::pollStatus);
+
+    // Every action asks for a refresh, and opening a repository asks twice; one scan covers them all
+    m_refreshTimer->setSingleShot(true);
+    m_refreshTimer->setInterval(30);
+    connect(m_refreshTimer, &QTimer::timeout, this, &GitWorker::runRefresh);
 }
 
 void GitWorker::openRepository(const QString &path)
 {
+    if (m_opening) {
+        // The newest request wins once the open in progress is done
+        m_queuedOpen = path;
+        return;
+    }
+    m_opening = true;
+    m_openStarted = std::chrono::steady_clock::now();
     emit operationStarted(tr("Opening repository..."));
-    
-    auto result = m_gitManager->openRepository(path.toStdString());
-    
+
+    // Nothing here touches the manager until the open is back: results still in flight for the
+    // current repository are dropped, and polling resumes only if the open fails
+    ++m_repositoryGeneration;
+    m_openStagesPending = 0;
+    bool wasPolling = m_statusPollTimer->isActive();
+    m_statusPollTimer->stop();
+    m_refreshTimer->stop();
+
+    // The open replaces the status cache, ref cache and object reader that tasks of the current
+    // repository may be using right now: those still queued are dropped, the running ones cancelled
+    // and waited out first. Unkeyed, so reopening the current repository does not wait on itself.
+    GitManager *manager = m_gitManager;
+    std::string target = path.toStdString();
+    TaskOptions options;
+    options.priority = TaskPriority::Interactive;
+    CommandScheduler::shared().start(std::move(options), [manager, target]() {
+        std::string previous = manager->getRepositoryPath();
+        if (!previous.empty() && manager->isValidRepository(target)) {
+            CommandScheduler::shared().cancelAll(previous);
+            CommandScheduler::shared().waitIdle(previous);
+        }
+        return manager->openRepository(target);
+    }).then(eventLoopExecutor(this), [this, path, wasPolling](const GitOperationResult &result) {
+        repositoryOpenFinished(path, result, wasPolling);
+    }, [this, path, wasPolling](std::exception_ptr error) {
+        GitOperationResult result{GitCommandResult::Failed, "", "Failed to open repository", 1};
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::exception &e) {
+            result.error = e.what();
+        } catch (...) {
+        }
+        repositoryOpenFinished(path, result, wasPolling);
+    });
+}
+
+void GitWorker::repositoryOpenFinished(const QString &path, const GitOperationResult &result, bool wasPolling)
+{
+    m_opening = false;
     if (result.isSuccess()) {
+        // The first scan here diffs against nothing, so its delta lists every change
+        ++m_repositoryGeneration;
+        m_status = std::make_shared<const GitStatus>();
+        m_history.reset();
+        ++m_historyGeneration;
+        m_openStagesPending = AllStages;
+
+        // Started before anything is shown, so the git processes run while the window paints;
+        // each stage streams into its view as it arrives, and the open finishes with the last
+        scanStatus(false);
+        loadHistory();
+        loadBranches();
+
+        // File reads only, so the repository and its branch show without waiting on git
         emit repositoryOpened(path);
-        emit operationFinished(tr("Repository opened"), true);
-        
-        // Refresh status after opening
-        refreshStatus();
+        emit repositoryHeadRead(m_gitManager->getRepositoryHead());
+        Tracer::shared().recordMilestone("startup", "first paint", m_openStarted);
     } else {
+        // Nothing was cancelled: the current repository stays open as it was
+        if (wasPolling) {
+            m_statusPollTimer->start();
+        }
         emit errorOccurred(QString::fromStdString(result.error));
         emit operationFinished(tr("Failed to open repository"), false);
     }
+
+    if (!m_queuedOpen.isEmpty()) {
+        QString next = m_queuedOpen;
+        m_queuedOpen.clear();
+        openRepository(next);
+    }
+}
+
+bool GitWorker::refuseWhileOpening(const QString &failed)
+{
+    if (!m_opening) {
+        return false;
+    }
+    emit errorOccurred(tr("A repository is being opened"));
+    emit operationFinished(failed, false);
+    return true;
 }
 
 void GitWorker::refreshStatus()
 {
-    emit operationStarted(tr("Refreshing status..."));
-    
-    try {
-        // Get repository status
-        auto status = m_gitManager->getStatus();
-        emit statusChanged();
-        emit operationFinished(tr("Status refreshed"), true);
-    } catch (const std::exception &e) {
-        emit errorOccurred(QString::fromUtf8(e.what()));
-        emit operationFinished(tr("Failed to refresh status"), false);
+    // Restarting a running timer pushes the refresh back, so a burst ends in a single refresh
+    m_refreshTimer->start();
+}
+
+void GitWorker::runRefresh()
+{
+    scanStatus(true);
+}
+
+void GitWorker::pollStatus()
+{
+    if (!m_refreshTimer->isActive()) {
+        scanStatus(false);
+    }
+}
+
+void GitWorker::scanStatus(bool announce)
+{
+    // The open scans once it is done
+    if (m_opening) {
+        return;
+    }
+    // One scan at a time; requests meanwhile share one trailing scan. A scan still running for
+    // a previous repository does not hold this one back, its result is dropped anyway.
+    if (m_scanRunning && m_scanGeneration == m_repositoryGeneration) {
+        m_scanPending = m_scanPending || announce;
+        return;
+    }
+    m_scanRunning = true;
+    m_scanPending = false;
+    m_scanGeneration = m_repositoryGeneration;
+    if (announce) {
+        emit operationStarted(tr("Refreshing status..."));
+    }
+
+    // The scan and the diff against the previous status run on the scheduler; only the delta is applied here
+    uint64_t generation = m_repositoryGeneration;
+    auto previous = m_status;
+    auto finished = [this, generation, announce](bool success) {
+        if (generation != m_scanGeneration) {
+            // Superseded by the scan of the repository opened since
+            return;
+        }
+        m_scanRunning = false;
+        if (announce && generation == m_repositoryGeneration) {
+            emit operationFinished(success ? tr("Status refreshed") : tr("Failed to refresh status"), success);
+        }
+        openStageFinished(StatusStage, generation);
+        if (m_scanPending) {
+            m_scanPending = false;
+            scanStatus(true);
+        }
+    };
+    m_gitManager->runAsync(TaskPriority::Interactive, TaskAccess::Read, [previous](GitManager &manager) {
+        // Only the paths that changed since the last refresh are re-queried
+        StatusScan scan;
+        scan.status = std::make_shared<const GitStatus>(manager.getStatus());
+        scan.delta = GitStatusCache::diff(*previous, *scan.status);
+        return scan;
+    }).then(eventLoopExecutor(this), [this, generation, finished](const StatusScan &scan) {
+        if (generation == m_repositoryGeneration && !scan.delta.isEmpty()) {
+            m_status = scan.status;
+            if (scan.delta.branchChanged) {
+                emit repositoryHeadRead(m_gitManager->getRepositoryHead());
+            }
+            emit statusChanged(*m_status, scan.delta);
+        }
+        finished(true);
+    }, [this, finished](std::exception_ptr error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const TaskCancelled &) {
+            // Dropped by the open of another repository
+        } catch (const std::exception &e) {
+            emit errorOccurred(QString::fromUtf8(e.what()));
+        } catch (...) {
+        }
+        finished(false);
+    });
+}
+
+void GitWorker::loadHistory()
+{
+    if (m_opening) {
+        return;
+    }
+    uint64_t repositoryGeneration = m_repositoryGeneration;
+    uint64_t generation = ++m_historyGeneration;
+    m_gitManager->runAsync(TaskPriority::Interactive, TaskAccess::Read, [](GitManager &manager) {
+        HistoryStart start;
+        start.cursor = std::make_shared<const HistoryCursor>(manager.openHistory());
+        start.firstPage = start.cursor->page(0, HISTORY_PAGE_SIZE);
+        return start;
+    }).then(eventLoopExecutor(this), [this, repositoryGeneration, generation](const HistoryStart &start) {
+        if (generation != m_historyGeneration) {
+            return;
+        }
+        m_history = start.cursor;
+        emit historyLoaded(static_cast<int>(m_history->size()), start.firstPage);
+        openStageFinished(HistoryStage, repositoryGeneration);
+    }, [this, repositoryGeneration, generation](std::exception_ptr) {
+        if (generation == m_historyGeneration) {
+            openStageFinished(HistoryStage, repositoryGeneration);
+        }
+    });
+}
+
+void GitWorker::loadHistoryPage(int offset, int count)
+{
+    if (m_opening || !m_history || offset < 0 || count <= 0) {
+        return;
+    }
+    uint64_t generation = m_historyGeneration;
+    auto history = m_history;
+    m_gitManager->runAsync(TaskPriority::Interactive, TaskAccess::Read, [history, offset, count](GitManager &) {
+        return history->page(static_cast<size_t>(offset), static_cast<size_t>(count));
+    }).then(eventLoopExecutor(this), [this, generation, offset](const std::vector<GitCommit> &commits) {
+        if (generation == m_historyGeneration) {
+            emit historyPageLoaded(offset, commits);
+        }
+    });
+}
+
+void GitWorker::loadBranches()
+{
+    if (m_opening) {
+        return;
+    }
+    uint64_t generation = m_repositoryGeneration;
+    m_gitManager->runAsync(TaskPriority::Interactive, TaskAccess::Read, [](GitManager &manager) {
+        return manager.getBranches(true);
+    }).then(eventLoopExecutor(this), [this, generation](const std::vector<GitBranch> &branches) {
+        if (generation == m_repositoryGeneration) {
+            emit branchesLoaded(branches);
+            openStageFinished(BranchesStage, generation);
+        }
+    }, [this, generation](std::exception_ptr) {
+        openStageFinished(BranchesStage, generation);
+    });
+}
+
+void GitWorker::openStageFinished(OpenStage stage, uint64_t generation)
+{
+    // Later refreshes of the same stage are not part of the open
+    if (generation != m_repositoryGeneration || !(m_openStagesPending & stage)) {
+        return;
+    }
+    m_openStagesPending &= ~stage;
+    const char *name = stage == StatusStage ? "status" : stage == HistoryStage ? "history" : "refs";
+    Tracer::shared().recordMilestone("startup", name, m_openStarted);
+
+    // The status cache is set up by the first scan; without notifications every refresh
+    // is a full scan, so only poll while watching
+    if (stage == StatusStage && m_gitManager->isWatchingStatus()) {
+        m_statusPollTimer->start();
+    }
+
+    if (m_openStagesPending == 0) {
+        Tracer::shared().recordMilestone("startup", "interactive", m_openStarted);
+        emit operationFinished(tr("Repository opened"), true);
+        emit repositoryReady();
     }
 }
 
@@ -52,15 +323,9 @@ void GitWorker::stageFiles(const QStringList &files)
         fileList.push_back(file.toStdString());
     }
     
-    auto result = m_gitManager->addFiles(fileList);
-    
-    if (result.isSuccess()) {
-        emit statusChanged();
-        emit operationFinished(tr("Files staged"), true);
-    } else {
-        emit errorOccurred(QString::fromStdString(result.error));
-        emit operationFinished(tr("Failed to stage files"), false);
-    }
+    runMutation(tr("Files staged"), tr("Failed to stage files"), false, [fileList](GitManager &manager) {
+        return manager.addFiles(fileList);
+    });
 }
 
 void GitWorker::unstageFiles(const QStringList &files)
@@ -72,75 +337,122 @@ void GitWorker::unstageFiles(const QStringList &files)
         fileList.push_back(file.toStdString());
     }
     
-    auto result = m_gitManager->resetFiles(fileList);
-    
-    if (result.isSuccess()) {
-        emit statusChanged();
-        emit operationFinished(tr("Files unstaged"), true);
-    } else {
-        emit errorOccurred(QString::fromStdString(result.error));
-        emit operationFinished(tr("Failed to unstage files"), false);
-    }
+    runMutation(tr("Files unstaged"), tr("Failed to unstage files"), false, [fileList](GitManager &manager) {
+        return manager.resetFiles(fileList);
+    });
 }
 
 void GitWorker::commitChanges(const QString &message)
 {
     emit operationStarted(tr("Creating commit..."));
     
-    auto result = m_gitManager->commit(message.toStdString());
-    
-    if (result.isSuccess()) {
-        emit statusChanged();
-        emit operationFinished(tr("Commit created"), true);
-    } else {
-        emit errorOccurred(QString::fromStdString(result.error));
-        emit operationFinished(tr("Failed to create commit"), false);
+    runMutation(tr("Commit created"), tr("Failed to create commit"), true,
+                [message = message.toStdString()](GitManager &manager) {
+        return manager.commit(message);
+    });
+}
+
+void GitWorker::runMutation(const QString &finished, const QString &failed, bool changesHistory,
+                            std::function<GitOperationResult(GitManager &)> work)
+{
+    if (refuseWhileOpening(failed)) {
+        return;
     }
+    uint64_t generation = m_repositoryGeneration;
+    auto onResult = [this, finished, failed, changesHistory, generation](const GitOperationResult &result) {
+        if (result.isSuccess()) {
+            // The repository may have been switched while the task ran
+            if (generation == m_repositoryGeneration) {
+                refreshStatus();
+                if (changesHistory) {
+                    loadHistory();
+                }
+            }
+            emit operationFinished(finished, true);
+        } else {
+            emit errorOccurred(QString::fromStdString(result.error));
+            emit operationFinished(failed, false);
+        }
+    };
+    m_gitManager->runAsync(TaskPriority::Normal, TaskAccess::Write, std::move(work))
+        .then(eventLoopExecutor(this), onResult, [this, failed](std::exception_ptr) {
+            emit operationFinished(failed, false);
+        });
 }
 
 void GitWorker::fetchRepository()
 {
     emit operationStarted(tr("Fetching from remote..."));
-    
-    auto result = m_gitManager->fetch();
-    
-    if (result.isSuccess()) {
-        emit statusChanged();
-        emit operationFinished(tr("Fetch completed"), true);
-    } else {
-        emit errorOccurred(QString::fromStdString(result.error));
-        emit operationFinished(tr("Failed to fetch"), false);
+    if (refuseWhileOpening(tr("Failed to fetch"))) {
+        return;
     }
+
+    m_remoteToken = CancellationToken();
+    m_gitManager->fetchAsync("origin", nullptr, m_remoteToken)
+        .then(eventLoopExecutor(this), [this](const GitOperationResult &result) {
+            if (result.isSuccess()) {
+                refreshStatus();
+                emit operationFinished(tr("Fetch completed"), true);
+            } else {
+                emit errorOccurred(QString::fromStdString(result.error));
+                emit operationFinished(tr("Failed to fetch"), false);
+            }
+        }, [this](std::exception_ptr) {
+            // Dropped by the open of another repository
+            emit operationFinished(tr("Failed to fetch"), false);
+        });
 }
 
 void GitWorker::pullRepository()
 {
     emit operationStarted(tr("Pulling from remote..."));
-    
-    auto result = m_gitManager->pull();
-    
-    if (result.isSuccess()) {
-        emit statusChanged();
-        emit operationFinished(tr("Pull completed"), true);
-    } else {
-        emit errorOccurred(QString::fromStdString(result.error));
-        emit operationFinished(tr("Failed to pull"), false);
+    if (refuseWhileOpening(tr("Failed to pull"))) {
+        return;
     }
+
+    m_remoteToken = CancellationToken();
+    m_gitManager->pullAsync("origin", "", nullptr, m_remoteToken)
+        .then(eventLoopExecutor(this), [this](const GitOperationResult &result) {
+            if (result.isSuccess()) {
+                refreshStatus();
+                loadHistory();
+                emit operationFinished(tr("Pull completed"), true);
+            } else {
+                emit errorOccurred(QString::fromStdString(result.error));
+                emit operationFinished(tr("Failed to pull"), false);
+            }
+        }, [this](std::exception_ptr) {
+            // Dropped by the open of another repository
+            emit operationFinished(tr("Failed to pull"), false);
+        });
 }
 
 void GitWorker::pushRepository()
 {
     emit operationStarted(tr("Pushing to remote..."));
-    
-    auto result = m_gitManager->push();
-    
-    if (result.isSuccess()) {
-        emit statusChanged();
-        emit operationFinished(tr("Push completed"), true);
-    } else {
-        emit errorOccurred(QString::fromStdString(result.error));
-        emit operationFinished(tr("Failed to push"), false);
+    if (refuseWhileOpening(tr("Failed to push"))) {
+        return;
     }
+
+    m_remoteToken = CancellationToken();
+    m_gitManager->pushAsync("origin", "", false, nullptr, m_remoteToken)
+        .then(eventLoopExecutor(this), [this](const GitOperationResult &result) {
+            if (result.isSuccess()) {
+                refreshStatus();
+                emit operationFinished(tr("Push completed"), true);
+            } else {
+                emit errorOccurred(QString::fromStdString(result.error));
+                emit operationFinished(tr("Failed to push"), false);
+            }
+        }, [this](std::exception_ptr) {
+            // Dropped by the open of another repository
+            emit operationFinished(tr("Failed to push"), false);
+        });
+}
+
+void GitWorker::cancelRemoteOperation()
+{
+    m_remoteToken.cancel();
 }
 
 #include "GitWorker.moc"
\ No newline at end of file
@@ -3,9 +3,19 @@
 #include <QObject>
 #include <QThread>
 #include <QString>
+#include <QTimer>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "core/CancellationToken.h"
+#include "core/GitTypes.h"
 
 namespace VersionTools {
 class GitManager;
+class HistoryCursor;
+struct GitOperationResult;
 }
 
 class GitWorker : public QObject
@@ -15,8 +25,17 @@ class GitWorker : public QObject
 public:
     explicit GitWorker(VersionTools::GitManager *gitManager, QObject *parent = nullptr);
 
+    // Status read by the last refresh; valid when statusChanged() is emitted
+    const VersionTools::GitStatus &status() const { return *m_status; }
+
 public slots:
+    // Opens in stages without blocking the event loop: the current
+    // repository's tasks are drained and the new one opened on the scheduler,
+    // then HEAD is read from the git directory and announced at once, while
+    // status, history and branches load in parallel on the scheduler and each
+    // arrive through their own signal
     void openRepository(const QString &path);
+    // Requests a refresh; requests made in quick succession run as one trailing refresh
     void refreshStatus();
     void stageFiles(const QStringList &files);
     void unstageFiles(const QStringList &files);
@@ -24,14 +43,77 @@ public slots:
     void fetchRepository();
     void pullRepository();
     void pushRepository();
+    // Kills the git process of the fetch, pull or push in progress
+    void cancelRemoteOperation();
+    // (Re)opens the history and delivers its first page through historyLoaded()
+    void loadHistory();
+    // Rows of the opened history, delivered through historyPageLoaded()
+    void loadHistoryPage(int offset, int count);
+    // Local and remote branches, delivered through branchesLoaded()
+    void loadBranches();
+
+private slots:
+    // Picks up filesystem changes between explicit refreshes
+    void pollStatus();
+    void runRefresh();
+
+private:
+    // Scans on the scheduler and emits statusChanged() when something changed;
+    // announce reports the scan through operationStarted()/operationFinished()
+    void scanStatus(bool announce);
+    // Runs work as a Write task of the repository, so no scan holds index.lock meanwhile, and
+    // reports it through operationFinished(); a success refreshes the status (and the history)
+    void runMutation(const QString &finished, const QString &failed, bool changesHistory,
+                     std::function<VersionTools::GitOperationResult(VersionTools::GitManager &)> work);
+    enum OpenStage {
+        StatusStage = 1,
+        HistoryStage = 2,
+        BranchesStage = 4,
+        AllStages = StatusStage | HistoryStage | BranchesStage
+    };
+    // Records the stage of the open in progress, and the open itself once its last stage arrived
+    void openStageFinished(OpenStage stage, uint64_t generation);
+    // Back on the event loop once the scheduler opened path (or failed to); starts the stages
+    void repositoryOpenFinished(const QString &path, const VersionTools::GitOperationResult &result,
+                                bool wasPolling);
+    // While an open is in progress nothing may use the manager; reports the refusal as failed
+    bool refuseWhileOpening(const QString &failed);
 
 signals:
     void repositoryOpened(const QString &path);
-    void statusChanged();
+    // HEAD of the opened repository, or of the current one after it moved; no status yet
+    void repositoryHeadRead(const VersionTools::GitRepository &repository);
+    // After the status, the history and the branches of an opened repository have all been delivered
+    void repositoryReady();
+    // delta turns the previous status into this one, so models apply only what changed
+    void statusChanged(const VersionTools::GitStatus &status, const VersionTools::GitStatusDelta &delta);
+    void historyLoaded(int totalCount, const std::vector<VersionTools::GitCommit> &firstPage);
+    void historyPageLoaded(int offset, const std::vector<VersionTools::GitCommit> &commits);
+    void branchesLoaded(const std::vector<VersionTools::GitBranch> &branches);
     void operationStarted(const QString &operation);
     void operationFinished(const QString &operation, bool success);
     void errorOccurred(const QString &error);
 
 private:
     VersionTools::GitManager *m_gitManager;
+    QTimer *m_statusPollTimer;
+    QTimer *m_refreshTimer;
+    // Shared with the scan diffing against it, so neither copies it
+    std::shared_ptr<const VersionTools::GitStatus> m_status;
+    bool m_scanRunning = false;
+    bool m_scanPending = false;
+    uint64_t m_scanGeneration = 0;  // Repository generation of the running scan
+    std::shared_ptr<const VersionTools::HistoryCursor> m_history;
+    // Bumped by openRepository() and loadHistory(); results of older ones are dropped
+    uint64_t m_repositoryGeneration = 0;
+    uint64_t m_historyGeneration = 0;
+    // Set from openRepository() until the scheduler is back with the result; an open requested
+    // meanwhile waits in m_queuedOpen
+    bool m_opening = false;
+    QString m_queuedOpen;
+    // Of the open in progress, for its "startup" trace spans
+    std::chrono::steady_clock::time_point m_openStarted;
+    int m_openStagesPending = 0;  // OpenStage flags
+    // Of the fetch, pull or push in progress
+    VersionTools::CancellationToken m_remoteToken;
 };
\ No newline at end of file
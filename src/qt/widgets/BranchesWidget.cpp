@@ -1,18 +1,43 @@
 #include "BranchesWidget.h"
 #include "core/GitManager.h"
 #include <QVBoxLayout>
-#include <QLabel>
+#include <QListWidget>
+#include <QFont>
 
 BranchesWidget::BranchesWidget(VersionTools::GitManager *gitManager, QWidget *parent)
     : QWidget(parent)
     , m_gitManager(gitManager)
+    , m_branchList(new QListWidget(this))
 {
     auto *layout = new QVBoxLayout(this);
-    layout->addWidget(new QLabel(tr("Branches Widget - Coming Soon"), this));
+    m_branchList->setUniformItemSizes(true);
+    layout->addWidget(m_branchList);
 }
 
 void BranchesWidget::setRepository(const QString &path)
 {
     (void)path;
-    // TODO: Load branches
+    // The branches of the repository arrive through setBranches()
+    m_branchList->clear();
+}
+
+void BranchesWidget::setBranches(const std::vector<VersionTools::GitBranch> &branches)
+{
+    m_branchList->clear();
+    for (bool remote : {false, true}) {
+        for (const auto &branch : branches) {
+            if (branch.isRemote != remote) {
+                continue;
+            }
+            auto *item = new QListWidgetItem(QString::fromStdString(branch.name), m_branchList);
+            if (!branch.upstreamBranch.empty()) {
+                item->setToolTip(QString::fromStdString(branch.upstreamBranch));
+            }
+            if (branch.isCurrent) {
+                QFont font = item->font();
+                font.setBold(true);
+                item->setFont(font);
+            }
+        }
+    }
 }
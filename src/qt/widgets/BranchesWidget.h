@@ -1,6 +1,10 @@
 #pragma once
 
 #include <QWidget>
+#include <vector>
+#include "core/GitTypes.h"
+
+class QListWidget;
 
 namespace VersionTools {
 class GitManager;
@@ -16,9 +20,14 @@ public:
 
     void setRepository(const QString &path);
 
+public slots:
+    // Fed by GitWorker::branchesLoaded(); local branches first, the current one in bold
+    void setBranches(const std::vector<VersionTools::GitBranch> &branches);
+
 signals:
     void branchChanged(const QString &branchName);
 
 private:
     VersionTools::GitManager *m_gitManager;
+    QListWidget *m_branchList;
 };
@@ -1,20 +1,30 @@
 #include "ChangesWidget.h"
 #include "core/GitManager.h"
+#include "models/ChangesModel.h"
 #include <QVBoxLayout>
 #include <QLabel>
 
 ChangesWidget::ChangesWidget(VersionTools::GitManager *gitManager, QWidget *parent)
     : QWidget(parent)
     , m_gitManager(gitManager)
+    , m_stagedModel(new ChangesModel(true, this))
+    , m_unstagedModel(new ChangesModel(false, this))
 {
-    auto *layout = new QVBoxLayout(this);
-    layout->addWidget(new QLabel(tr("Changes Widget - Coming Soon"), this));
+    setupUI();
 }
 
 void ChangesWidget::setRepository(const QString &path)
 {
     m_repositoryPath = path;
-    // TODO: Load changes
+    // The first status of the repository arrives as a delta that adds every change
+    m_stagedModel->clear();
+    m_unstagedModel->clear();
+}
+
+void ChangesWidget::applyStatus(const VersionTools::GitStatus &, const VersionTools::GitStatusDelta &delta)
+{
+    m_stagedModel->applyDelta(delta);
+    m_unstagedModel->applyDelta(delta);
 }
 
 void ChangesWidget::refreshChanges()
@@ -28,7 +38,30 @@ void ChangesWidget::onCommitClicked() {}
 void ChangesWidget::onFileItemChanged(QListWidgetItem *) {}
 void ChangesWidget::onFileSelectionChanged() {}
 void ChangesWidget::showCommitDialog() {}
-void ChangesWidget::setupUI() {}
+void ChangesWidget::setupUI()
+{
+    m_layout = new QVBoxLayout(this);
+    m_splitter = new QSplitter(Qt::Vertical, this);
+    m_layout->addWidget(m_splitter);
+
+    auto addList = [this](const QString &title, ChangesModel *model) {
+        auto *panel = new QWidget(m_splitter);
+        auto *panelLayout = new QVBoxLayout(panel);
+        panelLayout->setContentsMargins(0, 0, 0, 0);
+        panelLayout->addWidget(new QLabel(title, panel));
+
+        auto *list = new QListView(panel);
+        // Rows all have one height, so scrolling never measures the rows it skips
+        list->setUniformItemSizes(true);
+        list->setSelectionMode(QAbstractItemView::ExtendedSelection);
+        list->setModel(model);
+        panelLayout->addWidget(list);
+        m_splitter->addWidget(panel);
+        return list;
+    };
+    m_stagedList = addList(tr("Staged Changes"), m_stagedModel);
+    m_unstagedList = addList(tr("Changes"), m_unstagedModel);
+}
 void ChangesWidget::updateFileList() {}
 void ChangesWidget::updateCommitButton() {}
 void ChangesWidget::stageFile(const QString &) {}
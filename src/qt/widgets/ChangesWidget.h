@@ -2,7 +2,7 @@
 
 #include <QWidget>
 #include <QSplitter>
-#include <QListWidget>
+#include <QListView>
 #include <QTextEdit>
 #include <QLabel>
 #include <QToolBar>
@@ -22,6 +22,7 @@ class GitManager;
 }
 
 class FileStatusItem;
+class ChangesModel;
 
 class ChangesWidget : public QWidget
 {
@@ -33,6 +34,10 @@ public:
     void setRepository(const QString &path);
     void refreshChanges();
 
+public slots:
+    // From GitWorker::statusChanged(); only the rows the delta touches are updated
+    void applyStatus(const VersionTools::GitStatus &status, const VersionTools::GitStatusDelta &delta);
+
 private slots:
     void onStageAllClicked();
     void onUnstageAllClicked();
@@ -58,8 +63,10 @@ private:
     
     // Left panel - file list
     QWidget *m_fileListPanel;
-    QListWidget *m_stagedList;
-    QListWidget *m_unstagedList;
+    QListView *m_stagedList;
+    QListView *m_unstagedList;
+    ChangesModel *m_stagedModel;
+    ChangesModel *m_unstagedModel;
     
     // Right panel - diff view
     QWidget *m_diffPanel;
@@ -69,6 +76,4 @@ private:
     QPushButton *m_stageAllButton;
     QPushButton *m_unstageAllButton;
     QPushButton *m_commitButton;
-    
-    VersionTools::GitStatus m_currentStatus;
 };
\ No newline at end of file
@@ -1,18 +1,39 @@
 #include "HistoryWidget.h"
 #include "core/GitManager.h"
+#include "models/HistoryModel.h"
+#include <QHeaderView>
+#include <QTreeView>
 #include <QVBoxLayout>
-#include <QLabel>
 
 HistoryWidget::HistoryWidget(VersionTools::GitManager *gitManager, QWidget *parent)
     : QWidget(parent)
     , m_gitManager(gitManager)
+    , m_model(new HistoryModel(this))
+    , m_commitView(new QTreeView(this))
 {
     auto *layout = new QVBoxLayout(this);
-    layout->addWidget(new QLabel(tr("History Widget - Coming Soon"), this));
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_commitView->setRootIsDecorated(false);
+    // Rows all have one height, so scrolling never measures the rows it skips
+    m_commitView->setUniformRowHeights(true);
+    m_commitView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_commitView->setModel(m_model);
+    m_commitView->header()->setSectionResizeMode(HistoryModel::SubjectColumn, QHeaderView::Stretch);
+    m_commitView->header()->setStretchLastSection(false);
+    layout->addWidget(m_commitView);
+
+    connect(m_commitView->selectionModel(), &QItemSelectionModel::currentRowChanged, this,
+            [this](const QModelIndex &current) {
+                if (const auto *commit = m_model->commitAt(current.row())) {
+                    emit commitSelected(QString::fromStdString(commit->hash));
+                }
+            });
 }
 
 void HistoryWidget::setRepository(const QString &path)
 {
     m_repositoryPath = path;
-    // TODO: Load history
+    // The history of the repository arrives through the model once the worker has opened it
+    m_model->clear();
 }
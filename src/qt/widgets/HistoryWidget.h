@@ -2,8 +2,8 @@
 
 #include <QWidget>
 
-class QListWidget;
-class QTextEdit;
+class QTreeView;
+class HistoryModel;
 
 namespace VersionTools {
 class GitManager;
@@ -16,6 +16,8 @@ public:
     explicit HistoryWidget(VersionTools::GitManager *gitManager, QWidget *parent = nullptr);
 
     void setRepository(const QString &path);
+    // Fed by GitWorker::historyLoaded()/historyPageLoaded(); asks for pages through pageRequested()
+    HistoryModel *model() const { return m_model; }
 
 signals:
     void commitSelected(const QString& commitHash);
@@ -23,6 +25,6 @@ signals:
 private:
     VersionTools::GitManager *m_gitManager;
     QString m_repositoryPath;
-    QListWidget* m_commitList;
-    QTextEdit* m_commitDetails;
+    HistoryModel *m_model;
+    QTreeView *m_commitView;
 };
\ No newline at end of file
@@ -169,6 +169,11 @@ void SidebarWidget::setRepositoryPath(const QString &path)
     }
 }
 
+void SidebarWidget::setBranchName(const QString &branch)
+{
+    m_branchLabel->setText(branch);
+}
+
 void SidebarWidget::updateStatus(const VersionTools::GitStatus &status)
 {
     m_currentStatus = status;
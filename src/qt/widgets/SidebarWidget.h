@@ -21,6 +21,8 @@ public:
 
     void setRepositoryPath(const QString &path);
     void updateStatus(const VersionTools::GitStatus &status);
+    // Until the first status arrives with its ahead/behind counts
+    void setBranchName(const QString &branch);
 
 signals:
     void selectionChanged(int index);
@@ -0,0 +1,117 @@
+// Behavior checks for GitOutputParser: hunk headers, tracking counts, progress
+// meters and stash subjects.
+
+#include "GitOutputParser.h"
+#include "TestSupport.h"
+#include <string>
+
+using namespace VersionTools;
+
+namespace {
+
+bool sameRange(const GitHunkRange& range, int oldStart, int oldCount, int newStart, int newCount) {
+    return range.oldStart == oldStart && range.oldCount == oldCount && range.newStart == newStart &&
+           range.newCount == newCount;
+}
+
+void parsesHunkHeaders() {
+    GitHunkRange range;
+    CHECK(GitOutputParser::parseHunkHeader("@@ -12,7 +14,9 @@ void f() {", range));
+    CHECK(sameRange(range, 12, 7, 14, 9));
+    // An omitted count is 1, an explicit 0 stays 0 (new and deleted files)
+    CHECK(GitOutputParser::parseHunkHeader("@@ -5 +6 @@", range));
+    CHECK(sameRange(range, 5, 1, 6, 1));
+    CHECK(GitOutputParser::parseHunkHeader("@@ -0,0 +1,3 @@", range));
+    CHECK(sameRange(range, 0, 0, 1, 3));
+    CHECK(GitOutputParser::parseHunkHeader("@@ -1,2 +0,0 @@", range));
+    CHECK(sameRange(range, 1, 2, 0, 0));
+    // Section text may contain anything, "@@" included
+    CHECK(GitOutputParser::parseHunkHeader("@@ -3,1 +3,2 @@ @@ not a header @@", range));
+    CHECK(sameRange(range, 3, 1, 3, 2));
+}
+
+void rejectsMalformedHunkHeaders() {
+    const char* bad[] = {
+        "",
+        "@@",
+        "@@ -1,2 +1,2",          // No closing marker
+        "@@ -1,2 +1,2@@",        // Closing marker without its space
+        "@@ -1, +1,2 @@",        // Comma without a count
+        "@@ -a,2 +1,2 @@",
+        "@@ --5,2 +1,2 @@",      // Signed numbers are not ranges
+        "@@ -1,-2 +1,2 @@",
+        "@@ -1,2 +-1,2 @@",
+        "@@ -1,2  +1,2 @@",
+        "@@ -99999999999 +1 @@", // Out of int range
+        "@@@ -1,2 -1,2 +1,3 @@@", // Combined diffs of merges are not unified hunks
+        " @@ -1 +1 @@",
+    };
+    for (const char* line : bad) {
+        GitHunkRange range{7, 7, 7, 7};
+        bool parsed = GitOutputParser::parseHunkHeader(line, range);
+        if (parsed) {
+            Testing::fail(__FILE__, __LINE__, std::string("accepted ") + Testing::describe(line));
+        }
+        // A rejected header leaves the range untouched
+        CHECK(sameRange(range, 7, 7, 7, 7));
+    }
+}
+
+void parsesTrackingCounts() {
+    int ahead = -1, behind = -1;
+    GitOutputParser::parseTrackingCounts("[ahead 3, behind 14]", ahead, behind);
+    CHECK_EQ(ahead, 3);
+    CHECK_EQ(behind, 14);
+
+    ahead = behind = 9;
+    GitOutputParser::parseTrackingCounts("## main...origin/main [behind 2]", ahead, behind);
+    CHECK_EQ(ahead, 9);  // Not mentioned, left alone
+    CHECK_EQ(behind, 2);
+
+    ahead = behind = 0;
+    GitOutputParser::parseTrackingCounts("[gone]", ahead, behind);
+    CHECK_EQ(ahead, 0);
+    CHECK_EQ(behind, 0);
+}
+
+void parsesProgressLines() {
+    GitProgressLine progress;
+    CHECK(GitOutputParser::parseProgressLine("Receiving objects:  45% (450/1000), 1.20 MiB | 2.00 MiB/s", progress));
+    CHECK_EQ(progress.operation, std::string_view("Receiving objects"));
+    CHECK_EQ(progress.current, 450);
+    CHECK_EQ(progress.total, 1000);
+    CHECK(!progress.done);
+
+    CHECK(GitOutputParser::parseProgressLine("remote: Counting objects: 100% (12/12), done.", progress));
+    CHECK_EQ(progress.operation, std::string_view("Counting objects"));
+    CHECK_EQ(progress.current, 12);
+    CHECK(progress.done);
+
+    CHECK(GitOutputParser::parseProgressLine("remote: Enumerating objects: 1234, done.", progress));
+    CHECK_EQ(progress.current, 1234);
+    CHECK_EQ(progress.total, 0);
+    CHECK(progress.done);
+
+    CHECK(!GitOutputParser::parseProgressLine("fatal: repository 'x' not found", progress));
+    CHECK(!GitOutputParser::parseProgressLine("hint: Using 'master' as the name", progress));
+    CHECK(!GitOutputParser::parseProgressLine("Cloning into 'repo'...", progress));
+    CHECK(!GitOutputParser::parseProgressLine("Resolving deltas:  50% (1/", progress));
+}
+
+void parsesStashBranches() {
+    CHECK_EQ(GitOutputParser::parseStashBranch("On main: saved work"), "main");
+    CHECK_EQ(GitOutputParser::parseStashBranch("WIP on feature/x: 1234567 subject"), "feature/x");
+    CHECK_EQ(GitOutputParser::parseStashBranch("On : nothing"), "");
+    CHECK_EQ(GitOutputParser::parseStashBranch("autostash"), "");
+}
+
+}
+
+int main() {
+    parsesHunkHeaders();
+    rejectsMalformedHunkHeaders();
+    parsesTrackingCounts();
+    parsesProgressLines();
+    parsesStashBranches();
+    return Testing::testResult("GitOutputParserTest");
+}
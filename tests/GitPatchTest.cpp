@@ -0,0 +1,275 @@
+// Behavior checks for GitPatch, the parser behind getCommitDiff(All) and the
+// GitPatch::parse/toDiffs case of vt_bench, and for the budgeted Builder.
+
+#include "GitPatch.h"
+#include "TestSupport.h"
+#include <string>
+#include <vector>
+
+using namespace VersionTools;
+
+namespace {
+
+const char* PATCH =
+    "diff --git a/src/main.cpp b/src/main.cpp\n"
+    "index 1111111..2222222 100644\n"
+    "--- a/src/main.cpp\n"
+    "+++ b/src/main.cpp\n"
+    "@@ -1,3 +1,4 @@ int main() {\n"
+    " one\n"
+    "-two\n"
+    "+two changed\n"
+    "+two and a half\n"
+    " three\n"
+    "@@ -10 +11 @@\n"
+    "-last\n"
+    "+last\n"
+    "\\ No newline at end of file\n"
+    "diff --git a/old name.txt b/new name.txt\n"
+    "similarity index 90%\n"
+    "rename from old name.txt\n"
+    "rename to new name.txt\n"
+    "index 3333333..4444444 100644\n"
+    "--- a/old name.txt\n"
+    "+++ b/new name.txt\n"
+    "@@ -2,2 +2,2 @@\n"
+    " kept\n"
+    "-gone\n"
+    "+here\n"
+    "diff --git a/added.txt b/added.txt\n"
+    "new file mode 100644\n"
+    "index 0000000..5555555\n"
+    "--- /dev/null\n"
+    "+++ b/added.txt\n"
+    "@@ -0,0 +1,2 @@\n"
+    "+a\n"
+    "+b\n"
+    "diff --git a/image.png b/image.png\n"
+    "index 6666666..7777777 100644\n"
+    "Binary files a/image.png and b/image.png differ\n";
+
+void parsesFilesHunksAndLines() {
+    GitPatch patch = GitPatch::parse(PATCH);
+    CHECK_EQ(patch.fileCount(), size_t(4));
+    CHECK_EQ(patch.hunkCount(), size_t(4));
+
+    auto diffs = patch.toDiffs();
+    CHECK_EQ(diffs.size(), size_t(4));
+    if (diffs.size() != 4) {
+        return;
+    }
+
+    const GitDiff& modified = diffs[0];
+    CHECK_EQ(modified.filePath, "src/main.cpp");
+    CHECK(!modified.isNewFile && !modified.isDeletedFile && !modified.isBinary && !modified.isTruncated);
+    CHECK_EQ(modified.hunks.size(), size_t(2));
+    const GitDiffHunk& first = modified.hunks[0];
+    CHECK_EQ(first.oldStart, 1);
+    CHECK_EQ(first.oldCount, 3);
+    CHECK_EQ(first.newStart, 1);
+    CHECK_EQ(first.newCount, 4);
+    CHECK_EQ(first.lines.size(), size_t(5));
+    if (first.lines.size() == 5) {
+        CHECK(first.lines[0].type == GitDiffLine::Type::Context);
+        CHECK_EQ(first.lines[0].content, "one");
+        CHECK_EQ(first.lines[0].oldLineNumber, 1);
+        CHECK_EQ(first.lines[0].newLineNumber, 1);
+        CHECK(first.lines[1].type == GitDiffLine::Type::Deletion);
+        CHECK_EQ(first.lines[1].oldLineNumber, 2);
+        CHECK_EQ(first.lines[1].newLineNumber, -1);
+        CHECK(first.lines[3].type == GitDiffLine::Type::Addition);
+        CHECK_EQ(first.lines[3].content, "two and a half");
+        CHECK_EQ(first.lines[3].newLineNumber, 3);
+        CHECK_EQ(first.lines[4].oldLineNumber, 3);
+        CHECK_EQ(first.lines[4].newLineNumber, 4);
+    }
+    // Omitted counts mean 1, and the no-newline marker is not a body line
+    const GitDiffHunk& second = modified.hunks[1];
+    CHECK_EQ(second.oldStart, 10);
+    CHECK_EQ(second.oldCount, 1);
+    CHECK_EQ(second.newStart, 11);
+    CHECK_EQ(second.newCount, 1);
+    CHECK_EQ(second.lines.size(), size_t(2));
+
+    CHECK_EQ(diffs[1].filePath, "new name.txt");
+    CHECK_EQ(diffs[1].oldPath, "old name.txt");
+    CHECK_EQ(diffs[1].hunks.size(), size_t(1));
+
+    CHECK_EQ(diffs[2].filePath, "added.txt");
+    CHECK(diffs[2].isNewFile);
+    CHECK_EQ(diffs[2].hunks.size(), size_t(1));
+
+    CHECK_EQ(diffs[3].filePath, "image.png");
+    CHECK(diffs[3].isBinary);
+    CHECK(diffs[3].hunks.empty());
+
+    size_t added = 0, deleted = 0;
+    patch.countLines(0, added, deleted);
+    CHECK_EQ(added, size_t(3));
+    CHECK_EQ(deleted, size_t(2));
+    CHECK_EQ(patch.findFile("old name.txt"), size_t(1));
+    CHECK_EQ(patch.findFile("missing"), std::string::npos);
+}
+
+void emptyOutputHasNoFiles() {
+    GitPatch patch = GitPatch::parse("");
+    CHECK(patch.empty());
+    CHECK(patch.toDiffs().empty());
+}
+
+// One file with `hunks` hunks of one context line, `changes` deletions, `changes` additions and one more context line
+std::string manyHunks(size_t hunks, int changes) {
+    std::string text = "diff --git a/f.txt b/f.txt\nindex 1111111..2222222 100644\n--- a/f.txt\n+++ b/f.txt\n";
+    int start = 1;
+    for (size_t h = 0; h < hunks; ++h) {
+        int count = changes + 2;
+        text += "@@ -" + std::to_string(start) + "," + std::to_string(count) + " +" + std::to_string(start) + "," +
+                std::to_string(count) + " @@\n";
+        text += " context " + std::to_string(h) + "\n";
+        for (int i = 0; i < changes; ++i) {
+            text += "-old " + std::to_string(h) + "." + std::to_string(i) + "\n";
+        }
+        for (int i = 0; i < changes; ++i) {
+            text += "+new " + std::to_string(h) + "." + std::to_string(i) + "\n";
+        }
+        text += " after " + std::to_string(h) + "\n";
+        start += count + 10;
+    }
+    return text;
+}
+
+GitPatch build(const std::string& text, const GitDiffBudget& budget, size_t chunkSize, size_t firstHunk = 0,
+               size_t hunkCount = std::string::npos) {
+    GitPatch::Builder builder(budget, firstHunk, hunkCount);
+    for (size_t pos = 0; pos < text.size(); pos += chunkSize) {
+        builder.feed(std::string_view(text).substr(pos, chunkSize));
+    }
+    return builder.finish();
+}
+
+bool validUtf8(std::string_view text) {
+    for (size_t i = 0; i < text.size();) {
+        unsigned char byte = static_cast<unsigned char>(text[i]);
+        size_t length = byte < 0x80 ? 1 : byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 0;
+        if (length == 0 || i + length > text.size()) {
+            return false;
+        }
+        for (size_t k = 1; k < length; ++k) {
+            if ((static_cast<unsigned char>(text[i + k]) & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+void builderMatchesParseInAnyChunking() {
+    std::string text = std::string(PATCH) + manyHunks(3, 2);
+    std::vector<GitDiff> expected = GitPatch::parse(text).toDiffs();
+    for (size_t chunk : {size_t(1), size_t(3), size_t(64), text.size()}) {
+        std::vector<GitDiff> diffs = build(text, GitDiffBudget::unlimited(), chunk).toDiffs();
+        CHECK_EQ(diffs.size(), expected.size());
+        for (size_t f = 0; f < diffs.size() && f < expected.size(); ++f) {
+            CHECK_EQ(diffs[f].filePath, expected[f].filePath);
+            CHECK_EQ(diffs[f].hunks.size(), expected[f].hunks.size());
+            CHECK(!diffs[f].isTruncated);
+            for (size_t h = 0; h < diffs[f].hunks.size() && h < expected[f].hunks.size(); ++h) {
+                const auto& got = diffs[f].hunks[h].lines;
+                const auto& want = expected[f].hunks[h].lines;
+                CHECK_EQ(got.size(), want.size());
+                for (size_t l = 0; l < got.size() && l < want.size(); ++l) {
+                    CHECK_EQ(got[l].content, want[l].content);
+                    CHECK(got[l].type == want[l].type);
+                }
+            }
+        }
+    }
+}
+
+void budgetCutKeepsHunksWhole() {
+    // Six body lines per hunk: a budget of 10 lines runs out in the middle of the second hunk
+    std::string text = manyHunks(4, 2);
+    GitPatch full = GitPatch::parse(text);
+    GitDiffBudget budget{0, 10, 0};
+    for (size_t chunk : {size_t(1), size_t(7), text.size()}) {
+        GitPatch patch = build(text, budget, chunk);
+        CHECK_EQ(patch.hunkCount(), size_t(4));
+        CHECK(patch.file(0).isTruncated);
+        size_t keptLines = 0;
+        for (size_t h = 0; h < patch.hunkCount(); ++h) {
+            GitPatch::Hunk hunk = patch.hunk(h);
+            GitPatch::Hunk whole = full.hunk(h);
+            // Loaded hunks have every line, the others none; ranges and counts are always there
+            CHECK_EQ(hunk.isLoaded, h == 0);
+            CHECK_EQ(hunk.lineCount, hunk.isLoaded ? whole.lineCount : size_t(0));
+            CHECK_EQ(hunk.oldStart, whole.oldStart);
+            CHECK_EQ(hunk.newCount, whole.newCount);
+            CHECK_EQ(hunk.added, size_t(2));
+            CHECK_EQ(hunk.deleted, size_t(2));
+            keptLines += hunk.lineCount;
+        }
+        CHECK_EQ(patch.lineCount(), keptLines);
+
+        size_t added = 0, deleted = 0;
+        patch.countLines(0, added, deleted);
+        CHECK_EQ(added, size_t(8));
+        CHECK_EQ(deleted, size_t(8));
+        // Nothing of a dropped hunk's body is left in the text
+        CHECK(patch.text().find("new 1.0") == std::string::npos);
+        CHECK(patch.text().find("@@ -15,4 +15,4 @@") != std::string::npos);
+    }
+}
+
+void windowLoadsItsFirstHunkWhateverItsSize() {
+    std::string text = manyHunks(4, 50);
+    GitDiffBudget budget{0, 10, 0};
+    GitPatch patch = build(text, budget, 4096, 2, 2);
+    CHECK_EQ(patch.hunkCount(), size_t(4));
+    CHECK(!patch.hunk(0).isLoaded);
+    CHECK(!patch.hunk(1).isLoaded);
+    CHECK(patch.hunk(2).isLoaded);
+    CHECK_EQ(patch.hunk(2).lineCount, size_t(102));
+    CHECK(!patch.hunk(3).isLoaded);  // In the window, but over the budget
+}
+
+void longLinesAreCutOnCharacterBoundaries() {
+    // "é" is two bytes, "€" three and "𝄞" four: cut at every length, no sequence may be split
+    std::string wide;
+    for (int i = 0; i < 8; ++i) {
+        wide += "a\xc3\xa9\xe2\x82\xac\xf0\x9d\x84\x9e";
+    }
+    std::string text = "diff --git a/w.txt b/w.txt\n--- a/w.txt\n+++ b/w.txt\n@@ -1 +1,2 @@\n-short\n+" + wide +
+                       "\n+tail\n";
+    for (size_t length = 1; length < 40; ++length) {
+        for (size_t chunk : {size_t(1), size_t(5), text.size()}) {
+            GitPatch patch = build(text, GitDiffBudget{0, 0, length}, chunk);
+            if (!(patch.lineCount() == 3)) {
+                Testing::fail(__FILE__, __LINE__, "line count at length " + std::to_string(length));
+                continue;
+            }
+            std::string_view cut = patch.lineContent(1);
+            CHECK(cut.size() <= length);
+            CHECK(cut.size() + 3 >= length);  // At most one partial sequence is dropped
+            CHECK(validUtf8(cut));
+            CHECK_EQ(std::string(cut), wide.substr(0, cut.size()));
+            CHECK(patch.file(0).hasLongLines);
+            // The next line starts afresh, and headers are never cut
+            CHECK_EQ(patch.lineContent(2), std::string_view("tail").substr(0, length));
+            CHECK_EQ(patch.file(0).filePath, "w.txt");
+            CHECK(patch.lineType(2) == GitDiffLine::Type::Addition);
+        }
+    }
+}
+
+}
+
+int main() {
+    parsesFilesHunksAndLines();
+    emptyOutputHasNoFiles();
+    builderMatchesParseInAnyChunking();
+    budgetCutKeepsHunksWhole();
+    windowLoadsItsFirstHunkWhateverItsSize();
+    longLinesAreCutOnCharacterBoundaries();
+    return Testing::testResult("GitPatchTest");
+}
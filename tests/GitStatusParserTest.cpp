@@ -0,0 +1,174 @@
+// Behavior checks for GitStatusParser: `git status --porcelain=v2 -z --branch`
+// records, renames and unmerged entries included, and the numstat merge.
+
+#include "GitStatusParser.h"
+#include "TestSupport.h"
+#include <string>
+
+using namespace VersionTools;
+
+namespace {
+
+const char* HEAD_A = "1111111111111111111111111111111111111111";
+const char* HEAD_B = "2222222222222222222222222222222222222222";
+
+// Appends one NUL-terminated record
+void record(std::string& output, const std::string& text) {
+    output += text;
+    output.push_back('\0');
+}
+
+std::string ordinary(const std::string& xy, const std::string& path) {
+    return "1 " + xy + " N... 100644 100644 100644 " + HEAD_A + " " + HEAD_B + " " + path;
+}
+
+std::string unmerged(const std::string& xy, const std::string& path) {
+    return "u " + xy + " N... 100644 100644 100644 100644 " + HEAD_A + " " + HEAD_B + " " + HEAD_A + " " + path;
+}
+
+const GitFileChange* find(const GitStatus& status, const std::string& path) {
+    for (const auto& change : status.changes) {
+        if (change.filePath == path) {
+            return &change;
+        }
+    }
+    return nullptr;
+}
+
+void parsesBranchHeaders() {
+    std::string output;
+    record(output, std::string("# branch.oid ") + HEAD_A);
+    record(output, "# branch.head feature/x");
+    record(output, "# branch.upstream origin/feature/x");
+    record(output, "# branch.ab +3 -12");
+    GitStatus status = GitStatusParser::parse(output);
+    CHECK_EQ(status.currentBranch, "feature/x");
+    CHECK_EQ(status.upstreamBranch, "origin/feature/x");
+    CHECK_EQ(status.aheadCount, 3);
+    CHECK_EQ(status.behindCount, 12);
+    CHECK(status.changes.empty());
+    CHECK(!status.hasUncommittedChanges);
+
+    std::string detached;
+    record(detached, "# branch.oid (initial)");
+    record(detached, "# branch.head (detached)");
+    CHECK_EQ(GitStatusParser::parse(detached).currentBranch, "HEAD (no branch)");
+}
+
+void parsesOrdinaryUntrackedAndIgnored() {
+    std::string output;
+    record(output, ordinary(".M", "src/with space.cpp"));
+    record(output, ordinary("A.", "added.txt"));
+    record(output, ordinary("D.", "gone.txt"));
+    record(output, ordinary(".D", "missing.txt"));
+    record(output, "? new\nline.txt");  // -z paths are raw, newlines included
+    record(output, "! build/out.o");
+    GitStatus status = GitStatusParser::parse(output);
+    CHECK_EQ(status.changes.size(), size_t(6));
+
+    const GitFileChange* modified = find(status, "src/with space.cpp");
+    CHECK(modified && modified->status == FileStatus::Modified && !modified->isStaged);
+    const GitFileChange* added = find(status, "added.txt");
+    CHECK(added && added->status == FileStatus::Added && added->isStaged);
+    const GitFileChange* deleted = find(status, "gone.txt");
+    CHECK(deleted && deleted->status == FileStatus::Deleted && deleted->isStaged);
+    const GitFileChange* missing = find(status, "missing.txt");
+    CHECK(missing && missing->status == FileStatus::Deleted && !missing->isStaged);
+    const GitFileChange* untracked = find(status, "new\nline.txt");
+    CHECK(untracked && untracked->status == FileStatus::Untracked);
+    const GitFileChange* ignored = find(status, "build/out.o");
+    CHECK(ignored && ignored->status == FileStatus::Ignored);
+
+    CHECK(status.hasUncommittedChanges && status.hasStagedChanges && status.hasUnstagedChanges);
+}
+
+void parsesRenamesWithTheirSource() {
+    std::string output;
+    record(output, std::string("2 R. N... 100644 100644 100644 ") + HEAD_A + " " + HEAD_A + " R100 new dir/b.txt");
+    record(output, "old dir/a.txt");
+    record(output, std::string("2 C. N... 100644 100644 100644 ") + HEAD_A + " " + HEAD_A + " C75 copy.txt");
+    record(output, "source.txt");
+    record(output, ordinary(".M", "after.txt"));  // The source record is not read as an entry
+    GitStatus status = GitStatusParser::parse(output);
+    CHECK_EQ(status.changes.size(), size_t(3));
+
+    const GitFileChange* renamed = find(status, "new dir/b.txt");
+    CHECK(renamed && renamed->status == FileStatus::Renamed && renamed->isStaged);
+    CHECK(renamed && renamed->oldPath == "old dir/a.txt");
+    const GitFileChange* copied = find(status, "copy.txt");
+    CHECK(copied && copied->status == FileStatus::Copied && copied->oldPath == "source.txt");
+    CHECK(find(status, "old dir/a.txt") == nullptr);
+    CHECK(find(status, "after.txt") != nullptr);
+}
+
+void parsesEveryUnmergedPairAsConflicted() {
+    // All seven XY pairs git uses for unmerged paths, both-added and both-deleted included
+    const char* pairs[] = {"DD", "AU", "UD", "UA", "DU", "AA", "UU"};
+    std::string output;
+    for (const char* xy : pairs) {
+        record(output, unmerged(xy, std::string("conflict ") + xy + ".txt"));
+    }
+    GitStatus status = GitStatusParser::parse(output);
+    CHECK_EQ(status.changes.size(), size_t(7));
+    for (const char* xy : pairs) {
+        const GitFileChange* change = find(status, std::string("conflict ") + xy + ".txt");
+        CHECK(change != nullptr);
+        if (change) {
+            CHECK(change->status == FileStatus::Conflicted);
+            CHECK(!change->isStaged);
+        }
+    }
+    CHECK(status.hasUnstagedChanges && !status.hasStagedChanges);
+}
+
+void skipsTruncatedRecords() {
+    std::string output;
+    record(output, "1 .M N... 100644");  // Cut before the path
+    record(output, "x unknown kind");
+    record(output, ordinary(".M", "kept.txt"));
+    GitStatus status = GitStatusParser::parse(output);
+    CHECK_EQ(status.changes.size(), size_t(1));
+    CHECK(find(status, "kept.txt") != nullptr);
+}
+
+void mergesNumstatBySide() {
+    std::string output;
+    record(output, ordinary("M.", "staged.txt"));
+    record(output, ordinary(".M", "unstaged.txt"));
+    record(output, std::string("2 R. N... 100644 100644 100644 ") + HEAD_A + " " + HEAD_A + " R90 to.txt");
+    record(output, "from.txt");
+    record(output, ordinary(".M", "image.png"));
+    GitStatus status = GitStatusParser::parse(output);
+
+    std::string index;
+    record(index, "4\t1\tstaged.txt");
+    record(index, "2\t2\t");  // Renames write an empty path and then both names
+    record(index, "from.txt");
+    record(index, "to.txt");
+    record(index, "9\t9\tunstaged.txt");  // Ignored: that entry is not staged
+    std::string worktree;
+    record(worktree, "7\t0\tunstaged.txt");
+    record(worktree, "-\t-\timage.png");
+    GitStatusParser::mergeLineStats(status, index, worktree);
+
+    const GitFileChange* staged = find(status, "staged.txt");
+    CHECK(staged && staged->linesAdded == 4 && staged->linesDeleted == 1);
+    const GitFileChange* unstaged = find(status, "unstaged.txt");
+    CHECK(unstaged && unstaged->linesAdded == 7 && unstaged->linesDeleted == 0);
+    const GitFileChange* renamed = find(status, "to.txt");
+    CHECK(renamed && renamed->linesAdded == 2 && renamed->linesDeleted == 2);
+    const GitFileChange* binary = find(status, "image.png");
+    CHECK(binary && binary->linesAdded == 0 && binary->linesDeleted == 0);
+}
+
+}
+
+int main() {
+    parsesBranchHeaders();
+    parsesOrdinaryUntrackedAndIgnored();
+    parsesRenamesWithTheirSource();
+    parsesEveryUnmergedPairAsConflicted();
+    skipsTruncatedRecords();
+    mergesNumstatBySide();
+    return Testing::testResult("GitStatusParserTest");
+}
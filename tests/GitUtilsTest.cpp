@@ -0,0 +1,50 @@
+// Behavior checks for the GitUtils string helpers the log and status readers
+// build on (the GitUtils::split/log case of vt_bench).
+
+#include "GitUtils.h"
+#include "TestSupport.h"
+#include <string>
+
+using namespace VersionTools;
+
+namespace {
+
+void splitsNulSeparatedLogRecords() {
+    // `git log -z --format=%H%x00%P%x00%s`: fields and records both end in NUL
+    std::string output("aaa\0bbb\0first\0ccc\0\0root\0", 24);
+    auto fields = GitUtils::split(output, std::string(1, '\0'));
+    CHECK_EQ(fields.size(), size_t(7));
+    if (fields.size() == 7) {
+        CHECK_EQ(fields[0], "aaa");
+        CHECK_EQ(fields[2], "first");
+        CHECK_EQ(fields[4], "");  // A root commit has no parents
+        CHECK_EQ(fields[5], "root");
+        CHECK_EQ(fields[6], "");  // After the trailing terminator
+    }
+
+    auto single = GitUtils::split("no delimiter", "|");
+    CHECK_EQ(single.size(), size_t(1));
+    CHECK_EQ(GitUtils::split("", "|").size(), size_t(1));
+    CHECK_EQ(GitUtils::split("a||b", "||").size(), size_t(2));
+}
+
+void unquotesCQuotedPaths() {
+    CHECK_EQ(GitUtils::unquotePath("plain/name.txt"), "plain/name.txt");
+    CHECK_EQ(GitUtils::unquotePath("\"with space\""), "with space");
+    CHECK_EQ(GitUtils::unquotePath("\"caf\\303\\251 \\\"x\\\".txt\""), "caf\xc3\xa9 \"x\".txt");
+    CHECK_EQ(GitUtils::unquotePath("\"tab\\there\""), "tab\there");
+}
+
+void trims() {
+    CHECK_EQ(GitUtils::trim("  main\n"), "main");
+    CHECK_EQ(GitUtils::trim(" \t\n"), "");
+}
+
+}
+
+int main() {
+    splitsNulSeparatedLogRecords();
+    unquotesCQuotedPaths();
+    trims();
+    return Testing::testResult("GitUtilsTest");
+}
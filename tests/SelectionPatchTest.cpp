@@ -0,0 +1,295 @@
+// Behavior checks for GitPatch::selectionPatch, the patch stageLines and
+// unstageLines feed to `git apply --cached [-R]`. Diffs come from git itself in
+// a scratch repository, and every patch must pass `git apply --check` and
+// leave exactly the expected content in the index.
+
+#include "GitManager.h"
+#include "GitPatch.h"
+#include "SystemCommand.h"
+#include "TestSupport.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace VersionTools;
+
+namespace {
+
+class ScratchRepository {
+public:
+    ScratchRepository() {
+        auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        root = std::filesystem::temp_directory_path() / ("vt-selection-test-" + std::to_string(stamp));
+        std::filesystem::create_directories(root);
+        git({"init", "-q"});
+        git({"config", "user.name", "Test"});
+        git({"config", "user.email", "test@example.com"});
+        git({"config", "core.autocrlf", "false"});
+    }
+
+    ~ScratchRepository() {
+        std::error_code error;
+        std::filesystem::remove_all(root, error);
+    }
+
+    std::string path() const { return root.string(); }
+
+    SystemCommandResult git(const std::vector<std::string>& args, const std::string& input = "") const {
+        SystemCommand command;
+        if (!input.empty()) {
+            command.setInput(input);
+        }
+        return command.execute("git", args, path());
+    }
+
+    void write(const std::string& name, const std::string& content) const {
+        std::ofstream(root / name, std::ios::binary | std::ios::trunc) << content;
+    }
+
+    void commit(const std::string& message) const {
+        git({"add", "-A"});
+        git({"commit", "-q", "-m", message});
+    }
+
+    std::string indexed(const std::string& name) const { return git({"show", ":" + name}).output; }
+    bool isIndexed(const std::string& name) const { return !git({"ls-files", "--", name}).output.empty(); }
+
+private:
+    std::filesystem::path root;
+};
+
+std::string numberedLines(int count) {
+    std::string text;
+    for (int i = 1; i <= count; ++i) {
+        text += "line " + std::to_string(i) + "\n";
+    }
+    return text;
+}
+
+void replaceOnce(std::string& text, const std::string& from, const std::string& to) {
+    size_t at = text.find(from);
+    if (at != std::string::npos) {
+        text.replace(at, from.size(), to);
+    }
+}
+
+// Index of the body line with that content and type in a hunk, or npos
+size_t lineOf(const GitPatch& patch, size_t fileIndex, size_t hunk, const std::string& content,
+              GitDiffLine::Type type) {
+    GitPatch::Hunk view = patch.hunk(patch.file(fileIndex).firstHunk + hunk);
+    for (size_t i = 0; i < view.lineCount; ++i) {
+        GitPatch::Line line = patch.line(view.firstLine + i);
+        if (line.content == content && line.type == type) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+// Builds the selection patch of path from the worktree (or staged) diff, checks and applies it to the index
+bool applySelection(const ScratchRepository& repo, const std::string& path, const GitPatch& patch,
+                    const std::vector<GitLineSelection>& selection, bool reverse) {
+    size_t index = patch.findFile(path);
+    if (index == std::string::npos) {
+        Testing::fail(__FILE__, __LINE__, "no diff for " + path);
+        return false;
+    }
+    std::string selected = patch.selectionPatch(index, selection, reverse);
+    if (selected.empty()) {
+        Testing::fail(__FILE__, __LINE__, "empty selection patch for " + path);
+        return false;
+    }
+    std::vector<std::string> args = {"apply", "--cached", "--check"};
+    if (reverse) {
+        args.push_back("-R");
+    }
+    auto check = repo.git(args, selected);
+    if (check.exitCode != 0) {
+        Testing::fail(__FILE__, __LINE__, "git apply --check rejected:\n" + selected + check.error);
+        return false;
+    }
+    args.erase(args.begin() + 2);
+    return repo.git(args, selected).exitCode == 0;
+}
+
+GitPatch worktreePatch(const ScratchRepository& repo, const std::string& path, bool staged = false) {
+    GitManager manager(repo.path());
+    return manager.getDiffPatch(path, staged, GitDiffBudget::unlimited());
+}
+
+// Three hunks: a replacement plus an addition, a deletion, and a replacement near the end
+struct ModifiedFile {
+    std::string base = numberedLines(40);
+    std::string changed;
+
+    ModifiedFile() {
+        changed = base;
+        replaceOnce(changed, "line 2\n", "line 2 changed\nline 2b\n");
+        replaceOnce(changed, "line 20\n", "");
+        replaceOnce(changed, "line 35\n", "new 35\n");
+    }
+};
+
+void stagesALaterHunkPastUnselectedOnes() {
+    ScratchRepository repo;
+    ModifiedFile file;
+    repo.write("f.txt", file.base);
+    repo.commit("base");
+    repo.write("f.txt", file.changed);
+
+    // Hunks 0 (+1 line) and 1 (-1 line) stay out, so hunk 2's new start shifts back
+    GitPatch patch = worktreePatch(repo, "f.txt");
+    CHECK_EQ(patch.hunkCount(), size_t(3));
+    CHECK(applySelection(repo, "f.txt", patch, {{2, {}}}, false));
+    std::string expected = file.base;
+    replaceOnce(expected, "line 35\n", "new 35\n");
+    CHECK_EQ(repo.indexed("f.txt"), expected);
+
+    // Then one addition of the first hunk alone: its deletion becomes context, the other addition goes
+    patch = worktreePatch(repo, "f.txt");
+    size_t added = lineOf(patch, 0, 0, "line 2b", GitDiffLine::Type::Addition);
+    CHECK(added != std::string::npos);
+    CHECK(applySelection(repo, "f.txt", patch, {{0, {added}}}, false));
+    replaceOnce(expected, "line 2\n", "line 2\nline 2b\n");
+    CHECK_EQ(repo.indexed("f.txt"), expected);
+
+    // And the rest, so the index matches the worktree
+    patch = worktreePatch(repo, "f.txt");
+    std::vector<GitLineSelection> all;
+    for (size_t h = 0; h < patch.hunkCount(); ++h) {
+        all.push_back({h, {}});
+    }
+    CHECK(applySelection(repo, "f.txt", patch, all, false));
+    CHECK_EQ(repo.indexed("f.txt"), file.changed);
+}
+
+void unstagesLinesWithTheRolesSwapped() {
+    ScratchRepository repo;
+    ModifiedFile file;
+    repo.write("f.txt", file.base);
+    repo.commit("base");
+    repo.write("f.txt", file.changed);
+    repo.git({"add", "f.txt"});
+
+    // Take the "line 2b" addition back out of the index: the other staged lines stay
+    GitPatch staged = worktreePatch(repo, "f.txt", true);
+    size_t added = lineOf(staged, 0, 0, "line 2b", GitDiffLine::Type::Addition);
+    CHECK(added != std::string::npos);
+    CHECK(applySelection(repo, "f.txt", staged, {{0, {added}}}, true));
+    std::string expected = file.changed;
+    replaceOnce(expected, "line 2b\n", "");
+    CHECK_EQ(repo.indexed("f.txt"), expected);
+
+    // Then the last hunk only, past the partly staged first one and the whole second one
+    staged = worktreePatch(repo, "f.txt", true);
+    CHECK(applySelection(repo, "f.txt", staged, {{staged.hunkCount() - 1, {}}}, true));
+    replaceOnce(expected, "new 35\n", "line 35\n");
+    CHECK_EQ(repo.indexed("f.txt"), expected);
+
+    // A deletion alone: "line 20" comes back into the index
+    staged = worktreePatch(repo, "f.txt", true);
+    size_t deleted = std::string::npos;
+    size_t deletedHunk = 0;
+    for (size_t h = 0; h < staged.hunkCount() && deleted == std::string::npos; ++h) {
+        deleted = lineOf(staged, 0, h, "line 20", GitDiffLine::Type::Deletion);
+        deletedHunk = h;
+    }
+    CHECK(deleted != std::string::npos);
+    CHECK(applySelection(repo, "f.txt", staged, {{deletedHunk, {deleted}}}, true));
+    replaceOnce(expected, "line 19\n", "line 19\nline 20\n");
+    CHECK_EQ(repo.indexed("f.txt"), expected);
+}
+
+void stagesPartOfNewAndDeletedFiles() {
+    ScratchRepository repo;
+    repo.write("keep.txt", "k\n");
+    repo.write("del.txt", "x\ny\nz\n");
+    repo.commit("base");
+
+    // Part of an untracked file: the patch still creates it
+    repo.write("new.txt", "a\nb\nc\n");
+    GitPatch patch = worktreePatch(repo, "new.txt");
+    CHECK(patch.fileCount() == 1 && patch.file(0).isNewFile);
+    CHECK(applySelection(repo, "new.txt", patch, {{0, {0, 2}}}, false));
+    CHECK_EQ(repo.indexed("new.txt"), "a\nc\n");
+
+    // Part of it back out: the creation header becomes a modification, the file stays in the index
+    GitPatch staged = worktreePatch(repo, "new.txt", true);
+    CHECK(staged.fileCount() == 1 && staged.file(0).isNewFile);
+    CHECK(applySelection(repo, "new.txt", staged, {{0, {1}}}, true));
+    CHECK_EQ(repo.indexed("new.txt"), "a\n");
+    // All of it back out removes it
+    staged = worktreePatch(repo, "new.txt", true);
+    CHECK(applySelection(repo, "new.txt", staged, {{0, {}}}, true));
+    CHECK(!repo.isIndexed("new.txt"));
+
+    // Part of a removal: a modification, the file stays in the index
+    std::filesystem::remove(std::filesystem::path(repo.path()) / "del.txt");
+    patch = worktreePatch(repo, "del.txt");
+    CHECK(patch.fileCount() == 1 && patch.file(0).isDeletedFile);
+    CHECK(applySelection(repo, "del.txt", patch, {{0, {1}}}, false));
+    CHECK_EQ(repo.indexed("del.txt"), "x\nz\n");
+    patch = worktreePatch(repo, "del.txt");
+    CHECK(applySelection(repo, "del.txt", patch, {{0, {}}}, false));
+    CHECK(!repo.isIndexed("del.txt"));
+}
+
+void keepsTheNoNewlineMarkerWithItsLine() {
+    ScratchRepository repo;
+    repo.write("t.txt", "one\ntwo");
+    repo.commit("base");
+    repo.write("t.txt", "one\ntwo\nthree changed");
+
+    // "-two" / "+two" / "+three changed", the last two without a newline at the end
+    GitPatch patch = worktreePatch(repo, "t.txt");
+    CHECK(applySelection(repo, "t.txt", patch, {{0, {}}}, false));
+    CHECK_EQ(repo.indexed("t.txt"), "one\ntwo\nthree changed");
+
+    repo.git({"reset", "-q"});
+    patch = worktreePatch(repo, "t.txt");
+    // Only the change that adds the newline after "two": the old last line stays as context, without its marker
+    size_t removed = lineOf(patch, 0, 0, "two", GitDiffLine::Type::Deletion);
+    size_t added = lineOf(patch, 0, 0, "two", GitDiffLine::Type::Addition);
+    CHECK(removed != std::string::npos && added != std::string::npos);
+    CHECK(applySelection(repo, "t.txt", patch, {{0, {removed, added}}}, false));
+    CHECK_EQ(repo.indexed("t.txt"), "one\ntwo\n");
+}
+
+void emptyWhenNothingChanges() {
+    GitPatch patch = GitPatch::parse(
+        "diff --git a/f.txt b/f.txt\n"
+        "--- a/f.txt\n"
+        "+++ b/f.txt\n"
+        "@@ -1,3 +1,3 @@\n"
+        " a\n"
+        "-b\n"
+        "+B\n"
+        " c\n"
+        "diff --git a/i.png b/i.png\n"
+        "Binary files a/i.png and b/i.png differ\n");
+    CHECK(patch.selectionPatch(0, {}).empty());
+    CHECK(patch.selectionPatch(0, {{0, {0, 3}}}).empty());  // Context lines only
+    CHECK(patch.selectionPatch(0, {{5, {}}}).empty());      // No such hunk
+    CHECK(patch.selectionPatch(1, {{0, {}}}).empty());      // Binary
+    CHECK(!patch.selectionPatch(0, {{0, {1}}}).empty());
+
+    // A hunk the budget did not load cannot be staged from its header alone
+    GitPatch::Builder builder(GitDiffBudget{0, 1, 0});
+    builder.feed(patch.text());
+    GitPatch budgeted = builder.finish();
+    CHECK(budgeted.hunkCount() >= 1 && !budgeted.hunk(0).isLoaded);
+    CHECK(budgeted.selectionPatch(0, {{0, {}}}).empty());
+}
+
+}
+
+int main() {
+    stagesALaterHunkPastUnselectedOnes();
+    unstagesLinesWithTheRolesSwapped();
+    stagesPartOfNewAndDeletedFiles();
+    keepsTheNoNewlineMarkerWithItsLine();
+    emptyWhenNothingChanges();
+    return Testing::testResult("SelectionPatchTest");
+}
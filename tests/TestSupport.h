@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// Minimal checks for the core behavior tests: no framework, so the tests build
+// wherever GitCore does. A failed CHECK prints its location and the test keeps
+// going; main() returns testResult() so ctest sees the failure.
+
+namespace VersionTools::Testing {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char* file, int line, const std::string& message) {
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, message.c_str());
+    ++failures();
+}
+
+inline std::string describe(std::string_view value) { return "\"" + std::string(value) + "\""; }
+inline std::string describe(const std::string& value) { return describe(std::string_view(value)); }
+inline std::string describe(const char* value) { return describe(std::string_view(value)); }
+inline std::string describe(bool value) { return value ? "true" : "false"; }
+template <typename T>
+std::string describe(const T& value) {
+    return std::to_string(value);
+}
+
+template <typename A, typename E>
+void checkEqual(const A& actual, const E& expected, const char* text, const char* file, int line) {
+    if (!(actual == expected)) {
+        fail(file, line, std::string(text) + ": got " + describe(actual) + ", expected " + describe(expected));
+    }
+}
+
+inline int testResult(const char* name) {
+    if (failures() == 0) {
+        std::printf("%s: ok\n", name);
+        return 0;
+    }
+    std::fprintf(stderr, "%s: %d check(s) failed\n", name, failures());
+    return 1;
+}
+
+}
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            ::VersionTools::Testing::fail(__FILE__, __LINE__, #condition); \
+        }                                                                   \
+    } while (0)
+
+// For values describe() can print: strings, string_views, bools and numbers
+#define CHECK_EQ(actual, expected) \
+    ::VersionTools::Testing::checkEqual((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)